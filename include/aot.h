@@ -0,0 +1,79 @@
+#ifndef AOT_H
+#define AOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "chip8.h"
+
+// Ahead-of-time compiled ROMs. chip8-aot turns one ROM into a C source file
+// with a function per basic block (see cfg.h); built as a shared object it
+// is a plug-in core that run_cycles prefers over the JIT and the
+// interpreter while it matches the machine:
+//
+//     chip8-aot -o aot/Tetris.c roms/Tetris.ch8
+//     cc -O2 -fPIC -shared -Iinclude aot/Tetris.c -o aot/Tetris.so
+//     chip8-headless --aot aot/Tetris.so roms/Tetris.ch8
+//
+// Register, timer and memory instructions are inlined; jumps, calls and
+// skips with a known target call the next block directly (tail calls at
+// -O2). The back edge of an idle loop returns instead, so the dispatcher
+// can skip whole iterations as the JIT's does. Everything that draws,
+// waits for a key or ends the run goes back to the dispatcher, which runs
+// it on the interpreter, and so do BNNN and returns, whose targets are
+// looked up in the block table: an address no block starts at runs on the
+// interpreter one instruction at a time.
+//
+// The module only runs after load_chip8 (or a save state) if the profile
+// and every compiled byte match. A memory write over compiled code turns it
+// off until the next reset: the rest of the run uses the JIT or the
+// interpreter, as without a module.
+
+#define AOT_ABI_VERSION 1
+#define AOT_SYMBOL "chip8_aot_module" // The aot_module_t a module exports
+
+// Runs the block's instructions and those of the blocks it calls directly,
+// returns the budget left (unchanged, with pc on the block, when the first
+// block does not fit)
+typedef uint32_t ( *aot_block_fn_t ) ( chip8_t *chip8 , uint32_t budget ) ;
+
+typedef struct {
+    uint16_t address ; // First instruction
+    uint16_t length ;  // Bytes compiled into fn, from address on
+    uint16_t count ;   // Instructions fn runs before it returns or calls another block
+    bool idle_loop ;   // Head of a loop of idle instructions, checked by the dispatcher
+    aot_block_fn_t fn ;
+} aot_block_t ;
+
+typedef struct {
+    uint32_t abi ;          // AOT_ABI_VERSION
+    uint32_t chip8_size ;   // sizeof ( chip8_t ) in the build that compiled the module
+    quirks_t quirks ;       // Profile the code was generated for
+    const uint8_t *rom ;    // The ROM image, loaded at 0x200
+    uint32_t rom_size ;
+    const aot_block_t *blocks ; // Sorted by address
+    uint32_t block_count ;
+} aot_module_t ;
+
+typedef struct aot {
+    bool active ; // Module matches the machine, run_cycles uses it
+    // invalidate_decoded, for the instructions that write memory
+    void ( *invalidate ) ( chip8_t *chip8 , uint16_t address , uint16_t length ) ;
+    const aot_module_t *module ;
+    const aot_block_t **table ; // Block starting at each address, NULL where none does
+    uint8_t *compiled ;         // Per address: 1 when compiled into a block
+    uint16_t mask ;
+    void *handle ;
+} aot_t ;
+
+// Load a module (before init_chip8, like jit_enable); false when it cannot
+// be opened or was built for another ABI or chip8_t layout
+bool aot_load ( chip8_t *chip8 , const char *path ) ;
+void aot_unload ( chip8_t *chip8 ) ;
+// Turn the module on if it matches the profile and memory (load_chip8 and
+// save states call this)
+void aot_reset ( chip8_t *chip8 ) ;
+// Called by invalidate_decoded: a write over compiled code turns it off
+void aot_invalidate ( aot_t *aot , uint16_t address , uint16_t length ) ;
+uint32_t aot_run ( chip8_t *chip8 , uint32_t cycles ) ;
+
+#endif // AOT_H
@@ -0,0 +1,136 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "chip8.h"
+#include "display.h"
+
+// Batched core: many instances ("lanes") of one ROM stepped together, for
+// search and training workloads that run thousands of copies of the same
+// game with different inputs. The machine state is kept in structure-of-
+// arrays form, one array per register with a byte (or word) per lane, so
+// one instruction runs over every lane with vector instructions:
+//
+//     chip8_batch_t *batch = batch_create ( 4096 , QUIRKS_CHIP8 ) ;
+//     batch_load ( batch , rom , rom_size ) ;
+//     batch_reset ( batch , seeds ) ;        // One RNG seed per lane
+//     for ( ;; ) {
+//         batch->keys[lane] = ... ;          // Each lane's keypad, bit n = key n
+//         batch_step ( batch , 12 ) ;        // One frame at 720 instructions/s
+//         batch_tick_timers ( batch ) ;
+//     }
+//
+// Lanes start together and stay together until they take different ways
+// out of an instruction: a skip, a return, BNNN, FX0A... They are kept in
+// groups of lanes at the same pc, and each instruction runs once per group,
+// on every lane in it. Register, timer, I, RNG, skip and key instructions
+// are vectorised (AVX2 when the CPU has it, else the baseline SSE2), lanes
+// outside the group masked off; draws, scrolls, memory and stack
+// instructions run lane by lane. A group splits where its lanes part and
+// merges with any other that reaches the same pc. Lanes at more pcs than
+// BATCH_MAX_GROUPS hold run on their own. When most lanes run one at a
+// time, on their own or at instructions the vector code does not cover,
+// batch_step moves each running lane onto a chip8_t of its own and runs it
+// with run_cycles, as fast as a loop over separate machines, until the lane
+// is reset or imported (lanes of the VIP profile, which wait for the frame
+// after a draw, run their instructions in a row in the arrays instead).
+//
+// Every lane gives the same results as a chip8_t running the same ROM
+// with the same keys and seed: batch_step ( batch , n ) followed by
+// batch_tick_timers matches run_cycles ( chip8 , n ) and tick_timers,
+// including the VIP profile waiting for the next frame after a draw. The
+// 4K profiles are supported; XO-CHIP (64K of memory per lane) is not.
+
+#define BATCH_VECTOR_BYTES 32 // Lanes per byte vector (one AVX2 register, two SSE2 ones)
+#define BATCH_MAX_GROUPS 16   // Groups of lanes at one pc (see chip8_batch_t.group)
+
+#define BATCH_GROUP_DETACHED 0xFC
+#define BATCH_GROUP_PARKED 0xFD
+#define BATCH_GROUP_NONE 0xFE
+#define BATCH_GROUP_ALONE 0xFF
+
+// Lane states
+enum {
+    BATCH_RUNNING = 0 ,
+    BATCH_WAITING ,   // VIP: drew this frame, continues after batch_tick_timers
+    BATCH_STOPPED ,   // 00FD
+} ;
+
+typedef struct chip8_batch {
+    uint32_t lanes ;  // Instances
+    uint32_t stride ; // lanes rounded up to BATCH_VECTOR_BYTES, the length of every per-lane array
+    quirks_t quirks ;
+    const quirk_set_t *quirk_set ;
+    uint32_t rom_size ;
+
+    // Registers, structure of arrays: register r of lane l is at [r * stride + l]
+    uint8_t *V ;            // [16][stride]
+    uint16_t *stack ;       // [CHIP8_STACK_SIZE][stride]
+    uint8_t *flags ;        // [16][stride], SUPER-CHIP FX75/FX85
+    uint16_t *I ;           // [stride]
+    uint16_t *pc ;          // [stride], for lanes outside the groups (see group)
+    uint8_t *sp ;           // [stride]
+    uint8_t *delay_timer ;  // [stride]
+    uint8_t *sound_timer ;  // [stride]
+    uint32_t *rng ;         // [stride], xorshift32 for CXNN
+    uint16_t *keys ;        // [stride], keypad of each lane, bit n = key n down (set by the caller)
+    uint8_t *state ;        // [stride], BATCH_RUNNING, BATCH_WAITING or BATCH_STOPPED
+    uint8_t *hires ;        // [stride]
+    uint8_t *plane_mask ;   // [stride]
+
+    // Per-lane blocks: lane l's 4K of memory and display planes
+    uint8_t *memory ;                            // [lanes][CHIP8_MEMORY_SIZE]
+    display_plane_t (*display)[CHIP8_PLANES] ;   // [lanes]
+
+    // The ROM as loaded, decoded once for every lane. A lane writing into
+    // an address sets it in `written`: instructions there are then read
+    // from each lane's own memory.
+    uint8_t image[CHIP8_MEMORY_SIZE] ;
+    decoded_inst_t decoded[CHIP8_MEMORY_SIZE] ;
+    uint8_t written[CHIP8_MEMORY_SIZE] ;
+
+    // Running lanes at the same pc form a group: group[l] is the group of
+    // lane l, whose pc is group_pc of the group rather than pc[l]. Lanes
+    // not in one have BATCH_GROUP_NONE (waiting, stopped, the padding),
+    // BATCH_GROUP_ALONE (running on their own at pc[l]),
+    // BATCH_GROUP_PARKED (in an idle loop, skipped to the end of the
+    // batch_step call as run_cycles does, at pc[l]) or BATCH_GROUP_DETACHED
+    // (running on machine[l], which holds the lane's state: only state[l]
+    // and keys[l] of the arrays still apply to it).
+    uint8_t *group ;        // [stride]
+    uint16_t group_pc[BATCH_MAX_GROUPS] ;
+    uint32_t group_size[BATCH_MAX_GROUPS] ;
+    uint32_t groups ;       // Groups in use, 0 to groups - 1
+    uint32_t alone ;        // Lanes in BATCH_GROUP_ALONE
+    uint32_t parked ;       // Lanes in BATCH_GROUP_PARKED
+    uint32_t detached ;     // Lanes in BATCH_GROUP_DETACHED
+    chip8_t **machine ;     // [stride], a lane's own machine from the first time it is detached (kept for reuse)
+    uint32_t scalar_share ; // Running average, in 256ths, of the lanes run one at a time per step
+    const struct batch_kernel *kernel ; // Vector code for the CPU (see batch.c)
+} chip8_batch_t ;
+
+// NULL when out of memory or for XO-CHIP (QUIRKS_AUTO means QUIRKS_CHIP8).
+// A lane takes about 6 KB, plus a chip8_t (about 100 KB) once detached.
+chip8_batch_t *batch_create ( uint32_t lanes , quirks_t quirks ) ;
+void batch_destroy ( chip8_batch_t *batch ) ;
+// Load a ROM at 0x200 of every lane and reset them all with the default seed
+bool batch_load ( chip8_batch_t *batch , const uint8_t *rom , size_t rom_size ) ;
+// Power-on state for every lane, the RNG of lane l seeded with seeds[l]
+// (CHIP8_RNG_SEED for all of them when seeds is NULL, and for a seed of 0)
+void batch_reset ( chip8_batch_t *batch , const uint32_t *seeds ) ;
+void batch_reset_lane ( chip8_batch_t *batch , uint32_t lane , uint32_t seed ) ;
+// Run `steps` instructions on every running lane; returns the instructions
+// run, summed over the lanes (waiting and stopped lanes do not count)
+uint64_t batch_step ( chip8_batch_t *batch , uint32_t steps ) ;
+// Frame boundary: decrement the timers, wake lanes waiting for the frame
+void batch_tick_timers ( chip8_batch_t *batch ) ;
+// Copy a lane into a chip8_t (to render, hash or save it) and back; the
+// chip8_t must be set up for the batch's ROM and profile (load_chip8)
+void batch_export_lane ( chip8_batch_t *batch , uint32_t lane , chip8_t *chip8 ) ;
+void batch_import_lane ( chip8_batch_t *batch , uint32_t lane , const chip8_t *chip8 ) ;
+// Instruction set the vector code was compiled for: "avx2", "sse2" or "scalar"
+const char *batch_simd_name ( const chip8_batch_t *batch ) ;
+
+#endif // BATCH_H
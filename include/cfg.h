@@ -0,0 +1,78 @@
+#ifndef CFG_H
+#define CFG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "chip8.h"
+
+// Static control-flow analysis of a loaded ROM image: starting at the entry
+// point it follows jumps, calls, returns and both ways out of every skip,
+// and splits the reached code into basic blocks. Bytes that are never
+// reached are data; ANNN (and XO-CHIP F000 NNNN) targets outside code are
+// tagged as data references. BNNN jumps to a register-dependent address
+// and cannot be followed: those blocks are reported as computed jumps with
+// no successors, and code reached only through them shows up as data.
+//
+// chip8-disasm prints the listing and writes the graph as DOT or JSON;
+// init_chip8 uses the block table to decode (and, with the JIT, compile)
+// every reachable instruction before the first frame (cfg_prewarm).
+
+// Per-address bits of cfg_t::map
+#define CFG_CODE     0x01 // An instruction starts here
+#define CFG_OPERAND  0x02 // Second byte (or F000's address word) of an instruction
+#define CFG_LEADER   0x04 // A basic block starts here
+#define CFG_DATA_REF 0x08 // Loaded into I by ANNN / F000 NNNN
+#define CFG_CALLED   0x10 // Target of a CALL (a subroutine entry)
+
+typedef enum {
+    CFG_END_FALLTHROUGH , // Runs into the next block (which is a jump or call target)
+    CFG_END_JUMP ,        // 1NNN
+    CFG_END_SKIP ,        // 3XNN, 4XNN, 5XY0, 9XY0, EX9E, EXA1: next instruction or the one after
+    CFG_END_CALL ,        // 2NNN, continues after the call when it returns
+    CFG_END_RETURN ,      // 00EE
+    CFG_END_EXIT ,        // 00FD
+    CFG_END_COMPUTED ,    // BNNN, target unknown
+    CFG_END_OUTSIDE ,     // Ran off the end of the ROM image
+} cfg_end_t ;
+
+typedef struct {
+    uint16_t start ;        // First instruction
+    uint16_t last ;         // Last instruction
+    uint16_t end ;          // First byte after the block
+    cfg_end_t kind ;
+    uint8_t successor_count ;
+    uint16_t successors[2] ; // Taken order: fall-through/next first, then the skip target
+    uint16_t call_target ;  // CFG_END_CALL only
+} cfg_block_t ;
+
+typedef struct {
+    const uint8_t *memory ; // The analysed image, must outlive the cfg
+    uint16_t mask ;         // Address wrap (4K, or 64K for XO-CHIP)
+    bool xo_chip ;          // F000 NNNN is four bytes and skips step over it whole
+    uint16_t start ;        // Entry point
+    uint32_t end ;          // First byte after the ROM image
+    uint8_t *map ;          // mask + 1 entries of CFG_* bits
+    cfg_block_t *blocks ;   // Sorted by start address
+    size_t block_count ;
+    uint16_t *computed ;    // Addresses of the BNNN instructions found
+    size_t computed_count ;
+} cfg_t ;
+
+// Analyse [start, end) of `memory`; false (nothing to free) when out of memory
+bool cfg_analyze ( cfg_t *cfg , const uint8_t *memory , uint16_t mask , bool xo_chip , uint16_t start , uint32_t end ) ;
+void cfg_free ( cfg_t *cfg ) ;
+// The block containing the instruction at address, or NULL
+const cfg_block_t *cfg_block_at ( const cfg_t *cfg , uint16_t address ) ;
+
+// Decode every reached instruction into the decode cache and compile each
+// block on the JIT when enabled (chip8->memory must be the analysed image)
+void cfg_prewarm ( chip8_t *chip8 , const cfg_t *cfg ) ;
+
+// Disassembly of the whole image: labelled blocks, then data as DB lines
+void cfg_print_listing ( const cfg_t *cfg , FILE *out ) ;
+bool cfg_write_dot ( const cfg_t *cfg , const char *path ) ;
+bool cfg_write_json ( const cfg_t *cfg , const char *path ) ;
+
+#endif // CFG_H
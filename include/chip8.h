@@ -6,14 +6,27 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
-#include <SDL2/SDL.h>
 #include "config.h"
 
 
 
-#define CHIP8_MEMORY_SIZE 4096
-#define CHIP8_DISPLAY_WIDTH 64
+// The core has no SDL dependency: diagnostics go straight to stderr
+#define CHIP8_LOG(...) fprintf ( stderr , __VA_ARGS__ )
+
+#define CHIP8_MEMORY_SIZE 4096      // CHIP-8 and SUPER-CHIP address space
+#define CHIP8_MAX_MEMORY_SIZE 65536 // XO-CHIP address space, the size of chip8_t.memory
+#define CHIP8_DISPLAY_WIDTH 64      // Low resolution
 #define CHIP8_DISPLAY_HEIGHT 32
+#define CHIP8_HIRES_WIDTH 128       // SUPER-CHIP high resolution (00FF)
+#define CHIP8_HIRES_HEIGHT 64
+#define CHIP8_ROW_WORDS ( CHIP8_HIRES_WIDTH / 64 )
+#define CHIP8_PLANES 2              // XO-CHIP bitplanes, selected with FN01
+#define CHIP8_BIG_FONT_ADDRESS 0x50 // SUPER-CHIP 8x10 digits (FX30), after the 4x5 font
+#define CHIP8_STACK_SIZE 16
+#define CHIP8_FRAME_RATE 60 // Timer tick rate in Hz, one emulated frame per tick
+#define CHIP8_RNG_SEED 0x2545F491u // Default seed for chip8_t.rng (never 0)
+#define IDLE_MAX_STEPS 32     // Longest idle loop iteration recognised, in instructions
+#define IDLE_MIN_REMAINING 64 // skip_idle_loop is not worth calling with fewer cycles left
 
 
 typedef enum { 
@@ -22,39 +35,193 @@ typedef enum {
     STOPPED , 
 
 }state_t ;
+
+// Quirk profiles: the behaviours that differ between CHIP-8 implementations.
+// Each one has its own copy of the interpreter loop (see interpreter.inc).
+typedef enum {
+    QUIRKS_AUTO = 0 , // Chosen from the ROM by init_chip8
+    QUIRKS_CHIP8 ,    // This emulator's original behaviour, the default
+    QUIRKS_VIP ,      // COSMAC VIP
+    QUIRKS_CHIP48 ,   // CHIP-48 on the HP-48
+    QUIRKS_SCHIP ,    // SUPER-CHIP 1.1
+    QUIRKS_XO_CHIP ,  // Octo's XO-CHIP
+    QUIRKS_COUNT
+} quirks_t ;
+
+// Where FX55/FX65 leave I
+typedef enum {
+    INDEX_UNCHANGED , // I stays put
+    INDEX_LAST ,      // I += X (CHIP-48)
+    INDEX_PAST_LAST , // I += X + 1 (COSMAC VIP)
+} index_quirk_t ;
+
+typedef struct {
+    const char *name ;     // As given to --quirks
+    bool vf_reset_or_xor ; // 8XY1/8XY3 clear VF
+    bool vf_reset_and ;    // 8XY2 clears VF
+    bool shift_vy ;        // 8XY6/8XYE shift VY into VX instead of shifting VX in place
+    index_quirk_t index ;  // FX55/FX65
+    bool jump_vx ;         // BXNN jumps to XNN + VX instead of NNN + V0
+    bool clip ;            // Sprites are cut off at the screen edges instead of wrapping
+    bool display_wait ;    // DXYN ends the frame (the VIP waits for the vertical blank)
+    bool xo_chip ;         // 64K address space and four-byte F000 NNNN
+} quirk_set_t ;
+// Handler indices stored in decoded_inst_t::op
+enum {
+    OP_DECODE = 0 , // Not decoded yet: decode, cache and re-dispatch
+    OP_NOP ,
+    OP_CLS ,        // 00E0
+    OP_RET ,        // 00EE
+    OP_JP ,         // 1NNN
+    OP_CALL ,       // 2NNN
+    OP_SE_VX_NN ,   // 3XNN
+    OP_SNE_VX_NN ,  // 4XNN
+    OP_SE_VX_VY ,   // 5XY0
+    OP_LD_VX_NN ,   // 6XNN
+    OP_ADD_VX_NN ,  // 7XNN
+    OP_LD_VX_VY ,   // 8XY0
+    OP_OR ,         // 8XY1
+    OP_AND ,        // 8XY2
+    OP_XOR ,        // 8XY3
+    OP_ADD_VX_VY ,  // 8XY4
+    OP_SUB ,        // 8XY5
+    OP_SHR ,        // 8XY6
+    OP_SUBN ,       // 8XY7
+    OP_SHL ,        // 8XYE
+    OP_SNE_VX_VY ,  // 9XY0
+    OP_LD_I ,       // ANNN
+    OP_JP_V0 ,      // BNNN
+    OP_RND ,        // CXNN
+    OP_DRW ,        // DXYN
+    OP_SKP ,        // EX9E
+    OP_SKNP ,       // EXA1
+    OP_LD_VX_DT ,   // FX07
+    OP_LD_VX_K ,    // FX0A
+    OP_LD_DT_VX ,   // FX15
+    OP_LD_ST_VX ,   // FX18
+    OP_ADD_I_VX ,   // FX1E
+    OP_LD_F_VX ,    // FX29
+    OP_LD_B_VX ,    // FX33
+    OP_LD_MEM_VX ,  // FX55
+    OP_LD_VX_MEM ,  // FX65
+    OP_SCD ,        // 00CN (SUPER-CHIP)
+    OP_SCU ,        // 00DN (XO-CHIP)
+    OP_SCR ,        // 00FB (SUPER-CHIP)
+    OP_SCL ,        // 00FC (SUPER-CHIP)
+    OP_EXIT ,       // 00FD (SUPER-CHIP)
+    OP_LORES ,      // 00FE (SUPER-CHIP)
+    OP_HIRES ,      // 00FF (SUPER-CHIP)
+    OP_SAVE_RANGE , // 5XY2 (XO-CHIP)
+    OP_LOAD_RANGE , // 5XY3 (XO-CHIP)
+    OP_LD_I_LONG ,  // F000 NNNN (XO-CHIP), NNN holds the second word
+    OP_PLANE ,      // FN01 (XO-CHIP)
+    OP_LD_HF_VX ,   // FX30 (SUPER-CHIP)
+    OP_SAVE_FLAGS , // FX75 (SUPER-CHIP)
+    OP_LOAD_FLAGS , // FX85 (SUPER-CHIP)
+    OP_COUNT
+} ;
+
+// Pre-decoded instruction, filled in the first time an address is executed
 typedef struct {
-    uint16_t opcode ; 
-    uint16_t NNN ; 
-    uint8_t NN ; 
-    uint8_t N ; 
+    uint8_t op ; // Handler index (0 = not decoded yet)
     uint8_t X ;
-    uint8_t Y ;  
-} instruction_t  ; 
+    uint8_t Y ;
+    uint8_t N ;
+    uint8_t NN ;
+    uint16_t NNN ;
+} decoded_inst_t ;
+
+struct jit ;
+struct aot ;
+struct profiler ;
+struct debugger ;
 
 typedef struct { 
-    bool  display[CHIP8_DISPLAY_WIDTH * CHIP8_DISPLAY_HEIGHT]; // 64x32 pixel monochrome display
+    // Bitplanes, one row of CHIP8_ROW_WORDS words per line, bit 63 of word 0 = leftmost pixel.
+    // Low resolution uses word 0 of rows 0-31 only, high resolution the whole 128x64.
+    uint64_t display[CHIP8_PLANES][CHIP8_HIRES_HEIGHT][CHIP8_ROW_WORDS];
+    bool hires; // 128x64 mode (00FF)
+    uint8_t plane_mask; // Planes drawn, cleared and scrolled (FN01), 1 after reset
+    bool xo_chip; // 64K address space and 4-byte F000 NNNN, set with the XO-CHIP profile
+    quirks_t quirks; // Profile in effect, set by init_chip8
+    quirks_t quirks_request; // Profile asked for, kept across init_chip8 (QUIRKS_AUTO picks one per ROM)
+    bool idle_skip_off; // Run idle loops out instead of skipping them (to time the core), kept across init_chip8
     bool keypad[16];        // Hexadecimal keypad 0x0-0xF
-    uint8_t memory[CHIP8_MEMORY_SIZE];// 4K memory
+    uint8_t memory[CHIP8_MAX_MEMORY_SIZE];// 4K, or 64K for XO-CHIP (see chip8_address_mask)
     uint8_t V[16] ; // General purpose registers V0 to VF
     uint16_t I; // Index register
     uint16_t pc; // Program counter
-    uint16_t stack[16]; // Stack for subroutine calls
-    uint16_t *sp; // Stack pointer
+    uint16_t stack[CHIP8_STACK_SIZE]; // Stack for subroutine calls
+    uint8_t sp; // Stack pointer, index of the next free slot (wraps at CHIP8_STACK_SIZE)
     uint8_t delay_timer; // Delay timer
     uint8_t sound_timer; // Sound timer
-    uint32_t pixel_color[64 * 32]; // Color of the pixels (for rendering)
+    uint8_t flags[16]; // SUPER-CHIP persistent flag registers (FX75/FX85)
+    uint32_t rng; // xorshift32 state for 0xCXNN, per instance so parallel runs stay reproducible
     state_t state;
     const char *rom_name;
-    instruction_t inst;
+    uint32_t rom_size; // Bytes loaded at 0x200
+    decoded_inst_t decoded[CHIP8_MEMORY_SIZE]; // Decode cache, one entry per address of the 4K profiles
+    decoded_inst_t *decoded_xo; // XO-CHIP's cache for the 64K address space, allocated by load_chip8 and kept across resets (free_chip8)
+    struct jit *jit; // Native code cache, NULL when running on the interpreter
+    struct debugger *debugger; // Breakpoints and watchpoints (see debugger.h), NULL when not attached
+    struct aot *aot; // Ahead-of-time compiled ROM (see aot.h), NULL when none is loaded
+#ifdef CHIP8_PROFILE
+    struct profiler *profiler; // Execution counters (see profiler.h), NULL when not attached
+#endif
     char rom_name_copy[256];
     char save_filename[300];
  
 } chip8_t;
 
 
+// Addresses wrap at 4K, or at 64K for XO-CHIP
+static inline uint16_t chip8_address_mask ( const chip8_t *chip8 ) {
+    return chip8->xo_chip ? CHIP8_MAX_MEMORY_SIZE - 1 : CHIP8_MEMORY_SIZE - 1 ;
+}
+
+// Decode cache of the address space in use, chip8_address_mask + 1 entries
+static inline decoded_inst_t *chip8_decode_cache ( chip8_t *chip8 ) {
+    return chip8->xo_chip ? chip8->decoded_xo : chip8->decoded ;
+}
+
+// Reads only V, the delay timer and the keypad; writes only V and pc (see skip_idle_loop)
+static inline bool idle_instruction ( uint8_t op ) {
+    switch ( op ) {
+        case OP_NOP : case OP_JP : case OP_SE_VX_NN : case OP_SNE_VX_NN : case OP_SE_VX_VY : case OP_SNE_VX_VY :
+        case OP_SKP : case OP_SKNP : case OP_LD_VX_DT : case OP_LD_VX_NN : case OP_LD_VX_VY :
+            return true ;
+        default :
+            return false ;
+    }
+}
+
+// Colour index of pixel (x, y) in the current resolution: bit n = plane n
+static inline uint8_t chip8_pixel ( const chip8_t *chip8 , uint32_t x , uint32_t y ) {
+    uint8_t color = 0 ;
+    for ( uint32_t plane = 0 ; plane < CHIP8_PLANES ; plane++ ) {
+        color |= ((chip8->display[plane][y][x / 64] >> (63 - x % 64)) & 1) << plane ;
+    }
+    return color ;
+}
+
 bool init_chip8(chip8_t *chip8 ,const char rom_name[]) ; 
+bool load_chip8 ( chip8_t *chip8 , const uint8_t *rom , size_t rom_size , const char *rom_name ) ;
+// Release what load_chip8 allocated (the XO-CHIP decode cache); the machine can be loaded again
+void free_chip8 ( chip8_t *chip8 ) ;
+const quirk_set_t *chip8_quirk_set ( quirks_t quirks ) ;
+bool chip8_parse_quirks ( const char *name , quirks_t *quirks ) ;
 void run_intructions ( chip8_t *chip8 ) ; 
-bool save_state ( chip8_t *chip8 , char *save_file ,size_t save_file_size , int slot) ;
-bool load_state ( chip8_t *chip8 , char *save_file , size_t save_file_size , int slot ) ;
+void tick_timers ( chip8_t *chip8 ) ;
+uint32_t run_cycles ( chip8_t *chip8 , uint32_t cycles ) ;
+uint32_t run_interpreter ( chip8_t *chip8 , uint32_t cycles ) ;
+// COSMAC VIP timing: run until *budget_us microseconds are spent (see chip8.c)
+uint32_t run_timed ( chip8_t *chip8 , uint32_t cycles , int64_t *budget_us ) ;
+uint8_t decode_op ( uint16_t opcode ) ;
+const decoded_inst_t *fetch_decoded ( chip8_t *chip8 , uint16_t address ) ;
+uint32_t instruction_cost_us ( chip8_t *chip8 ) ;
+void invalidate_decoded ( chip8_t *chip8 , uint16_t address , uint16_t length ) ;
+// Forget every cached decode (after the memory was replaced)
+void flush_decoded ( chip8_t *chip8 ) ;
+uint32_t skip_idle_loop ( chip8_t *chip8 , uint16_t start , uint32_t remaining ) ;
 
 #endif // CHIP8_H
\ No newline at end of file
@@ -13,12 +13,22 @@ typedef struct {
     SDL_Renderer *renderer;
     SDL_AudioDeviceID chip8_audio_device; 
     SDL_AudioSpec desired_spec , obtained_spec ;
+    SDL_Texture *screen_texture; // 128x64 streaming texture holding the framebuffer (2x2 texels per low-resolution pixel)
+    SDL_Texture *grid_texture; // Window-sized pixel grid overlay (pixelized mode), 64x32 cells
+    SDL_Texture *hires_grid_texture; // The same with 128x64 cells
+    uint64_t last_frame[CHIP8_PLANES][CHIP8_HIRES_HEIGHT][CHIP8_ROW_WORDS]; // Display last uploaded to screen_texture
+    bool last_hires; // Resolution of that upload
+    uint32_t last_fg_color , last_bg_color ; // Palette used for that upload
+    bool frame_uploaded; // screen_texture holds a valid frame
+    uint32_t pixels[CHIP8_HIRES_WIDTH * CHIP8_HIRES_HEIGHT]; // RGBA frame expanded from the planes, uploaded to screen_texture
 } sdl_t;
 
 bool init_display ( sdl_t * sdl , config_t *config ) ; 
 void close_display ( sdl_t * sdl ) ; 
 void clear_display ( sdl_t *sdl , config_t config ) ; 
 void update_display ( sdl_t *sdl , chip8_t *chip8 , config_t config ) ;
+// The same from a copy of the display planes (the main thread draws frames the emulation thread published)
+void present_frame ( sdl_t *sdl , const uint64_t display[CHIP8_PLANES][CHIP8_HIRES_HEIGHT][CHIP8_ROW_WORDS] , bool hires , config_t config ) ;
 void audio_callback ( void *userdata , uint8_t * stream , int len ) ;
 
 
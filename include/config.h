@@ -12,11 +12,22 @@ typedef struct {
     uint32_t scale_factor; // scaling factor for display
     uint32_t fg_color; // foreground color
     uint32_t bg_color; // background color
+    uint32_t plane1_color; // XO-CHIP: pixels set only in the second plane (fg_color is the first)
+    uint32_t overlap_color; // XO-CHIP: pixels set in both planes
     bool pixelized; // whether to draw pixel borders
     uint32_t instructions_per_second; // Number of instructions to execute per second
     uint32_t sqr_freq; // Frequency in Hz
     int16_t volume; // Volume (0-128)
     uint32_t sample_rate; // Audio sample rate
+    bool use_jit; // Run on the x86-64 JIT instead of the interpreter
+    bool vip_timing; // Pace instructions by COSMAC VIP per-opcode timings instead of instructions_per_second
+    uint32_t speed; // Emulated frames per real-time frame (1 = real time, 0 = uncapped)
+    uint32_t turbo_speed; // speed while Tab is held (0 = uncapped)
+    uint32_t render_interval; // Faster than real time, draw only every Nth emulated frame (0 = once per real-time frame)
+    uint32_t rewind_budget; // Bytes reserved for the rewind history
+    uint32_t rewind_keyframe_interval; // Frames between full snapshots in the rewind history
+    const char *library_path; // ROM index with per-ROM overrides (see library.h)
+    uint8_t keymap[16]; // CHIP-8 key sent by the host key normally mapped to key k
 
 } config_t;
 
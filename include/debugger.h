@@ -0,0 +1,109 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "chip8.h"
+
+// Debugger: PC breakpoints, conditional breaks on register values, write
+// watchpoints and stepping, driven from a command prompt (debugger_prompt).
+//
+// Checks live in a separate copy of the interpreter (interpret_debug in
+// chip8.c). run_interpreter only switches to it while a breakpoint or
+// watchpoint is set, so an attached debugger with nothing set costs one
+// branch per run_interpreter call and the normal loops are untouched. The
+// debug copy tests one bit of break_map per instruction; only a set bit
+// calls debugger_check. Watchpoints are tested after FX33, FX55 and 5XY2,
+// the instructions that write memory at I. The JIT and idle-loop skipping
+// are off while debugging, so every instruction goes past the checks.
+#define DEBUG_MAX_BREAKPOINTS 32
+#define DEBUG_MAX_WATCHPOINTS 16
+
+// Registers a condition can test
+typedef enum {
+    DEBUG_REG_V0 = 0 , // V0-VF are 0-15
+    DEBUG_REG_I = 16 ,
+    DEBUG_REG_SP ,
+    DEBUG_REG_DT ,
+    DEBUG_REG_ST ,
+    DEBUG_REG_NONE ,   // Unconditional
+} debug_register_t ;
+
+typedef enum { DEBUG_EQ , DEBUG_NE , DEBUG_LT , DEBUG_LE , DEBUG_GT , DEBUG_GE } debug_compare_t ;
+
+typedef struct {
+    debug_register_t reg ;
+    debug_compare_t compare ;
+    uint16_t value ;
+} debug_condition_t ;
+
+typedef struct {
+    bool used ;
+    bool anywhere ;       // Condition checked before every instruction instead of at one address
+    bool temporary ;      // Set by "next", removed when hit
+    uint16_t address ;
+    debug_condition_t condition ;
+    uint32_t hits ;
+} breakpoint_t ;
+
+typedef struct {
+    bool used ;
+    uint16_t address ;
+    uint16_t length ;
+} watchpoint_t ;
+
+typedef struct debugger {
+    // Bit a set: the debug interpreter calls debugger_check before the
+    // instruction at a. All ones while an "anywhere" condition is set.
+    uint64_t break_map[CHIP8_MAX_MEMORY_SIZE / 64] ;
+    uint32_t watch_count ;
+    breakpoint_t breakpoints[DEBUG_MAX_BREAKPOINTS] ;
+    watchpoint_t watchpoints[DEBUG_MAX_WATCHPOINTS] ;
+    bool active ;         // Something is set: run_interpreter uses the debug copy
+    bool resuming ;       // Running again from resume_pc: do not stop there before it executes
+    uint16_t resume_pc ;
+    bool stopped ;        // A breakpoint or watchpoint paused the machine
+    char reason[96] ;     // Why, for the prompt
+} debugger_t ;
+
+// The debug interpreter's per-instruction test
+static inline bool debug_break_bit ( const debugger_t *debugger , uint16_t address ) {
+    return (debugger->break_map[address >> 6] >> (address & 63)) & 1 ;
+}
+
+bool debugger_attach ( chip8_t *chip8 ) ;
+void debugger_detach ( chip8_t *chip8 ) ;
+
+// Returns the breakpoint number, or -1 when the table is full
+int debugger_break ( debugger_t *debugger , uint16_t address , bool anywhere , debug_condition_t condition ) ;
+bool debugger_delete ( debugger_t *debugger , int number ) ;
+int debugger_watch ( debugger_t *debugger , uint16_t address , uint16_t length ) ;
+bool debugger_unwatch ( debugger_t *debugger , int number ) ;
+bool debugger_parse_condition ( const char *text , debug_condition_t *condition ) ;
+
+// Called by the debug interpreter: true to stop before the instruction at pc
+bool debugger_check ( chip8_t *chip8 , uint16_t pc ) ;
+// Called after an instruction at pc wrote [address, address + length): true to stop
+bool debugger_watch_hit ( chip8_t *chip8 , uint16_t pc , uint16_t address , uint16_t length ) ;
+// Stop between frames as if a breakpoint hit (chip8's F11)
+void debugger_interrupt ( chip8_t *chip8 ) ;
+
+// Run `count` instructions outside the frame loop (timers do not tick),
+// stopping at breakpoints
+uint32_t debugger_step ( chip8_t *chip8 , uint32_t count ) ;
+// Step, but run a CALL until it returns (through a temporary breakpoint,
+// then debugger_continue: the call runs in the normal frame loop)
+bool debugger_next ( chip8_t *chip8 ) ;
+// Resume: the instruction at pc runs even if it has a breakpoint
+void debugger_continue ( chip8_t *chip8 ) ;
+
+void debugger_print_registers ( const chip8_t *chip8 , FILE *out ) ;
+void debugger_print_stack ( const chip8_t *chip8 , FILE *out ) ;
+void debugger_print_disassembly ( const chip8_t *chip8 , uint16_t address , uint32_t count , FILE *out ) ;
+
+// Read commands until the user continues (true) or quits (false, the
+// machine is STOPPED). "help" lists the commands.
+bool debugger_prompt ( chip8_t *chip8 , FILE *in , FILE *out ) ;
+
+#endif // DEBUGGER_H
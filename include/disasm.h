@@ -0,0 +1,19 @@
+#ifndef DISASM_H
+#define DISASM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "chip8.h"
+
+// Disassembler: Cowgod-style mnemonics ("LD V1, 0x05", "DRW V0, V1, 5"),
+// using the same decode_op as the interpreter so a listing never disagrees
+// with what runs. Opcodes the interpreter treats as no-ops print as
+// "DW 0xXXXX" (or "SYS 0xNNN" for 0NNN).
+#define DISASM_TEXT_MAX 32
+
+// Format the instruction at `address` into `text`; returns its length in
+// bytes (4 for XO-CHIP's F000 NNNN, otherwise 2). `mask` wraps addresses.
+uint16_t disassemble ( const uint8_t *memory , uint16_t mask , uint16_t address , bool xo_chip , char *text , size_t size ) ;
+
+#endif // DISASM_H
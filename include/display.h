@@ -0,0 +1,145 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "chip8.h"
+
+// Bitplane display operations, shared by the interpreter (chip8.c) and the
+// batched core (batch.c). Each plane is an array of rows of CHIP8_ROW_WORDS
+// words, laid out as chip8_t.display; in low resolution only word 0 of the
+// first 32 rows is used (everything else stays zero), so a 64-pixel row is
+// one 64-bit rotate and XOR, and a 128-pixel row is a rotate across a word
+// pair. Scrolls are shifts of those words and memmoves of whole rows.
+//
+// Every operation affects the planes selected in plane_mask (FN01).
+
+typedef uint64_t display_plane_t[CHIP8_HIRES_HEIGHT][CHIP8_ROW_WORDS] ;
+
+// Rows of the current resolution
+static inline uint32_t display_rows ( bool hires ) {
+    return hires ? CHIP8_HIRES_HEIGHT : CHIP8_DISPLAY_HEIGHT ;
+}
+
+// 00E0: clear the selected planes
+static inline void display_clear ( display_plane_t planes[CHIP8_PLANES] , bool hires , uint8_t plane_mask ) {
+    const size_t size = display_rows ( hires ) * sizeof ( planes[0][0] ) ;
+    for ( uint32_t plane = 0 ; plane < CHIP8_PLANES ; plane++ ) {
+        if ( plane_mask & (1u << plane) ) memset ( planes[plane] , 0 , size ) ;
+    }
+}
+
+// 00CN/00DN: move the selected planes `rows` rows down or up, blank rows enter at the edge
+static inline void display_scroll_vertical ( display_plane_t planes[CHIP8_PLANES] , bool hires , uint8_t plane_mask ,
+                                             uint32_t rows , bool down ) {
+    const uint32_t height = display_rows ( hires ) ;
+    const size_t row_size = sizeof ( planes[0][0] ) ;
+    if ( rows > height ) rows = height ;
+
+    for ( uint32_t plane = 0 ; plane < CHIP8_PLANES ; plane++ ) {
+        if ( !(plane_mask & (1u << plane)) ) continue ;
+        uint64_t (*lines)[CHIP8_ROW_WORDS] = planes[plane] ;
+        if ( down ) {
+            memmove ( lines[rows] , lines[0] , (height - rows) * row_size ) ;
+            memset ( lines[0] , 0 , rows * row_size ) ;
+        } else {
+            memmove ( lines[0] , lines[rows] , (height - rows) * row_size ) ;
+            memset ( lines[height - rows] , 0 , rows * row_size ) ;
+        }
+    }
+}
+
+// 00FB/00FC: move the selected planes 4 pixels right or left
+static inline void display_scroll_horizontal ( display_plane_t planes[CHIP8_PLANES] , bool hires , uint8_t plane_mask , bool right ) {
+    const uint32_t height = display_rows ( hires ) ;
+    for ( uint32_t plane = 0 ; plane < CHIP8_PLANES ; plane++ ) {
+        if ( !(plane_mask & (1u << plane)) ) continue ;
+        for ( uint32_t y = 0 ; y < height ; y++ ) {
+            uint64_t *row = planes[plane][y] ;
+            if ( !hires ) row[0] = right ? row[0] >> 4 : row[0] << 4 ;
+            else if ( right ) {
+                row[1] = (row[1] >> 4) | (row[0] << 60) ;
+                row[0] >>= 4 ;
+            } else {
+                row[0] = (row[0] << 4) | (row[1] >> 60) ;
+                row[1] <<= 4 ;
+            }
+        }
+    }
+}
+
+// XOR a sprite row (left-aligned in `bits`, at most 16 pixels) into a
+// 128-pixel row at column x, wrapping around unless clipped; returns the
+// pixels turned off
+static inline uint64_t xor_hires_row ( uint64_t row[CHIP8_ROW_WORDS] , uint64_t bits , uint32_t x , bool clip ) {
+    uint64_t left = bits , right = 0 ;
+    if ( x >= 64 ) {
+        right = left ;
+        left = 0 ;
+        x -= 64 ;
+    }
+    if ( x ) {
+        const uint64_t carry = left << (64 - x) ;
+        left = (left >> x) | (clip ? 0 : right << (64 - x)) ; // bits off the right edge wrap to the left
+        right = (right >> x) | carry ;
+    }
+    const uint64_t collision = (row[0] & left) | (row[1] & right) ;
+    row[0] ^= left ;
+    row[1] ^= right ;
+    return collision ;
+}
+
+// A sprite row (left-aligned in `bits`) moved to column x of a 64-pixel row
+static inline uint64_t lores_row ( uint64_t bits , uint32_t x , bool clip ) {
+    return clip ? bits >> x : (bits >> x) | (bits << ((64 - x) & 63)) ;
+}
+
+// DXYN: draw an 8xN sprite (16x16 for N = 0) read from memory at `address`
+// at (vx, vy) in every selected plane, the data for each plane following
+// the previous one's; returns the collision flag (VF). The position always
+// wraps, `clip` cuts off what then crosses an edge.
+static inline bool display_draw ( display_plane_t planes[CHIP8_PLANES] , bool hires , uint8_t plane_mask ,
+                                  const uint8_t *memory , uint16_t mask , uint16_t address ,
+                                  uint8_t vx , uint8_t vy , uint8_t n , bool clip ) {
+    const uint32_t width = hires ? CHIP8_HIRES_WIDTH : CHIP8_DISPLAY_WIDTH ;
+    const uint32_t height = display_rows ( hires ) ;
+    const uint32_t x = vx % width ; // wrap around if going off screen
+    const uint32_t y = vy % height ;
+    const uint32_t rows = n ? n : 16 ;
+    uint64_t collision = 0 ;
+
+    if ( !hires && plane_mask == 0x01 && n ) {
+        // Plain CHIP-8: one plane, one byte and one word per row
+        uint64_t (*lines)[CHIP8_ROW_WORDS] = planes[0] ;
+        const uint32_t visible = clip && y + rows > CHIP8_DISPLAY_HEIGHT ? CHIP8_DISPLAY_HEIGHT - y : rows ;
+        for ( uint32_t row = 0 ; row < visible ; row++ ) {
+            const uint64_t sprite_row = (uint64_t)memory[(address + row) & mask] << 56 ;
+            const uint64_t bits = lores_row ( sprite_row , x , clip ) ;
+            uint64_t *line = &lines[(y + row) % CHIP8_DISPLAY_HEIGHT][0] ;
+            collision |= *line & bits ;
+            *line ^= bits ;
+        }
+        return collision != 0 ;
+    }
+
+    for ( uint32_t plane = 0 ; plane < CHIP8_PLANES ; plane++ ) {
+        if ( !(plane_mask & (1u << plane)) ) continue ;
+        for ( uint32_t row = 0 ; row < rows ; row++ ) {
+            uint64_t sprite_row = (uint64_t)memory[address++ & mask] << 56 ;
+            if ( n == 0 ) sprite_row |= (uint64_t)memory[address++ & mask] << 48 ;
+            if ( clip && y + row >= height ) continue ;
+            uint64_t *line = planes[plane][(y + row) % height] ;
+            if ( hires ) {
+                collision |= xor_hires_row ( line , sprite_row , x , clip ) ;
+            } else {
+                const uint64_t bits = lores_row ( sprite_row , x , clip ) ;
+                collision |= line[0] & bits ;
+                line[0] ^= bits ;
+            }
+        }
+    }
+    return collision != 0 ;
+}
+
+#endif // DISPLAY_H
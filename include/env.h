@@ -0,0 +1,108 @@
+#ifndef ENV_H
+#define ENV_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "chip8.h"
+#include "config.h"
+#include "savestate.h"
+
+// Reinforcement-learning environments: a pool of machines running one ROM,
+// stepped together on worker threads, with no window or audio device.
+//
+//     env_options_t options ;
+//     env_default_options ( &options , &config ) ;
+//     options.reward = my_reward ;             // Score from the machine after each frame
+//     env_pool_t *pool = env_pool_create ( "roms/Brick.ch8" , 64 , &options ) ;
+//     uint8_t *obs = shared_memory ( 64 * env_observation_size ( pool ) ) ;
+//     env_set_observations ( pool , obs ) ;   // Env e writes its frame at obs + e * size
+//     env_reset_all ( pool , seeds ) ;
+//     for ( ;; ) {
+//         env_step ( pool , actions , 4 , rewards , dones ) ; // Four frames per action
+//         ... read obs, reset the envs that are done ...
+//     }
+//
+// Observations are written straight into the caller's buffer (shared
+// memory with a trainer process, a tensor...) after every reset and step,
+// nothing is copied afterwards. They are always 64x32: a 128x64 frame is
+// reduced by OR-ing each 2x2 block, so what the agent sees does not change
+// shape when a ROM switches resolution.
+//
+// Every env gives the same frames as a chip8_t running the ROM on its own
+// (run_frame then tick_timers per frame) with the same keys and seed, on
+// any number of threads.
+#define ENV_OBS_WIDTH 64
+#define ENV_OBS_HEIGHT 32
+
+typedef enum {
+    ENV_OBS_BITS ,  // 256 bytes: 32 rows of 8 bytes, most significant bit leftmost, planes ORed
+    ENV_OBS_BYTES , // 2048 bytes: one colour index (bit n = plane n) per pixel, row after row
+} env_obs_format_t ;
+
+// Values of env_step's dones
+enum {
+    ENV_RUNNING = 0 ,
+    ENV_TERMINATED , // The reward hook said so, or the ROM stopped (00FD)
+    ENV_TRUNCATED ,  // Reached max_frames
+} ;
+
+// Called on a worker thread after each frame of env `env`: returns the
+// reward for the frame and may set *terminal to end the episode. Must only
+// touch state of its own env (it runs concurrently for different envs).
+typedef float ( *env_reward_fn ) ( const chip8_t *chip8 , uint32_t env , void *context , bool *terminal ) ;
+
+typedef struct {
+    quirks_t quirks ;                 // QUIRKS_AUTO picks the profile from the ROM as init_chip8 does
+    uint32_t instructions_per_second ;
+    bool vip_timing ;
+    env_obs_format_t format ;
+    uint64_t max_frames ;             // Episode length before ENV_TRUNCATED (0 = no limit)
+    env_reward_fn reward ;            // May be NULL: rewards are 0
+    void *reward_context ;
+    unsigned threads ;                // Workers including the caller's thread (0 = one per core)
+} env_options_t ;
+
+typedef struct env_pool env_pool_t ;
+
+// Speed and timing from config_t, ENV_OBS_BITS, no frame limit, no reward, one thread per core
+void env_default_options ( env_options_t *options , const config_t *config ) ;
+
+// NULL if the ROM cannot be loaded or out of memory (each env holds a chip8_t,
+// about 100 KB, plus 512 KB of decode cache for XO-CHIP ROMs). Envs start reset with the default seed, no buffer set.
+env_pool_t *env_pool_create ( const char *rom_path , uint32_t count , const env_options_t *options ) ;
+void env_pool_destroy ( env_pool_t *pool ) ;
+uint32_t env_count ( const env_pool_t *pool ) ;
+
+// Bytes of one observation in the pool's format
+size_t env_observation_size ( const env_pool_t *pool ) ;
+// count * env_observation_size bytes, env e at e * size (NULL stops writing);
+// the current frame of every env is written into it right away
+void env_set_observations ( env_pool_t *pool , uint8_t *buffer ) ;
+
+// Power-on state with the RNG seeded with `seed` (0 = CHIP8_RNG_SEED)
+void env_reset ( env_pool_t *pool , uint32_t env , uint32_t seed ) ;
+// Every env, env e seeded with seeds[e] (the default seed for all when NULL)
+void env_reset_all ( env_pool_t *pool , const uint32_t *seeds ) ;
+
+// Hold actions[e] (bit k = key k down) on env e for `frames` frames, then
+// write its observation. rewards[e] gets the sum over the frames and
+// dones[e] ENV_RUNNING, ENV_TERMINATED or ENV_TRUNCATED; an episode ends at
+// the frame it is done and the env stays as it is until reset. rewards and
+// dones may be NULL.
+void env_step ( env_pool_t *pool , const uint16_t *actions , uint32_t frames , float *rewards , uint8_t *dones ) ;
+
+// Snapshot of one env (machine, frame budget and episode) for search or to
+// branch an episode: returns the size written, 0 if `capacity` is too small.
+// Snapshots restore into any env of a pool running the same ROM and profile,
+// in this process.
+#define ENV_STATE_HEADER_SIZE 32
+#define ENV_STATE_MAX_SIZE ( ENV_STATE_HEADER_SIZE + SAVESTATE_MAX_SIZE )
+size_t env_clone ( env_pool_t *pool , uint32_t env , uint8_t *buffer , size_t capacity ) ;
+// The env is left untouched if the snapshot is not valid
+bool env_restore ( env_pool_t *pool , uint32_t env , const uint8_t *buffer , size_t size ) ;
+
+// The machine of an env, to read scores from memory (not while stepping)
+chip8_t *env_machine ( env_pool_t *pool , uint32_t env ) ;
+
+#endif // ENV_H
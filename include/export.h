@@ -0,0 +1,50 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "chip8.h"
+#include "config.h"
+
+// Frame export: every frame handed to export_frame is copied (just the
+// packed display planes, 2 KB) into a bounded queue, and a writer thread
+// turns it into pixels and writes it. The emulation thread only waits when
+// the queue is full.
+//
+// Frames are always 128x64 times the scale, a low-resolution pixel covering
+// 2x2, like the SDL texture. Formats:
+//
+//   y4m : YUV4MPEG2 at 60 fps, 4:4:4 BT.601 (ffmpeg and mpv read it directly)
+//   raw : bare RGBA bytes, one frame after the other, no header
+//   png : one 8-bit palette PNG per frame, "frame.png" -> "frame_000042.png"
+//         where 42 is the emulated frame number
+#define EXPORT_QUEUE_DEPTH 64 // Frames buffered before export_frame blocks
+
+typedef enum {
+    EXPORT_Y4M ,
+    EXPORT_RAW ,
+    EXPORT_PNG ,
+} export_format_t ;
+
+typedef struct {
+    export_format_t format ;
+    uint32_t palette[4] ; // 0xRRGGBBAA for background, plane 0, plane 1 and both planes
+    uint32_t scale ;      // Output pixels per 128x64 pixel (1 = 128x64)
+    bool dedupe ;         // Drop frames identical to the last one written
+} export_options_t ;
+
+typedef struct exporter exporter_t ;
+
+// Palette from config_t, scale 1, format from the file extension (.y4m,
+// .png, anything else raw)
+void export_default_options ( export_options_t *options , const config_t *config , const char *path ) ;
+bool export_parse_format ( const char *name , export_format_t *format ) ;
+
+// NULL if the file cannot be created (PNG sequences open a file per frame)
+exporter_t *export_open ( const char *path , const export_options_t *options ) ;
+// Queue the current display as emulated frame `frame`
+bool export_frame ( exporter_t *exporter , const chip8_t *chip8 , uint64_t frame ) ;
+// Write out the queue and close; false if any frame failed to write
+bool export_close ( exporter_t *exporter , uint64_t *written ) ;
+
+#endif // EXPORT_H
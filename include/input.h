@@ -1,10 +1,51 @@
-#ifndef INPUT_H 
+#ifndef INPUT_H
 #define INPUT_H
 
 #include <SDL2/SDL.h>
 #include "chip8.h"
+#include "config.h"
+#include "savestate.h"
+#include "profiler.h"
+#include "debugger.h"
 
-void handle_input (chip8_t *chip8) ;
+// Host input, handed from the main thread (which owns the SDL event queue)
+// to the emulation thread (which owns the machine) without locks. The
+// keypad and the held keys are bit masks in atomics that the emulation
+// thread reads at every frame; everything else is a command in a single-
+// producer, single-consumer ring that it runs between frames.
+#define INPUT_QUEUE_SIZE 64 // Commands queued before poll_input drops them
 
+typedef enum {
+    INPUT_PAUSE ,           // Toggle pause
+    INPUT_RESET ,
+    INPUT_SAVE_1 ,          // INPUT_SAVE_1 + n: save to slot n + 1 (F1-F4)
+    INPUT_LOAD_1 = INPUT_SAVE_1 + 4 , // INPUT_LOAD_1 + n: load from slot n + 1 (F5-F8)
+    INPUT_PROFILE_REPORT = INPUT_LOAD_1 + 4 ,
+    INPUT_PROFILE_RESET ,
+    INPUT_DEBUG ,           // Break into the debugger prompt
+} input_command_t ;
 
-#endif 
+// Keys that act for as long as they are down
+#define INPUT_HELD_REWIND 0x01 // Backspace
+#define INPUT_HELD_TURBO 0x02  // Tab
+
+typedef struct {
+    uint16_t keypad ;  // Bit k: CHIP-8 key k down
+    uint8_t held ;     // INPUT_HELD_* bits
+    bool quit ;        // Window closed or Escape, never dropped
+    uint8_t commands[INPUT_QUEUE_SIZE] ; // input_command_t
+    uint32_t head ;    // Next command to run, advanced by the emulation thread
+    uint32_t tail ;    // Next free slot, advanced by the main thread
+} input_t ;
+
+// Main thread: drain the SDL events into `input`
+void poll_input ( input_t *input , const config_t *config ) ;
+// Emulation thread, between frames: run the queued commands and copy the
+// keypad; true when the machine state was replaced (reset or state load)
+bool apply_input ( input_t *input , chip8_t *chip8 ) ;
+// Emulation thread, before each frame: copy the keypad
+void input_keypad ( input_t *input , chip8_t *chip8 ) ;
+uint8_t input_held ( input_t *input ) ;
+
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "chip8.h"
+
+// x86-64 dynamic recompiler for CHIP-8 basic blocks, cached by start
+// address. Blocks end with a native jump, call, return or skip, and run
+// DXYN and the FX33/FX55 stores inline through C helpers (a store over
+// compiled code leaves the block there). They stop before FX0A, CXNN and
+// anything else that needs host services, which the interpreter runs.
+// Only available on x86-64 hosts with mmap.
+
+typedef struct jit jit_t ;
+
+bool jit_available ( void ) ;
+bool jit_enable ( chip8_t *chip8 ) ;
+void jit_disable ( chip8_t *chip8 ) ;
+void jit_flush ( jit_t *jit ) ;
+void jit_invalidate ( jit_t *jit , uint16_t address , uint16_t length ) ;
+uint32_t jit_run ( chip8_t *chip8 , uint32_t cycles ) ;
+// Compile the block at address ahead of its first run (see cfg_prewarm)
+void jit_prewarm ( chip8_t *chip8 , uint16_t address ) ;
+
+#endif // JIT_H
@@ -0,0 +1,75 @@
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "chip8.h"
+#include "config.h"
+
+// ROM library: an index of ROMs by content hash with per-ROM settings that
+// override config_t, so a ROM gets its quirk profile, speed and keys
+// whatever its file is called or wherever it lives.
+//
+// The index is a text file (config_t::library_path), one ROM per line,
+// tab-separated:
+//
+//   hash  size  mtime  quirks  ips  keymap  title  path
+//
+// hash is the 64-bit FNV-1a of the file in hex, "-" leaves a setting to
+// the defaults, and keymap is 16 hex digits: digit k is the CHIP-8 key sent
+// by the host key normally mapped to key k. A rescan follows a ROM moved
+// or edited in place under the scanned directory, settings and all, and
+// drops the entries under it whose file is gone; entries elsewhere are kept.
+#define LIBRARY_KEYMAP_DEFAULT "0123456789ABCDEF"
+
+typedef struct {
+    uint64_t hash ;
+    uint64_t size ;
+    int64_t mtime ;   // Seconds, to skip unchanged files on a rescan
+    char *path ;      // Where the ROM was last seen
+    char *title ;     // Never NULL, the file name when first scanned
+    quirks_t quirks ; // QUIRKS_AUTO = no override
+    uint32_t ips ;    // 0 = no override
+    bool has_keymap ;
+    uint8_t keymap[16] ;
+} library_entry_t ;
+
+typedef struct {
+    library_entry_t *entries ;
+    size_t count ;
+    size_t capacity ;
+    // Open addressing, entry index + 1 (0 = empty), power-of-two sizes
+    uint32_t *by_hash ;
+    uint32_t *by_path ;
+    size_t slots ;
+} library_t ;
+
+typedef struct {
+    uint32_t files ;     // ROM files found
+    uint32_t hashed ;    // Read because they were new or changed
+    uint32_t added ;     // Hashes not in the index before
+    uint32_t removed ;   // Entries dropped: file gone, or its path now holds another indexed ROM
+} library_scan_t ;
+
+// A missing index loads as an empty library
+bool library_load ( library_t *library , const char *path ) ;
+bool library_save ( const library_t *library , const char *path ) ;
+void library_free ( library_t *library ) ;
+
+// FNV-1a of a file's contents (read through mmap), plus its size and mtime
+bool library_hash_file ( const char *path , uint64_t *hash , uint64_t *size , int64_t *mtime ) ;
+library_entry_t *library_find ( const library_t *library , uint64_t hash ) ;
+// Hash a ROM and find it, NULL when it is not in the index
+library_entry_t *library_lookup_rom ( const library_t *library , const char *rom_path ) ;
+// Index every ROM under `directory`, only reading files whose size or mtime
+// changed, and drop the entries under it whose file is gone
+bool library_scan ( library_t *library , const char *directory , library_scan_t *stats ) ;
+
+// Parse one "key=value" setting (title, quirks, ips, keys) into an entry
+bool library_set ( library_entry_t *entry , const char *setting ) ;
+bool library_parse_keymap ( const char *text , uint8_t keymap[16] ) ;
+// Copy the entry's overrides into config (instruction rate, keymap) and *quirks
+void library_apply ( const library_entry_t *entry , config_t *config , quirks_t *quirks ) ;
+
+#endif // LIBRARY_H
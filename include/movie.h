@@ -0,0 +1,51 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "chip8.h"
+#include "runner.h"
+
+// Input movie: everything needed to reproduce a run bit for bit, i.e. the
+// RNG seed, the pacing, and keypad changes by frame number, plus hashes of
+// the final state to check a replay against.
+//
+// File layout (little-endian): magic "C8MV", u16 version, u8 flags
+// (bit 0 = VIP timing), u8 quirk profile (quirks_t, 0 = chosen from the
+// ROM), u32 seed, u32 instructions per
+// second, u64 ROM hash, u64 frames, u64 display hash, u64 state hash,
+// u32 event count, then per event three varints: frame delta from the
+// previous event, press mask, release mask. Version 2 movies hash a machine
+// with the SUPER-CHIP font loaded, so version 1 ROM hashes no longer match.
+#define MOVIE_MAGIC "C8MV"
+#define MOVIE_VERSION 2
+
+typedef struct {
+    uint32_t seed ;
+    uint32_t instructions_per_second ;
+    bool vip_timing ;
+    quirks_t quirks ;       // Profile the run used, replays need the same one
+    uint64_t rom_hash ;     // state_hash right after init_chip8
+    uint64_t frames ;       // Frames recorded
+    uint64_t display_hash ; // Final framebuffer
+    uint64_t state_hash ;   // Final registers, stack, timers, memory and display
+    input_script_t input ;  // Keypad changes, frame-numbered like an input script
+    uint16_t keys ;         // Keypad as of the last recorded frame
+} movie_t ;
+
+// Start recording on a freshly initialised machine; seeds its RNG
+void movie_begin ( movie_t *movie , chip8_t *chip8 , uint32_t seed , uint32_t instructions_per_second , bool vip_timing ) ;
+// Call at the start of every frame, before its instructions run
+bool movie_record_frame ( movie_t *movie , const chip8_t *chip8 ) ;
+// Store the final hashes
+void movie_end ( movie_t *movie , const chip8_t *chip8 ) ;
+bool movie_save ( const movie_t *movie , const char *path ) ;
+bool movie_load ( movie_t *movie , const char *path ) ;
+void movie_free ( movie_t *movie ) ;
+
+// Replay a loaded movie on a freshly initialised machine as fast as
+// possible; true when the final hashes match the recording. Set the
+// machine's quirks_request to movie->quirks before initialising it.
+bool movie_replay ( const movie_t *movie , chip8_t *chip8 , run_result_t *result ) ;
+
+#endif // MOVIE_H
@@ -0,0 +1,94 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "chip8.h"
+
+// Execution profiler, compiled in only with -DCHIP8_PROFILE (make PROFILE=1).
+// Without it every PROFILE_* macro below expands to nothing and chip8_t has
+// no profiler field, so a normal build pays nothing for it.
+
+#define PROFILE_HISTORY 3600 // Frames of timing kept for percentiles (one minute at 60 Hz)
+
+typedef enum {
+    PROFILE_INPUT ,
+    PROFILE_EMULATION ,
+    PROFILE_RENDER ,
+    PROFILE_PHASES
+} profile_phase_t ;
+
+// One presented frame
+typedef struct {
+    uint32_t instructions ;
+    float phase_us[PROFILE_PHASES] ;
+} profile_frame_t ;
+
+typedef struct profiler {
+    uint64_t op_counts[OP_COUNT] ;
+    uint64_t pc_counts[CHIP8_MAX_MEMORY_SIZE] ; // Executions per instruction address
+    uint64_t instructions ;
+    uint64_t frame_first_instruction ;      // Value of instructions when the current frame began
+    double phase_start[PROFILE_PHASES] ;
+    double phase_seconds[PROFILE_PHASES] ;  // Current frame
+    double total_seconds[PROFILE_PHASES] ;  // Whole run
+    double present_start ;                  // Main thread only (PROFILE_PRESENT_BEGIN)
+    uint64_t presented_ns ;                 // present_frame time the main thread added since the last frame ended (atomic)
+    uint64_t frames ;
+    profile_frame_t history[PROFILE_HISTORY] ; // history[frame % PROFILE_HISTORY]
+} profiler_t ;
+
+#ifdef CHIP8_PROFILE
+
+bool profiler_attach ( chip8_t *chip8 ) ;
+void profiler_detach ( chip8_t *chip8 ) ;
+void profiler_reset ( profiler_t *profiler ) ;
+void profiler_begin ( profiler_t *profiler , profile_phase_t phase ) ;
+void profiler_end ( profiler_t *profiler , profile_phase_t phase ) ;
+// End of a frame; its render phase takes in the presentation time the main
+// thread reported since the previous one
+void profiler_end_frame ( profiler_t *profiler ) ;
+// Bracket present_frame on the main thread, which runs beside the emulation one
+void profiler_present_begin ( profiler_t *profiler ) ;
+void profiler_present_end ( profiler_t *profiler ) ;
+// Human-readable summary: opcode mix, hottest addresses, loops and frame times
+void profiler_report ( chip8_t *chip8 , FILE *out ) ;
+// The summary followed by the full PC histogram
+bool profiler_write ( chip8_t *chip8 , const char *path ) ;
+
+// Called by the interpreter for every instruction it dispatches
+static inline void profile_instruction ( profiler_t *profiler , uint8_t op , uint16_t address ) {
+    if ( !profiler ) return ;
+    profiler->op_counts[op]++ ;
+    profiler->pc_counts[address & (CHIP8_MAX_MEMORY_SIZE - 1)]++ ;
+    profiler->instructions++ ;
+}
+
+// First execution of an address was counted as OP_DECODE, move it to the real opcode
+static inline void profile_decoded ( profiler_t *profiler , uint8_t op ) {
+    if ( !profiler ) return ;
+    profiler->op_counts[OP_DECODE]-- ;
+    profiler->op_counts[op]++ ;
+}
+
+#define PROFILE_INSTRUCTION(chip8 , op , address) profile_instruction ( (chip8)->profiler , (op) , (address) )
+#define PROFILE_DECODED(chip8 , op) profile_decoded ( (chip8)->profiler , (op) )
+#define PROFILE_BEGIN(chip8 , phase) profiler_begin ( (chip8)->profiler , (phase) )
+#define PROFILE_END(chip8 , phase) profiler_end ( (chip8)->profiler , (phase) )
+#define PROFILE_END_FRAME(chip8) profiler_end_frame ( (chip8)->profiler )
+#define PROFILE_PRESENT_BEGIN(chip8) profiler_present_begin ( (chip8)->profiler )
+#define PROFILE_PRESENT_END(chip8) profiler_present_end ( (chip8)->profiler )
+
+#else
+
+#define PROFILE_INSTRUCTION(chip8 , op , address) ((void)0)
+#define PROFILE_DECODED(chip8 , op) ((void)0)
+#define PROFILE_BEGIN(chip8 , phase) ((void)0)
+#define PROFILE_END(chip8 , phase) ((void)0)
+#define PROFILE_END_FRAME(chip8) ((void)0)
+#define PROFILE_PRESENT_BEGIN(chip8) ((void)0)
+#define PROFILE_PRESENT_END(chip8) ((void)0)
+
+#endif // CHIP8_PROFILE
+
+#endif // PROFILER_H
@@ -0,0 +1,68 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "chip8.h"
+
+// Everything needed to resume a frame, laid out without internal padding
+// so whole snapshots can be XORed and compared byte-wise (up to
+// snapshot_size, memory is last so a 4K machine skips the other 60K)
+typedef struct {
+    uint64_t display[CHIP8_PLANES][CHIP8_HIRES_HEIGHT][CHIP8_ROW_WORDS] ;
+    uint32_t rng ;
+    uint16_t stack[CHIP8_STACK_SIZE] ;
+    uint16_t I ;
+    uint16_t pc ;
+    uint8_t V[16] ;
+    uint8_t flags[16] ;
+    uint8_t sp ;
+    uint8_t delay_timer ;
+    uint8_t sound_timer ;
+    uint8_t hires ;
+    uint8_t plane_mask ;
+    uint8_t xo_chip ;
+    uint8_t reserved[2] ;
+    uint8_t memory[CHIP8_MAX_MEMORY_SIZE] ; // Only the first 4K are recorded for a classic machine
+} rewind_snapshot_t ;
+
+// One recorded frame: a keyframe (RLE of the snapshot) or a delta (RLE of
+// the snapshot XOR its group's keyframe)
+typedef struct {
+    uint32_t offset ; // Into the arena
+    uint32_t size ;
+    uint64_t key ;    // Sequence number of the group's keyframe
+} rewind_entry_t ;
+
+// Ring of per-frame snapshots inside a fixed byte budget. All memory is
+// allocated by rewind_init; pushing and stepping back never allocate. When
+// the budget is full, the oldest keyframe group is dropped as a whole.
+typedef struct {
+    uint8_t *arena ;
+    uint32_t arena_size ;
+    uint32_t head ;           // Next write offset in the arena
+    rewind_entry_t *entries ; // entries[seq % capacity]
+    uint32_t capacity ;
+    uint64_t first ;          // Oldest recorded sequence number
+    uint64_t next ;           // Sequence number of the next push
+    uint32_t keyframe_interval ;
+    rewind_snapshot_t key_snapshot ; // Decoded keyframe of key_seq
+    uint64_t key_seq ;
+    bool key_valid ;
+    rewind_snapshot_t current ;      // Scratch for capture and restore
+    uint8_t *scratch ;               // Encoder output, worst case size
+    uint64_t bytes_pushed ;          // Stats for tuning the budget
+    uint64_t frames_pushed ;
+} rewind_t ;
+
+bool rewind_init ( rewind_t *history , size_t budget , uint32_t keyframe_interval ) ;
+void rewind_free ( rewind_t *history ) ;
+void rewind_clear ( rewind_t *history ) ;
+// Record the state at the end of a frame
+void rewind_push ( rewind_t *history , const chip8_t *chip8 ) ;
+// Drop the newest frame and restore the one before it; false when only one frame is left
+bool rewind_step_back ( rewind_t *history , chip8_t *chip8 ) ;
+uint64_t rewind_frames ( const rewind_t *history ) ;
+
+#endif // REWIND_H
@@ -0,0 +1,60 @@
+#ifndef RUNNER_H
+#define RUNNER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "chip8.h"
+
+// Keypad change applied at the start of a frame
+typedef struct {
+    uint32_t frame ;
+    uint16_t press ;   // Bit k set: key k goes down
+    uint16_t release ; // Bit k set: key k goes up
+} input_event_t ;
+
+// Scripted keypad input, events sorted by frame
+typedef struct {
+    input_event_t *events ;
+    size_t count ;
+    size_t capacity ;
+} input_script_t ;
+
+// Per-frame CPU budget carried from one frame to the next. Shared by the
+// SDL scheduler and run_headless so both run identical frames.
+typedef struct {
+    uint64_t cycle_credit ; // Fraction of a cycle (or microsecond) carried between frames, in 1/60ths
+    int64_t time_debt_us ;  // VIP timing: microseconds the last instruction ran past the frame budget
+} frame_budget_t ;
+
+typedef struct {
+    uint64_t max_frames ;       // Stop after this many 60 Hz frames (0 = no limit)
+    uint64_t max_instructions ; // Stop after this many instructions (0 = no limit)
+    uint32_t instructions_per_second ;
+    bool vip_timing ;              // COSMAC VIP per-opcode timings instead of instructions_per_second
+    const input_script_t *script ; // May be NULL
+    // Called after every frame's instructions and timer tick (may be NULL)
+    void ( *frame_done ) ( const chip8_t *chip8 , uint64_t frame , void *context ) ;
+    void *frame_context ;
+    // Called after a frame in which the machine paused (a debugger stop) and
+    // until it runs again; returning false ends the run (may be NULL)
+    bool ( *paused ) ( chip8_t *chip8 , void *context ) ;
+    void *paused_context ;
+} run_options_t ;
+
+typedef struct {
+    uint64_t frames ;
+    uint64_t instructions ;
+    double seconds ; // Wall time spent in run_headless
+} run_result_t ;
+
+bool load_input_script ( input_script_t *script , const char *path ) ;
+void free_input_script ( input_script_t *script ) ;
+bool push_input_event ( input_script_t *script , input_event_t event ) ;
+uint32_t run_frame ( chip8_t *chip8 , frame_budget_t *budget , uint32_t instructions_per_second , bool vip_timing , uint32_t max_instructions ) ;
+void run_headless ( chip8_t *chip8 , const run_options_t *options , run_result_t *result ) ;
+uint64_t display_hash ( const chip8_t *chip8 ) ;
+uint64_t state_hash ( const chip8_t *chip8 ) ;
+double monotonic_seconds ( void ) ;
+
+#endif // RUNNER_H
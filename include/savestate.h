@@ -0,0 +1,44 @@
+#ifndef SAVESTATE_H
+#define SAVESTATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "chip8.h"
+
+// Save-state file layout (all integers little-endian):
+//
+//   header  : magic "C8SV", u16 version, u16 header size, u32 payload size, u32 CRC-32 of payload
+//   payload : V[16], u16 I, u16 pc, u8 sp, u8 delay, u8 sound, u8 mode (bit 0 = 128x64,
+//             bit 1 = XO-CHIP), u32 rng, u16 keypad mask, u16 stack[16], u8 plane mask,
+//             u8 flags[16], u32 packed display size, PackBits-compressed display (both
+//             planes, 64 rows of 2 u64 words), u32 packed memory size, PackBits-compressed
+//             memory (4K, or 64K for XO-CHIP)
+//
+// Version 1 (no plane mask or flags, u64 display[32], u16 packed size and 4K of
+// memory) still loads. Only machine state is stored: no pointers, no file
+// names, no quirk profile (a state only loads into a machine with the same
+// address space, XO-CHIP or not).
+#define SAVESTATE_MAGIC "C8SV"
+#define SAVESTATE_VERSION 2
+#define SAVESTATE_HEADER_SIZE 16
+#define SAVESTATE_FIXED_SIZE ( 16 + 4 + 4 + 4 + 2 + 2 * CHIP8_STACK_SIZE + 1 + 16 + 4 + 4 )
+#define SAVESTATE_DISPLAY_SIZE ( 8 * CHIP8_PLANES * CHIP8_HIRES_HEIGHT * CHIP8_ROW_WORDS )
+// PackBits adds at most one control byte per 128 bytes
+#define SAVESTATE_MAX_SIZE ( SAVESTATE_HEADER_SIZE + SAVESTATE_FIXED_SIZE + \
+                             SAVESTATE_DISPLAY_SIZE + SAVESTATE_DISPLAY_SIZE / 128 + 1 + \
+                             CHIP8_MAX_MEMORY_SIZE + CHIP8_MAX_MEMORY_SIZE / 128 + 1 )
+
+// Serialize into `buffer`, returns the encoded size (0 if `capacity` is too small)
+size_t savestate_encode ( const chip8_t *chip8 , uint8_t *buffer , size_t capacity ) ;
+// Validate and restore; the machine is left untouched if anything is wrong
+bool savestate_decode ( chip8_t *chip8 , const uint8_t *buffer , size_t size ) ;
+
+// Slot files ("<rom>_slotN.bin"). Saving encodes on the caller's thread and
+// hands the bytes to a background writer, so it never waits on the disk.
+bool save_state ( chip8_t *chip8 , char *save_file , size_t save_file_size , int slot ) ;
+bool load_state ( chip8_t *chip8 , char *save_file , size_t save_file_size , int slot ) ;
+// Block until every queued write has reached the disk (call before exiting)
+void savestate_flush ( void ) ;
+
+#endif // SAVESTATE_H
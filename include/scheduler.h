@@ -0,0 +1,32 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+#include "chip8.h"
+#include "config.h"
+#include "runner.h"
+
+#define SCHEDULER_FRAME_RATE CHIP8_FRAME_RATE // Timer and display rate in Hz
+#define SCHEDULER_MAX_CATCHUP_FRAMES 5 // Frames run back to back after a stall before dropping time
+#define SCHEDULER_UNCAPPED 0 // Speed: as many frames as fit in each real-time frame
+
+// Fixed-step frame scheduler driven by the high-resolution counter
+typedef struct {
+    uint64_t frequency; // Counter ticks per second
+    uint64_t last_counter; // Counter value at the last update
+    uint64_t elapsed; // Real time owed, in counter ticks * SCHEDULER_FRAME_RATE
+    frame_budget_t budget; // Cycles (or VIP microseconds) carried between frames
+    bool uncapped; // The frames due were asked for at SCHEDULER_UNCAPPED speed
+    uint64_t slice_end; // Counter value at which the current real-time frame is used up (UINT64_MAX at speed 1)
+} scheduler_t;
+
+void scheduler_init ( scheduler_t *scheduler ) ;
+void scheduler_reset ( scheduler_t *scheduler ) ;
+uint32_t scheduler_frames_due ( scheduler_t *scheduler , uint32_t speed ) ;
+bool scheduler_slice_over ( const scheduler_t *scheduler ) ;
+uint32_t scheduler_run_frame ( scheduler_t *scheduler , chip8_t *chip8 , const config_t *config ) ;
+void scheduler_wait ( scheduler_t *scheduler ) ;
+
+#endif // SCHEDULER_H
@@ -0,0 +1,18 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Run `count` independent tasks on `threads` workers with work stealing.
+// Tasks are dealt round-robin into per-worker deques; a worker pops from
+// the back of its own deque and, once empty, steals from the front of the
+// others. `worker` is stable per thread so callers can keep per-worker
+// scratch state (e.g. a pre-allocated chip8_t).
+typedef void ( *workpool_task_fn ) ( void *context , size_t task , unsigned worker ) ;
+
+unsigned workpool_default_threads ( void ) ;
+bool workpool_run ( unsigned threads , size_t count , workpool_task_fn fn , void *context ) ;
+
+#endif // WORKPOOL_H
@@ -0,0 +1,124 @@
+/**
+ * @file aot.c
+ * @brief Loader and Dispatcher for Ahead-of-Time Compiled ROMs
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * Opens a module written by chip8-aot (see aot.h) with dlopen, indexes its
+ * blocks by address and runs them from run_cycles. The dispatcher mirrors
+ * jit_run: blocks run while the budget lasts, the instructions modules
+ * leave out run on the interpreter one at a time.
+ */
+#define _POSIX_C_SOURCE 200809L // dlopen under -std=c99
+
+#include "aot.h"
+#include <dlfcn.h>
+
+bool aot_load ( chip8_t *chip8 , const char *path ) {
+    void *handle = dlopen ( path , RTLD_NOW | RTLD_LOCAL ) ;
+    if ( !handle ) {
+        CHIP8_LOG ( "Could not load AOT module %s: %s\n" , path , dlerror () ) ;
+        return false ;
+    }
+    const aot_module_t *module = (const aot_module_t *)dlsym ( handle , AOT_SYMBOL ) ;
+    if ( !module || module->abi != AOT_ABI_VERSION || module->chip8_size != sizeof ( chip8_t ) ) {
+        CHIP8_LOG ( "%s is not an AOT module for this build (regenerate it with chip8-aot)\n" , path ) ;
+        dlclose ( handle ) ;
+        return false ;
+    }
+    // The table covers the whole address space of the module's profile
+    const uint16_t mask = chip8_quirk_set ( module->quirks )->xo_chip ? CHIP8_MAX_MEMORY_SIZE - 1 : CHIP8_MEMORY_SIZE - 1 ;
+    aot_t *aot = calloc ( 1 , sizeof ( aot_t ) ) ;
+    const aot_block_t **table = calloc ( (size_t)mask + 1 , sizeof ( *table ) ) ;
+    uint8_t *compiled = calloc ( (size_t)mask + 1 , 1 ) ;
+    if ( !aot || !table || !compiled ) {
+        CHIP8_LOG ( "Out of memory for AOT module %s\n" , path ) ;
+        free ( aot ) ;
+        free ( table ) ;
+        free ( compiled ) ;
+        dlclose ( handle ) ;
+        return false ;
+    }
+    for ( uint32_t i = 0 ; i < module->block_count ; i++ ) {
+        const aot_block_t *block = &module->blocks[i] ;
+        table[block->address & mask] = block ;
+        for ( uint32_t b = 0 ; b < block->length ; b++ ) compiled[(block->address + b) & mask] = 1 ;
+    }
+    aot->invalidate = invalidate_decoded ;
+    aot->module = module ;
+    aot->table = table ;
+    aot->compiled = compiled ;
+    aot->mask = mask ;
+    aot->handle = handle ;
+
+    aot_unload ( chip8 ) ;
+    chip8->aot = aot ;
+    aot_reset ( chip8 ) ;
+    return true ;
+}
+
+void aot_unload ( chip8_t *chip8 ) {
+    aot_t *aot = chip8->aot ;
+    if ( !aot ) return ;
+    dlclose ( aot->handle ) ;
+    free ( aot->table ) ;
+    free ( aot->compiled ) ;
+    free ( aot ) ;
+    chip8->aot = NULL ;
+}
+
+void aot_reset ( chip8_t *chip8 ) {
+    aot_t *aot = chip8->aot ;
+    const aot_module_t *module = aot->module ;
+    aot->active = false ;
+    if ( chip8->quirks != module->quirks || chip8_address_mask ( chip8 ) != aot->mask ) return ;
+    // Data may differ (a save state from later in the run), code may not
+    for ( uint32_t address = 0 ; address <= aot->mask ; address++ ) {
+        if ( !aot->compiled[address] ) continue ;
+        const uint32_t offset = address - 0x200 ;
+        if ( address < 0x200 || offset >= module->rom_size || chip8->memory[address] != module->rom[offset] ) return ;
+    }
+    aot->active = true ;
+}
+
+void aot_invalidate ( aot_t *aot , uint16_t address , uint16_t length ) {
+    for ( uint32_t i = 0 ; i < length ; i++ ) {
+        if ( aot->compiled[(address + i) & aot->mask] ) aot->active = false ;
+    }
+}
+
+uint32_t aot_run ( chip8_t *chip8 , uint32_t cycles ) {
+    aot_t *aot = chip8->aot ;
+    const uint16_t mask = aot->mask ;
+    uint32_t remaining = cycles ;
+
+    while ( remaining > 0 ) {
+        // Code was overwritten: the rest of the budget goes to the JIT or the interpreter
+        if ( !aot->active ) return cycles - remaining + run_cycles ( chip8 , remaining ) ;
+
+        const uint16_t pc = chip8->pc ;
+        // Blocks store the addresses they leave for, so only take pc before it wraps
+        const aot_block_t *block = pc <= mask ? aot->table[pc] : NULL ;
+        if ( block && block->idle_loop && remaining >= IDLE_MIN_REMAINING ) {
+            remaining = skip_idle_loop ( chip8 , pc , remaining ) ;
+            if ( remaining == 0 ) break ; // Whole iterations used the budget up, pc is back at the head
+        }
+        if ( block ) {
+            if ( block->count > remaining ) {
+                // Not enough budget for the whole block, finish instruction by instruction
+                return cycles - remaining + run_interpreter ( chip8 , remaining ) ;
+            }
+            remaining = block->fn ( chip8 , remaining ) ;
+            continue ;
+        }
+        // An instruction modules leave to the interpreter
+        remaining -= run_interpreter ( chip8 , 1 ) ;
+        // FX0A with no key down repeats itself until the keypad changes between calls,
+        // DXYN may end the frame, 00FD stops the machine where it is
+        const uint8_t op = chip8_decode_cache ( chip8 )[pc & mask].op ;
+        if ( chip8->pc == pc && op == OP_LD_VX_K ) remaining = 0 ;
+        if ( op == OP_DRW && chip8_quirk_set ( chip8->quirks )->display_wait ) remaining = 0 ;
+        if ( op == OP_EXIT ) break ;
+    }
+    return cycles - remaining ;
+}
@@ -0,0 +1,964 @@
+/**
+ * @file batch.c
+ * @brief Batched Core: Many Instances of One ROM in Structure-of-Arrays Form
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * See batch.h for the model. Each step runs every group's instruction,
+ * decoded once from the image every lane was loaded with: register, timer,
+ * I, RNG and skip instructions on the vector code in batch.inc (masked to
+ * the group's lanes), jumps and calls on the group's pc, everything else
+ * on step_lane, the scalar interpreter for one lane, in a loop over the
+ * group. A skip whose lanes disagree splits the group in two; lanes that
+ * leave a group by any other way go to a group opened this step or, when
+ * none has room, run on their own. Groups meeting at a pc merge at the
+ * end of the step. Lanes detached onto machines of their own (see batch.h)
+ * run first in each batch_step call, on run_cycles.
+ */
+#define _POSIX_C_SOURCE 200809L // posix_memalign
+
+#include "batch.h"
+
+#define MASK ( CHIP8_MEMORY_SIZE - 1 ) // Only the 4K profiles run on the batch
+#define STACK_MASK ( CHIP8_STACK_SIZE - 1 )
+
+// What a skip does across the lanes of a group (batch_kernel_t.skip)
+enum { BATCH_SKIP_NONE , BATCH_SKIP_ALL , BATCH_SKIP_MIXED } ;
+
+typedef struct batch_kernel {
+    const char *name ;
+    bool ( *registers ) ( chip8_batch_t *batch , const decoded_inst_t *d , const uint8_t *group , uint8_t g ) ;
+    bool ( *index ) ( chip8_batch_t *batch , const decoded_inst_t *d , const uint8_t *group , uint8_t g ) ;
+    int ( *skip ) ( chip8_batch_t *batch , const decoded_inst_t *d , uint8_t g , uint8_t taken ) ;
+    void ( *relabel ) ( chip8_batch_t *batch , uint8_t from , uint8_t to ) ;
+    void ( *tick ) ( chip8_batch_t *batch ) ;
+} batch_kernel_t ;
+
+// Whether a skip instruction skips on this lane
+static bool lane_skips ( const chip8_batch_t *batch , uint32_t lane , const decoded_inst_t *d ) {
+    const uint32_t stride = batch->stride ;
+    const uint8_t vx = batch->V[d->X * stride + lane] , vy = batch->V[d->Y * stride + lane] ;
+    const bool pressed = ( batch->keys[lane] >> (vx & 0x0F) ) & 1 ;
+    switch ( d->op ) {
+        case OP_SE_VX_NN : return vx == d->NN ;
+        case OP_SNE_VX_NN : return vx != d->NN ;
+        case OP_SE_VX_VY : return vx == vy ;
+        case OP_SNE_VX_VY : return vx != vy ;
+        case OP_SKP : return pressed ;
+        case OP_SKNP : return !pressed ;
+        default : return false ;
+    }
+}
+
+#if defined(__GNUC__)
+    #define KERNEL(name) name##_base
+    #define KERNEL_BYTES 16
+    #if defined(__x86_64__)
+        #define KERNEL_NAME "sse2"
+    #else
+        #define KERNEL_NAME "vector"
+    #endif
+    #include "batch.inc"
+    // A second copy for AVX2, picked at run time (GCC only: clang spells the pragma differently)
+    #if defined(__x86_64__) && !defined(__clang__)
+        #define BATCH_AVX2 1
+        #pragma GCC push_options
+        #pragma GCC target ( "avx2" )
+        #define KERNEL(name) name##_avx2
+        #define KERNEL_BYTES 32
+        #define KERNEL_NAME "avx2"
+        #include "batch.inc"
+        #pragma GCC pop_options
+    #endif
+#else
+// Without vector extensions register instructions run on step_lane, the
+// kernel keeps the group bookkeeping
+static bool registers_scalar ( chip8_batch_t *batch , const decoded_inst_t *d , const uint8_t *group , uint8_t g ) {
+    (void)batch ; (void)d ; (void)group ; (void)g ;
+    return false ;
+}
+
+static bool index_scalar ( chip8_batch_t *batch , const decoded_inst_t *d , const uint8_t *group , uint8_t g ) {
+    (void)batch ; (void)d ; (void)group ; (void)g ;
+    return false ;
+}
+
+static int skip_scalar ( chip8_batch_t *batch , const decoded_inst_t *d , uint8_t g , uint8_t taken ) {
+    bool skipping = false , staying = false ;
+    for ( uint32_t l = 0 ; l < batch->lanes ; l++ ) {
+        if ( batch->group[l] != g ) continue ;
+        if ( lane_skips ( batch , l , d ) ) skipping = true ;
+        else staying = true ;
+    }
+    if ( !skipping ) return BATCH_SKIP_NONE ;
+    if ( !staying ) return BATCH_SKIP_ALL ;
+    for ( uint32_t l = 0 ; l < batch->lanes ; l++ ) {
+        if ( batch->group[l] == g && lane_skips ( batch , l , d ) ) batch->group[l] = taken ;
+    }
+    return BATCH_SKIP_MIXED ;
+}
+
+static void relabel_scalar ( chip8_batch_t *batch , uint8_t from , uint8_t to ) {
+    for ( uint32_t l = 0 ; l < batch->lanes ; l++ ) {
+        if ( batch->group[l] == from ) batch->group[l] = to ;
+    }
+}
+
+static void tick_scalar ( chip8_batch_t *batch ) {
+    for ( uint32_t l = 0 ; l < batch->stride ; l++ ) {
+        if ( batch->delay_timer[l] > 0 ) batch->delay_timer[l]-- ;
+        if ( batch->sound_timer[l] > 0 ) batch->sound_timer[l]-- ;
+    }
+}
+
+static const batch_kernel_t kernel_scalar = {
+    .name = "scalar" , .registers = registers_scalar , .index = index_scalar ,
+    .skip = skip_scalar , .relabel = relabel_scalar , .tick = tick_scalar ,
+} ;
+#endif
+
+// ---------------------------------------------------------------------------
+// Set up
+
+static void *batch_alloc ( size_t size ) {
+    void *block = NULL ;
+    if ( posix_memalign ( &block , BATCH_VECTOR_BYTES , size ? size : 1 ) != 0 ) return NULL ;
+    memset ( block , 0 , size ) ;
+    return block ;
+}
+
+chip8_batch_t *batch_create ( uint32_t lanes , quirks_t quirks ) {
+    if ( quirks == QUIRKS_AUTO ) quirks = QUIRKS_CHIP8 ;
+    if ( lanes == 0 || quirks >= QUIRKS_COUNT || chip8_quirk_set ( quirks )->xo_chip ) {
+        CHIP8_LOG ( "The batched core runs 1 or more lanes of a 4K profile (not XO-CHIP)\n" ) ;
+        return NULL ;
+    }
+    chip8_batch_t *batch = calloc ( 1 , sizeof ( chip8_batch_t ) ) ;
+    if ( !batch ) return NULL ;
+    const size_t stride = ( (size_t)lanes + BATCH_VECTOR_BYTES - 1 ) / BATCH_VECTOR_BYTES * BATCH_VECTOR_BYTES ;
+    batch->lanes = lanes ;
+    batch->stride = (uint32_t)stride ;
+    batch->quirks = quirks ;
+    batch->quirk_set = chip8_quirk_set ( quirks ) ;
+    batch->V = batch_alloc ( 16 * stride ) ;
+    batch->stack = batch_alloc ( CHIP8_STACK_SIZE * stride * sizeof ( uint16_t ) ) ;
+    batch->flags = batch_alloc ( 16 * stride ) ;
+    batch->I = batch_alloc ( stride * sizeof ( uint16_t ) ) ;
+    batch->pc = batch_alloc ( stride * sizeof ( uint16_t ) ) ;
+    batch->sp = batch_alloc ( stride ) ;
+    batch->delay_timer = batch_alloc ( stride ) ;
+    batch->sound_timer = batch_alloc ( stride ) ;
+    batch->rng = batch_alloc ( stride * sizeof ( uint32_t ) ) ;
+    batch->keys = batch_alloc ( stride * sizeof ( uint16_t ) ) ;
+    batch->state = batch_alloc ( stride ) ;
+    batch->hires = batch_alloc ( stride ) ;
+    batch->plane_mask = batch_alloc ( stride ) ;
+    batch->group = batch_alloc ( stride ) ;
+    batch->machine = calloc ( stride , sizeof ( chip8_t * ) ) ;
+    batch->memory = batch_alloc ( (size_t)lanes * CHIP8_MEMORY_SIZE ) ;
+    batch->display = batch_alloc ( (size_t)lanes * sizeof ( batch->display[0] ) ) ;
+    if ( !batch->V || !batch->stack || !batch->flags || !batch->I || !batch->pc || !batch->sp || !batch->delay_timer ||
+         !batch->sound_timer || !batch->rng || !batch->keys || !batch->state || !batch->hires || !batch->plane_mask ||
+         !batch->group || !batch->machine || !batch->memory || !batch->display ) {
+        CHIP8_LOG ( "Out of memory for a batch of %u lanes\n" , lanes ) ;
+        batch_destroy ( batch ) ;
+        return NULL ;
+    }
+#if defined(__GNUC__)
+    batch->kernel = &kernel_base ;
+#ifdef BATCH_AVX2
+    if ( __builtin_cpu_supports ( "avx2" ) ) batch->kernel = &kernel_avx2 ;
+#endif
+#else
+    batch->kernel = &kernel_scalar ;
+#endif
+    // An empty program until batch_load (0000 everywhere after the fonts)
+    batch_load ( batch , NULL , 0 ) ;
+    return batch ;
+}
+
+// Free the lanes' own machines (they were loaded with the previous ROM)
+static void free_machines ( chip8_batch_t *batch ) {
+    for ( uint32_t l = 0 ; batch->machine && l < batch->stride ; l++ ) {
+        if ( !batch->machine[l] ) continue ;
+        free_chip8 ( batch->machine[l] ) ;
+        free ( batch->machine[l] ) ;
+        batch->machine[l] = NULL ;
+    }
+}
+
+void batch_destroy ( chip8_batch_t *batch ) {
+    if ( !batch ) return ;
+    free ( batch->V ) ;
+    free ( batch->stack ) ;
+    free ( batch->flags ) ;
+    free ( batch->I ) ;
+    free ( batch->pc ) ;
+    free ( batch->sp ) ;
+    free ( batch->delay_timer ) ;
+    free ( batch->sound_timer ) ;
+    free ( batch->rng ) ;
+    free ( batch->keys ) ;
+    free ( batch->state ) ;
+    free ( batch->hires ) ;
+    free ( batch->plane_mask ) ;
+    free ( batch->group ) ;
+    free_machines ( batch ) ;
+    free ( batch->machine ) ;
+    free ( batch->memory ) ;
+    free ( batch->display ) ;
+    free ( batch ) ;
+}
+
+bool batch_load ( chip8_batch_t *batch , const uint8_t *rom , size_t rom_size ) {
+    // load_chip8 lays out the fonts and the ROM and decodes, the batch keeps copies
+    chip8_t *chip8 = calloc ( 1 , sizeof ( chip8_t ) ) ;
+    if ( !chip8 ) return false ;
+    chip8->quirks_request = batch->quirks ;
+    if ( !load_chip8 ( chip8 , rom , rom_size , NULL ) ) {
+        free_chip8 ( chip8 ) ;
+        free ( chip8 ) ;
+        return false ;
+    }
+    memcpy ( batch->image , chip8->memory , sizeof ( batch->image ) ) ;
+    for ( uint32_t address = 0 ; address < CHIP8_MEMORY_SIZE ; address++ ) {
+        batch->decoded[address] = *fetch_decoded ( chip8 , (uint16_t)address ) ;
+    }
+    batch->rom_size = chip8->rom_size ;
+    free_chip8 ( chip8 ) ;
+    free ( chip8 ) ;
+    free_machines ( batch ) ;
+    batch_reset ( batch , NULL ) ;
+    return true ;
+}
+
+static uint16_t lane_pc ( const chip8_batch_t *batch , uint32_t lane ) {
+    const uint8_t g = batch->group[lane] ;
+    return g < BATCH_MAX_GROUPS ? batch->group_pc[g] : batch->pc[lane] ;
+}
+
+// Take a lane out of its group (its pc goes to pc[lane]), to change it from outside
+static void leave_group ( chip8_batch_t *batch , uint32_t lane ) {
+    const uint8_t g = batch->group[lane] ;
+    if ( g < BATCH_MAX_GROUPS ) {
+        batch->pc[lane] = batch->group_pc[g] ;
+        batch->group_size[g]-- ;
+    } else if ( g == BATCH_GROUP_ALONE ) {
+        batch->alone-- ;
+    } else if ( g == BATCH_GROUP_PARKED ) {
+        batch->parked-- ;
+    } else if ( g == BATCH_GROUP_DETACHED ) {
+        batch->detached-- ; // The arrays' copy of it is stale: callers overwrite it
+    }
+    batch->group[lane] = BATCH_GROUP_NONE ;
+}
+
+// A running lane outside the groups: on its own until the next regrouping
+static void set_alone ( chip8_batch_t *batch , uint32_t lane ) {
+    batch->group[lane] = BATCH_GROUP_ALONE ;
+    batch->alone++ ;
+}
+
+static void reset_lane ( chip8_batch_t *batch , uint32_t l , uint32_t seed ) {
+    const uint32_t stride = batch->stride ;
+    for ( uint32_t r = 0 ; r < 16 ; r++ ) batch->V[r * stride + l] = batch->flags[r * stride + l] = 0 ;
+    for ( uint32_t s = 0 ; s < CHIP8_STACK_SIZE ; s++ ) batch->stack[s * stride + l] = 0 ;
+    batch->I[l] = 0 ;
+    batch->pc[l] = 0x200 ;
+    batch->sp[l] = 0 ;
+    batch->delay_timer[l] = batch->sound_timer[l] = 0 ;
+    batch->rng[l] = seed ? seed : CHIP8_RNG_SEED ;
+    batch->keys[l] = 0 ;
+    batch->state[l] = BATCH_RUNNING ;
+    batch->hires[l] = false ;
+    batch->plane_mask[l] = 0x01 ;
+    memcpy ( batch->memory + (size_t)l * CHIP8_MEMORY_SIZE , batch->image , CHIP8_MEMORY_SIZE ) ;
+    memset ( batch->display[l] , 0 , sizeof ( batch->display[l] ) ) ;
+}
+
+void batch_reset ( chip8_batch_t *batch , const uint32_t *seeds ) {
+    for ( uint32_t l = 0 ; l < batch->lanes ; l++ ) reset_lane ( batch , l , seeds ? seeds[l] : CHIP8_RNG_SEED ) ;
+    // The padding never runs
+    for ( uint32_t l = batch->lanes ; l < batch->stride ; l++ ) batch->state[l] = BATCH_STOPPED ;
+    memset ( batch->written , 0 , sizeof ( batch->written ) ) ;
+    // One group of every lane at 0x200
+    memset ( batch->group , 0 , batch->lanes ) ;
+    memset ( batch->group + batch->lanes , BATCH_GROUP_NONE , batch->stride - batch->lanes ) ;
+    batch->groups = 1 ;
+    batch->group_pc[0] = 0x200 ;
+    batch->group_size[0] = batch->lanes ;
+    batch->alone = 0 ;
+    batch->parked = 0 ;
+    batch->detached = 0 ;
+    batch->scalar_share = 0 ;
+}
+
+void batch_reset_lane ( chip8_batch_t *batch , uint32_t lane , uint32_t seed ) {
+    if ( lane >= batch->lanes ) return ;
+    leave_group ( batch , lane ) ;
+    reset_lane ( batch , lane , seed ) ;
+    set_alone ( batch , lane ) ;
+}
+
+const char *batch_simd_name ( const chip8_batch_t *batch ) {
+    return batch->kernel->name ;
+}
+
+// ---------------------------------------------------------------------------
+// One lane at a time
+
+// A lane wrote [address, address + length): instructions reading those
+// bytes (one starting a byte earlier included) now come from lane memory
+static void mark_written ( chip8_batch_t *batch , uint16_t address , uint32_t length ) {
+    for ( uint32_t i = 0 ; i <= length ; i++ ) batch->written[(address - 1 + i) & MASK] = 1 ;
+}
+
+// The instruction at pc for one lane: the shared decode unless a lane wrote there
+static decoded_inst_t lane_decode ( const chip8_batch_t *batch , uint32_t lane , uint16_t pc ) {
+    if ( !batch->written[pc & MASK] ) return batch->decoded[pc & MASK] ;
+    const uint8_t *memory = batch->memory + (size_t)lane * CHIP8_MEMORY_SIZE ;
+    const uint16_t opcode = (memory[pc & MASK] << 8) | memory[(pc + 1) & MASK] ;
+    decoded_inst_t d = {
+        .op = decode_op ( opcode ) , .X = (opcode >> 8) & 0x0F , .Y = (opcode >> 4) & 0x0F ,
+        .N = opcode & 0x0F , .NN = opcode & 0xFF , .NNN = opcode & 0x0FFF ,
+    } ;
+    if ( d.op == OP_LD_I_LONG ) d.op = OP_NOP ; // The four-byte form is XO-CHIP only
+    return d ;
+}
+
+// Execute the instruction at pc on one lane, as interpreter.inc does;
+// returns the lane's next pc
+static uint16_t step_lane ( chip8_batch_t *batch , uint32_t l , uint16_t pc ) {
+    const uint32_t stride = batch->stride ;
+    const quirk_set_t *quirks = batch->quirk_set ;
+    const decoded_inst_t d = lane_decode ( batch , l , pc ) ;
+    uint8_t *memory = batch->memory + (size_t)l * CHIP8_MEMORY_SIZE ;
+    uint8_t *V = batch->V + l ; // V[r * stride] is register r of the lane
+    #define REG(r) V[(r) * stride]
+    uint16_t *I = &batch->I[l] ;
+    uint8_t carry ;
+    pc += 2 ;
+
+    switch ( d.op ) {
+        case OP_CLS :
+            display_clear ( batch->display[l] , batch->hires[l] , batch->plane_mask[l] ) ;
+            break ;
+        case OP_RET :
+            pc = batch->stack[( --batch->sp[l] & STACK_MASK ) * stride + l] ;
+            break ;
+        case OP_JP :
+            pc = d.NNN ;
+            break ;
+        case OP_CALL :
+            batch->stack[( batch->sp[l]++ & STACK_MASK ) * stride + l] = pc ;
+            pc = d.NNN ;
+            break ;
+        case OP_SE_VX_NN : case OP_SNE_VX_NN : case OP_SE_VX_VY : case OP_SNE_VX_VY : case OP_SKP : case OP_SKNP :
+            if ( lane_skips ( batch , l , &d ) ) pc += 2 ;
+            break ;
+        case OP_LD_VX_NN : REG(d.X) = d.NN ; break ;
+        case OP_ADD_VX_NN : REG(d.X) += d.NN ; break ;
+        case OP_LD_VX_VY : REG(d.X) = REG(d.Y) ; break ;
+        case OP_OR :
+            REG(d.X) |= REG(d.Y) ;
+            if ( quirks->vf_reset_or_xor ) REG(0xF) = 0 ;
+            break ;
+        case OP_AND :
+            REG(d.X) &= REG(d.Y) ;
+            if ( quirks->vf_reset_and ) REG(0xF) = 0 ;
+            break ;
+        case OP_XOR :
+            REG(d.X) ^= REG(d.Y) ;
+            if ( quirks->vf_reset_or_xor ) REG(0xF) = 0 ;
+            break ;
+        case OP_ADD_VX_VY :
+            carry = REG(d.X) + REG(d.Y) > 255 ;
+            REG(d.X) += REG(d.Y) ;
+            REG(0xF) = carry ;
+            break ;
+        case OP_SUB :
+            carry = REG(d.Y) <= REG(d.X) ;
+            REG(d.X) -= REG(d.Y) ;
+            REG(0xF) = carry ;
+            break ;
+        case OP_SHR :
+            carry = REG(quirks->shift_vy ? d.Y : d.X) ;
+            REG(d.X) = carry >> 1 ;
+            REG(0xF) = carry & 0x1 ;
+            break ;
+        case OP_SUBN :
+            carry = REG(d.X) <= REG(d.Y) ;
+            REG(d.X) = REG(d.Y) - REG(d.X) ;
+            REG(0xF) = carry ;
+            break ;
+        case OP_SHL :
+            carry = REG(quirks->shift_vy ? d.Y : d.X) ;
+            REG(d.X) = carry << 1 ;
+            REG(0xF) = carry >> 7 ;
+            break ;
+        case OP_LD_I : *I = d.NNN ; break ;
+        case OP_JP_V0 :
+            pc = REG(quirks->jump_vx ? d.X : 0) + d.NNN ;
+            break ;
+        case OP_RND : {
+            uint32_t rng = batch->rng[l] ;
+            rng ^= rng << 13 ;
+            rng ^= rng >> 17 ;
+            rng ^= rng << 5 ;
+            batch->rng[l] = rng ;
+            REG(d.X) = (rng >> 24) & d.NN ;
+            break ;
+        }
+        case OP_DRW :
+            REG(0xF) = display_draw ( batch->display[l] , batch->hires[l] , batch->plane_mask[l] , memory , MASK ,
+                                      *I , REG(d.X) , REG(d.Y) , d.N , quirks->clip ) ;
+            if ( quirks->display_wait ) batch->state[l] = BATCH_WAITING ; // until the next batch_tick_timers
+            break ;
+        case OP_LD_VX_DT : REG(d.X) = batch->delay_timer[l] ; break ;
+        case OP_LD_VX_K :
+            // Lowest key down, else repeat this instruction
+            if ( batch->keys[l] ) {
+                uint8_t key = 0 ;
+                while ( !( ( batch->keys[l] >> key ) & 1 ) ) key++ ;
+                REG(d.X) = key ;
+            } else pc -= 2 ;
+            break ;
+        case OP_LD_DT_VX : batch->delay_timer[l] = REG(d.X) ; break ;
+        case OP_LD_ST_VX : batch->sound_timer[l] = REG(d.X) ; break ;
+        case OP_ADD_I_VX : *I += REG(d.X) ; break ;
+        case OP_LD_F_VX : *I = REG(d.X) * 5 ; break ;
+        case OP_LD_B_VX : {
+            const uint8_t value = REG(d.X) ;
+            memory[*I & MASK] = value / 100 ;
+            memory[(*I + 1) & MASK] = (value / 10) % 10 ;
+            memory[(*I + 2) & MASK] = value % 10 ;
+            mark_written ( batch , *I , 3 ) ;
+            break ;
+        }
+        case OP_LD_MEM_VX :
+            for ( uint32_t i = 0 ; i <= d.X ; i++ ) memory[(*I + i) & MASK] = REG(i) ;
+            mark_written ( batch , *I , d.X + 1u ) ;
+            if ( quirks->index != INDEX_UNCHANGED ) *I += d.X + (quirks->index == INDEX_PAST_LAST) ;
+            break ;
+        case OP_LD_VX_MEM :
+            for ( uint32_t i = 0 ; i <= d.X ; i++ ) REG(i) = memory[(*I + i) & MASK] ;
+            if ( quirks->index != INDEX_UNCHANGED ) *I += d.X + (quirks->index == INDEX_PAST_LAST) ;
+            break ;
+        case OP_SCD : case OP_SCU :
+            display_scroll_vertical ( batch->display[l] , batch->hires[l] , batch->plane_mask[l] , d.N , d.op == OP_SCD ) ;
+            break ;
+        case OP_SCR : case OP_SCL :
+            display_scroll_horizontal ( batch->display[l] , batch->hires[l] , batch->plane_mask[l] , d.op == OP_SCR ) ;
+            break ;
+        case OP_EXIT :
+            batch->state[l] = BATCH_STOPPED ;
+            pc -= 2 ;
+            break ;
+        case OP_LORES : case OP_HIRES :
+            batch->hires[l] = d.op == OP_HIRES ;
+            memset ( batch->display[l] , 0 , sizeof ( batch->display[l] ) ) ;
+            break ;
+        case OP_SAVE_RANGE : case OP_LOAD_RANGE : {
+            const int step = d.X <= d.Y ? 1 : -1 ;
+            const uint32_t count = (uint32_t)( (d.Y - d.X) * step + 1 ) ;
+            for ( uint32_t i = 0 ; i < count ; i++ ) {
+                uint8_t *reg = &REG((d.X + i * step) & 0x0F) ;
+                if ( d.op == OP_SAVE_RANGE ) memory[(*I + i) & MASK] = *reg ;
+                else *reg = memory[(*I + i) & MASK] ;
+            }
+            if ( d.op == OP_SAVE_RANGE ) mark_written ( batch , *I , count ) ;
+            break ;
+        }
+        case OP_PLANE : batch->plane_mask[l] = d.X & 0x03 ; break ;
+        case OP_LD_HF_VX : *I = CHIP8_BIG_FONT_ADDRESS + (REG(d.X) & 0x0F) * 10 ; break ;
+        case OP_SAVE_FLAGS :
+            for ( uint32_t i = 0 ; i <= d.X ; i++ ) batch->flags[i * stride + l] = REG(i) ;
+            break ;
+        case OP_LOAD_FLAGS :
+            for ( uint32_t i = 0 ; i <= d.X ; i++ ) REG(i) = batch->flags[i * stride + l] ;
+            break ;
+        default : // 0NNN and undefined opcodes
+            break ;
+    }
+    #undef REG
+    return pc ;
+}
+
+// ---------------------------------------------------------------------------
+// Stepping
+
+// One iteration of the loop at `start` on a lane, on the register copy V;
+// its length in instructions, 0 when it runs anything but idle instructions
+// (idle_iteration in chip8.c, for a lane)
+static uint32_t lane_idle_iteration ( const chip8_batch_t *batch , uint32_t l , uint16_t start , uint8_t V[16] ) {
+    uint16_t pc = start ;
+    for ( uint32_t steps = 1 ; steps <= IDLE_MAX_STEPS ; steps++ ) {
+        const decoded_inst_t d = lane_decode ( batch , l , pc ) ;
+        if ( !idle_instruction ( d.op ) ) return 0 ;
+        pc += 2 ;
+        switch ( d.op ) {
+            case OP_JP : pc = d.NNN ; break ;
+            case OP_SE_VX_NN : if ( V[d.X] == d.NN ) pc += 2 ; break ;
+            case OP_SNE_VX_NN : if ( V[d.X] != d.NN ) pc += 2 ; break ;
+            case OP_SE_VX_VY : if ( V[d.X] == V[d.Y] ) pc += 2 ; break ;
+            case OP_SNE_VX_VY : if ( V[d.X] != V[d.Y] ) pc += 2 ; break ;
+            case OP_SKP : if ( ( batch->keys[l] >> (V[d.X] & 0x0F) ) & 1 ) pc += 2 ; break ;
+            case OP_SKNP : if ( !( ( batch->keys[l] >> (V[d.X] & 0x0F) ) & 1 ) ) pc += 2 ; break ;
+            case OP_LD_VX_DT : V[d.X] = batch->delay_timer[l] ; break ;
+            case OP_LD_VX_NN : V[d.X] = d.NN ; break ;
+            case OP_LD_VX_VY : V[d.X] = V[d.Y] ; break ;
+            default : break ; // 0NNN
+        }
+        if ( pc == start ) return steps ;
+    }
+    return 0 ;
+}
+
+// The steps left out of `remaining` with the lane at `start` once whole
+// iterations of an idle loop there are skipped, as skip_idle_loop does
+static uint32_t skip_lane_idle_loop ( chip8_batch_t *batch , uint32_t l , uint16_t start , uint32_t remaining ) {
+    const uint32_t stride = batch->stride ;
+    uint8_t V[16] , settled[16] ;
+    for ( uint32_t r = 0 ; r < 16 ; r++ ) V[r] = batch->V[r * stride + l] ;
+    const uint32_t first = lane_idle_iteration ( batch , l , start , V ) ;
+    if ( first == 0 || first > remaining ) return remaining ;
+    memcpy ( settled , V , sizeof ( V ) ) ;
+    const uint32_t period = lane_idle_iteration ( batch , l , start , V ) ;
+    if ( period == 0 || memcmp ( V , settled , sizeof ( V ) ) != 0 ) return remaining ;
+    for ( uint32_t r = 0 ; r < 16 ; r++ ) batch->V[r * stride + l] = settled[r] ;
+    return ( remaining - first ) % period ;
+}
+
+// The first lane from l on in group g, batch->lanes when there is none.
+// Eight group bytes are tested at a time: a few lanes of a big batch are
+// often all a group has.
+static uint32_t find_lane ( const chip8_batch_t *batch , uint32_t l , uint8_t g ) {
+    const uint64_t ones = 0x0101010101010101ull , pattern = ones * g ;
+    for ( ; l < batch->lanes ; l++ ) {
+        if ( (l & 7) == 0 ) {
+            // The arrays are padded to whole vectors, l + 8 <= stride
+            uint64_t word ;
+            memcpy ( &word , batch->group + l , sizeof ( word ) ) ;
+            word ^= pattern ;
+            if ( !( ( word - ones ) & ~word & ( ones << 7 ) ) ) { // No zero byte: no lane of g
+                l += 7 ;
+                continue ;
+            }
+        }
+        if ( batch->group[l] == g ) return l ;
+    }
+    return batch->lanes ;
+}
+
+// Put a running lane at pc in the group there among groups first and up,
+// opening one if there is room, else leave it on its own
+static void join_group ( chip8_batch_t *batch , uint32_t l , uint16_t pc , uint32_t first ) {
+    for ( uint32_t g = first ; g < batch->groups ; g++ ) {
+        if ( batch->group_pc[g] != pc ) continue ;
+        batch->group[l] = (uint8_t)g ;
+        batch->group_size[g]++ ;
+        return ;
+    }
+    if ( batch->groups < BATCH_MAX_GROUPS ) {
+        const uint32_t g = batch->groups++ ;
+        batch->group_pc[g] = pc ;
+        batch->group_size[g] = 1 ;
+        batch->group[l] = (uint8_t)g ;
+        return ;
+    }
+    batch->pc[l] = pc ;
+    set_alone ( batch , l ) ;
+}
+
+// Run group g's instruction lane by lane. The lanes that end up where the
+// first one does stay in g; the others go to groups opened this step
+// (first_new and up), lanes that stop or wait leave the groups. A lane
+// waiting for the frame uses up the `remaining` steps of the call, as
+// run_cycles counts them, which go to *waiting_steps. Returns the lanes run.
+static uint32_t step_group_lanes ( chip8_batch_t *batch , uint32_t g , uint32_t first_new , uint32_t remaining ,
+                                   uint64_t *waiting_steps ) {
+    const uint16_t pc = batch->group_pc[g] ;
+    const uint32_t size = batch->group_size[g] ;
+    uint16_t group_pc = 0 ;
+    bool any = false ;
+    for ( uint32_t l = find_lane ( batch , 0 , (uint8_t)g ) ; l < batch->lanes ; l = find_lane ( batch , l + 1 , (uint8_t)g ) ) {
+        const uint16_t next = step_lane ( batch , l , pc ) ;
+        if ( batch->state[l] != BATCH_RUNNING ) {
+            if ( batch->state[l] == BATCH_WAITING ) *waiting_steps += remaining ;
+            batch->group[l] = BATCH_GROUP_NONE ;
+            batch->pc[l] = next ;
+            batch->group_size[g]-- ;
+            continue ;
+        }
+        if ( !any ) {
+            any = true ;
+            group_pc = next ;
+        } else if ( next != group_pc ) {
+            batch->group_size[g]-- ;
+            join_group ( batch , l , next , first_new ) ;
+        }
+    }
+    batch->group_pc[g] = group_pc ;
+    return size ;
+}
+
+// Group g jumped back with `remaining` steps of the batch_step call left:
+// its lanes spinning in an idle loop there skip to where the call would
+// leave them and sit it out (BATCH_GROUP_PARKED). Returns the steps they
+// account for.
+static uint64_t park_idle_lanes ( chip8_batch_t *batch , uint32_t g , uint32_t remaining ) {
+    const uint16_t start = batch->group_pc[g] ;
+    if ( !batch->written[start & MASK] && !idle_instruction ( batch->decoded[start & MASK].op ) ) return 0 ;
+    uint64_t steps = 0 ;
+    for ( uint32_t l = find_lane ( batch , 0 , (uint8_t)g ) ; l < batch->lanes ; l = find_lane ( batch , l + 1 , (uint8_t)g ) ) {
+        uint32_t left = skip_lane_idle_loop ( batch , l , start , remaining ) ;
+        if ( left == remaining ) continue ; // Not idle, or not for long enough
+        // Less than an iteration to go: idle instructions, the lane keeps running
+        uint16_t pc = start ;
+        for ( ; left ; left-- ) pc = step_lane ( batch , l , pc ) ;
+        batch->pc[l] = pc ;
+        batch->group[l] = BATCH_GROUP_PARKED ;
+        batch->group_size[g]-- ;
+        batch->parked++ ;
+        steps += remaining ;
+    }
+    return steps ;
+}
+
+// One instruction on the lanes of group g, with `remaining` steps of the
+// call left after it; returns the lanes that ran it one at a time, adds the
+// steps of lanes parked or waiting for the frame to *parked_steps
+static uint32_t step_group ( chip8_batch_t *batch , uint32_t g , uint32_t first_new , uint32_t remaining ,
+                             uint64_t *parked_steps ) {
+    const uint16_t pc = batch->group_pc[g] ;
+    if ( batch->written[pc & MASK] ) {
+        // Some lane changed this code, each runs what is in its own memory
+        return step_group_lanes ( batch , g , first_new , remaining , parked_steps ) ;
+    }
+    const decoded_inst_t *d = &batch->decoded[pc & MASK] ;
+    const batch_kernel_t *kernel = batch->kernel ;
+    // Every lane in the group: no masking
+    const uint8_t *group = batch->group_size[g] == batch->lanes ? NULL : batch->group ;
+    if ( kernel->registers ( batch , d , group , (uint8_t)g ) || kernel->index ( batch , d , group , (uint8_t)g ) ) {
+        batch->group_pc[g] = pc + 2 ;
+        return 0 ;
+    }
+    switch ( d->op ) {
+        case OP_JP :
+            batch->group_pc[g] = d->NNN ;
+            // A backward jump may close an idle loop, as in the interpreter
+            if ( d->NNN < pc && remaining >= IDLE_MIN_REMAINING ) *parked_steps += park_idle_lanes ( batch , g , remaining ) ;
+            return 0 ;
+        case OP_CALL :
+            for ( uint32_t l = 0 ; l < batch->lanes ; l++ ) {
+                if ( group && group[l] != g ) continue ;
+                batch->stack[( batch->sp[l]++ & STACK_MASK ) * batch->stride + l] = pc + 2 ;
+            }
+            batch->group_pc[g] = d->NNN ;
+            return 0 ;
+        case OP_SE_VX_NN : case OP_SNE_VX_NN : case OP_SE_VX_VY : case OP_SNE_VX_VY : case OP_SKP : case OP_SKNP : {
+            if ( batch->groups == BATCH_MAX_GROUPS ) break ; // No room to split
+            const uint8_t taken = (uint8_t)batch->groups ;
+            const int skip = kernel->skip ( batch , d , (uint8_t)g , taken ) ;
+            if ( skip == BATCH_SKIP_MIXED ) {
+                // The lanes that skip are now group `taken`
+                uint32_t size = 0 ;
+                for ( uint32_t l = 0 ; l < batch->lanes ; l++ ) size += batch->group[l] == taken ;
+                batch->groups++ ;
+                batch->group_pc[taken] = pc + 4 ;
+                batch->group_size[taken] = size ;
+                batch->group_size[g] -= size ;
+            }
+            batch->group_pc[g] = pc + ( skip == BATCH_SKIP_ALL ? 4 : 2 ) ;
+            return 0 ;
+        }
+        default :
+            break ;
+    }
+    // Everything else (draws, returns, keys, memory) on each lane
+    return step_group_lanes ( batch , g , first_new , remaining , parked_steps ) ;
+}
+
+// Merge groups at the same pc, drop the empty ones, and put lanes on their
+// own back in groups where one is at their pc or there is room for one
+static void regroup ( chip8_batch_t *batch ) {
+    const batch_kernel_t *kernel = batch->kernel ;
+    uint32_t g = 0 ;
+    while ( g < batch->groups ) {
+        for ( uint32_t h = 0 ; h < g && batch->group_size[g] ; h++ ) {
+            if ( batch->group_pc[h] != batch->group_pc[g] ) continue ;
+            kernel->relabel ( batch , (uint8_t)g , (uint8_t)h ) ;
+            batch->group_size[h] += batch->group_size[g] ;
+            batch->group_size[g] = 0 ;
+        }
+        if ( batch->group_size[g] == 0 ) {
+            // The last group takes the place, and is looked at next
+            const uint32_t last = --batch->groups ;
+            if ( last != g ) {
+                kernel->relabel ( batch , (uint8_t)last , (uint8_t)g ) ;
+                batch->group_pc[g] = batch->group_pc[last] ;
+                batch->group_size[g] = batch->group_size[last] ;
+            }
+            continue ;
+        }
+        g++ ;
+    }
+    for ( uint32_t l = 0 ; batch->alone && l < batch->lanes ; l++ ) {
+        l = find_lane ( batch , l , BATCH_GROUP_ALONE ) ;
+        if ( l == batch->lanes ) break ;
+        batch->alone-- ;
+        join_group ( batch , l , batch->pc[l] , 0 ) ;
+    }
+}
+
+// Lanes running now, in groups or not
+static uint32_t running_lanes ( const chip8_batch_t *batch ) {
+    uint32_t running = batch->alone ;
+    for ( uint32_t g = 0 ; g < batch->groups ; g++ ) running += batch->group_size[g] ;
+    return running ;
+}
+
+// One instruction on every running lane, `remaining` steps of the call left
+// after it; returns the lanes that ran it one at a time, adds the steps of
+// lanes parked or waiting for the frame to *parked_steps
+static uint32_t step_groups ( chip8_batch_t *batch , uint32_t remaining , uint64_t *parked_steps ) {
+    uint32_t scalar = batch->alone ;
+    // Lanes on their own first: the ones that leave a group below have run already
+    for ( uint32_t l = 0 , left = batch->alone ; left && l < batch->lanes ; l++ ) {
+        l = find_lane ( batch , l , BATCH_GROUP_ALONE ) ;
+        if ( l == batch->lanes ) break ;
+        left-- ;
+        batch->pc[l] = step_lane ( batch , l , batch->pc[l] ) ;
+        if ( batch->state[l] != BATCH_RUNNING ) {
+            if ( batch->state[l] == BATCH_WAITING ) *parked_steps += remaining ;
+            batch->group[l] = BATCH_GROUP_NONE ;
+            batch->alone-- ;
+        }
+    }
+    const uint32_t groups = batch->groups ;
+    for ( uint32_t g = 0 ; g < groups ; g++ ) {
+        if ( batch->group_size[g] ) scalar += step_group ( batch , g , groups , remaining , parked_steps ) ;
+    }
+    regroup ( batch ) ;
+    return scalar ;
+}
+
+// Move a running lane onto a machine of its own, loaded once with the
+// batch's ROM; false when out of memory (the lane stays in the arrays)
+static bool detach_lane ( chip8_batch_t *batch , uint32_t l ) {
+    chip8_t *chip8 = batch->machine[l] ;
+    if ( !chip8 ) {
+        chip8 = calloc ( 1 , sizeof ( chip8_t ) ) ;
+        if ( !chip8 ) return false ;
+        chip8->quirks_request = batch->quirks ;
+        if ( !load_chip8 ( chip8 , batch->image + 0x200 , batch->rom_size , NULL ) ) {
+            free_chip8 ( chip8 ) ;
+            free ( chip8 ) ;
+            return false ;
+        }
+        batch->machine[l] = chip8 ;
+    }
+    batch_export_lane ( batch , l , chip8 ) ;
+    leave_group ( batch , l ) ;
+    batch->group[l] = BATCH_GROUP_DETACHED ;
+    batch->detached++ ;
+    return true ;
+}
+
+// `steps` instructions on a detached lane, as run_cycles in a loop over
+// machines would run them (a stopped one does not run)
+static uint32_t run_machine ( chip8_batch_t *batch , uint32_t l , uint32_t steps ) {
+    chip8_t *chip8 = batch->machine[l] ;
+    if ( chip8->state != RUNNING ) return 0 ;
+    for ( uint32_t k = 0 ; k < 16 ; k++ ) chip8->keypad[k] = ( batch->keys[l] >> k ) & 1 ;
+    const uint32_t ran = run_cycles ( chip8 , steps ) ;
+    if ( chip8->state == STOPPED ) batch->state[l] = BATCH_STOPPED ;
+    return ran ;
+}
+
+// Every detached lane; returns the instructions run
+static uint64_t step_machines ( chip8_batch_t *batch , uint32_t steps ) {
+    uint64_t executed = 0 ;
+    for ( uint32_t l = 0 , left = batch->detached ; left && l < batch->lanes ; l++ ) {
+        if ( batch->group[l] != BATCH_GROUP_DETACHED ) continue ;
+        left-- ;
+        executed += run_machine ( batch , l , steps ) ;
+    }
+    return executed ;
+}
+
+// Lanes running mostly one at a time anyway (spread over more pcs than the
+// groups hold, or at draws and memory instructions): take them all out of
+// the groups and onto machines of their own. On the VIP profile, or out of
+// memory, run each one's steps in a row in the arrays instead, which keeps
+// its state in cache. Returns the instructions run.
+static uint64_t step_each ( chip8_batch_t *batch , uint32_t steps ) {
+    uint64_t executed = 0 ;
+    for ( uint32_t l = 0 ; l < batch->lanes ; l++ ) {
+        const uint8_t g = batch->group[l] ;
+        // Detached ones ran at the start of the call
+        if ( g == BATCH_GROUP_NONE || g == BATCH_GROUP_DETACHED ) continue ;
+        if ( g == BATCH_GROUP_PARKED ) {
+            // Already at the end of the call: off the arrays too, or they
+            // only rejoin the groups to split from them again next call
+            if ( !batch->quirk_set->display_wait ) detach_lane ( batch , l ) ;
+            continue ;
+        }
+        if ( !batch->quirk_set->display_wait && detach_lane ( batch , l ) ) {
+            executed += run_machine ( batch , l , steps ) ;
+            continue ;
+        }
+        uint16_t pc = lane_pc ( batch , l ) ;
+        uint32_t s = 0 ;
+        while ( s < steps && batch->state[l] == BATCH_RUNNING ) {
+            const uint16_t next = step_lane ( batch , l , pc ) ;
+            s++ ;
+            // FX0A with no key down and a jump to itself repeat unchanged until the keypad does
+            if ( next == pc && batch->state[l] == BATCH_RUNNING ) {
+                const uint8_t op = lane_decode ( batch , l , pc ).op ;
+                if ( op == OP_LD_VX_K || op == OP_JP ) s = steps ;
+            } else if ( next < pc && steps - s >= IDLE_MIN_REMAINING && lane_decode ( batch , l , pc ).op == OP_JP ) {
+                // A backward jump may close an idle loop, as in the interpreter
+                s = steps - skip_lane_idle_loop ( batch , l , next , steps - s ) ;
+            }
+            pc = next ;
+        }
+        if ( batch->state[l] == BATCH_WAITING ) s = steps ; // The wait for the frame uses up the call, as in run_cycles
+        batch->pc[l] = pc ;
+        batch->group[l] = batch->state[l] == BATCH_RUNNING ? BATCH_GROUP_ALONE : BATCH_GROUP_NONE ;
+        executed += s ;
+    }
+    batch->groups = 0 ;
+    batch->alone = 0 ;
+    for ( uint32_t l = 0 ; l < batch->lanes ; l++ ) batch->alone += batch->group[l] == BATCH_GROUP_ALONE ;
+    return executed ;
+}
+
+uint64_t batch_step ( chip8_batch_t *batch , uint32_t steps ) {
+    uint64_t executed = batch->detached ? step_machines ( batch , steps ) : 0 ;
+    // Lanes parked, woken, reset or imported since the last call join the groups
+    for ( uint32_t l = 0 ; batch->parked && l < batch->lanes ; l++ ) {
+        l = find_lane ( batch , l , BATCH_GROUP_PARKED ) ;
+        if ( l == batch->lanes ) break ;
+        batch->parked-- ;
+        set_alone ( batch , l ) ;
+    }
+    if ( batch->alone ) regroup ( batch ) ;
+    for ( uint32_t s = 0 ; s < steps ; s++ ) {
+        const uint32_t running = running_lanes ( batch ) ;
+        if ( running == 0 ) break ; // Every lane waits for the frame or stopped
+        // Mostly lanes run one at a time, or so few lanes left running that a
+        // pass over every group's vectors costs more than running them one
+        // by one: no point grouping them again this call
+        if ( batch->alone * 2 > running || batch->scalar_share > 128 ||
+             (uint64_t)running * BATCH_VECTOR_BYTES < (uint64_t)batch->groups * batch->stride ) {
+            return executed + step_each ( batch , steps - s ) ;
+        }
+        const uint32_t scalar = step_groups ( batch , steps - s - 1 , &executed ) ;
+        batch->scalar_share = ( batch->scalar_share * 15 + (uint32_t)( (uint64_t)scalar * 256 / running ) ) / 16 ;
+        executed += running ;
+    }
+    return executed ;
+}
+
+void batch_tick_timers ( chip8_batch_t *batch ) {
+    batch->kernel->tick ( batch ) ;
+    for ( uint32_t l = 0 ; l < batch->lanes ; l++ ) {
+        if ( batch->group[l] == BATCH_GROUP_DETACHED ) tick_timers ( batch->machine[l] ) ;
+        if ( batch->state[l] != BATCH_WAITING ) continue ;
+        // pc[l] was kept when it left its group
+        batch->state[l] = BATCH_RUNNING ;
+        set_alone ( batch , l ) ;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Lanes to and from chip8_t
+
+// Only the bytes that differ, so the chip8_t keeps the rest of its decode
+// cache; compared a cache line at a time, as few do
+static void export_memory ( const uint8_t *memory , chip8_t *chip8 ) {
+    for ( uint32_t line = 0 ; line < CHIP8_MEMORY_SIZE ; line += 64 ) {
+        if ( !memcmp ( chip8->memory + line , memory + line , 64 ) ) continue ;
+        for ( uint32_t address = line ; address < line + 64 ; address++ ) {
+            if ( chip8->memory[address] == memory[address] ) continue ;
+            chip8->memory[address] = memory[address] ;
+            invalidate_decoded ( chip8 , (uint16_t)address , 1 ) ;
+        }
+    }
+}
+
+// A detached lane's machine into chip8, the fields batch_export_lane copies
+// (the keypad comes from keys[] as for the other lanes)
+static void export_machine ( const chip8_t *machine , chip8_t *chip8 ) {
+    export_memory ( machine->memory , chip8 ) ;
+    memcpy ( chip8->display , machine->display , sizeof ( chip8->display ) ) ;
+    chip8->hires = machine->hires ;
+    chip8->plane_mask = machine->plane_mask ;
+    memcpy ( chip8->V , machine->V , sizeof ( chip8->V ) ) ;
+    memcpy ( chip8->flags , machine->flags , sizeof ( chip8->flags ) ) ;
+    memcpy ( chip8->stack , machine->stack , sizeof ( chip8->stack ) ) ;
+    chip8->I = machine->I ;
+    chip8->pc = machine->pc ;
+    chip8->sp = machine->sp ;
+    chip8->delay_timer = machine->delay_timer ;
+    chip8->sound_timer = machine->sound_timer ;
+    chip8->rng = machine->rng ;
+    chip8->state = machine->state ;
+}
+
+void batch_export_lane ( chip8_batch_t *batch , uint32_t lane , chip8_t *chip8 ) {
+    if ( lane >= batch->lanes ) return ;
+    if ( batch->group[lane] == BATCH_GROUP_DETACHED ) {
+        export_machine ( batch->machine[lane] , chip8 ) ;
+        for ( uint32_t k = 0 ; k < 16 ; k++ ) chip8->keypad[k] = ( batch->keys[lane] >> k ) & 1 ;
+        return ;
+    }
+    const uint32_t stride = batch->stride ;
+    export_memory ( batch->memory + (size_t)lane * CHIP8_MEMORY_SIZE , chip8 ) ;
+    memcpy ( chip8->display , batch->display[lane] , sizeof ( chip8->display ) ) ;
+    chip8->hires = batch->hires[lane] ;
+    chip8->plane_mask = batch->plane_mask[lane] ;
+    for ( uint32_t k = 0 ; k < 16 ; k++ ) chip8->keypad[k] = ( batch->keys[lane] >> k ) & 1 ;
+    for ( uint32_t r = 0 ; r < 16 ; r++ ) {
+        chip8->V[r] = batch->V[r * stride + lane] ;
+        chip8->flags[r] = batch->flags[r * stride + lane] ;
+    }
+    for ( uint32_t s = 0 ; s < CHIP8_STACK_SIZE ; s++ ) chip8->stack[s] = batch->stack[s * stride + lane] ;
+    chip8->I = batch->I[lane] ;
+    chip8->pc = lane_pc ( batch , lane ) ;
+    chip8->sp = batch->sp[lane] ;
+    chip8->delay_timer = batch->delay_timer[lane] ;
+    chip8->sound_timer = batch->sound_timer[lane] ;
+    chip8->rng = batch->rng[lane] ;
+    chip8->state = batch->state[lane] == BATCH_STOPPED ? STOPPED : RUNNING ;
+}
+
+void batch_import_lane ( chip8_batch_t *batch , uint32_t lane , const chip8_t *chip8 ) {
+    if ( lane >= batch->lanes ) return ;
+    const uint32_t stride = batch->stride ;
+    uint8_t *memory = batch->memory + (size_t)lane * CHIP8_MEMORY_SIZE ;
+    memcpy ( memory , chip8->memory , CHIP8_MEMORY_SIZE ) ;
+    for ( uint32_t address = 0 ; address < CHIP8_MEMORY_SIZE ; address++ ) {
+        if ( memory[address] != batch->image[address] ) mark_written ( batch , (uint16_t)address , 1 ) ;
+    }
+    memcpy ( batch->display[lane] , chip8->display , sizeof ( batch->display[lane] ) ) ;
+    batch->hires[lane] = chip8->hires ;
+    batch->plane_mask[lane] = chip8->plane_mask ;
+    batch->keys[lane] = 0 ;
+    for ( uint32_t k = 0 ; k < 16 ; k++ ) batch->keys[lane] |= (uint16_t)( chip8->keypad[k] ? 1u << k : 0 ) ;
+    for ( uint32_t r = 0 ; r < 16 ; r++ ) {
+        batch->V[r * stride + lane] = chip8->V[r] ;
+        batch->flags[r * stride + lane] = chip8->flags[r] ;
+    }
+    for ( uint32_t s = 0 ; s < CHIP8_STACK_SIZE ; s++ ) batch->stack[s * stride + lane] = chip8->stack[s] ;
+    batch->I[lane] = chip8->I ;
+    leave_group ( batch , lane ) ;
+    batch->pc[lane] = chip8->pc ;
+    batch->sp[lane] = chip8->sp ;
+    batch->delay_timer[lane] = chip8->delay_timer ;
+    batch->sound_timer[lane] = chip8->sound_timer ;
+    batch->rng[lane] = chip8->rng ;
+    batch->state[lane] = chip8->state == STOPPED ? BATCH_STOPPED : BATCH_RUNNING ;
+    if ( batch->state[lane] == BATCH_RUNNING ) set_alone ( batch , lane ) ;
+}
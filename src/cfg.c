@@ -0,0 +1,340 @@
+/**
+ * @file cfg.c
+ * @brief Static Control-Flow Analysis of ROM Images
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * Recursive traversal from the entry point (see cfg.h): a worklist of
+ * block leaders, each walked in a straight line until a jump, call, skip,
+ * return or an instruction already walked. A second pass cuts the walked
+ * code at every leader into the block table. Both passes classify
+ * instructions with decode_op, so the graph matches what the interpreter
+ * runs.
+ */
+
+#include "cfg.h"
+#include "disasm.h"
+#include "jit.h"
+
+static uint16_t opcode_at ( const cfg_t *cfg , uint16_t address ) {
+    return (cfg->memory[address & cfg->mask] << 8) | cfg->memory[(address + 1) & cfg->mask] ;
+}
+
+static bool in_image ( const cfg_t *cfg , uint32_t address ) {
+    return address >= cfg->start && address + 2 <= cfg->end ;
+}
+
+// Bytes of the instruction at address (F000 NNNN is four on XO-CHIP)
+static uint16_t instruction_length ( const cfg_t *cfg , uint16_t address ) {
+    return cfg->xo_chip && decode_op ( opcode_at ( cfg , address ) ) == OP_LD_I_LONG ? 4 : 2 ;
+}
+
+static bool is_skip ( uint8_t op ) {
+    return op == OP_SE_VX_NN || op == OP_SNE_VX_NN || op == OP_SE_VX_VY || op == OP_SNE_VX_VY ||
+           op == OP_SKP || op == OP_SKNP ;
+}
+
+typedef struct {
+    uint16_t *addresses ;
+    size_t count ;
+} worklist_t ;
+
+static void add_leader ( cfg_t *cfg , worklist_t *work , uint32_t address ) {
+    if ( !in_image ( cfg , address ) || ( cfg->map[address] & CFG_LEADER ) ) return ;
+    cfg->map[address] |= CFG_LEADER ;
+    work->addresses[work->count++] = (uint16_t)address ; // Each address is pushed at most once
+}
+
+// Mark the straight-line code from address, queueing the leaders it reaches
+static void walk ( cfg_t *cfg , worklist_t *work , uint16_t address ) {
+    uint32_t pc = address ;
+    while ( in_image ( cfg , pc ) && !( cfg->map[pc] & CFG_CODE ) ) {
+        const uint16_t opcode = opcode_at ( cfg , pc ) ;
+        const uint16_t length = instruction_length ( cfg , pc ) ;
+        const uint16_t NNN = opcode & 0x0FFF ;
+        const uint8_t op = decode_op ( opcode ) ;
+        cfg->map[pc] |= CFG_CODE ;
+        for ( uint16_t i = 1 ; i < length ; i++ ) cfg->map[(pc + i) & cfg->mask] |= CFG_OPERAND ;
+
+        if ( op == OP_JP ) {
+            add_leader ( cfg , work , NNN ) ;
+            return ;
+        }
+        if ( op == OP_CALL ) {
+            cfg->map[NNN] |= CFG_CALLED ;
+            add_leader ( cfg , work , NNN ) ;
+            add_leader ( cfg , work , pc + 2 ) ;
+            return ;
+        }
+        if ( is_skip ( op ) ) {
+            add_leader ( cfg , work , pc + 2 ) ;
+            if ( in_image ( cfg , pc + 2 ) ) add_leader ( cfg , work , pc + 2 + instruction_length ( cfg , pc + 2 ) ) ;
+            return ;
+        }
+        if ( op == OP_RET || op == OP_EXIT || op == OP_JP_V0 ) return ;
+        if ( op == OP_LD_I ) cfg->map[NNN] |= CFG_DATA_REF ;
+        if ( op == OP_LD_I_LONG && cfg->xo_chip ) cfg->map[opcode_at ( cfg , pc + 2 ) & cfg->mask] |= CFG_DATA_REF ;
+        pc += length ;
+    }
+}
+
+// Cut the walked code starting at leader into one block
+static void build_block ( cfg_t *cfg , uint16_t leader , cfg_block_t *block ) {
+    *block = (cfg_block_t){ .start = leader } ;
+    uint32_t pc = leader ;
+    for ( ;; ) {
+        const uint16_t opcode = opcode_at ( cfg , pc ) ;
+        const uint32_t next = pc + instruction_length ( cfg , pc ) ;
+        const uint8_t op = decode_op ( opcode ) ;
+        block->last = (uint16_t)pc ;
+        block->end = (uint16_t)next ;
+        if ( op == OP_JP ) {
+            block->kind = CFG_END_JUMP ;
+            block->successors[block->successor_count++] = opcode & 0x0FFF ;
+            return ;
+        }
+        if ( op == OP_CALL ) {
+            block->kind = CFG_END_CALL ;
+            block->call_target = opcode & 0x0FFF ;
+            block->successors[block->successor_count++] = (uint16_t)next ;
+            return ;
+        }
+        if ( is_skip ( op ) ) {
+            block->kind = CFG_END_SKIP ;
+            block->successors[block->successor_count++] = (uint16_t)next ;
+            if ( in_image ( cfg , next ) ) block->successors[block->successor_count++] = (uint16_t)( next + instruction_length ( cfg , next ) ) ;
+            return ;
+        }
+        if ( op == OP_RET || op == OP_EXIT || op == OP_JP_V0 ) {
+            block->kind = op == OP_RET ? CFG_END_RETURN : op == OP_EXIT ? CFG_END_EXIT : CFG_END_COMPUTED ;
+            return ;
+        }
+        if ( !in_image ( cfg , next ) || !( cfg->map[next] & CFG_CODE ) ) {
+            block->kind = CFG_END_OUTSIDE ;
+            return ;
+        }
+        if ( cfg->map[next] & CFG_LEADER ) {
+            block->kind = CFG_END_FALLTHROUGH ;
+            block->successors[block->successor_count++] = (uint16_t)next ;
+            return ;
+        }
+        pc = next ;
+    }
+}
+
+bool cfg_analyze ( cfg_t *cfg , const uint8_t *memory , uint16_t mask , bool xo_chip , uint16_t start , uint32_t end ) {
+    *cfg = (cfg_t){ .memory = memory , .mask = mask , .xo_chip = xo_chip , .start = start ,
+                    .end = end > (uint32_t)mask + 1 ? (uint32_t)mask + 1 : end } ;
+    cfg->map = calloc ( (size_t)mask + 1 , 1 ) ;
+    worklist_t work = { .addresses = malloc ( ( (size_t)mask + 1 ) * sizeof ( uint16_t ) ) } ;
+    if ( !cfg->map || !work.addresses ) {
+        CHIP8_LOG ( "Could not allocate the control-flow analysis\n" ) ;
+        free ( work.addresses ) ;
+        cfg_free ( cfg ) ;
+        return false ;
+    }
+
+    add_leader ( cfg , &work , start ) ;
+    for ( size_t next = 0 ; next < work.count ; next++ ) walk ( cfg , &work , work.addresses[next] ) ;
+    free ( work.addresses ) ;
+
+    // Every leader was pushed once: that is the block count
+    size_t leaders = 0 ;
+    for ( uint32_t a = cfg->start ; a < cfg->end ; a++ ) leaders += ( cfg->map[a] & CFG_LEADER ) != 0 ;
+    cfg->blocks = malloc ( ( leaders ? leaders : 1 ) * sizeof ( cfg_block_t ) ) ;
+    cfg->computed = malloc ( ( leaders ? leaders : 1 ) * sizeof ( uint16_t ) ) ;
+    if ( !cfg->blocks || !cfg->computed ) {
+        CHIP8_LOG ( "Could not allocate the control-flow analysis\n" ) ;
+        cfg_free ( cfg ) ;
+        return false ;
+    }
+    for ( uint32_t a = cfg->start ; a < cfg->end ; a++ ) {
+        if ( !( cfg->map[a] & CFG_LEADER ) ) continue ;
+        cfg_block_t *block = &cfg->blocks[cfg->block_count++] ;
+        build_block ( cfg , (uint16_t)a , block ) ;
+        if ( block->kind == CFG_END_COMPUTED ) cfg->computed[cfg->computed_count++] = block->last ;
+    }
+    return true ;
+}
+
+void cfg_free ( cfg_t *cfg ) {
+    free ( cfg->map ) ;
+    free ( cfg->blocks ) ;
+    free ( cfg->computed ) ;
+    cfg->map = NULL ;
+    cfg->blocks = NULL ;
+    cfg->computed = NULL ;
+    cfg->block_count = cfg->computed_count = 0 ;
+}
+
+const cfg_block_t *cfg_block_at ( const cfg_t *cfg , uint16_t address ) {
+    // Last block starting at or before address
+    size_t low = 0 , high = cfg->block_count ;
+    while ( low < high ) {
+        const size_t middle = ( low + high ) / 2 ;
+        if ( cfg->blocks[middle].start <= address ) low = middle + 1 ;
+        else high = middle ;
+    }
+    if ( low == 0 ) return NULL ;
+    const cfg_block_t *block = &cfg->blocks[low - 1] ;
+    return address < block->end ? block : NULL ;
+}
+
+void cfg_prewarm ( chip8_t *chip8 , const cfg_t *cfg ) {
+    for ( size_t b = 0 ; b < cfg->block_count ; b++ ) {
+        const cfg_block_t *block = &cfg->blocks[b] ;
+        for ( uint32_t pc = block->start ; pc <= block->last ; pc += instruction_length ( cfg , pc ) ) {
+            fetch_decoded ( chip8 , pc ) ;
+        }
+        // The JIT only runs 4K programs (see run_cycles)
+        if ( chip8->jit && !chip8->xo_chip ) jit_prewarm ( chip8 , block->start ) ;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Output
+
+static const char *const end_names[] = {
+    [CFG_END_FALLTHROUGH] = "fallthrough" , [CFG_END_JUMP] = "jump" , [CFG_END_SKIP] = "skip" ,
+    [CFG_END_CALL] = "call" , [CFG_END_RETURN] = "return" , [CFG_END_EXIT] = "exit" ,
+    [CFG_END_COMPUTED] = "computed" , [CFG_END_OUTSIDE] = "outside" ,
+} ;
+
+static void print_data ( const cfg_t *cfg , uint32_t from , uint32_t to , FILE *out ) {
+    uint32_t a = from ;
+    while ( a < to ) {
+        if ( cfg->map[a] & CFG_DATA_REF ) fprintf ( out , "data_%03X:\n" , a ) ;
+        fprintf ( out , "  0x%03X:  DB" , a ) ;
+        // Up to 8 bytes per line, a new line at every referenced address
+        uint32_t i = 0 ;
+        do {
+            fprintf ( out , "%s0x%02X" , i ? ", " : " " , cfg->memory[a + i] ) ;
+            i++ ;
+        } while ( i < 8 && a + i < to && !( cfg->map[a + i] & CFG_DATA_REF ) ) ;
+        fprintf ( out , "\n" ) ;
+        a += i ;
+    }
+}
+
+void cfg_print_listing ( const cfg_t *cfg , FILE *out ) {
+    size_t subroutines = 0 ;
+    for ( size_t b = 0 ; b < cfg->block_count ; b++ ) subroutines += ( cfg->map[cfg->blocks[b].start] & CFG_CALLED ) != 0 ;
+    fprintf ( out , "; 0x%03X-0x%03X: %zu blocks, %zu subroutines, %zu computed jumps\n" , cfg->start , cfg->end - 1 ,
+              cfg->block_count , subroutines , cfg->computed_count ) ;
+
+    uint32_t cursor = cfg->start ;
+    for ( size_t b = 0 ; b < cfg->block_count ; b++ ) {
+        const cfg_block_t *block = &cfg->blocks[b] ;
+        if ( block->start > cursor ) print_data ( cfg , cursor , block->start , out ) ;
+        if ( block->end > cursor ) cursor = block->end ;
+
+        fprintf ( out , "\n%s_%03X:" , cfg->map[block->start] & CFG_CALLED ? "sub" : "L" , block->start ) ;
+        if ( block->start == cfg->start ) fprintf ( out , "  ; entry" ) ;
+        fprintf ( out , "\n" ) ;
+        for ( uint32_t pc = block->start ; pc <= block->last ; ) {
+            char text[DISASM_TEXT_MAX] ;
+            const uint16_t length = disassemble ( cfg->memory , cfg->mask , (uint16_t)pc , cfg->xo_chip , text , sizeof ( text ) ) ;
+            fprintf ( out , "  0x%03X:  %02X%02X  %s%s\n" , pc , cfg->memory[pc] , cfg->memory[(pc + 1) & cfg->mask] , text ,
+                      block->kind == CFG_END_COMPUTED && pc == block->last ? "  ; computed jump" : "" ) ;
+            pc += length ;
+        }
+    }
+    if ( cfg->end > cursor ) print_data ( cfg , cursor , cfg->end , out ) ;
+}
+
+static FILE *open_output ( const char *path ) {
+    FILE *file = fopen ( path , "w" ) ;
+    if ( !file ) CHIP8_LOG ( "Could not open %s for writing\n" , path ) ;
+    return file ;
+}
+
+static bool close_output ( FILE *file , const char *path ) {
+    const bool ok = !ferror ( file ) ;
+    if ( fclose ( file ) != 0 || !ok ) {
+        CHIP8_LOG ( "Could not write %s\n" , path ) ;
+        return false ;
+    }
+    return true ;
+}
+
+bool cfg_write_dot ( const cfg_t *cfg , const char *path ) {
+    FILE *file = open_output ( path ) ;
+    if ( !file ) return false ;
+    fprintf ( file , "digraph cfg {\n  node [shape=box, fontname=\"monospace\"];\n" ) ;
+    for ( size_t b = 0 ; b < cfg->block_count ; b++ ) {
+        const cfg_block_t *block = &cfg->blocks[b] ;
+        fprintf ( file , "  b%03X [label=\"%s_%03X:\\l" , block->start ,
+                  cfg->map[block->start] & CFG_CALLED ? "sub" : "L" , block->start ) ;
+        for ( uint32_t pc = block->start ; pc <= block->last ; ) {
+            char text[DISASM_TEXT_MAX] ;
+            pc += disassemble ( cfg->memory , cfg->mask , (uint16_t)pc , cfg->xo_chip , text , sizeof ( text ) ) ;
+            fprintf ( file , "%s\\l" , text ) ;
+        }
+        fprintf ( file , "\"%s];\n" , block->kind == CFG_END_COMPUTED ? ", color=red" :
+                  block->start == cfg->start ? ", penwidth=2" : "" ) ;
+    }
+    for ( size_t b = 0 ; b < cfg->block_count ; b++ ) {
+        const cfg_block_t *block = &cfg->blocks[b] ;
+        for ( uint8_t s = 0 ; s < block->successor_count ; s++ ) {
+            const uint16_t target = block->successors[s] ;
+            if ( !cfg_block_at ( cfg , target ) ) fprintf ( file , "  b%03X [label=\"0x%03X (outside the ROM)\", shape=ellipse];\n" , target , target ) ;
+            fprintf ( file , "  b%03X -> b%03X%s;\n" , block->start , target ,
+                      block->kind == CFG_END_SKIP ? ( s ? " [label=\"skip\"]" : " [label=\"next\"]" ) : "" ) ;
+        }
+        if ( block->kind == CFG_END_CALL ) {
+            if ( !cfg_block_at ( cfg , block->call_target ) ) {
+                fprintf ( file , "  b%03X [label=\"0x%03X (outside the ROM)\", shape=ellipse];\n" , block->call_target , block->call_target ) ;
+            }
+            fprintf ( file , "  b%03X -> b%03X [style=dashed, label=\"call\"];\n" , block->start , block->call_target ) ;
+        }
+    }
+    fprintf ( file , "}\n" ) ;
+    return close_output ( file , path ) ;
+}
+
+bool cfg_write_json ( const cfg_t *cfg , const char *path ) {
+    FILE *file = open_output ( path ) ;
+    if ( !file ) return false ;
+    fprintf ( file , "{\n  \"entry\": %u,\n  \"end\": %u,\n  \"xo_chip\": %s,\n  \"blocks\": [\n" , cfg->start , cfg->end ,
+              cfg->xo_chip ? "true" : "false" ) ;
+    for ( size_t b = 0 ; b < cfg->block_count ; b++ ) {
+        const cfg_block_t *block = &cfg->blocks[b] ;
+        fprintf ( file , "    {\"start\": %u, \"end\": %u, \"kind\": \"%s\", \"subroutine\": %s, \"successors\": [" ,
+                  block->start , block->end , end_names[block->kind] , cfg->map[block->start] & CFG_CALLED ? "true" : "false" ) ;
+        for ( uint8_t s = 0 ; s < block->successor_count ; s++ ) fprintf ( file , "%s%u" , s ? ", " : "" , block->successors[s] ) ;
+        fprintf ( file , "]" ) ;
+        if ( block->kind == CFG_END_CALL ) fprintf ( file , ", \"call\": %u" , block->call_target ) ;
+        fprintf ( file , ", \"instructions\": [" ) ;
+        for ( uint32_t pc = block->start ; pc <= block->last ; ) {
+            char text[DISASM_TEXT_MAX] ;
+            const uint16_t length = disassemble ( cfg->memory , cfg->mask , (uint16_t)pc , cfg->xo_chip , text , sizeof ( text ) ) ;
+            fprintf ( file , "%s{\"address\": %u, \"text\": \"%s\"}" , pc == block->start ? "" : ", " , pc , text ) ;
+            pc += length ;
+        }
+        fprintf ( file , "]}%s\n" , b + 1 < cfg->block_count ? "," : "" ) ;
+    }
+    fprintf ( file , "  ],\n  \"computed_jumps\": [" ) ;
+    for ( size_t i = 0 ; i < cfg->computed_count ; i++ ) fprintf ( file , "%s%u" , i ? ", " : "" , cfg->computed[i] ) ;
+    fprintf ( file , "],\n  \"data_refs\": [" ) ;
+    bool first = true ;
+    for ( uint32_t a = cfg->start ; a < cfg->end ; a++ ) {
+        if ( !( cfg->map[a] & CFG_DATA_REF ) ) continue ;
+        fprintf ( file , "%s%u" , first ? "" : ", " , a ) ;
+        first = false ;
+    }
+    // Runs of bytes that are neither instructions nor operands
+    fprintf ( file , "],\n  \"data\": [" ) ;
+    first = true ;
+    for ( uint32_t a = cfg->start ; a < cfg->end ; ) {
+        if ( cfg->map[a] & ( CFG_CODE | CFG_OPERAND ) ) {
+            a++ ;
+            continue ;
+        }
+        const uint32_t from = a ;
+        while ( a < cfg->end && !( cfg->map[a] & ( CFG_CODE | CFG_OPERAND ) ) ) a++ ;
+        fprintf ( file , "%s[%u, %u]" , first ? "" : ", " , from , a ) ;
+        first = false ;
+    }
+    fprintf ( file , "]\n}\n" ) ;
+    return close_output ( file , path ) ;
+}
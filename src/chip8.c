@@ -5,15 +5,24 @@
  * @date 2025
  * 
  * This file contains the core implementation of the CHIP-8 emulator,
- * including initialization, instruction execution, and state saving/loading.
- * It adheres to the C17 standard and uses SDL2 for logging.
+ * including initialization and instruction execution (save states live in
+ * savestate.c).
+ * It adheres to the C17 standard and does not depend on SDL, so it can be
+ * linked into headless tools.
  */
 
 
 #include "chip8.h"
-
-// Initialize CHIP-8 system and load ROM
-bool init_chip8 (chip8_t *chip8 , const char rom_name[]) {
+#include "jit.h"
+#include "aot.h"
+#include "debugger.h"
+#include "cfg.h"
+#include "profiler.h"
+#include "display.h"
+
+// Reset the CHIP-8 system and load a ROM image already in memory. rom_name
+// (may be NULL) only picks the profile by extension and is kept for display.
+bool load_chip8 ( chip8_t *chip8 , const uint8_t *rom , size_t rom_size , const char *rom_name ) {
     const uint32_t entry_point = 0x200 ; 
      
     // Built-in hexadecimal font set (0-F), each character is 4x5 pixels
@@ -35,357 +44,485 @@ bool init_chip8 (chip8_t *chip8 , const char rom_name[]) {
         0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
         0xF0, 0x80, 0xF0, 0x80, 0x80  // F
     } ;
-    // Clear all memory and registers
+    // SUPER-CHIP large digits (0-F, XO-CHIP added A-F), each character is 8x10 pixels
+    const uint8_t big_font[] = {
+        0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+        0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+        0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+        0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+        0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+        0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+        0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+        0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+    } ;
+    // Clear all memory and registers (the JIT cache survives a reset, its blocks do not)
+    struct jit *jit = chip8->jit ;
+    struct debugger *debugger = chip8->debugger ; // Breakpoints outlive a reset too
+    struct aot *aot = chip8->aot ; // So does a compiled ROM, aot_reset checks it still matches
+    decoded_inst_t *decoded_xo = chip8->decoded_xo ; // And the XO-CHIP cache's allocation
+    const quirks_t quirks_request = chip8->quirks_request ;
+    const bool idle_skip_off = chip8->idle_skip_off ;
+#ifdef CHIP8_PROFILE
+    struct profiler *profiler = chip8->profiler ; // Counters keep accumulating across resets
+#endif
     memset ( chip8 , 0 , sizeof ( chip8_t ) ) ;
-    // Load font set into memory (0x50-0x9F)
+    chip8->jit = jit ;
+    chip8->debugger = debugger ;
+    chip8->aot = aot ;
+    chip8->decoded_xo = decoded_xo ;
+    chip8->quirks_request = quirks_request ;
+    chip8->idle_skip_off = idle_skip_off ;
+#ifdef CHIP8_PROFILE
+    chip8->profiler = profiler ;
+#endif
+    if ( jit ) jit_flush ( jit ) ;
+    chip8->rng = CHIP8_RNG_SEED ;
+    chip8->plane_mask = 0x01 ;
+    // Load font sets into memory (0x00-0x4F, then 0x50-0xEF)
     memcpy (&chip8->memory[0], font , sizeof(font )) ; 
+    memcpy (&chip8->memory[CHIP8_BIG_FONT_ADDRESS], big_font , sizeof(big_font )) ; 
     
+    // Validate the ROM fits in memory
+    const size_t max_size = sizeof ( chip8->memory ) - entry_point ; 
+    // Without a requested profile, XO-CHIP programs are recognised by extension or by
+    // not fitting in 4K, SUPER-CHIP ones by extension
+    const char *extension = rom_name ? strrchr ( rom_name , '.' ) : NULL ;
+    const bool fits_4k = rom_size <= CHIP8_MEMORY_SIZE - entry_point ;
+    chip8->quirks = quirks_request ;
+    if ( chip8->quirks == QUIRKS_AUTO ) {
+        if ( ( extension && strcmp ( extension , ".xo8" ) == 0 ) || !fits_4k ) chip8->quirks = QUIRKS_XO_CHIP ;
+        else if ( extension && strcmp ( extension , ".sc8" ) == 0 ) chip8->quirks = QUIRKS_SCHIP ;
+        else chip8->quirks = QUIRKS_CHIP8 ;
+    }
+    chip8->xo_chip = chip8_quirk_set ( chip8->quirks )->xo_chip ;
+    // Only XO-CHIP needs a decode cache for 64K, the 4K one is in chip8_t
+    if ( chip8->xo_chip && !chip8->decoded_xo ) {
+        chip8->decoded_xo = malloc ( CHIP8_MAX_MEMORY_SIZE * sizeof ( decoded_inst_t ) ) ;
+        if ( !chip8->decoded_xo ) {
+            CHIP8_LOG ( "Out of memory for the XO-CHIP decode cache\n" ) ;
+            return false ;
+        }
+    }
+    if ( chip8->xo_chip ) flush_decoded ( chip8 ) ;
+
+    if (rom_size > max_size || ( !chip8->xo_chip && !fits_4k )) {
+        CHIP8_LOG("Rom file %s size is too big, rom size : %zu, max size : %zu\n " , rom_name ? rom_name : "(memory)" , rom_size ,
+                  chip8->xo_chip ? max_size : (size_t)( CHIP8_MEMORY_SIZE - entry_point )) ; 
+        return false ; 
+    }
+    // Load ROM into memory starting at 0x200
+    if ( rom_size ) memcpy ( &chip8->memory[entry_point] , rom , rom_size ) ;
+
+    // set chip8 // config 
+    chip8->state = RUNNING ; 
+    chip8->pc = entry_point ; 
+    chip8->sp = 0 ;  // Initialize stack pointer to beginning of stack
+    chip8->rom_name = rom_name  ; 
+    chip8->rom_size = (uint32_t)rom_size ;
+
+    // Decode (and compile, on the JIT) everything reachable from the entry point
+    // now rather than on first use; without memory for the analysis it stays lazy
+    cfg_t cfg ;
+    if ( cfg_analyze ( &cfg , chip8->memory , chip8_address_mask ( chip8 ) , chip8->xo_chip , entry_point , entry_point + chip8->rom_size ) ) {
+        cfg_prewarm ( chip8 , &cfg ) ;
+        cfg_free ( &cfg ) ;
+    }
+    if ( chip8->aot ) aot_reset ( chip8 ) ;
+
+    return true  ; 
+}
+
+void free_chip8 ( chip8_t *chip8 ) {
+    if ( !chip8 ) return ;
+    free ( chip8->decoded_xo ) ;
+    chip8->decoded_xo = NULL ;
+}
+
+// Initialize CHIP-8 system and load ROM
+bool init_chip8 (chip8_t *chip8 , const char rom_name[]) {
     // Open ROM file
     FILE *rom = fopen(rom_name , "rb") ; 
      if (!rom) { 
-        SDL_Log ("Rom file %s is invalid\n" ,rom_name ) ; 
+        CHIP8_LOG ("Rom file %s is invalid\n" ,rom_name ) ; 
             return false   ;
      }
-    // Get ROM size and validate it fits in memory
+    // Read it whole; load_chip8 checks the size against the profile
     fseek ( rom , 0 , SEEK_END) ; 
-    const size_t rom_size = ftell(rom) ; 
-    const size_t max_size = sizeof ( chip8->memory ) - entry_point ; 
+    const long rom_size = ftell(rom) ; 
     rewind(rom) ; 
-
-    if (rom_size > max_size) {
-        SDL_Log("Rom file %s size is too big, rom size : %zu, max size : %zu\n " , rom_name , rom_size , max_size) ; 
-        fclose(rom);
-        return false ; 
-    }
-    // Load ROM into memory starting at 0x200
-    if (fread(&chip8->memory[entry_point], rom_size , 1 , rom )!= 1) {
-        SDL_Log ("Could not read rom %s \n" , rom_name) ; 
+    uint8_t *image = malloc ( rom_size > 0 ? (size_t)rom_size : 1 ) ;
+    if ( rom_size < 0 || !image || ( rom_size > 0 && fread ( image , (size_t)rom_size , 1 , rom ) != 1 ) ) {
+        CHIP8_LOG ("Could not read rom %s \n" , rom_name) ; 
+        free ( image ) ;
         fclose(rom);
         return false;
     } 
+    fclose(rom) ;
 
+    const bool loaded = load_chip8 ( chip8 , image , (size_t)rom_size , rom_name ) ;
+    free ( image ) ;
+    return loaded ;
+}
 
-     fclose(rom) ;
-    
-
-    // set chip8 // config 
-    chip8->state = RUNNING ; 
-    chip8->pc = entry_point ; 
-    chip8->sp = &chip8->stack[0];  // Initialize stack pointer to beginning of stack
-    chip8->rom_name = rom_name  ; 
+#define STACK_MASK ( CHIP8_STACK_SIZE - 1 )
+
+// Behaviour of each profile, indexed by quirks_t (QUIRKS_AUTO never runs)
+static const quirk_set_t quirk_sets[QUIRKS_COUNT] = {
+    [QUIRKS_AUTO]    = { .name = "auto" } ,
+    [QUIRKS_CHIP8]   = { .name = "chip8" , .vf_reset_or_xor = true } ,
+    [QUIRKS_VIP]     = { .name = "vip" , .vf_reset_or_xor = true , .vf_reset_and = true , .shift_vy = true ,
+                         .index = INDEX_PAST_LAST , .clip = true , .display_wait = true } ,
+    [QUIRKS_CHIP48]  = { .name = "chip48" , .index = INDEX_LAST , .jump_vx = true , .clip = true } ,
+    [QUIRKS_SCHIP]   = { .name = "schip" , .jump_vx = true , .clip = true } ,
+    [QUIRKS_XO_CHIP] = { .name = "xochip" , .shift_vy = true , .index = INDEX_PAST_LAST , .xo_chip = true } ,
+} ;
+
+const quirk_set_t *chip8_quirk_set ( quirks_t quirks ) {
+    return &quirk_sets[quirks < QUIRKS_COUNT ? quirks : QUIRKS_CHIP8] ;
+}
 
+// Look up a profile by name ("auto", "chip8", "vip", "chip48", "schip" or "xochip")
+bool chip8_parse_quirks ( const char *name , quirks_t *quirks ) {
+    for ( uint32_t i = 0 ; i < QUIRKS_COUNT ; i++ ) {
+        if ( strcmp ( name , quirk_sets[i].name ) == 0 ) {
+            *quirks = (quirks_t)i ;
+            return true ;
+        }
+    }
+    CHIP8_LOG ( "Unknown quirk profile %s (auto, chip8, vip, chip48, schip or xochip)\n" , name ) ;
+    return false ;
+}
 
+// Map a raw opcode to its handler index
+uint8_t decode_op ( uint16_t opcode ) {
+    const uint8_t NN = opcode & 0x00FF ;
+
+    switch ( (opcode >> 12) & 0x000F ) {
+        case 0x00 :
+            if ( (NN & 0xF0) == 0xC0 ) return OP_SCD ;
+            if ( (NN & 0xF0) == 0xD0 ) return OP_SCU ;
+            switch ( NN ) {
+                case 0xE0 : return OP_CLS ;
+                case 0xEE : return OP_RET ;
+                case 0xFB : return OP_SCR ;
+                case 0xFC : return OP_SCL ;
+                case 0xFD : return OP_EXIT ;
+                case 0xFE : return OP_LORES ;
+                case 0xFF : return OP_HIRES ;
+                default : return OP_NOP ;
+            }
+        case 0x01 : return OP_JP ;
+        case 0x02 : return OP_CALL ;
+        case 0x03 : return OP_SE_VX_NN ;
+        case 0x04 : return OP_SNE_VX_NN ;
+        case 0x05 :
+            switch ( opcode & 0x000F ) {
+                case 0x00 : return OP_SE_VX_VY ;
+                case 0x02 : return OP_SAVE_RANGE ;
+                case 0x03 : return OP_LOAD_RANGE ;
+                default : return OP_NOP ;
+            }
+        case 0x06 : return OP_LD_VX_NN ;
+        case 0x07 : return OP_ADD_VX_NN ;
+        case 0x08 :
+            switch ( opcode & 0x000F ) {
+                case 0x00 : return OP_LD_VX_VY ;
+                case 0x01 : return OP_OR ;
+                case 0x02 : return OP_AND ;
+                case 0x03 : return OP_XOR ;
+                case 0x04 : return OP_ADD_VX_VY ;
+                case 0x05 : return OP_SUB ;
+                case 0x06 : return OP_SHR ;
+                case 0x07 : return OP_SUBN ;
+                case 0x0E : return OP_SHL ;
+                default : return OP_NOP ;
+            }
+        case 0x09 : return OP_SNE_VX_VY ;
+        case 0x0A : return OP_LD_I ;
+        case 0x0B : return OP_JP_V0 ;
+        case 0x0C : return OP_RND ;
+        case 0x0D : return OP_DRW ;
+        case 0x0E :
+            if ( NN == 0x9E ) return OP_SKP ;
+            if ( NN == 0xA1 ) return OP_SKNP ;
+            return OP_NOP ;
+        case 0x0F :
+            if ( opcode == 0xF000 ) return OP_LD_I_LONG ;
+            switch ( NN ) {
+                case 0x01 : return OP_PLANE ;
+                case 0x07 : return OP_LD_VX_DT ;
+                case 0x0A : return OP_LD_VX_K ;
+                case 0x15 : return OP_LD_DT_VX ;
+                case 0x18 : return OP_LD_ST_VX ;
+                case 0x1E : return OP_ADD_I_VX ;
+                case 0x29 : return OP_LD_F_VX ;
+                case 0x30 : return OP_LD_HF_VX ;
+                case 0x33 : return OP_LD_B_VX ;
+                case 0x55 : return OP_LD_MEM_VX ;
+                case 0x65 : return OP_LD_VX_MEM ;
+                case 0x75 : return OP_SAVE_FLAGS ;
+                case 0x85 : return OP_LOAD_FLAGS ;
+                default : return OP_NOP ; // F002 and FX3A (XO-CHIP audio) included
+            }
+        default :
+            return OP_NOP ;
+    }
+}
 
-    return true  ; 
+// Decode the instruction at address into the decode cache
+static decoded_inst_t *decode_at ( chip8_t *chip8 , uint16_t address ) {
+    const uint16_t mask = chip8_address_mask ( chip8 ) ;
+    decoded_inst_t *d = &chip8_decode_cache ( chip8 )[address & mask] ;
+    const uint16_t opcode = (chip8->memory[address & mask] << 8) | chip8->memory[(address + 1) & mask] ;
+
+    d->NNN = opcode & 0x0FFF ;
+    d->NN = opcode & 0x00FF ;
+    d->N = opcode & 0x000F ;
+    d->X = (opcode >> 8) & 0x000F ;
+    d->Y = (opcode >> 4) & 0x000F ;
+    d->op = decode_op ( opcode ) ;
+    if ( d->op == OP_LD_I_LONG ) {
+        // Only XO-CHIP has the four-byte form, the address follows the opcode
+        if ( !chip8->xo_chip ) d->op = OP_NOP ;
+        d->NNN = (chip8->memory[(address + 2) & mask] << 8) | chip8->memory[(address + 3) & mask] ;
+    }
+    return d ;
 }
-// Generate save filename based on ROM name and slot number
-static void prepare_save_filename(chip8_t *chip8, char *save_file, size_t save_file_size, int slot) {
-    // Copy ROM name to working buffer
-    strncpy(chip8->rom_name_copy, chip8->rom_name, sizeof(chip8->rom_name_copy) - 1);
-    chip8->rom_name_copy[sizeof(chip8->rom_name_copy) - 1] = '\0';
-
-    // Remove file extension if present
-    char *dot = strrchr(chip8->rom_name_copy, '.');
-    if (dot) *dot = '\0';
-
-    // Create filename: "romname_slotN.bin"
-    snprintf(save_file, save_file_size, "%s_slot%d.bin", chip8->rom_name_copy, slot);
+
+// Return the cached decode for address, decoding it on first use
+const decoded_inst_t *fetch_decoded ( chip8_t *chip8 , uint16_t address ) {
+    const decoded_inst_t *d = &chip8_decode_cache ( chip8 )[address & chip8_address_mask ( chip8 )] ;
+    return d->op == OP_DECODE ? decode_at ( chip8 , address ) : d ;
 }
 
-// Save current CHIP-8 state to file
-bool save_state ( chip8_t *chip8 , char *save_file,size_t save_file_size ,  int slot ) { 
-    prepare_save_filename(chip8, save_file, save_file_size, slot);
+// Approximate COSMAC VIP execution time of each instruction in microseconds
+static const uint16_t vip_cost_us[OP_COUNT] = {
+    [OP_NOP] = 0 , [OP_CLS] = 109 , [OP_RET] = 105 , [OP_JP] = 105 , [OP_CALL] = 105 ,
+    [OP_SE_VX_NN] = 55 , [OP_SNE_VX_NN] = 55 , [OP_SE_VX_VY] = 73 , [OP_LD_VX_NN] = 27 , [OP_ADD_VX_NN] = 45 ,
+    [OP_LD_VX_VY] = 200 , [OP_OR] = 200 , [OP_AND] = 200 , [OP_XOR] = 200 , [OP_ADD_VX_VY] = 200 ,
+    [OP_SUB] = 200 , [OP_SHR] = 200 , [OP_SUBN] = 200 , [OP_SHL] = 200 , [OP_SNE_VX_VY] = 73 ,
+    [OP_LD_I] = 55 , [OP_JP_V0] = 105 , [OP_RND] = 164 , [OP_DRW] = 22734 , [OP_SKP] = 73 , [OP_SKNP] = 73 ,
+    [OP_LD_VX_DT] = 45 , [OP_LD_VX_K] = 45 , [OP_LD_DT_VX] = 45 , [OP_LD_ST_VX] = 45 , [OP_ADD_I_VX] = 86 ,
+    [OP_LD_F_VX] = 91 , [OP_LD_B_VX] = 927 , [OP_LD_MEM_VX] = 605 , [OP_LD_VX_MEM] = 605 ,
+    // SUPER-CHIP and XO-CHIP never ran on a VIP: charged like the closest VIP instruction
+    [OP_SCD] = 109 , [OP_SCU] = 109 , [OP_SCR] = 109 , [OP_SCL] = 109 , [OP_EXIT] = 0 , [OP_LORES] = 109 ,
+    [OP_HIRES] = 109 , [OP_SAVE_RANGE] = 605 , [OP_LOAD_RANGE] = 605 , [OP_LD_I_LONG] = 110 , [OP_PLANE] = 45 ,
+    [OP_LD_HF_VX] = 91 , [OP_SAVE_FLAGS] = 605 , [OP_LOAD_FLAGS] = 605 ,
+} ;
+
+// VIP cost of the instruction at pc (FX0A is charged per poll while it waits)
+uint32_t instruction_cost_us ( chip8_t *chip8 ) {
+    return vip_cost_us[fetch_decoded ( chip8 , chip8->pc )->op] ;
+}
 
-    FILE *file = fopen(save_file , "wb") ; 
-    if (!file) { 
-        SDL_Log("Could not open file %s for writing\n" , save_file) ;
-        return false ; 
-    }
-    // Write entire system state as binary data
-    if ( fwrite ( chip8 , sizeof ( chip8_t ) , 1 , file) != 1 ) { 
-        SDL_Log ("Could not write to file %s\n" , save_file) ; 
-        fclose(file) ; 
-        return false ; 
+// Drop cached decodes (and native blocks) that read any byte in [address, address + length)
+void invalidate_decoded ( chip8_t *chip8 , uint16_t address , uint16_t length ) {
+    // Instructions starting one byte earlier (three for F000 NNNN) also read the first byte
+    const uint16_t mask = chip8_address_mask ( chip8 ) ;
+    const uint32_t before = chip8->xo_chip ? 3 : 1 ;
+    decoded_inst_t *cache = chip8_decode_cache ( chip8 ) ;
+    for ( uint32_t i = 0 ; i < length + before ; i++ ) {
+        cache[(address - before + i) & mask].op = OP_DECODE ;
     }
+    if ( chip8->jit ) jit_invalidate ( chip8->jit , address , length ) ;
+    if ( chip8->aot ) aot_invalidate ( chip8->aot , address , length ) ;
+}
+
+void flush_decoded ( chip8_t *chip8 ) {
+    memset ( chip8_decode_cache ( chip8 ) , 0 , ( (size_t)chip8_address_mask ( chip8 ) + 1 ) * sizeof ( decoded_inst_t ) ) ;
+}
 
-    fclose(file) ;
-    return true ;
+// Execute a single instruction
+void run_intructions ( chip8_t *chip8 ) { 
+    run_cycles ( chip8 , 1 ) ;
 }
 
+// Decrement the delay and sound timers (called at 60Hz)
+void tick_timers ( chip8_t *chip8 ) {
+    if ( chip8->delay_timer > 0 ) chip8->delay_timer -- ;
+    if ( chip8->sound_timer > 0 ) chip8->sound_timer -- ;
+}
 
+// Execute up to `cycles` instructions on the AOT module or the JIT when enabled, else on the interpreter
+uint32_t run_cycles ( chip8_t *chip8 , uint32_t cycles ) {
+#ifdef CHIP8_PROFILE
+    // Native blocks are not instrumented: count every instruction on the interpreter
+    if ( chip8->profiler ) return run_interpreter ( chip8 , cycles ) ;
+#endif
+    const bool debugging = chip8->debugger && chip8->debugger->active ;
+    if ( chip8->aot && chip8->aot->active && !debugging ) return aot_run ( chip8 , cycles ) ;
+    // The JIT only knows the 4K address space and two-byte skips, and has no breakpoint checks
+    if ( chip8->jit && !chip8->xo_chip && !debugging ) return jit_run ( chip8 , cycles ) ;
+    return run_interpreter ( chip8 , cycles ) ;
+}
 
-// Load CHIP-8 state from save file
-bool load_state ( chip8_t *chip8 ,  char *save_file , size_t save_file_size , int slot ) { 
-    prepare_save_filename(chip8, save_file, save_file_size, slot);
+// Bytes a taken skip at `pc` jumps over: XO-CHIP skips F000 NNNN as a whole
+static inline uint16_t skip_length ( const chip8_t *chip8 , uint16_t pc , bool xo_chip ) {
+    if ( !xo_chip ) return 2 ;
+    return chip8->memory[pc] == 0xF0 && chip8->memory[(uint16_t)(pc + 1)] == 0x00 ? 4 : 2 ;
+}
 
-    FILE *file = fopen(save_file , "rb") ; 
-    if (!file) { 
-        SDL_Log("Could not open file %s for reading\n" , save_file) ;
-        return false ; 
-    }
-    // Load entire system state from binary data
-    if ( fread ( chip8 , sizeof ( chip8_t ) , 1 , file) != 1 ) { 
-        SDL_Log ("Could not read from file %s\n" , save_file) ; 
-        fclose(file) ; 
-        return false ; 
+/*
+ * Idle loops: code that only reads the delay timer and keypad, compares and
+ * jumps. Timers tick and keys change only between calls to run_cycles, so
+ * once such a loop is back at its start with the registers it started
+ * with, it spins identically until the budget runs out. The interpreter
+ * (on backward jumps) and the JIT dispatcher (at loop heads) skip those
+ * iterations: the cycles still count, pc and registers end exactly where
+ * executing them would have left them.
+ */
+
+// Run one iteration of the loop at `start` on the register copy V; returns
+// its length in instructions, 0 when it runs anything but idle instructions
+static uint32_t idle_iteration ( chip8_t *chip8 , uint16_t start , uint8_t V[16] ) {
+    uint16_t pc = start ;
+    for ( uint32_t steps = 1 ; steps <= IDLE_MAX_STEPS ; steps++ ) {
+        const decoded_inst_t *d = fetch_decoded ( chip8 , pc ) ;
+        if ( !idle_instruction ( d->op ) ) return 0 ;
+        pc += 2 ;
+        switch ( d->op ) {
+            case OP_JP : pc = d->NNN ; break ;
+            case OP_SE_VX_NN : if ( V[d->X] == d->NN ) pc += skip_length ( chip8 , pc , chip8->xo_chip ) ; break ;
+            case OP_SNE_VX_NN : if ( V[d->X] != d->NN ) pc += skip_length ( chip8 , pc , chip8->xo_chip ) ; break ;
+            case OP_SE_VX_VY : if ( V[d->X] == V[d->Y] ) pc += skip_length ( chip8 , pc , chip8->xo_chip ) ; break ;
+            case OP_SNE_VX_VY : if ( V[d->X] != V[d->Y] ) pc += skip_length ( chip8 , pc , chip8->xo_chip ) ; break ;
+            case OP_SKP : if ( chip8->keypad[V[d->X] & 0x0F] ) pc += skip_length ( chip8 , pc , chip8->xo_chip ) ; break ;
+            case OP_SKNP : if ( !chip8->keypad[V[d->X] & 0x0F] ) pc += skip_length ( chip8 , pc , chip8->xo_chip ) ; break ;
+            case OP_LD_VX_DT : V[d->X] = chip8->delay_timer ; break ;
+            case OP_LD_VX_NN : V[d->X] = d->NN ; break ;
+            case OP_LD_VX_VY : V[d->X] = V[d->Y] ; break ;
+            default : break ; // 0NNN
+        }
+        if ( pc == start ) return steps ;
     }
-    fclose(file) ;
-    return true ;
+    return 0 ;
 }
 
-void run_intructions ( chip8_t *chip8 ) { 
-    bool carry ;
-    chip8->inst.opcode= (chip8->memory[chip8->pc] << 8 ) | chip8->memory[chip8->pc+1 ] ; 
-    chip8->pc += 2 ; 
-    
-    // Single out the opcodes 
-    chip8->inst.NNN = chip8->inst.opcode &  0x0FFF ; 
-    chip8->inst.NN = chip8->inst.opcode & 0x00FF ; 
-    chip8->inst.N = chip8->inst.opcode & 0x000F ; 
-    chip8->inst.X = (chip8->inst.opcode >> 8 ) & 0x000F ;
-    chip8->inst.Y = (chip8->inst.opcode >> 4 ) & 0x000F ;
-
-
-    switch ( (chip8->inst.opcode >> 12) & 0x000F ) 
-
-    {   
-        case 0x00 : 
-            if(chip8->inst.NN == 0xE0) { 
-                memset(&chip8->display[0], false, sizeof chip8->display);
-            } 
-            else if ( chip8->inst.NN == 0xEE) { 
-                chip8->pc = *--chip8->sp ; 
-            }
-            break;
-
-        case 0x01 : 
-            chip8->pc = chip8->inst.NNN ; 
-            break;
-
-        case 0x02 :  
-            // 0x2NNN: Call subroutine at NNN
-            *chip8->sp++ = chip8->pc ;
-            chip8->pc = chip8->inst.NNN ;
-            break; 
-
-        case 0x03 :
-            // 0x3XNN: Skip next instruction if VX == NN
-            
-            if(chip8->V[chip8->inst.X] == chip8->inst.NN) { 
-                chip8->pc += 2 ; 
-            }
-            break;
-    
+// Returns the cycles left out of `remaining` with pc at `start` once whole
+// iterations of an idle loop there are skipped (unchanged if there is none,
+// or with idle_skip_off)
+uint32_t skip_idle_loop ( chip8_t *chip8 , uint16_t start , uint32_t remaining ) {
+#ifdef CHIP8_PROFILE
+    return remaining ; // Keep executing idle loops so the heat map shows where the time goes
+#endif
+    if ( chip8->idle_skip_off ) return remaining ;
+    uint8_t V[16] , settled[16] ;
+    memcpy ( V , chip8->V , sizeof ( V ) ) ;
+    const uint32_t first = idle_iteration ( chip8 , start , V ) ;
+    if ( first == 0 || first > remaining ) return remaining ;
+    memcpy ( settled , V , sizeof ( V ) ) ;
+    const uint32_t period = idle_iteration ( chip8 , start , V ) ;
+    if ( period == 0 || memcmp ( V , settled , sizeof ( V ) ) != 0 ) return remaining ;
+
+    // The first iteration may still load registers, from then on nothing changes
+    memcpy ( chip8->V , settled , sizeof ( settled ) ) ;
+    return ( remaining - first ) % period ;
+}
 
-        case 0x04 :
-            // 0x4XNN: Skip next instruction if VX != NN 
-            if (chip8->V[chip8->inst.X] != chip8->inst.NN) {
-                chip8->pc += 2;
-            }
-            break;
+// Display operations on the machine's planes (the bit twiddling is in display.h)
 
-        case 0x05 :  
-            // 0x5XY0: Skip next instruction if VX == VY
-            if (chip8->inst.N != 0) break ; 
-            if (chip8->V[chip8->inst.X] == chip8->V[chip8->inst.Y]) { 
-                chip8->pc += 2  ;
-            }
-            break;
-        
-        case 0x06 :
-            // 0x6XNN: Set VX to NN
-            chip8->V [ chip8->inst.X] = chip8->inst.NN ; 
-            break;
-        case (0x07) : 
-            // 0x7XNN: Set VX += NN
-            chip8->V[chip8->inst.X] += chip8->inst.NN ; 
-            break;
-            
-        case 0x08 :
-            switch (chip8->inst.N) 
-            {
-                case 0x00:
-                    chip8->V[chip8->inst.X] = chip8->V[chip8->inst.Y ] ;    
-                    break;
-                case 0x01 :
-                    chip8->V[chip8->inst.X] |= chip8->V[chip8->inst.Y] ;   
-                    chip8->V[0x0F] =0 ; // carry flag
-                    break;
-                case 0x02 :
-                    chip8->V[chip8->inst.X] &= chip8->V[chip8->inst.Y] ; 
-                    break;
-                
-                case 0x03 : 
-                    chip8->V[chip8->inst.X] ^= chip8->V[chip8->inst.Y] ;
-                    chip8->V[0x0F] = 0 ; // carry flag
-                    break; 
-                case 0x04 : 
-                 // 0x8XY4: Set register VX += VY, set VF to 1 if carry, 0 if not 
-                    carry = ((uint16_t)(chip8->V[chip8->inst.X] + chip8->V[chip8->inst.Y]) > 255) ;
-                    chip8->V[chip8->inst.X] += chip8->V[chip8->inst.Y] ;
-                    chip8->V[0xF] = carry ;
-                    break;
-
-                case 0x05 : 
-                // 0x8XY5: Set register VX -= VY, set vf to 0 if borrow, 1 if not
-                    carry= (chip8->V[chip8->inst.Y] <= chip8->V[chip8->inst.X]); // if vy >= vx , no borrow
-
-                    chip8->V[chip8->inst.X] -= chip8->V[chip8->inst.Y] ;
-                    chip8->V[0xF] = carry ;
-                    break;
-                case 0x06 : 
-                // shift right and store least significant bit in VF
-                    carry = chip8->V[chip8->inst.X] & 0x1 ;
-                    chip8->V[chip8->inst.X] = chip8->V[chip8->inst.X] >> 1 ;
-                    chip8->V[0xF] = carry ;
-                    break;
-
-                case 0x07 : 
-                // 0x8XY7: Set register VX = VY - VX, set VF to 0 if borrow, 1 if not
-                    carry = (chip8->V[chip8->inst.X] <= chip8->V[chip8->inst.Y]); // if vy >= vx , no borrow 
-
-                    chip8->V[chip8->inst.X] = chip8->V[chip8->inst.Y] - chip8->V[chip8->inst.X] ;
-                    chip8->V[0xF] = carry ;
-                    break;
-
-                case 0x0E : 
-                     // 0x8XYE: Set register VX <<= 1, store shifted off bit in VF
-                     // E 12: 8XYE verify that VF is set to the MSB (most significant bit or most left) before the shift and  VF does not take value 0 every time
-                    carry = (chip8->V[chip8->inst.X] & 0x80) >> 7 ;// if the most significant bit of VY is 1, set carry to 1, else 0
-                    chip8->V[chip8->inst.X] = chip8->V[chip8->inst.X] << 1 ;
-                    chip8->V[0xF] = carry ;
-                    break;
-
-            default:
-                break;
-            }
-            break;
+// 00E0: clear the selected planes
+static void clear_planes ( chip8_t *chip8 ) {
+    display_clear ( chip8->display , chip8->hires , chip8->plane_mask ) ;
+}
 
-        case 0x09 : 
-            // 0x9XY0: Skip next instruction if VX != VY
-            if ( chip8->V[chip8->inst.X] != chip8->V[chip8->inst.Y]) { 
-                chip8->pc += 2 ;
-                break; 
-            }
-            break;
-
-        case 0x0A : 
-            // 0xANNN: Set index register I to the address NNN
-            chip8->I = chip8->inst.NNN ;
-            break;
-
-        case 0x0B : 
-            // 0xBNNN: Jump to address NNN + V0
-            chip8->pc = chip8->V[0] + chip8->inst.NNN ; 
-            break; 
-        case 0x0C : 
-            // 0xCXNN: Set VX to random byte AND NN
-            chip8->V[chip8->inst.X] = (rand() % 256) & chip8->inst.NN ; 
-            break;
-        
-        case 0x0D : 
-            // 0xDXYN: Draw sprite at coordinate (VX, VY) with width 8 pixels and height N pixels
-            uint8_t VX = chip8->V[chip8->inst.X] % CHIP8_DISPLAY_WIDTH ; // wrap around if going off screen
-            uint8_t VY = chip8->V[chip8->inst.Y] % CHIP8_DISPLAY_HEIGHT ; // wrap around if going off screen
-            chip8->V[0xF] = 0 ; // reset collision flag
-            uint8_t height = chip8->inst.N ;
-
-            for ( int row = 0 ; row < height ; row ++) { 
-                uint8_t sprite_byte = chip8->memory[chip8->I + row ] ; 
-                for ( int col = 0 ; col < 8 ; col++) { 
-                    if ( sprite_byte & (0x80 >> col)) // check if the current bit is set
-                    { 
-                        uint16_t pixel_index = ( (VY + row) % CHIP8_DISPLAY_HEIGHT) * CHIP8_DISPLAY_WIDTH + ( (VX + col) % CHIP8_DISPLAY_WIDTH) ; 
-                        if ( chip8->display[pixel_index]) { 
-                            chip8->V[0xF] = 1 ; // set collision flag
-                        }
-                        chip8->display[pixel_index] ^= 1 ; // XOR the pixel
-                        
-                    }
-                }
-            }
-            break;
+// 00FE/00FF: switch resolution, which clears every plane
+static void set_resolution ( chip8_t *chip8 , bool hires ) {
+    chip8->hires = hires ;
+    memset ( chip8->display , 0 , sizeof ( chip8->display ) ) ;
+}
 
-        case 0x0E :
-            if(chip8->inst.NN == 0x9E) { 
-                // key pressing 
-                if (chip8->keypad[chip8->V[chip8->inst.X]]) { 
-                    chip8->pc += 2 ;
-                }
-                break;
-            }
-            else if ( chip8->inst.NN == 0xA1) { 
-                // TODO : key pressing 
-                if (!chip8->keypad[chip8->V[chip8->inst.X]]) { 
-                    chip8->pc += 2 ;
-                    break;
-                }
-                break;
+// 00CN/00DN: move the selected planes `rows` rows down or up
+static void scroll_vertical ( chip8_t *chip8 , uint32_t rows , bool down ) {
+    display_scroll_vertical ( chip8->display , chip8->hires , chip8->plane_mask , rows , down ) ;
+}
 
-            }
-            break;  
-        case 0x0F :
-            switch (chip8->inst.NN)
-            {
-            case 0x07:
-                // 0xFX07: Set VX to the value of the delay timer
-                chip8->V[chip8->inst.X] = chip8->delay_timer ;
-                break;
-            case 0x0A : 
-                // 0xFX0A: Wait for a key press, store the value of the key in VX
-                bool key_pressed = false;
-                for ( uint8_t i = 0 ; i < sizeof(chip8->keypad) ; i++ ) { 
-                    if ( chip8->keypad[i]) { 
-                        chip8->V[chip8->inst.X] = i ; 
-                        key_pressed = true ;
-                        break ; 
-                    }
-                }
-                if (!key_pressed) {
-                    chip8->pc -= 2 ; // repeat this instruction
-                }
-                break ; 
-            case 0x15 : // timer 
-                // 0xFX15: Set the delay timer to VX
-                chip8->delay_timer = chip8->V[chip8->inst.X ] ;
-                break;
-            case 0x18 : // sound 
-                // 0xFX18: Set the sound timer to VX
-                chip8->sound_timer = chip8->V[chip8->inst.X ] ;
-                break;
-            case 0x1E : // adds vx to I 
-                chip8->I += chip8->V[chip8->inst.X ];
-                break;
-            case 0x29 :
-                // set I to the location of the sprite for the character in VX 
-                chip8->I = chip8->V[chip8->inst.X] * 5 ; // each sprite is 5 bytes long
-
-                break; 
-            case 0x33 :
-                // store the binary-coded decimal representation of VX at I, I+1, and I+2
-                chip8->memory[chip8->I] = chip8->V[chip8->inst.X] / 100 ;
-                chip8->memory[chip8->I + 1] = (chip8->V[chip8->inst.X] /10) %10  ;
-                chip8->memory[chip8->I + 2] = chip8->V[chip8->inst.X] % 10 ;
-                break;
-            case 0x55 :
-                // store registers V0 to VX in memory starting at location I
-                for (uint8_t i = 0 ; i <= chip8->inst.X ; i++ ) { 
-                    chip8->memory[chip8->I + i] = chip8->V[i] ;
-                }
-                break;
-            case 0x65 :
-                // load registers V0 to VX from memory starting at location I
-                for ( uint8_t i =0 ; i <= chip8->inst.X ; i++  ) {
-                    chip8->V[i] = chip8->memory[chip8->I + i] ; 
-                }
-
-                
-            default:
-                break;
-            }   
-            break;
-        default :   
-            break;
+// 00FB/00FC: move the selected planes 4 pixels right or left
+static void scroll_horizontal ( chip8_t *chip8 , bool right ) {
+    display_scroll_horizontal ( chip8->display , chip8->hires , chip8->plane_mask , right ) ;
+}
+
+// DXYN: draw at (VX, VY) from I, VF = collision
+static inline void draw_sprite ( chip8_t *chip8 , const decoded_inst_t *d , uint16_t mask , bool clip ) {
+    chip8->V[0xF] = display_draw ( chip8->display , chip8->hires , chip8->plane_mask , chip8->memory , mask ,
+                                   chip8->I , chip8->V[d->X] , chip8->V[d->Y] , d->N , clip ) ; // collision flag
+}
+
+/*
+ * The interpreter loop is in interpreter.inc, instantiated for each quirk
+ * profile: picking a profile costs one indirect call per run_interpreter
+ * call and nothing per instruction.
+ */
+#define QUIRK(field) ( quirk_sets[QUIRKS].field )
+
+#define INTERPRETER interpret_chip8
+#define QUIRKS QUIRKS_CHIP8
+#include "interpreter.inc"
+
+#define INTERPRETER interpret_vip
+#define QUIRKS QUIRKS_VIP
+#include "interpreter.inc"
+
+#define INTERPRETER interpret_chip48
+#define QUIRKS QUIRKS_CHIP48
+#include "interpreter.inc"
+
+#define INTERPRETER interpret_schip
+#define QUIRKS QUIRKS_SCHIP
+#include "interpreter.inc"
+
+#define INTERPRETER interpret_xo_chip
+#define QUIRKS QUIRKS_XO_CHIP
+#include "interpreter.inc"
+
+#undef QUIRK
+
+// The debugger's copy serves every profile, reading the quirks at run time
+#define QUIRK(field) ( quirk_sets[chip8->quirks == QUIRKS_AUTO ? QUIRKS_CHIP8 : chip8->quirks].field )
+#define INTERPRETER_DEBUG
+#define INTERPRETER interpret_debug
+#include "interpreter.inc"
+#undef INTERPRETER_DEBUG
+
+// So does the VIP-timed copy, which only runs under --vip-timing
+#define INTERPRETER_TIMED
+#define INTERPRETER interpret_timed
+#include "interpreter.inc"
+#undef INTERPRETER_TIMED
+#undef QUIRK
+
+// COSMAC VIP timing: execute instructions while *budget_us (microseconds)
+// is positive, charging each its VIP cost before it runs, at most `cycles`.
+// *budget_us ends at zero or below unless the cycles ran out or the machine
+// stopped. Always on the interpreter: native blocks do not count time.
+uint32_t run_timed ( chip8_t *chip8 , uint32_t cycles , int64_t *budget_us ) {
+    if ( chip8->debugger && chip8->debugger->active ) {
+        // Single steps, so breakpoints and watchpoints still stop it
+        uint32_t executed = 0 ;
+        while ( *budget_us > 0 && executed < cycles && chip8->state == RUNNING ) {
+            *budget_us -= instruction_cost_us ( chip8 ) ;
+            executed += interpret_debug ( chip8 , 1 ) ;
+        }
+        return executed ;
     }
+    if ( chip8->state != RUNNING ) return 0 ;
+    return interpret_timed ( chip8 , cycles , budget_us ) ;
+}
 
-}
\ No newline at end of file
+// Execute up to `cycles` instructions on the interpreter for chip8->quirks
+uint32_t run_interpreter ( chip8_t *chip8 , uint32_t cycles ) {
+    static uint32_t (*const interpreters[QUIRKS_COUNT])( chip8_t * , uint32_t ) = {
+        [QUIRKS_AUTO] = interpret_chip8 , [QUIRKS_CHIP8] = interpret_chip8 , [QUIRKS_VIP] = interpret_vip ,
+        [QUIRKS_CHIP48] = interpret_chip48 , [QUIRKS_SCHIP] = interpret_schip , [QUIRKS_XO_CHIP] = interpret_xo_chip ,
+    } ;
+    if ( chip8->debugger && chip8->debugger->active ) return interpret_debug ( chip8 , cycles ) ;
+    return interpreters[chip8->quirks] ( chip8 , cycles ) ;
+}
@@ -29,6 +29,37 @@ void audio_callback(void *userdata, uint8_t *stream, int len) {
     }
 }
 
+// Pre-render a pixel grid of columns x rows cells once: background-colored
+// cell borders on a transparent texture, drawn over the framebuffer each frame
+static SDL_Texture *init_grid_texture ( sdl_t *sdl , const config_t *config , uint32_t columns , uint32_t rows ) {
+    const int width = CHIP8_DISPLAY_WIDTH * config->scale_factor ;
+    const int height = CHIP8_DISPLAY_HEIGHT * config->scale_factor ;
+    const int cell = width / columns ;
+
+    SDL_Texture *grid = SDL_CreateTexture ( sdl->renderer , SDL_PIXELFORMAT_RGBA8888 , SDL_TEXTUREACCESS_TARGET , width , height ) ;
+    if ( !grid || SDL_SetRenderTarget ( sdl->renderer , grid ) != 0 ) {
+        SDL_Log ( "Pixel grid overlay unavailable: %s\n", SDL_GetError() ) ;
+        if ( grid ) SDL_DestroyTexture ( grid ) ;
+        return NULL ;
+    }
+    SDL_SetTextureBlendMode ( grid , SDL_BLENDMODE_BLEND ) ;
+    SDL_SetRenderDrawColor ( sdl->renderer , 0 , 0 , 0 , 0 ) ;
+    SDL_RenderClear ( sdl->renderer ) ;
+
+    SDL_SetRenderDrawColor ( sdl->renderer , (config->bg_color >> 24) & 0xFF , (config->bg_color >> 16) & 0xFF ,
+                             (config->bg_color >> 8) & 0xFF , config->bg_color & 0xFF ) ;
+    SDL_Rect rect = {.x=0, .y=0, .w=cell, .h=cell} ;
+    for ( uint32_t y = 0 ; y < rows ; y++ ) {
+        for ( uint32_t x = 0 ; x < columns ; x++ ) {
+            rect.x = x * cell ;
+            rect.y = y * cell ;
+            SDL_RenderDrawRect ( sdl->renderer , &rect ) ;
+        }
+    }
+    SDL_SetRenderTarget ( sdl->renderer , NULL ) ;
+    return grid ;
+}
+
 bool init_display( sdl_t * sdl , config_t *config ) { 
     // Initialize SDL
     if (SDL_Init ( SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER ) !=0) { 
@@ -47,6 +78,17 @@ bool init_display( sdl_t * sdl , config_t *config ) {
         SDL_Log ( "Could not create renderer: %s\n", SDL_GetError() ) ;
         return false ;
     }
+    // Framebuffer texture: RGBA8888 matches the 0xRRGGBBAA colors in config_t
+    sdl->screen_texture = SDL_CreateTexture ( sdl->renderer , SDL_PIXELFORMAT_RGBA8888 , SDL_TEXTUREACCESS_STREAMING ,
+                                              CHIP8_HIRES_WIDTH , CHIP8_HIRES_HEIGHT ) ;
+    if ( !sdl->screen_texture ) {
+        SDL_Log ( "Could not create screen texture: %s\n", SDL_GetError() ) ;
+        return false ;
+    }
+    if ( config->pixelized ) {
+        sdl->grid_texture = init_grid_texture ( sdl , config , CHIP8_DISPLAY_WIDTH , CHIP8_DISPLAY_HEIGHT ) ;
+        sdl->hires_grid_texture = init_grid_texture ( sdl , config , CHIP8_HIRES_WIDTH , CHIP8_HIRES_HEIGHT ) ;
+    }
     // Initialize audio
     sdl->desired_spec = (SDL_AudioSpec) {
         .freq = 44100 ,
@@ -77,6 +119,9 @@ bool init_display( sdl_t * sdl , config_t *config ) {
 }
 
 void close_display ( sdl_t * sdl ) { 
+    if ( sdl->grid_texture ) SDL_DestroyTexture ( sdl->grid_texture ) ;
+    if ( sdl->hires_grid_texture ) SDL_DestroyTexture ( sdl->hires_grid_texture ) ;
+    SDL_DestroyTexture ( sdl->screen_texture ) ;
     SDL_DestroyRenderer ( sdl->renderer ) ; 
     SDL_DestroyWindow ( sdl->window ) ; 
     SDL_CloseAudioDevice ( sdl->chip8_audio_device ) ;
@@ -94,39 +139,47 @@ void clear_display ( sdl_t *sdl , config_t config ) {
     SDL_RenderClear ( sdl->renderer ) ;
 }
 
-void update_display ( sdl_t *sdl , chip8_t *chip8 , config_t config ) {
-    SDL_Rect rect = {.x=0, .y=0, .w=config.scale_factor, .h=config.scale_factor} ;
-
-
-    // grab foreground color
-    uint8_t fg_r = (config.fg_color >> 24) & 0xFF ; // red = 0xFF
-    uint8_t fg_g = (config.fg_color >> 16) & 0xFF ; // green = 0xFF
-    uint8_t fg_b = (config.fg_color >> 8) & 0xFF ; // blue = 0xFF
-    uint8_t fg_a = config.fg_color & 0xFF ; // alpha = 0xFF
-
-    // Grab background color
-    uint8_t bg_r = (config.bg_color >> 24) & 0xFF ; // red = 0x00
-    uint8_t bg_g = (config.bg_color >> 16) & 0xFF ; // green = 0x00
-    uint8_t bg_b = (config.bg_color >> 8) & 0xFF ; // blue = 0x00
-    uint8_t bg_a = config.bg_color & 0xFF ; // alpha = 0xFF
-
-    for (uint32_t i = 0 ; i< sizeof (chip8->display) ; i++ ) { 
-        rect.x = (i % CHIP8_DISPLAY_WIDTH) * config.scale_factor ;
-        rect.y = (i / CHIP8_DISPLAY_WIDTH) * config.scale_factor ;
-
-        if ( chip8->display[i]) { 
-            SDL_SetRenderDrawColor ( sdl->renderer , fg_r , fg_g , fg_b , fg_a ) ;
-            SDL_RenderFillRect ( sdl->renderer , &rect ) ;
-
-            if (config.pixelized) { 
-                SDL_SetRenderDrawColor ( sdl->renderer , bg_r , bg_g , bg_b , bg_a ) ;
-                SDL_RenderDrawRect ( sdl->renderer , &rect ) ;
+// Expand the packed planes into sdl->pixels and upload it in one
+// call, skipping the upload when nothing changed since the last frame.
+// Each pixel's plane bits pick its color (background, fg_color for the
+// first plane, plane1_color for the second, overlap_color for both); a
+// low-resolution pixel fills 2x2 texels. The texture is then scaled to
+// the window with a single copy.
+void present_frame ( sdl_t *sdl , const uint64_t display[CHIP8_PLANES][CHIP8_HIRES_HEIGHT][CHIP8_ROW_WORDS] , bool hires , config_t config ) {
+    const bool changed = !sdl->frame_uploaded || sdl->last_hires != hires ||
+                         sdl->last_fg_color != config.fg_color || sdl->last_bg_color != config.bg_color ||
+                         memcmp ( sdl->last_frame , display , sizeof ( sdl->last_frame ) ) != 0 ;
+
+    if ( changed ) {
+        const uint32_t palette[4] = { config.bg_color , config.fg_color , config.plane1_color , config.overlap_color } ;
+        const uint32_t scale = hires ? 1 : 2 ;
+        for ( uint32_t y = 0 ; y < CHIP8_HIRES_HEIGHT / scale ; y++ ) {
+            uint32_t *out = &sdl->pixels[y * scale * CHIP8_HIRES_WIDTH] ;
+            for ( uint32_t x = 0 ; x < CHIP8_HIRES_WIDTH / scale ; x++ ) {
+                const uint32_t shift = 63 - x % 64 ;
+                const uint32_t color = palette[((display[0][y][x / 64] >> shift) & 1) |
+                                               ((display[1][y][x / 64] >> shift) & 1) << 1] ;
+                for ( uint32_t i = 0 ; i < scale ; i++ ) out[x * scale + i] = color ;
             }
-        } else { 
-            SDL_SetRenderDrawColor ( sdl->renderer , bg_r , bg_g , bg_b , bg_a ) ;
-            SDL_RenderFillRect ( sdl->renderer , &rect ) ;
+            if ( scale == 2 ) memcpy ( out + CHIP8_HIRES_WIDTH , out , CHIP8_HIRES_WIDTH * sizeof ( uint32_t ) ) ;
         }
+        SDL_UpdateTexture ( sdl->screen_texture , NULL , sdl->pixels , CHIP8_HIRES_WIDTH * sizeof ( uint32_t ) ) ;
+        memcpy ( sdl->last_frame , display , sizeof ( sdl->last_frame ) ) ;
+        sdl->last_hires = hires ;
+        sdl->last_fg_color = config.fg_color ;
+        sdl->last_bg_color = config.bg_color ;
+        sdl->frame_uploaded = true ;
+    }
+
+    const SDL_Rect screen = {.x=0, .y=0, .w=CHIP8_DISPLAY_WIDTH * config.scale_factor, .h=CHIP8_DISPLAY_HEIGHT * config.scale_factor} ;
+    SDL_RenderCopy ( sdl->renderer , sdl->screen_texture , NULL , &screen ) ;
+    SDL_Texture *grid = hires ? sdl->hires_grid_texture : sdl->grid_texture ;
+    if ( config.pixelized && grid ) {
+        SDL_RenderCopy ( sdl->renderer , grid , NULL , &screen ) ;
     }
     SDL_RenderPresent ( sdl->renderer ) ;
+}
 
-} 
\ No newline at end of file
+void update_display ( sdl_t *sdl , chip8_t *chip8 , config_t config ) {
+    present_frame ( sdl , (const uint64_t (*)[CHIP8_HIRES_HEIGHT][CHIP8_ROW_WORDS])chip8->display , chip8->hires , config ) ;
+}
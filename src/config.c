@@ -10,11 +10,22 @@ bool init_config (config_t *config) {
     config->scale_factor = 10;
     config->fg_color = 0xFFFFFFFF;
     config->bg_color = 0x000000FF;
+    config->plane1_color = 0xFF6600FF;
+    config->overlap_color = 0x662200FF;
     config->pixelized = true;
     config->instructions_per_second = 500;
     config->sqr_freq = 440; // Frequency in Hz
     config->volume = 3000; // Volume (0-128)
     config->sample_rate = 44100; // Samples per second
+    config->use_jit = false; // Interpreter by default, --jit on the command line
+    config->vip_timing = false; // --vip-timing on the command line
+    config->speed = 1; // Real time, --speed N or --speed max on the command line
+    config->turbo_speed = 0; // Hold Tab to run uncapped, --turbo N for a fixed multiplier
+    config->render_interval = 0; // --render-every N
+    config->rewind_budget = 1024 * 1024; // ~4 minutes of history at ~45 bytes per frame
+    config->rewind_keyframe_interval = 60; // One keyframe per second
+    config->library_path = "chip8-library.txt"; // chip8-library scan, --library on the command line
+    for (uint8_t key = 0; key < 16; key++) config->keymap[key] = key; // Overridden per ROM by the library
     return true; // success
 }
 
@@ -0,0 +1,450 @@
+/**
+ * @file debugger.c
+ * @brief Breakpoints, Watchpoints, Stepping and the Debugger Prompt
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * Bookkeeping for the debug interpreter (see debugger.h) and a small
+ * gdb-like command prompt on a pair of stdio streams, used by chip8
+ * (F11 or --debug) and chip8-headless (--debug).
+ */
+
+#include <ctype.h>
+#include "debugger.h"
+#include "disasm.h"
+
+#define DEBUG_LINE_MAX 256
+
+static const char *const register_names[DEBUG_REG_NONE] = {
+    "V0" , "V1" , "V2" , "V3" , "V4" , "V5" , "V6" , "V7" , "V8" , "V9" , "VA" , "VB" , "VC" , "VD" , "VE" , "VF" ,
+    "I" , "SP" , "DT" , "ST" ,
+} ;
+static const char *const compare_names[] = { "==" , "!=" , "<" , "<=" , ">" , ">=" } ;
+
+bool debugger_attach ( chip8_t *chip8 ) {
+    if ( chip8->debugger ) return true ;
+    chip8->debugger = calloc ( 1 , sizeof ( debugger_t ) ) ;
+    if ( !chip8->debugger ) {
+        CHIP8_LOG ( "Could not allocate the debugger\n" ) ;
+        return false ;
+    }
+    return true ;
+}
+
+void debugger_detach ( chip8_t *chip8 ) {
+    free ( chip8->debugger ) ;
+    chip8->debugger = NULL ;
+}
+
+// ---------------------------------------------------------------------------
+// Breakpoints and watchpoints
+
+// Recompute break_map and active from the tables
+static void update_map ( debugger_t *debugger ) {
+    bool anywhere = false ;
+    memset ( debugger->break_map , 0 , sizeof ( debugger->break_map ) ) ;
+    for ( int i = 0 ; i < DEBUG_MAX_BREAKPOINTS ; i++ ) {
+        const breakpoint_t *b = &debugger->breakpoints[i] ;
+        if ( !b->used ) continue ;
+        if ( b->anywhere ) anywhere = true ;
+        else debugger->break_map[b->address >> 6] |= 1ull << (b->address & 63) ;
+    }
+    if ( anywhere ) memset ( debugger->break_map , 0xFF , sizeof ( debugger->break_map ) ) ;
+    debugger->watch_count = 0 ;
+    for ( int i = 0 ; i < DEBUG_MAX_WATCHPOINTS ; i++ ) debugger->watch_count += debugger->watchpoints[i].used ;
+    bool breaks = false ;
+    for ( int i = 0 ; i < DEBUG_MAX_BREAKPOINTS ; i++ ) breaks = breaks || debugger->breakpoints[i].used ;
+    debugger->active = breaks || debugger->watch_count ;
+}
+
+int debugger_break ( debugger_t *debugger , uint16_t address , bool anywhere , debug_condition_t condition ) {
+    for ( int i = 0 ; i < DEBUG_MAX_BREAKPOINTS ; i++ ) {
+        breakpoint_t *b = &debugger->breakpoints[i] ;
+        if ( b->used ) continue ;
+        *b = (breakpoint_t){ .used = true , .anywhere = anywhere , .address = address , .condition = condition } ;
+        update_map ( debugger ) ;
+        return i ;
+    }
+    return -1 ;
+}
+
+bool debugger_delete ( debugger_t *debugger , int number ) {
+    if ( number < 0 || number >= DEBUG_MAX_BREAKPOINTS || !debugger->breakpoints[number].used ) return false ;
+    debugger->breakpoints[number].used = false ;
+    update_map ( debugger ) ;
+    return true ;
+}
+
+int debugger_watch ( debugger_t *debugger , uint16_t address , uint16_t length ) {
+    for ( int i = 0 ; i < DEBUG_MAX_WATCHPOINTS ; i++ ) {
+        watchpoint_t *w = &debugger->watchpoints[i] ;
+        if ( w->used ) continue ;
+        *w = (watchpoint_t){ .used = true , .address = address , .length = length ? length : 1 } ;
+        update_map ( debugger ) ;
+        return i ;
+    }
+    return -1 ;
+}
+
+bool debugger_unwatch ( debugger_t *debugger , int number ) {
+    if ( number < 0 || number >= DEBUG_MAX_WATCHPOINTS || !debugger->watchpoints[number].used ) return false ;
+    debugger->watchpoints[number].used = false ;
+    update_map ( debugger ) ;
+    return true ;
+}
+
+// "V3==5", "I >= 0x300", "DT!=0" (spaces allowed)
+bool debugger_parse_condition ( const char *text , debug_condition_t *condition ) {
+    char compact[DEBUG_LINE_MAX] ;
+    size_t length = 0 ;
+    for ( ; *text && length + 1 < sizeof ( compact ) ; text++ ) {
+        if ( !isspace ( (unsigned char)*text ) ) compact[length++] = (char)toupper ( (unsigned char)*text ) ;
+    }
+    compact[length] = '\0' ;
+
+    int reg = -1 ;
+    size_t name_length = 0 ;
+    for ( int i = 0 ; i < DEBUG_REG_NONE ; i++ ) {
+        const size_t n = strlen ( register_names[i] ) ;
+        if ( strncmp ( compact , register_names[i] , n ) == 0 && n > name_length ) {
+            reg = i ;
+            name_length = n ;
+        }
+    }
+    if ( reg < 0 ) return false ;
+
+    const char *rest = compact + name_length ;
+    int compare = -1 ;
+    size_t compare_length = 0 ;
+    for ( int i = 0 ; i < (int)( sizeof ( compare_names ) / sizeof ( compare_names[0] ) ) ; i++ ) {
+        const size_t n = strlen ( compare_names[i] ) ;
+        if ( strncmp ( rest , compare_names[i] , n ) == 0 && n > compare_length ) {
+            compare = i ;
+            compare_length = n ;
+        }
+    }
+    if ( compare < 0 ) return false ;
+
+    char *end ;
+    const unsigned long value = strtoul ( rest + compare_length , &end , 0 ) ;
+    if ( *end != '\0' || end == rest + compare_length || value > 0xFFFF ) return false ;
+    *condition = (debug_condition_t){ .reg = (debug_register_t)reg , .compare = (debug_compare_t)compare , .value = (uint16_t)value } ;
+    return true ;
+}
+
+static uint16_t register_value ( const chip8_t *chip8 , debug_register_t reg ) {
+    switch ( reg ) {
+    case DEBUG_REG_I : return chip8->I ;
+    case DEBUG_REG_SP : return chip8->sp ;
+    case DEBUG_REG_DT : return chip8->delay_timer ;
+    case DEBUG_REG_ST : return chip8->sound_timer ;
+    default : return chip8->V[reg & 0x0F] ;
+    }
+}
+
+static bool condition_holds ( const chip8_t *chip8 , const debug_condition_t *condition ) {
+    if ( condition->reg == DEBUG_REG_NONE ) return true ;
+    const uint16_t value = register_value ( chip8 , condition->reg ) ;
+    switch ( condition->compare ) {
+    case DEBUG_EQ : return value == condition->value ;
+    case DEBUG_NE : return value != condition->value ;
+    case DEBUG_LT : return value < condition->value ;
+    case DEBUG_LE : return value <= condition->value ;
+    case DEBUG_GT : return value > condition->value ;
+    case DEBUG_GE : return value >= condition->value ;
+    }
+    return false ;
+}
+
+static void format_condition ( const debug_condition_t *condition , char *text , size_t size ) {
+    if ( condition->reg == DEBUG_REG_NONE ) text[0] = '\0' ;
+    else snprintf ( text , size , " if %s %s 0x%X" , register_names[condition->reg] ,
+                    compare_names[condition->compare] , condition->value ) ;
+}
+
+// ---------------------------------------------------------------------------
+// Called from the debug interpreter
+
+static void stop ( chip8_t *chip8 ) {
+    chip8->debugger->stopped = true ;
+    if ( chip8->state == RUNNING ) chip8->state = PAUSED ;
+}
+
+bool debugger_check ( chip8_t *chip8 , uint16_t pc ) {
+    debugger_t *debugger = chip8->debugger ;
+    if ( debugger->resuming ) {
+        // Resuming at resume_pc runs that instruction even when it has a breakpoint
+        debugger->resuming = false ;
+        if ( pc == debugger->resume_pc ) return false ;
+    }
+    for ( int i = 0 ; i < DEBUG_MAX_BREAKPOINTS ; i++ ) {
+        breakpoint_t *b = &debugger->breakpoints[i] ;
+        if ( !b->used || ( !b->anywhere && b->address != pc ) || !condition_holds ( chip8 , &b->condition ) ) continue ;
+        b->hits++ ;
+        if ( b->temporary ) {
+            snprintf ( debugger->reason , sizeof ( debugger->reason ) , "Returned to 0x%03X" , pc ) ;
+            debugger_delete ( debugger , i ) ;
+        }
+        else {
+            char condition[48] ;
+            format_condition ( &b->condition , condition , sizeof ( condition ) ) ;
+            snprintf ( debugger->reason , sizeof ( debugger->reason ) , "Breakpoint %d at 0x%03X%s" , i , pc , condition ) ;
+        }
+        stop ( chip8 ) ;
+        return true ;
+    }
+    return false ;
+}
+
+bool debugger_watch_hit ( chip8_t *chip8 , uint16_t pc , uint16_t address , uint16_t length ) {
+    debugger_t *debugger = chip8->debugger ;
+    const uint16_t mask = chip8_address_mask ( chip8 ) ;
+    for ( int i = 0 ; i < DEBUG_MAX_WATCHPOINTS ; i++ ) {
+        const watchpoint_t *w = &debugger->watchpoints[i] ;
+        if ( !w->used ) continue ;
+        for ( uint16_t j = 0 ; j < length ; j++ ) {
+            const uint16_t written = (address + j) & mask ;
+            if ( (uint16_t)( written - w->address ) >= w->length ) continue ;
+            char text[DISASM_TEXT_MAX] ;
+            disassemble ( chip8->memory , mask , pc & mask , chip8->xo_chip , text , sizeof ( text ) ) ;
+            snprintf ( debugger->reason , sizeof ( debugger->reason ) , "Watchpoint %d: 0x%03X = 0x%02X, written by %s at 0x%03X" ,
+                       i , written , chip8->memory[written] , text , pc & mask ) ;
+            stop ( chip8 ) ;
+            return true ;
+        }
+    }
+    return false ;
+}
+
+void debugger_interrupt ( chip8_t *chip8 ) {
+    snprintf ( chip8->debugger->reason , sizeof ( chip8->debugger->reason ) , "Interrupted at 0x%03X" , chip8->pc ) ;
+    stop ( chip8 ) ;
+}
+
+// ---------------------------------------------------------------------------
+// Running
+
+static void prepare_resume ( chip8_t *chip8 ) {
+    debugger_t *debugger = chip8->debugger ;
+    debugger->resuming = true ;
+    debugger->resume_pc = chip8->pc & chip8_address_mask ( chip8 ) ;
+    debugger->stopped = false ;
+}
+
+uint32_t debugger_step ( chip8_t *chip8 , uint32_t count ) {
+    prepare_resume ( chip8 ) ;
+    const state_t state = chip8->state ;
+    chip8->state = RUNNING ;
+    const uint32_t executed = run_interpreter ( chip8 , count ) ;
+    if ( chip8->state == RUNNING ) chip8->state = state ; // Still paused unless 00FD ran
+    chip8->debugger->resuming = false ;
+    return executed ;
+}
+
+bool debugger_next ( chip8_t *chip8 ) {
+    const decoded_inst_t *d = fetch_decoded ( chip8 , chip8->pc ) ;
+    if ( d->op != OP_CALL ) {
+        debugger_step ( chip8 , 1 ) ;
+        return false ;
+    }
+    // Back at the next instruction with the same stack depth
+    const debug_condition_t depth = { .reg = DEBUG_REG_SP , .compare = DEBUG_EQ , .value = chip8->sp } ;
+    const int number = debugger_break ( chip8->debugger , (chip8->pc + 2) & chip8_address_mask ( chip8 ) , false , depth ) ;
+    if ( number < 0 ) return false ;
+    chip8->debugger->breakpoints[number].temporary = true ;
+    debugger_continue ( chip8 ) ;
+    return true ;
+}
+
+void debugger_continue ( chip8_t *chip8 ) {
+    prepare_resume ( chip8 ) ;
+    if ( chip8->state == PAUSED ) chip8->state = RUNNING ;
+}
+
+// ---------------------------------------------------------------------------
+// Views
+
+void debugger_print_registers ( const chip8_t *chip8 , FILE *out ) {
+    for ( int i = 0 ; i < 16 ; i++ ) fprintf ( out , "V%X=%02X%s" , i , chip8->V[i] , i == 7 || i == 15 ? "\n" : " " ) ;
+    fprintf ( out , "PC=%04X I=%04X SP=%X DT=%02X ST=%02X  quirks=%s%s\n" , chip8->pc , chip8->I , chip8->sp ,
+              chip8->delay_timer , chip8->sound_timer , chip8_quirk_set ( chip8->quirks )->name , chip8->hires ? " hires" : "" ) ;
+}
+
+void debugger_print_stack ( const chip8_t *chip8 , FILE *out ) {
+    if ( chip8->sp == 0 ) fprintf ( out , "Stack empty\n" ) ;
+    for ( int i = chip8->sp - 1 ; i >= 0 ; i-- ) {
+        fprintf ( out , "#%d  return to 0x%03X\n" , chip8->sp - 1 - i , chip8->stack[i % CHIP8_STACK_SIZE] ) ;
+    }
+}
+
+void debugger_print_disassembly ( const chip8_t *chip8 , uint16_t address , uint32_t count , FILE *out ) {
+    const uint16_t mask = chip8_address_mask ( chip8 ) ;
+    const debugger_t *debugger = chip8->debugger ;
+    for ( uint32_t i = 0 ; i < count ; i++ ) {
+        address &= mask ;
+        char text[DISASM_TEXT_MAX] ;
+        const uint16_t length = disassemble ( chip8->memory , mask , address , chip8->xo_chip , text , sizeof ( text ) ) ;
+        bool breakpoint = false ;
+        for ( int b = 0 ; debugger && b < DEBUG_MAX_BREAKPOINTS ; b++ ) {
+            breakpoint = breakpoint || ( debugger->breakpoints[b].used && !debugger->breakpoints[b].anywhere &&
+                                         debugger->breakpoints[b].address == address ) ;
+        }
+        fprintf ( out , "%s%c 0x%03X:  %02X%02X  %s\n" , address == ( chip8->pc & mask ) ? "=>" : "  " , breakpoint ? '*' : ' ' ,
+                  address , chip8->memory[address] , chip8->memory[(address + 1) & mask] , text ) ;
+        address += length ;
+    }
+}
+
+static void print_memory ( const chip8_t *chip8 , uint16_t address , uint32_t count , FILE *out ) {
+    const uint16_t mask = chip8_address_mask ( chip8 ) ;
+    for ( uint32_t i = 0 ; i < count ; i++ ) {
+        if ( i % 16 == 0 ) fprintf ( out , "%s0x%03X:" , i ? "\n" : "" , (address + i) & mask ) ;
+        fprintf ( out , " %02X" , chip8->memory[(address + i) & mask] ) ;
+    }
+    fprintf ( out , "\n" ) ;
+}
+
+static void print_points ( const debugger_t *debugger , FILE *out ) {
+    bool any = false ;
+    for ( int i = 0 ; i < DEBUG_MAX_BREAKPOINTS ; i++ ) {
+        const breakpoint_t *b = &debugger->breakpoints[i] ;
+        if ( !b->used || b->temporary ) continue ;
+        char condition[48] ;
+        format_condition ( &b->condition , condition , sizeof ( condition ) ) ;
+        if ( b->anywhere ) fprintf ( out , "Breakpoint %d anywhere%s, %u hits\n" , i , condition , b->hits ) ;
+        else fprintf ( out , "Breakpoint %d at 0x%03X%s, %u hits\n" , i , b->address , condition , b->hits ) ;
+        any = true ;
+    }
+    for ( int i = 0 ; i < DEBUG_MAX_WATCHPOINTS ; i++ ) {
+        const watchpoint_t *w = &debugger->watchpoints[i] ;
+        if ( !w->used ) continue ;
+        fprintf ( out , "Watchpoint %d on 0x%03X-0x%03X\n" , i , w->address , w->address + w->length - 1 ) ;
+        any = true ;
+    }
+    if ( !any ) fprintf ( out , "No breakpoints or watchpoints\n" ) ;
+}
+
+// ---------------------------------------------------------------------------
+// Prompt
+
+static void print_help ( FILE *out ) {
+    fprintf ( out ,
+        "  break ADDR [if COND]  b   stop before the instruction at ADDR (hex), optionally only when COND holds\n"
+        "  break if COND             stop before any instruction where COND holds, e.g. V3 == 5, I >= 0x300, DT != 0\n"
+        "  delete N              d   remove breakpoint N\n"
+        "  watch ADDR [LEN]      w   stop after FX33, FX55 or 5XY2 writes to ADDR..ADDR+LEN-1\n"
+        "  unwatch N             u   remove watchpoint N\n"
+        "  info                  i   list breakpoints and watchpoints\n"
+        "  step [N]              s   run N instructions (default 1)\n"
+        "  next                  n   step, running a CALL until it returns\n"
+        "  continue              c   resume\n"
+        "  regs                  r   registers\n"
+        "  stack                 k   call stack\n"
+        "  list [ADDR] [N]       l   disassemble N instructions from ADDR (default: around PC)\n"
+        "  mem ADDR [N]          x   dump N bytes (default 16)\n"
+        "  quit                  q   stop the emulator\n" ) ;
+}
+
+static bool is_command ( const char *word , const char *name , const char *alias ) {
+    return strcmp ( word , name ) == 0 || strcmp ( word , alias ) == 0 ;
+}
+
+static bool parse_address ( const char *text , uint16_t *address ) {
+    if ( !text ) return false ;
+    char *end ;
+    const unsigned long value = strtoul ( text , &end , 16 ) ;
+    if ( *end != '\0' || end == text || value > 0xFFFF ) return false ;
+    *address = (uint16_t)value ;
+    return true ;
+}
+
+static void print_location ( const chip8_t *chip8 , FILE *out ) {
+    if ( chip8->debugger->stopped ) fprintf ( out , "%s\n" , chip8->debugger->reason ) ;
+    debugger_print_disassembly ( chip8 , chip8->pc , 1 , out ) ;
+}
+
+bool debugger_prompt ( chip8_t *chip8 , FILE *in , FILE *out ) {
+    debugger_t *debugger = chip8->debugger ;
+    print_location ( chip8 , out ) ;
+    char line[DEBUG_LINE_MAX] ;
+    for ( ;; ) {
+        fprintf ( out , "(chip8 0x%03X) " , chip8->pc ) ;
+        fflush ( out ) ;
+        if ( !fgets ( line , sizeof ( line ) , in ) ) {
+            // End of input (a piped script ran out): let the emulator run on
+            fprintf ( out , "\n" ) ;
+            debugger_continue ( chip8 ) ;
+            return true ;
+        }
+        const char *command = strtok ( line , " \t\r\n" ) ;
+        const char *arg1 = strtok ( NULL , " \t\r\n" ) ;
+        const char *arg2 = strtok ( NULL , "\r\n" ) ;
+        if ( !command ) continue ;
+
+        if ( is_command ( command , "break" , "b" ) ) {
+            debug_condition_t condition = { .reg = DEBUG_REG_NONE } ;
+            uint16_t address = 0 ;
+            const bool anywhere = arg1 && strcmp ( arg1 , "if" ) == 0 ;
+            const char *condition_text = anywhere ? arg2 : NULL ;
+            if ( !anywhere && arg2 ) {
+                while ( isspace ( (unsigned char)*arg2 ) ) arg2++ ;
+                condition_text = strncmp ( arg2 , "if" , 2 ) == 0 ? arg2 + 2 : "" ;
+            }
+            if ( ( !anywhere && !parse_address ( arg1 , &address ) ) ||
+                 ( condition_text && !debugger_parse_condition ( condition_text , &condition ) ) ) {
+                fprintf ( out , "Usage: break ADDR [if COND] or break if COND\n" ) ;
+                continue ;
+            }
+            const int number = debugger_break ( debugger , address , anywhere , condition ) ;
+            if ( number < 0 ) fprintf ( out , "No free breakpoint (%d at most)\n" , DEBUG_MAX_BREAKPOINTS ) ;
+            else fprintf ( out , "Breakpoint %d set\n" , number ) ;
+        }
+        else if ( is_command ( command , "delete" , "d" ) ) {
+            if ( !arg1 || !debugger_delete ( debugger , atoi ( arg1 ) ) ) fprintf ( out , "No breakpoint %s\n" , arg1 ? arg1 : "" ) ;
+        }
+        else if ( is_command ( command , "watch" , "w" ) ) {
+            uint16_t address ;
+            if ( !parse_address ( arg1 , &address ) ) {
+                fprintf ( out , "Usage: watch ADDR [LEN]\n" ) ;
+                continue ;
+            }
+            const int number = debugger_watch ( debugger , address , arg2 ? (uint16_t)strtoul ( arg2 , NULL , 0 ) : 1 ) ;
+            if ( number < 0 ) fprintf ( out , "No free watchpoint (%d at most)\n" , DEBUG_MAX_WATCHPOINTS ) ;
+            else fprintf ( out , "Watchpoint %d set\n" , number ) ;
+        }
+        else if ( is_command ( command , "unwatch" , "u" ) ) {
+            if ( !arg1 || !debugger_unwatch ( debugger , atoi ( arg1 ) ) ) fprintf ( out , "No watchpoint %s\n" , arg1 ? arg1 : "" ) ;
+        }
+        else if ( is_command ( command , "info" , "i" ) ) print_points ( debugger , out ) ;
+        else if ( is_command ( command , "step" , "s" ) ) {
+            debugger_step ( chip8 , arg1 ? (uint32_t)strtoul ( arg1 , NULL , 0 ) : 1 ) ;
+            print_location ( chip8 , out ) ;
+        }
+        else if ( is_command ( command , "next" , "n" ) ) {
+            if ( debugger_next ( chip8 ) ) return true ;
+            print_location ( chip8 , out ) ;
+        }
+        else if ( is_command ( command , "continue" , "c" ) ) {
+            debugger_continue ( chip8 ) ;
+            return true ;
+        }
+        else if ( is_command ( command , "regs" , "r" ) ) debugger_print_registers ( chip8 , out ) ;
+        else if ( is_command ( command , "stack" , "k" ) ) debugger_print_stack ( chip8 , out ) ;
+        else if ( is_command ( command , "list" , "l" ) ) {
+            uint16_t address = (uint16_t)( chip8->pc - 8 ) ;
+            if ( arg1 && !parse_address ( arg1 , &address ) ) fprintf ( out , "Usage: list [ADDR] [N]\n" ) ;
+            else debugger_print_disassembly ( chip8 , address , arg2 ? (uint32_t)strtoul ( arg2 , NULL , 0 ) : 10 , out ) ;
+        }
+        else if ( is_command ( command , "mem" , "x" ) ) {
+            uint16_t address ;
+            if ( !parse_address ( arg1 , &address ) ) fprintf ( out , "Usage: mem ADDR [N]\n" ) ;
+            else print_memory ( chip8 , address , arg2 ? (uint32_t)strtoul ( arg2 , NULL , 0 ) : 16 , out ) ;
+        }
+        else if ( is_command ( command , "quit" , "q" ) ) {
+            chip8->state = STOPPED ;
+            return false ;
+        }
+        else if ( is_command ( command , "help" , "h" ) ) print_help ( out ) ;
+        else fprintf ( out , "Unknown command %s, try help\n" , command ) ;
+    }
+}
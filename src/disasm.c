@@ -0,0 +1,82 @@
+/**
+ * @file disasm.c
+ * @brief CHIP-8 / SUPER-CHIP / XO-CHIP Disassembler
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * Turns one instruction into text for the debugger's listings. The opcode
+ * is classified by decode_op, the interpreter's own decoder, then printed
+ * from a per-handler format.
+ */
+
+#include "disasm.h"
+
+uint16_t disassemble ( const uint8_t *memory , uint16_t mask , uint16_t address , bool xo_chip , char *text , size_t size ) {
+    const uint16_t opcode = (memory[address & mask] << 8) | memory[(address + 1) & mask] ;
+    const unsigned X = (opcode >> 8) & 0x0F , Y = (opcode >> 4) & 0x0F , N = opcode & 0x0F ;
+    const unsigned NN = opcode & 0xFF , NNN = opcode & 0x0FFF ;
+
+    switch ( decode_op ( opcode ) ) {
+    case OP_CLS : snprintf ( text , size , "CLS" ) ; break ;
+    case OP_RET : snprintf ( text , size , "RET" ) ; break ;
+    case OP_JP : snprintf ( text , size , "JP 0x%03X" , NNN ) ; break ;
+    case OP_CALL : snprintf ( text , size , "CALL 0x%03X" , NNN ) ; break ;
+    case OP_SE_VX_NN : snprintf ( text , size , "SE V%X, 0x%02X" , X , NN ) ; break ;
+    case OP_SNE_VX_NN : snprintf ( text , size , "SNE V%X, 0x%02X" , X , NN ) ; break ;
+    case OP_SE_VX_VY : snprintf ( text , size , "SE V%X, V%X" , X , Y ) ; break ;
+    case OP_LD_VX_NN : snprintf ( text , size , "LD V%X, 0x%02X" , X , NN ) ; break ;
+    case OP_ADD_VX_NN : snprintf ( text , size , "ADD V%X, 0x%02X" , X , NN ) ; break ;
+    case OP_LD_VX_VY : snprintf ( text , size , "LD V%X, V%X" , X , Y ) ; break ;
+    case OP_OR : snprintf ( text , size , "OR V%X, V%X" , X , Y ) ; break ;
+    case OP_AND : snprintf ( text , size , "AND V%X, V%X" , X , Y ) ; break ;
+    case OP_XOR : snprintf ( text , size , "XOR V%X, V%X" , X , Y ) ; break ;
+    case OP_ADD_VX_VY : snprintf ( text , size , "ADD V%X, V%X" , X , Y ) ; break ;
+    case OP_SUB : snprintf ( text , size , "SUB V%X, V%X" , X , Y ) ; break ;
+    case OP_SHR : snprintf ( text , size , "SHR V%X, V%X" , X , Y ) ; break ;
+    case OP_SUBN : snprintf ( text , size , "SUBN V%X, V%X" , X , Y ) ; break ;
+    case OP_SHL : snprintf ( text , size , "SHL V%X, V%X" , X , Y ) ; break ;
+    case OP_SNE_VX_VY : snprintf ( text , size , "SNE V%X, V%X" , X , Y ) ; break ;
+    case OP_LD_I : snprintf ( text , size , "LD I, 0x%03X" , NNN ) ; break ;
+    case OP_JP_V0 : snprintf ( text , size , "JP V0, 0x%03X" , NNN ) ; break ;
+    case OP_RND : snprintf ( text , size , "RND V%X, 0x%02X" , X , NN ) ; break ;
+    case OP_DRW : snprintf ( text , size , "DRW V%X, V%X, %u" , X , Y , N ) ; break ;
+    case OP_SKP : snprintf ( text , size , "SKP V%X" , X ) ; break ;
+    case OP_SKNP : snprintf ( text , size , "SKNP V%X" , X ) ; break ;
+    case OP_LD_VX_DT : snprintf ( text , size , "LD V%X, DT" , X ) ; break ;
+    case OP_LD_VX_K : snprintf ( text , size , "LD V%X, K" , X ) ; break ;
+    case OP_LD_DT_VX : snprintf ( text , size , "LD DT, V%X" , X ) ; break ;
+    case OP_LD_ST_VX : snprintf ( text , size , "LD ST, V%X" , X ) ; break ;
+    case OP_ADD_I_VX : snprintf ( text , size , "ADD I, V%X" , X ) ; break ;
+    case OP_LD_F_VX : snprintf ( text , size , "LD F, V%X" , X ) ; break ;
+    case OP_LD_B_VX : snprintf ( text , size , "LD B, V%X" , X ) ; break ;
+    case OP_LD_MEM_VX : snprintf ( text , size , "LD [I], V%X" , X ) ; break ;
+    case OP_LD_VX_MEM : snprintf ( text , size , "LD V%X, [I]" , X ) ; break ;
+    case OP_SCD : snprintf ( text , size , "SCD %u" , N ) ; break ;
+    case OP_SCU : snprintf ( text , size , "SCU %u" , N ) ; break ;
+    case OP_SCR : snprintf ( text , size , "SCR" ) ; break ;
+    case OP_SCL : snprintf ( text , size , "SCL" ) ; break ;
+    case OP_EXIT : snprintf ( text , size , "EXIT" ) ; break ;
+    case OP_LORES : snprintf ( text , size , "LOW" ) ; break ;
+    case OP_HIRES : snprintf ( text , size , "HIGH" ) ; break ;
+    case OP_SAVE_RANGE : snprintf ( text , size , "SAVE V%X - V%X" , X , Y ) ; break ;
+    case OP_LOAD_RANGE : snprintf ( text , size , "LOAD V%X - V%X" , X , Y ) ; break ;
+    case OP_PLANE : snprintf ( text , size , "PLANE %u" , X ) ; break ;
+    case OP_LD_HF_VX : snprintf ( text , size , "LD HF, V%X" , X ) ; break ;
+    case OP_SAVE_FLAGS : snprintf ( text , size , "LD R, V%X" , X ) ; break ;
+    case OP_LOAD_FLAGS : snprintf ( text , size , "LD V%X, R" , X ) ; break ;
+    case OP_LD_I_LONG :
+        if ( xo_chip ) {
+            const unsigned target = (memory[(address + 2) & mask] << 8) | memory[(address + 3) & mask] ;
+            snprintf ( text , size , "LD I, LONG 0x%04X" , target ) ;
+            return 4 ;
+        }
+        snprintf ( text , size , "DW 0x%04X" , opcode ) ;
+        break ;
+    default :
+        // No-ops: 0NNN machine calls and opcodes no profile defines
+        if ( opcode >> 12 == 0 ) snprintf ( text , size , "SYS 0x%03X" , NNN ) ;
+        else snprintf ( text , size , "DW 0x%04X" , opcode ) ;
+        break ;
+    }
+    return 2 ;
+}
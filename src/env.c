@@ -0,0 +1,359 @@
+/**
+ * @file env.c
+ * @brief Reinforcement-Learning Environments: a Pool of Headless Machines
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * See env.h for the API. The ROM is loaded once, into a template machine
+ * whose decode cache the load prewarms; a reset copies the template. Steps
+ * and resets of the whole pool run on workers started with the pool and
+ * kept for its lifetime: a step is often a few hundred microseconds of
+ * emulation, too little to start threads for each one. The caller's thread
+ * works too, and every env is claimed by one thread per job, in chunks.
+ */
+#define _POSIX_C_SOURCE 200809L // pthreads
+
+#include <pthread.h>
+#include "env.h"
+#include "runner.h"
+#include "workpool.h"
+
+#define ENV_STATE_MAGIC "C8EV"
+#define ENV_CHUNKS_PER_THREAD 8 // Claims per thread and job, to even out envs that run longer
+
+typedef struct {
+    chip8_t *chip8 ;
+    frame_budget_t budget ;
+    uint64_t frames ; // Frames since the reset
+    uint8_t done ;    // ENV_RUNNING, ENV_TERMINATED or ENV_TRUNCATED
+} env_t ;
+
+typedef void ( *env_task_fn ) ( env_pool_t *pool , uint32_t env ) ;
+
+struct env_pool {
+    env_options_t options ;
+    uint32_t count ;
+    env_t *envs ;
+    chip8_t *initial ; // Power-on machine every reset copies
+    char *rom_path ;   // initial->rom_name points here
+    size_t observation_size ;
+    uint8_t *observations ;
+
+    // The job in progress: its task runs once for each env
+    env_task_fn task ;
+    const uint16_t *actions ;
+    uint32_t frames ;
+    float *rewards ;
+    uint8_t *dones ;
+    const uint32_t *seeds ;
+
+    pthread_mutex_t lock ;
+    pthread_cond_t changed ;
+    uint64_t generation ; // Bumped for each job
+    uint32_t next ;       // First env not claimed yet
+    uint32_t chunk ;      // Envs per claim
+    uint32_t busy ;       // Workers not done with the job
+    bool closing ;
+    pthread_t *workers ;
+    unsigned worker_count ; // Threads started besides the caller's (0 = everything inline)
+} ;
+
+// ---------------------------------------------------------------------------
+// Observations
+
+// One 128-pixel row to 64 pixels, each the OR of two neighbours
+static uint64_t halve_row ( const uint64_t row[CHIP8_ROW_WORDS] ) {
+    uint64_t halves[2] ;
+    for ( int w = 0 ; w < 2 ; w++ ) {
+        // Pixels 2k and 2k+1 into bit 2k, then the even bits packed together
+        uint64_t x = ( row[w] | row[w] >> 1 ) & 0x5555555555555555ull ;
+        x = ( x | x >> 1 ) & 0x3333333333333333ull ;
+        x = ( x | x >> 2 ) & 0x0F0F0F0F0F0F0F0Full ;
+        x = ( x | x >> 4 ) & 0x00FF00FF00FF00FFull ;
+        x = ( x | x >> 8 ) & 0x0000FFFF0000FFFFull ;
+        halves[w] = ( x | x >> 16 ) & 0x00000000FFFFFFFFull ;
+    }
+    return halves[0] << 32 | halves[1] ;
+}
+
+// Row y of a plane at 64x32, bit 63 = leftmost
+static uint64_t observed_row ( const chip8_t *chip8 , uint32_t plane , uint32_t y ) {
+    if ( !chip8->hires ) return chip8->display[plane][y][0] ;
+    uint64_t rows[CHIP8_ROW_WORDS] ;
+    for ( uint32_t w = 0 ; w < CHIP8_ROW_WORDS ; w++ ) {
+        rows[w] = chip8->display[plane][2 * y][w] | chip8->display[plane][2 * y + 1][w] ;
+    }
+    return halve_row ( rows ) ;
+}
+
+static void write_observation ( env_pool_t *pool , uint32_t env ) {
+    if ( !pool->observations ) return ;
+    const chip8_t *chip8 = pool->envs[env].chip8 ;
+    uint8_t *out = pool->observations + (size_t)env * pool->observation_size ;
+    for ( uint32_t y = 0 ; y < ENV_OBS_HEIGHT ; y++ ) {
+        uint64_t planes[CHIP8_PLANES] ;
+        uint64_t any = 0 ;
+        for ( uint32_t p = 0 ; p < CHIP8_PLANES ; p++ ) {
+            planes[p] = observed_row ( chip8 , p , y ) ;
+            any |= planes[p] ;
+        }
+        if ( pool->options.format == ENV_OBS_BITS ) {
+            for ( uint32_t b = 0 ; b < 8 ; b++ ) *out++ = (uint8_t)( any >> ( 56 - 8 * b ) ) ;
+            continue ;
+        }
+        for ( uint32_t x = 0 ; x < ENV_OBS_WIDTH ; x++ ) {
+            uint8_t color = 0 ;
+            for ( uint32_t p = 0 ; p < CHIP8_PLANES ; p++ ) color |= ( ( planes[p] >> ( 63 - x ) ) & 1 ) << p ;
+            *out++ = color ;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Tasks, one env each
+
+static void reset_env ( env_pool_t *pool , uint32_t env , uint32_t seed ) {
+    env_t *e = &pool->envs[env] ;
+    decoded_inst_t *decoded_xo = e->chip8->decoded_xo ; // Each env keeps its own
+    memcpy ( e->chip8 , pool->initial , sizeof ( chip8_t ) ) ;
+    e->chip8->decoded_xo = decoded_xo ;
+    if ( decoded_xo ) memcpy ( decoded_xo , pool->initial->decoded_xo , CHIP8_MAX_MEMORY_SIZE * sizeof ( decoded_inst_t ) ) ;
+    e->chip8->rng = seed ? seed : CHIP8_RNG_SEED ;
+    e->budget = (frame_budget_t){ 0 } ;
+    e->frames = 0 ;
+    e->done = ENV_RUNNING ;
+    write_observation ( pool , env ) ;
+}
+
+static void reset_task ( env_pool_t *pool , uint32_t env ) {
+    reset_env ( pool , env , pool->seeds ? pool->seeds[env] : 0 ) ;
+}
+
+static void step_task ( env_pool_t *pool , uint32_t env ) {
+    env_t *e = &pool->envs[env] ;
+    chip8_t *chip8 = e->chip8 ;
+    const env_options_t *options = &pool->options ;
+    float reward = 0 ;
+    if ( e->done == ENV_RUNNING ) {
+        const uint16_t keys = pool->actions[env] ;
+        for ( uint32_t k = 0 ; k < 16 ; k++ ) chip8->keypad[k] = ( keys >> k ) & 1 ;
+        for ( uint32_t f = 0 ; f < pool->frames ; f++ ) {
+            run_frame ( chip8 , &e->budget , options->instructions_per_second , options->vip_timing , UINT32_MAX ) ;
+            tick_timers ( chip8 ) ;
+            e->frames++ ;
+            bool terminal = false ;
+            if ( options->reward ) reward += options->reward ( chip8 , env , options->reward_context , &terminal ) ;
+            if ( terminal || chip8->state == STOPPED ) e->done = ENV_TERMINATED ;
+            else if ( options->max_frames && e->frames >= options->max_frames ) e->done = ENV_TRUNCATED ;
+            if ( e->done != ENV_RUNNING ) break ;
+        }
+        write_observation ( pool , env ) ;
+    }
+    if ( pool->rewards ) pool->rewards[env] = reward ;
+    if ( pool->dones ) pool->dones[env] = e->done ;
+}
+
+// ---------------------------------------------------------------------------
+// Workers
+
+// Claim chunks of the job until none is left
+static void work ( env_pool_t *pool ) {
+    for ( ;; ) {
+        pthread_mutex_lock ( &pool->lock ) ;
+        const uint32_t first = pool->next ;
+        pool->next = first < pool->count ? first + pool->chunk : first ;
+        pthread_mutex_unlock ( &pool->lock ) ;
+        if ( first >= pool->count ) return ;
+        const uint32_t end = first + pool->chunk < pool->count ? first + pool->chunk : pool->count ;
+        for ( uint32_t env = first ; env < end ; env++ ) pool->task ( pool , env ) ;
+    }
+}
+
+static void *worker_main ( void *arg ) {
+    env_pool_t *pool = arg ;
+    uint64_t seen = 0 ; // Started before the first job, which may be out before this runs
+    pthread_mutex_lock ( &pool->lock ) ;
+    for ( ;; ) {
+        while ( pool->generation == seen && !pool->closing ) pthread_cond_wait ( &pool->changed , &pool->lock ) ;
+        if ( pool->closing ) break ;
+        seen = pool->generation ;
+        pthread_mutex_unlock ( &pool->lock ) ;
+        work ( pool ) ;
+        pthread_mutex_lock ( &pool->lock ) ;
+        if ( --pool->busy == 0 ) pthread_cond_broadcast ( &pool->changed ) ;
+    }
+    pthread_mutex_unlock ( &pool->lock ) ;
+    return NULL ;
+}
+
+// Run pool->task on every env and wait for all of them
+static void run_job ( env_pool_t *pool , env_task_fn task ) {
+    pool->task = task ;
+    if ( pool->worker_count == 0 ) {
+        for ( uint32_t env = 0 ; env < pool->count ; env++ ) task ( pool , env ) ;
+        return ;
+    }
+    pthread_mutex_lock ( &pool->lock ) ;
+    pool->next = 0 ;
+    pool->busy = pool->worker_count ;
+    pool->generation++ ;
+    pthread_cond_broadcast ( &pool->changed ) ;
+    pthread_mutex_unlock ( &pool->lock ) ;
+    work ( pool ) ;
+    pthread_mutex_lock ( &pool->lock ) ;
+    while ( pool->busy ) pthread_cond_wait ( &pool->changed , &pool->lock ) ;
+    pthread_mutex_unlock ( &pool->lock ) ;
+}
+
+// ---------------------------------------------------------------------------
+// Pool
+
+void env_default_options ( env_options_t *options , const config_t *config ) {
+    memset ( options , 0 , sizeof ( *options ) ) ;
+    options->quirks = QUIRKS_AUTO ;
+    options->instructions_per_second = config->instructions_per_second ;
+    options->vip_timing = config->vip_timing ;
+    options->format = ENV_OBS_BITS ;
+}
+
+env_pool_t *env_pool_create ( const char *rom_path , uint32_t count , const env_options_t *options ) {
+    if ( count == 0 ) return NULL ;
+    env_pool_t *pool = calloc ( 1 , sizeof ( env_pool_t ) ) ;
+    if ( !pool ) return NULL ;
+    pool->options = *options ;
+    pool->count = count ;
+    pool->observation_size = options->format == ENV_OBS_BITS ? ENV_OBS_HEIGHT * ENV_OBS_WIDTH / 8 : ENV_OBS_HEIGHT * ENV_OBS_WIDTH ;
+    pool->rom_path = strdup ( rom_path ) ;
+    pool->initial = calloc ( 1 , sizeof ( chip8_t ) ) ;
+    pool->envs = calloc ( count , sizeof ( env_t ) ) ;
+    if ( !pool->rom_path || !pool->initial || !pool->envs ) {
+        CHIP8_LOG ( "Out of memory for %u environments\n" , count ) ;
+        env_pool_destroy ( pool ) ;
+        return NULL ;
+    }
+    pool->initial->quirks_request = options->quirks ;
+    if ( !init_chip8 ( pool->initial , pool->rom_path ) ) {
+        env_pool_destroy ( pool ) ;
+        return NULL ;
+    }
+    for ( uint32_t env = 0 ; env < count ; env++ ) {
+        chip8_t *chip8 = pool->envs[env].chip8 = calloc ( 1 , sizeof ( chip8_t ) ) ;
+        if ( chip8 && pool->initial->xo_chip ) chip8->decoded_xo = malloc ( CHIP8_MAX_MEMORY_SIZE * sizeof ( decoded_inst_t ) ) ;
+        if ( !chip8 || ( pool->initial->xo_chip && !chip8->decoded_xo ) ) {
+            CHIP8_LOG ( "Out of memory for %u environments\n" , count ) ;
+            env_pool_destroy ( pool ) ;
+            return NULL ;
+        }
+    }
+
+    unsigned threads = options->threads ? options->threads : workpool_default_threads () ;
+    if ( threads > count ) threads = count ;
+    pool->chunk = count / ( threads * ENV_CHUNKS_PER_THREAD ) ;
+    if ( pool->chunk == 0 ) pool->chunk = 1 ;
+    pthread_mutex_init ( &pool->lock , NULL ) ;
+    pthread_cond_init ( &pool->changed , NULL ) ;
+    if ( threads > 1 ) pool->workers = malloc ( ( threads - 1 ) * sizeof ( pthread_t ) ) ;
+    // Runs inline, or on fewer threads, when they cannot start
+    while ( pool->workers && pool->worker_count < threads - 1 &&
+            pthread_create ( &pool->workers[pool->worker_count] , NULL , worker_main , pool ) == 0 ) {
+        pool->worker_count++ ;
+    }
+    run_job ( pool , reset_task ) ;
+    return pool ;
+}
+
+void env_pool_destroy ( env_pool_t *pool ) {
+    if ( !pool ) return ;
+    if ( pool->workers ) {
+        pthread_mutex_lock ( &pool->lock ) ;
+        pool->closing = true ;
+        pthread_cond_broadcast ( &pool->changed ) ;
+        pthread_mutex_unlock ( &pool->lock ) ;
+        for ( unsigned w = 0 ; w < pool->worker_count ; w++ ) pthread_join ( pool->workers[w] , NULL ) ;
+        free ( pool->workers ) ;
+    }
+    if ( pool->chunk ) {
+        // Only set up once the machines are
+        pthread_mutex_destroy ( &pool->lock ) ;
+        pthread_cond_destroy ( &pool->changed ) ;
+    }
+    for ( uint32_t env = 0 ; pool->envs && env < pool->count ; env++ ) {
+        free_chip8 ( pool->envs[env].chip8 ) ;
+        free ( pool->envs[env].chip8 ) ;
+    }
+    free ( pool->envs ) ;
+    free_chip8 ( pool->initial ) ;
+    free ( pool->initial ) ;
+    free ( pool->rom_path ) ;
+    free ( pool ) ;
+}
+
+uint32_t env_count ( const env_pool_t *pool ) {
+    return pool->count ;
+}
+
+size_t env_observation_size ( const env_pool_t *pool ) {
+    return pool->observation_size ;
+}
+
+void env_set_observations ( env_pool_t *pool , uint8_t *buffer ) {
+    pool->observations = buffer ;
+    for ( uint32_t env = 0 ; env < pool->count ; env++ ) write_observation ( pool , env ) ;
+}
+
+void env_reset ( env_pool_t *pool , uint32_t env , uint32_t seed ) {
+    if ( env < pool->count ) reset_env ( pool , env , seed ) ;
+}
+
+void env_reset_all ( env_pool_t *pool , const uint32_t *seeds ) {
+    pool->seeds = seeds ;
+    run_job ( pool , reset_task ) ;
+    pool->seeds = NULL ;
+}
+
+void env_step ( env_pool_t *pool , const uint16_t *actions , uint32_t frames , float *rewards , uint8_t *dones ) {
+    pool->actions = actions ;
+    pool->frames = frames ;
+    pool->rewards = rewards ;
+    pool->dones = dones ;
+    run_job ( pool , step_task ) ;
+}
+
+// Snapshot header (native byte order): magic, u8 done, u8 machine state,
+// u16 zero, u64 frames, u64 cycle credit, i64 time debt; a save state follows
+size_t env_clone ( env_pool_t *pool , uint32_t env , uint8_t *buffer , size_t capacity ) {
+    if ( env >= pool->count || capacity < ENV_STATE_HEADER_SIZE ) return 0 ;
+    const env_t *e = &pool->envs[env] ;
+    const size_t size = savestate_encode ( e->chip8 , buffer + ENV_STATE_HEADER_SIZE , capacity - ENV_STATE_HEADER_SIZE ) ;
+    if ( size == 0 ) return 0 ;
+    uint8_t header[ENV_STATE_HEADER_SIZE] = { 0 } ;
+    memcpy ( header , ENV_STATE_MAGIC , 4 ) ;
+    header[4] = e->done ;
+    header[5] = (uint8_t)e->chip8->state ;
+    memcpy ( header + 8 , &e->frames , 8 ) ;
+    memcpy ( header + 16 , &e->budget.cycle_credit , 8 ) ;
+    memcpy ( header + 24 , &e->budget.time_debt_us , 8 ) ;
+    memcpy ( buffer , header , ENV_STATE_HEADER_SIZE ) ;
+    return ENV_STATE_HEADER_SIZE + size ;
+}
+
+bool env_restore ( env_pool_t *pool , uint32_t env , const uint8_t *buffer , size_t size ) {
+    if ( env >= pool->count || size < ENV_STATE_HEADER_SIZE || memcmp ( buffer , ENV_STATE_MAGIC , 4 ) != 0 ||
+         buffer[4] > ENV_TRUNCATED || ( buffer[5] != RUNNING && buffer[5] != STOPPED ) ) {
+        CHIP8_LOG ( "Not an environment snapshot\n" ) ;
+        return false ;
+    }
+    env_t *e = &pool->envs[env] ;
+    if ( !savestate_decode ( e->chip8 , buffer + ENV_STATE_HEADER_SIZE , size - ENV_STATE_HEADER_SIZE ) ) return false ;
+    e->done = buffer[4] ;
+    e->chip8->state = (state_t)buffer[5] ;
+    memcpy ( &e->frames , buffer + 8 , 8 ) ;
+    memcpy ( &e->budget.cycle_credit , buffer + 16 , 8 ) ;
+    memcpy ( &e->budget.time_debt_us , buffer + 24 , 8 ) ;
+    write_observation ( pool , env ) ;
+    return true ;
+}
+
+chip8_t *env_machine ( env_pool_t *pool , uint32_t env ) {
+    return env < pool->count ? pool->envs[env].chip8 : NULL ;
+}
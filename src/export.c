@@ -0,0 +1,484 @@
+/**
+ * @file export.c
+ * @brief Frame Export to Y4M, Raw RGBA and PNG Sequences
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * The emulation side of an export is a 2 KB copy of the display planes
+ * into a ring of EXPORT_QUEUE_DEPTH slots. Everything slow (expanding the
+ * planes to pixels, colour conversion, PNG compression and the file I/O)
+ * runs on one writer thread per exporter, in frame order.
+ */
+#define _POSIX_C_SOURCE 200809L // pthreads
+
+#include <pthread.h>
+#include "export.h"
+
+#define EXPORT_WIDTH CHIP8_HIRES_WIDTH
+#define EXPORT_HEIGHT CHIP8_HIRES_HEIGHT
+#define EXPORT_MAX_SCALE 64
+
+// One queued frame, still in the packed bitplane form
+typedef struct {
+    uint64_t display[CHIP8_PLANES][CHIP8_HIRES_HEIGHT][CHIP8_ROW_WORDS] ;
+    bool hires ;
+    uint64_t frame ;
+} export_job_t ;
+
+typedef struct {
+    uint8_t *data ;
+    size_t size ;
+    size_t capacity ;
+} buffer_t ;
+
+struct exporter {
+    export_options_t options ;
+    uint32_t width ;
+    uint32_t height ;
+    FILE *file ;         // y4m and raw
+    char *path ;         // PNG name pattern
+    uint8_t *indices ;   // width * height palette indices of the frame being written
+    uint8_t *pixels ;    // y4m planes or raw RGBA
+    buffer_t png ;
+    uint8_t yuv[4][3] ;  // Palette in Y'CbCr
+    export_job_t last ;  // Last frame queued, for dedupe
+    bool has_last ;
+    uint64_t written ;
+
+    pthread_mutex_t lock ;
+    pthread_cond_t changed ;
+    export_job_t *jobs ; // EXPORT_QUEUE_DEPTH slots
+    uint32_t head ;      // Next job to write
+    uint32_t pending ;   // Jobs queued or being written
+    bool closing ;
+    bool threaded ;      // Falls back to writing inline when no thread can start
+    bool failed ;
+    pthread_t thread ;
+} ;
+
+// ---------------------------------------------------------------------------
+// Pixels
+
+// Expand the planes to one palette index per output pixel; scaled rows are copies
+static void expand_frame ( exporter_t *exporter , const export_job_t *job ) {
+    const uint32_t scale = exporter->options.scale ;
+    const uint32_t source = job->hires ? 1 : 2 ; // Output pixels per display pixel at scale 1
+    for ( uint32_t y = 0 ; y < EXPORT_HEIGHT ; y++ ) {
+        uint8_t *out = &exporter->indices[(size_t)y * scale * exporter->width] ;
+        const uint32_t row = y / source ;
+        for ( uint32_t x = 0 ; x < EXPORT_WIDTH ; x++ ) {
+            const uint32_t column = x / source ;
+            const uint32_t shift = 63 - column % 64 ;
+            const uint8_t index = ((job->display[0][row][column / 64] >> shift) & 1) |
+                                  ((job->display[1][row][column / 64] >> shift) & 1) << 1 ;
+            memset ( out + x * scale , index , scale ) ;
+        }
+        for ( uint32_t i = 1 ; i < scale ; i++ ) memcpy ( out + (size_t)i * exporter->width , out , exporter->width ) ;
+    }
+}
+
+// BT.601 studio range, the YUV4MPEG2 default
+static void palette_to_yuv ( exporter_t *exporter ) {
+    for ( int i = 0 ; i < 4 ; i++ ) {
+        const int r = (exporter->options.palette[i] >> 24) & 0xFF ;
+        const int g = (exporter->options.palette[i] >> 16) & 0xFF ;
+        const int b = (exporter->options.palette[i] >> 8) & 0xFF ;
+        exporter->yuv[i][0] = (uint8_t)( ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16 ) ;
+        exporter->yuv[i][1] = (uint8_t)( ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128 ) ;
+        exporter->yuv[i][2] = (uint8_t)( ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128 ) ;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// PNG: palette image, each row unfiltered or "Up" when it repeats the row
+// above, compressed with fixed-Huffman deflate and distance-1 runs. Frames
+// are long runs of a few colours, so this gets within a few percent of zlib.
+
+static bool buffer_reserve ( buffer_t *buffer , size_t extra ) {
+    if ( buffer->size + extra <= buffer->capacity ) return true ;
+    size_t capacity = buffer->capacity ? buffer->capacity : 4096 ;
+    while ( capacity < buffer->size + extra ) capacity *= 2 ;
+    uint8_t *data = realloc ( buffer->data , capacity ) ;
+    if ( !data ) return false ;
+    buffer->data = data ;
+    buffer->capacity = capacity ;
+    return true ;
+}
+
+static void put_be32 ( buffer_t *buffer , uint32_t value ) {
+    for ( int i = 3 ; i >= 0 ; i-- ) buffer->data[buffer->size++] = (uint8_t)( value >> (8 * i) ) ;
+}
+
+// Bitwise CRC-32 (IEEE), only run over the compressed chunks
+static uint32_t crc32 ( const uint8_t *data , size_t size ) {
+    uint32_t crc = 0xFFFFFFFFu ;
+    for ( size_t i = 0 ; i < size ; i++ ) {
+        crc ^= data[i] ;
+        for ( int bit = 0 ; bit < 8 ; bit++ ) crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1)) ;
+    }
+    return ~crc ;
+}
+
+typedef struct {
+    buffer_t *out ;
+    uint32_t bits ;
+    int count ;
+} bit_writer_t ;
+
+// Deflate packs bits from the least significant end
+static void put_bits ( bit_writer_t *w , uint32_t value , int count ) {
+    w->bits |= value << w->count ;
+    w->count += count ;
+    while ( w->count >= 8 ) {
+        w->out->data[w->out->size++] = (uint8_t)w->bits ;
+        w->bits >>= 8 ;
+        w->count -= 8 ;
+    }
+}
+
+// Huffman codes go out most significant bit first
+static void put_code ( bit_writer_t *w , uint32_t code , int length ) {
+    uint32_t reversed = 0 ;
+    for ( int i = 0 ; i < length ; i++ ) reversed |= ((code >> i) & 1) << (length - 1 - i) ;
+    put_bits ( w , reversed , length ) ;
+}
+
+// Fixed literal/length code (RFC 1951 3.2.6)
+static void put_symbol ( bit_writer_t *w , uint32_t symbol ) {
+    if ( symbol < 144 ) put_code ( w , 0x30 + symbol , 8 ) ;
+    else if ( symbol < 256 ) put_code ( w , 0x190 + symbol - 144 , 9 ) ;
+    else if ( symbol < 280 ) put_code ( w , symbol - 256 , 7 ) ;
+    else put_code ( w , 0xC0 + symbol - 280 , 8 ) ;
+}
+
+// Copy `length` (3-258) bytes from one byte back
+static void put_run ( bit_writer_t *w , uint32_t length ) {
+    static const uint16_t base[29] = { 3 , 4 , 5 , 6 , 7 , 8 , 9 , 10 , 11 , 13 , 15 , 17 , 19 , 23 , 27 , 31 ,
+                                       35 , 43 , 51 , 59 , 67 , 83 , 99 , 115 , 131 , 163 , 195 , 227 , 258 } ;
+    static const uint8_t extra[29] = { 0 , 0 , 0 , 0 , 0 , 0 , 0 , 0 , 1 , 1 , 1 , 1 , 2 , 2 , 2 , 2 ,
+                                       3 , 3 , 3 , 3 , 4 , 4 , 4 , 4 , 5 , 5 , 5 , 5 , 0 } ;
+    int code = 28 ;
+    while ( base[code] > length ) code-- ;
+    put_symbol ( w , 257 + code ) ;
+    put_bits ( w , length - base[code] , extra[code] ) ;
+    put_code ( w , 0 , 5 ) ; // Distance code 0: one byte back
+}
+
+// zlib stream of the filtered rows, appended to the buffer
+static bool deflate_image ( exporter_t *exporter , buffer_t *out ) {
+    const uint32_t width = exporter->width ;
+    const size_t raw_size = (size_t)( width + 1 ) * exporter->height ;
+    // A 9-bit code per byte at worst, plus headers
+    if ( !buffer_reserve ( out , raw_size + raw_size / 8 + 64 ) ) return false ;
+
+    out->data[out->size++] = 0x78 ; // Deflate, 32K window
+    out->data[out->size++] = 0x01 ; // No dictionary, fastest (header checksum is a multiple of 31)
+    bit_writer_t w = { .out = out } ;
+    put_bits ( &w , 1 , 1 ) ; // Final block
+    put_bits ( &w , 1 , 2 ) ; // Fixed Huffman codes
+
+    uint32_t a = 1 , b = 0 ; // Adler-32 of the filtered rows
+    for ( uint32_t y = 0 ; y < exporter->height ; y++ ) {
+        const uint8_t *row = &exporter->indices[(size_t)y * width] ;
+        const bool repeat = y > 0 && memcmp ( row , row - width , width ) == 0 ;
+        // An "Up" row that repeats the one above is all zeros
+        uint8_t filter = repeat ? 2 : 0 ;
+        put_symbol ( &w , filter ) ;
+        a = (a + filter) % 65521 ;
+        b = (b + a) % 65521 ;
+        for ( uint32_t x = 0 ; x < width ; ) {
+            const uint8_t value = repeat ? 0 : row[x] ;
+            uint32_t run = 1 ;
+            while ( x + run < width && ( repeat || row[x + run] == value ) ) run++ ;
+            for ( uint32_t i = 0 ; i < run ; i++ ) {
+                a = (a + value) % 65521 ;
+                b = (b + a) % 65521 ;
+            }
+            put_symbol ( &w , value ) ;
+            uint32_t left = run - 1 ;
+            while ( left >= 3 ) {
+                const uint32_t length = left < 258 ? left : 258 ;
+                put_run ( &w , length ) ;
+                left -= length ;
+            }
+            // Runs start at 3 bytes, a shorter tail goes out as literals
+            while ( left-- ) put_symbol ( &w , value ) ;
+            x += run ;
+        }
+    }
+    put_symbol ( &w , 256 ) ; // End of block
+    if ( w.count ) put_bits ( &w , 0 , 8 - w.count ) ;
+    put_be32 ( out , (b << 16) | a ) ;
+    return true ;
+}
+
+static bool put_chunk_start ( buffer_t *buffer , const char *type , uint32_t length ) {
+    if ( !buffer_reserve ( buffer , 12 + length ) ) return false ;
+    put_be32 ( buffer , length ) ;
+    memcpy ( buffer->data + buffer->size , type , 4 ) ;
+    buffer->size += 4 ;
+    return true ;
+}
+
+// The CRC covers the type and the data, which start `start` bytes in
+static void put_chunk_end ( buffer_t *buffer , size_t start ) {
+    put_be32 ( buffer , crc32 ( buffer->data + start + 4 , buffer->size - start - 4 ) ) ;
+}
+
+static bool encode_png ( exporter_t *exporter , buffer_t *png ) {
+    static const uint8_t signature[8] = { 0x89 , 'P' , 'N' , 'G' , '\r' , '\n' , 0x1A , '\n' } ;
+    png->size = 0 ;
+    if ( !buffer_reserve ( png , sizeof ( signature ) ) ) return false ;
+    memcpy ( png->data , signature , sizeof ( signature ) ) ;
+    png->size = sizeof ( signature ) ;
+
+    size_t start = png->size ;
+    if ( !put_chunk_start ( png , "IHDR" , 13 ) ) return false ;
+    put_be32 ( png , exporter->width ) ;
+    put_be32 ( png , exporter->height ) ;
+    const uint8_t header[5] = { 8 , 3 , 0 , 0 , 0 } ; // 8-bit palette indices, no interlacing
+    memcpy ( png->data + png->size , header , sizeof ( header ) ) ;
+    png->size += sizeof ( header ) ;
+    put_chunk_end ( png , start ) ;
+
+    start = png->size ;
+    if ( !put_chunk_start ( png , "PLTE" , 12 ) ) return false ;
+    bool opaque = true ;
+    for ( int i = 0 ; i < 4 ; i++ ) {
+        const uint32_t color = exporter->options.palette[i] ;
+        for ( int shift = 24 ; shift >= 8 ; shift -= 8 ) png->data[png->size++] = (uint8_t)( color >> shift ) ;
+        opaque = opaque && ( color & 0xFF ) == 0xFF ;
+    }
+    put_chunk_end ( png , start ) ;
+
+    if ( !opaque ) {
+        start = png->size ;
+        if ( !put_chunk_start ( png , "tRNS" , 4 ) ) return false ;
+        for ( int i = 0 ; i < 4 ; i++ ) png->data[png->size++] = (uint8_t)exporter->options.palette[i] ;
+        put_chunk_end ( png , start ) ;
+    }
+
+    // The IDAT length is only known once the image is compressed
+    start = png->size ;
+    if ( !put_chunk_start ( png , "IDAT" , 0 ) ) return false ;
+    if ( !deflate_image ( exporter , png ) ) return false ;
+    const uint32_t length = (uint32_t)( png->size - start - 8 ) ;
+    for ( int i = 0 ; i < 4 ; i++ ) png->data[start + i] = (uint8_t)( length >> (24 - 8 * i) ) ;
+    if ( !buffer_reserve ( png , 4 ) ) return false ;
+    put_chunk_end ( png , start ) ;
+
+    start = png->size ;
+    if ( !put_chunk_start ( png , "IEND" , 0 ) ) return false ;
+    put_chunk_end ( png , start ) ;
+    return true ;
+}
+
+// "frame.png" -> "frame_000042.png"
+static void png_filename ( const char *pattern , uint64_t frame , char *name , size_t size ) {
+    const char *dot = strrchr ( pattern , '.' ) ;
+    const char *slash = strrchr ( pattern , '/' ) ;
+    if ( !dot || ( slash && dot < slash ) ) dot = pattern + strlen ( pattern ) ;
+    snprintf ( name , size , "%.*s_%06llu%s" , (int)( dot - pattern ) , pattern , (unsigned long long)frame , dot ) ;
+}
+
+// ---------------------------------------------------------------------------
+// Writer
+
+static bool write_job ( exporter_t *exporter , const export_job_t *job ) {
+    expand_frame ( exporter , job ) ;
+    const size_t count = (size_t)exporter->width * exporter->height ;
+
+    switch ( exporter->options.format ) {
+    case EXPORT_Y4M : {
+        for ( size_t i = 0 ; i < count ; i++ ) {
+            const uint8_t *yuv = exporter->yuv[exporter->indices[i]] ;
+            exporter->pixels[i] = yuv[0] ;
+            exporter->pixels[count + i] = yuv[1] ;
+            exporter->pixels[2 * count + i] = yuv[2] ;
+        }
+        return fputs ( "FRAME\n" , exporter->file ) != EOF &&
+               fwrite ( exporter->pixels , 1 , 3 * count , exporter->file ) == 3 * count ;
+    }
+    case EXPORT_RAW : {
+        for ( size_t i = 0 ; i < count ; i++ ) {
+            const uint32_t color = exporter->options.palette[exporter->indices[i]] ;
+            exporter->pixels[4 * i] = (uint8_t)( color >> 24 ) ;
+            exporter->pixels[4 * i + 1] = (uint8_t)( color >> 16 ) ;
+            exporter->pixels[4 * i + 2] = (uint8_t)( color >> 8 ) ;
+            exporter->pixels[4 * i + 3] = (uint8_t)color ;
+        }
+        return fwrite ( exporter->pixels , 1 , 4 * count , exporter->file ) == 4 * count ;
+    }
+    case EXPORT_PNG : {
+        char name[4096] ;
+        png_filename ( exporter->path , job->frame , name , sizeof ( name ) ) ;
+        if ( !encode_png ( exporter , &exporter->png ) ) {
+            CHIP8_LOG ( "Out of memory encoding %s\n" , name ) ;
+            return false ;
+        }
+        FILE *file = fopen ( name , "wb" ) ;
+        if ( !file ) {
+            CHIP8_LOG ( "Could not open file %s for writing\n" , name ) ;
+            return false ;
+        }
+        const bool written = fwrite ( exporter->png.data , 1 , exporter->png.size , file ) == exporter->png.size ;
+        if ( fclose ( file ) != 0 || !written ) {
+            CHIP8_LOG ( "Could not write to file %s\n" , name ) ;
+            return false ;
+        }
+        return true ;
+    }
+    }
+    return false ;
+}
+
+static void *writer_main ( void *context ) {
+    exporter_t *exporter = context ;
+    pthread_mutex_lock ( &exporter->lock ) ;
+    for ( ;; ) {
+        while ( exporter->pending == 0 && !exporter->closing ) pthread_cond_wait ( &exporter->changed , &exporter->lock ) ;
+        if ( exporter->pending == 0 ) break ; // Closing and drained
+        // The slot stays reserved until the write is done, so the job can be read unlocked
+        const export_job_t *job = &exporter->jobs[exporter->head] ;
+        pthread_mutex_unlock ( &exporter->lock ) ;
+        const bool ok = write_job ( exporter , job ) ;
+        pthread_mutex_lock ( &exporter->lock ) ;
+        if ( ok ) exporter->written++ ;
+        else exporter->failed = true ;
+        exporter->head = (exporter->head + 1) % EXPORT_QUEUE_DEPTH ;
+        exporter->pending-- ;
+        pthread_cond_broadcast ( &exporter->changed ) ;
+    }
+    pthread_mutex_unlock ( &exporter->lock ) ;
+    return NULL ;
+}
+
+// ---------------------------------------------------------------------------
+// API
+
+void export_default_options ( export_options_t *options , const config_t *config , const char *path ) {
+    const char *dot = path ? strrchr ( path , '.' ) : NULL ;
+    options->format = EXPORT_RAW ;
+    if ( dot ) export_parse_format ( dot + 1 , &options->format ) ;
+    options->palette[0] = config->bg_color ;
+    options->palette[1] = config->fg_color ;
+    options->palette[2] = config->plane1_color ;
+    options->palette[3] = config->overlap_color ;
+    options->scale = 1 ;
+    options->dedupe = false ;
+}
+
+bool export_parse_format ( const char *name , export_format_t *format ) {
+    static const char *const names[] = { [EXPORT_Y4M] = "y4m" , [EXPORT_RAW] = "raw" , [EXPORT_PNG] = "png" } ;
+    for ( int i = 0 ; i < (int)( sizeof ( names ) / sizeof ( names[0] ) ) ; i++ ) {
+        if ( strcmp ( name , names[i] ) == 0 ) {
+            *format = (export_format_t)i ;
+            return true ;
+        }
+    }
+    return false ;
+}
+
+static void free_exporter ( exporter_t *exporter ) {
+    if ( exporter->file ) fclose ( exporter->file ) ;
+    free ( exporter->path ) ;
+    free ( exporter->indices ) ;
+    free ( exporter->pixels ) ;
+    free ( exporter->png.data ) ;
+    free ( exporter->jobs ) ;
+    free ( exporter ) ;
+}
+
+exporter_t *export_open ( const char *path , const export_options_t *options ) {
+    if ( options->scale == 0 || options->scale > EXPORT_MAX_SCALE ) {
+        CHIP8_LOG ( "Export scale must be between 1 and %d\n" , EXPORT_MAX_SCALE ) ;
+        return NULL ;
+    }
+    exporter_t *exporter = calloc ( 1 , sizeof ( exporter_t ) ) ;
+    if ( !exporter ) return NULL ;
+    exporter->options = *options ;
+    exporter->width = EXPORT_WIDTH * options->scale ;
+    exporter->height = EXPORT_HEIGHT * options->scale ;
+    const size_t count = (size_t)exporter->width * exporter->height ;
+    exporter->indices = malloc ( count ) ;
+    exporter->jobs = malloc ( EXPORT_QUEUE_DEPTH * sizeof ( export_job_t ) ) ;
+    exporter->path = malloc ( strlen ( path ) + 1 ) ;
+    if ( options->format != EXPORT_PNG ) exporter->pixels = malloc ( 4 * count ) ;
+    if ( !exporter->indices || !exporter->jobs || !exporter->path || ( options->format != EXPORT_PNG && !exporter->pixels ) ) {
+        CHIP8_LOG ( "Out of memory opening export %s\n" , path ) ;
+        free_exporter ( exporter ) ;
+        return NULL ;
+    }
+    strcpy ( exporter->path , path ) ;
+    palette_to_yuv ( exporter ) ;
+
+    if ( options->format != EXPORT_PNG ) {
+        exporter->file = fopen ( path , "wb" ) ;
+        if ( !exporter->file ) {
+            CHIP8_LOG ( "Could not open file %s for writing\n" , path ) ;
+            free_exporter ( exporter ) ;
+            return NULL ;
+        }
+        if ( options->format == EXPORT_Y4M &&
+             fprintf ( exporter->file , "YUV4MPEG2 W%u H%u F%d:1 Ip A1:1 C444\n" ,
+                       exporter->width , exporter->height , CHIP8_FRAME_RATE ) < 0 ) {
+            CHIP8_LOG ( "Could not write to file %s\n" , path ) ;
+            free_exporter ( exporter ) ;
+            return NULL ;
+        }
+    }
+
+    pthread_mutex_init ( &exporter->lock , NULL ) ;
+    pthread_cond_init ( &exporter->changed , NULL ) ;
+    exporter->threaded = pthread_create ( &exporter->thread , NULL , writer_main , exporter ) == 0 ;
+    return exporter ;
+}
+
+bool export_frame ( exporter_t *exporter , const chip8_t *chip8 , uint64_t frame ) {
+    if ( exporter->options.dedupe && exporter->has_last && exporter->last.hires == chip8->hires &&
+         memcmp ( exporter->last.display , chip8->display , sizeof ( exporter->last.display ) ) == 0 ) {
+        return true ;
+    }
+    memcpy ( exporter->last.display , chip8->display , sizeof ( exporter->last.display ) ) ;
+    exporter->last.hires = chip8->hires ;
+    exporter->last.frame = frame ;
+    exporter->has_last = true ;
+
+    if ( !exporter->threaded ) {
+        const bool ok = write_job ( exporter , &exporter->last ) ;
+        if ( ok ) exporter->written++ ;
+        else exporter->failed = true ;
+        return ok ;
+    }
+    pthread_mutex_lock ( &exporter->lock ) ;
+    // Only waits when the writer is a whole queue behind
+    while ( exporter->pending == EXPORT_QUEUE_DEPTH ) pthread_cond_wait ( &exporter->changed , &exporter->lock ) ;
+    exporter->jobs[(exporter->head + exporter->pending) % EXPORT_QUEUE_DEPTH] = exporter->last ;
+    exporter->pending++ ;
+    const bool ok = !exporter->failed ;
+    pthread_cond_broadcast ( &exporter->changed ) ;
+    pthread_mutex_unlock ( &exporter->lock ) ;
+    return ok ;
+}
+
+bool export_close ( exporter_t *exporter , uint64_t *written ) {
+    if ( exporter->threaded ) {
+        pthread_mutex_lock ( &exporter->lock ) ;
+        exporter->closing = true ;
+        pthread_cond_broadcast ( &exporter->changed ) ;
+        pthread_mutex_unlock ( &exporter->lock ) ;
+        pthread_join ( exporter->thread , NULL ) ;
+    }
+    pthread_mutex_destroy ( &exporter->lock ) ;
+    pthread_cond_destroy ( &exporter->changed ) ;
+
+    bool ok = !exporter->failed ;
+    if ( exporter->file ) {
+        ok = fclose ( exporter->file ) == 0 && ok ;
+        exporter->file = NULL ;
+        if ( !ok ) CHIP8_LOG ( "Could not write to file %s\n" , exporter->path ) ;
+    }
+    if ( written ) *written = exporter->written ;
+    free_exporter ( exporter ) ;
+    return ok ;
+}
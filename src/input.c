@@ -1,7 +1,8 @@
 #include "input.h"
 
 // CHIP-8 Input Handling
-// Manages keyboard input, save/load states, and emulator controls
+// The main thread turns SDL events into keypad bits and commands, the
+// emulation thread runs them between frames (see input.h)
 
 /*    CHIP-8 Keypad layout:  AZERTY Keyboard mapping:
         1 2 3 4        1 2 3 4
@@ -16,127 +17,91 @@
      Z X C V => Z X C V
        */
 
-// Handle all SDL events and keyboard input
-void handle_input (chip8_t *chip8) {
+// Press or release the CHIP-8 key mapped to keypad position `key` (see config_t::keymap)
+static void set_key (input_t *input , const config_t *config , uint8_t key , bool down) {
+    const uint16_t bit = (uint16_t)(1u << (config->keymap[key] & 0xF)) ;
+    if (down) __atomic_fetch_or(&input->keypad , bit , __ATOMIC_RELEASE) ;
+    else __atomic_fetch_and(&input->keypad , (uint16_t)~bit , __ATOMIC_RELEASE) ;
+}
+
+// Queue a command for the emulation thread, dropped when it is a whole queue behind
+static void push_command (input_t *input , input_command_t command) {
+    const uint32_t tail = input->tail ;  // Only this thread writes it
+    if (tail - __atomic_load_n(&input->head , __ATOMIC_ACQUIRE) == INPUT_QUEUE_SIZE) return ;
+    input->commands[tail % INPUT_QUEUE_SIZE] = (uint8_t)command ;
+    __atomic_store_n(&input->tail , tail + 1 , __ATOMIC_RELEASE) ;
+}
+
+// Handle all SDL events and keyboard input (main thread)
+void poll_input (input_t *input , const config_t *config) {
     SDL_Event event ; 
     while (SDL_PollEvent(&event)) {
         switch (event.type)
         {
         case SDL_QUIT:
-            chip8->state = STOPPED; 
+            __atomic_store_n(&input->quit , true , __ATOMIC_RELEASE) ;
             break;
         case SDL_KEYDOWN : 
             switch (event.key.keysym.sym) {
                 // System controls
                 case SDLK_ESCAPE : 
-                    chip8->state = STOPPED ; 
-                    return ; 
-                case SDLK_SPACE : 
-                    // Toggle pause/resume
-                    if(chip8->state == RUNNING) { 
-                        chip8->state = PAUSED ;
-                        puts("=====PAUSED =======") ; 
-                    } else { 
-                        chip8->state = RUNNING  ; 
-                        puts("=====RUNNING =======") ;
-                    }
-                    return ; 
-                case SDLK_m : 
-                    // Reset emulator
-                    init_chip8(chip8 , chip8->rom_name ) ;
+                    __atomic_store_n(&input->quit , true , __ATOMIC_RELEASE) ;
                     break;
+                case SDLK_SPACE : push_command(input , INPUT_PAUSE) ; break;
+                case SDLK_m : push_command(input , INPUT_RESET) ; break;
                 // Save states (F1-F4)
-                case SDLK_F1 :
-                    if (save_state(chip8 , chip8->save_filename , sizeof(chip8->save_filename) , 1))
-                        puts ("State saved successfully in slot 1 !") ;
-                    else
-                        puts ("Failed to save state !") ;
-                    break;
-
-                case SDLK_F2 :
-                    if (save_state(chip8 , chip8->save_filename , sizeof(chip8->save_filename) , 2))
-                        puts ("State saved successfully in slot 2 !") ;
-                    else
-                        puts ("Failed to save state !") ;
-                    break;
-
-                case SDLK_F3 :
-                    if (save_state(chip8 , chip8->save_filename , sizeof(chip8->save_filename) , 3))
-                        puts ("State saved successfully in slot 3 !") ;
-                    else
-                        puts ("Failed to save state !") ;
-                    break;
-                case SDLK_F4 :
-                    if (save_state(chip8 , chip8->save_filename , sizeof(chip8->save_filename) , 4))
-                        puts ("State saved successfully in slot 4 !") ;
-                    else
-                        puts ("Failed to save state !") ;
-                    break;  
-
+                case SDLK_F1 : push_command(input , INPUT_SAVE_1) ; break;
+                case SDLK_F2 : push_command(input , INPUT_SAVE_1 + 1) ; break;
+                case SDLK_F3 : push_command(input , INPUT_SAVE_1 + 2) ; break;
+                case SDLK_F4 : push_command(input , INPUT_SAVE_1 + 3) ; break;
                 // Load states (F5-F8)
-                case SDLK_F5 :
-                    if (load_state(chip8 , chip8->save_filename , sizeof(chip8->save_filename) , 1))
-                        puts ("State loaded successfully from slot 1 !") ;
-                    else
-                        puts ("Failed to load state !") ;
-                    break;
-
-                case SDLK_F6 :
-                    if (load_state(chip8 , chip8->save_filename , sizeof(chip8->save_filename) , 2))
-                        puts ("State loaded successfully from slot 2 !") ;
-                    else
-                        puts ("Failed to load state !") ;
-                    break;
-
-                case SDLK_F7 :
-                    if (load_state(chip8 , chip8->save_filename , sizeof(chip8->save_filename) , 3))
-                        puts ("State loaded successfully from slot 3 !") ;
-                    else
-                        puts ("Failed to load state !") ;
-                    break;
-
-                case SDLK_F8 :
-                    if (load_state(chip8 , chip8->save_filename , sizeof(chip8->save_filename) , 4))
-                        puts ("State loaded successfully from slot 4 !") ;
-                    else
-                        puts ("Failed to load state !") ;
-                    break;
+                case SDLK_F5 : push_command(input , INPUT_LOAD_1) ; break;
+                case SDLK_F6 : push_command(input , INPUT_LOAD_1 + 1) ; break;
+                case SDLK_F7 : push_command(input , INPUT_LOAD_1 + 2) ; break;
+                case SDLK_F8 : push_command(input , INPUT_LOAD_1 + 3) ; break;
+#ifdef CHIP8_PROFILE
+                // Profiler (PROFILE=1 builds): F9 prints the report, F10 restarts the counters
+                case SDLK_F9 : push_command(input , INPUT_PROFILE_REPORT) ; break;
+                case SDLK_F10 : push_command(input , INPUT_PROFILE_RESET) ; break;
+#endif
+                // Break into the debugger prompt in the terminal (attached on first use)
+                case SDLK_F11 : push_command(input , INPUT_DEBUG) ; break;
                    
                 // CHIP-8 keypad mapping (AZERTY layout)
-                case SDLK_1 : chip8->keypad[0x1] = true ; break;
-                case SDLK_2 : chip8->keypad[0x2] = true ; break;
-                case SDLK_3 : chip8->keypad[0x3] = true ; break;
-                case SDLK_4 : chip8->keypad[0xC] = true ; break;
-                case SDLK_a : chip8->keypad[0x4] = true ; break;
-                case SDLK_z : chip8->keypad[0x5] = true ; break;
-                case SDLK_e : chip8->keypad[0x6] = true ; break;
-                case SDLK_r : chip8->keypad[0xD] = true ; break;
-                case SDLK_q : chip8->keypad[0x7] = true ; break;
-                case SDLK_s : chip8->keypad[0x8] = true ; break;
-                case SDLK_d : chip8->keypad[0x9] = true ; break;
-                case SDLK_f : chip8->keypad[0xE] = true ; break;
-                case SDLK_w : chip8->keypad[0xA] = true ; break;
-                case SDLK_x : chip8->keypad[0x0] = true ; break;
-                case SDLK_c : chip8->keypad[0xB] = true ; break;
-                case SDLK_v : chip8->keypad[0xF] = true ; break;
+                case SDLK_1 : set_key(input , config , 0x1 , true) ; break;
+                case SDLK_2 : set_key(input , config , 0x2 , true) ; break;
+                case SDLK_3 : set_key(input , config , 0x3 , true) ; break;
+                case SDLK_4 : set_key(input , config , 0xC , true) ; break;
+                case SDLK_a : set_key(input , config , 0x4 , true) ; break;
+                case SDLK_z : set_key(input , config , 0x5 , true) ; break;
+                case SDLK_e : set_key(input , config , 0x6 , true) ; break;
+                case SDLK_r : set_key(input , config , 0xD , true) ; break;
+                case SDLK_q : set_key(input , config , 0x7 , true) ; break;
+                case SDLK_s : set_key(input , config , 0x8 , true) ; break;
+                case SDLK_d : set_key(input , config , 0x9 , true) ; break;
+                case SDLK_f : set_key(input , config , 0xE , true) ; break;
+                case SDLK_w : set_key(input , config , 0xA , true) ; break;
+                case SDLK_x : set_key(input , config , 0x0 , true) ; break;
+                case SDLK_c : set_key(input , config , 0xB , true) ; break;
+                case SDLK_v : set_key(input , config , 0xF , true) ; break;
                 // CHIP-8 keypad mapping (QWERTY layout)
                 /*
-                case SDLK_1 : chip8->keypad[0x1] = true ; break;
-                case SDLK_2 : chip8->keypad[0x2] = true ; break;
-                case SDLK_3 : chip8->keypad[0x3] = true ; break;
-                case SDLK_4 : chip8->keypad[0xC] = true ; break;
-                case SDLK_q : chip8->keypad[0x4] = true ; break;
-                case SDLK_w : chip8->keypad[0x5] = true ; break;
-                case SDLK_e : chip8->keypad[0x6] = true ; break;
-                case SDLK_r : chip8->keypad[0xD] = true ; break;
-                case SDLK_a : chip8->keypad[0x7] = true ; break;
-                case SDLK_s : chip8->keypad[0x8] = true ; break;
-                case SDLK_d : chip8->keypad[0x9] = true ; break;
-                case SDLK_f : chip8->keypad[0xE] = true ; break;
-                case SDLK_z : chip8->keypad[0xA] = true ; break;
-                case SDLK_x : chip8->keypad[0x0] = true ; break;
-                case SDLK_c : chip8->keypad[0xB] = true ; break;
-                case SDLK_v : chip8->keypad[0xF] = true ; break; 
+                case SDLK_1 : set_key(input , config , 0x1 , true) ; break;
+                case SDLK_2 : set_key(input , config , 0x2 , true) ; break;
+                case SDLK_3 : set_key(input , config , 0x3 , true) ; break;
+                case SDLK_4 : set_key(input , config , 0xC , true) ; break;
+                case SDLK_q : set_key(input , config , 0x4 , true) ; break;
+                case SDLK_w : set_key(input , config , 0x5 , true) ; break;
+                case SDLK_e : set_key(input , config , 0x6 , true) ; break;
+                case SDLK_r : set_key(input , config , 0xD , true) ; break;
+                case SDLK_a : set_key(input , config , 0x7 , true) ; break;
+                case SDLK_s : set_key(input , config , 0x8 , true) ; break;
+                case SDLK_d : set_key(input , config , 0x9 , true) ; break;
+                case SDLK_f : set_key(input , config , 0xE , true) ; break;
+                case SDLK_z : set_key(input , config , 0xA , true) ; break;
+                case SDLK_x : set_key(input , config , 0x0 , true) ; break;
+                case SDLK_c : set_key(input , config , 0xB , true) ; break;
+                case SDLK_v : set_key(input , config , 0xF , true) ; break; 
                 */
                 
                 default : 
@@ -147,40 +112,40 @@ void handle_input (chip8_t *chip8) {
         case SDL_KEYUP : 
             // Release CHIP-8 keypad buttons
             switch (event.key.keysym.sym) {
-                case SDLK_1 : chip8->keypad[0x1] = false ; break;
-                case SDLK_2 : chip8->keypad[0x2] = false ; break;
-                case SDLK_3 : chip8->keypad[0x3] = false ; break;
-                case SDLK_4 : chip8->keypad[0xC] = false ; break;
-                case SDLK_a : chip8->keypad[0x4] = false ; break;
-                case SDLK_z : chip8->keypad[0x5] = false ; break;
-                case SDLK_e : chip8->keypad[0x6] = false ; break;
-                case SDLK_r : chip8->keypad[0xD] = false ; break;
-                case SDLK_q : chip8->keypad[0x7] = false ; break;
-                case SDLK_s : chip8->keypad[0x8] = false ; break;
-                case SDLK_d : chip8->keypad[0x9] = false ; break;
-                case SDLK_f : chip8->keypad[0xE] = false ; break;
-                case SDLK_w : chip8->keypad[0xA] = false ; break;
-                case SDLK_x : chip8->keypad[0x0] = false ; break;
-                case SDLK_c : chip8->keypad[0xB] = false ; break;
-                case SDLK_v : chip8->keypad[0xF] = false ; break;
+                case SDLK_1 : set_key(input , config , 0x1 , false) ; break;
+                case SDLK_2 : set_key(input , config , 0x2 , false) ; break;
+                case SDLK_3 : set_key(input , config , 0x3 , false) ; break;
+                case SDLK_4 : set_key(input , config , 0xC , false) ; break;
+                case SDLK_a : set_key(input , config , 0x4 , false) ; break;
+                case SDLK_z : set_key(input , config , 0x5 , false) ; break;
+                case SDLK_e : set_key(input , config , 0x6 , false) ; break;
+                case SDLK_r : set_key(input , config , 0xD , false) ; break;
+                case SDLK_q : set_key(input , config , 0x7 , false) ; break;
+                case SDLK_s : set_key(input , config , 0x8 , false) ; break;
+                case SDLK_d : set_key(input , config , 0x9 , false) ; break;
+                case SDLK_f : set_key(input , config , 0xE , false) ; break;
+                case SDLK_w : set_key(input , config , 0xA , false) ; break;
+                case SDLK_x : set_key(input , config , 0x0 , false) ; break;
+                case SDLK_c : set_key(input , config , 0xB , false) ; break;
+                case SDLK_v : set_key(input , config , 0xF , false) ; break;
                 // CHIP-8 keypad mapping (QWERTY layout)
                 /*
-                case SDLK_1 : chip8->keypad[0x1] = false ; break;
-                case SDLK_2 : chip8->keypad[0x2] = false ; break;
-                case SDLK_3 : chip8->keypad[0x3] = false ; break;
-                case SDLK_4 : chip8->keypad[0xC] = false ; break;
-                case SDLK_q : chip8->keypad[0x4] = false ; break;
-                case SDLK_w : chip8->keypad[0x5] = false ; break;
-                case SDLK_e : chip8->keypad[0x6] = false ; break;
-                case SDLK_r : chip8->keypad[0xD] = false ; break;
-                case SDLK_a : chip8->keypad[0x7] = false ; break;
-                case SDLK_s : chip8->keypad[0x8] = false ; break;
-                case SDLK_d : chip8->keypad[0x9] = false ; break;
-                case SDLK_f : chip8->keypad[0xE] = false ; break;
-                case SDLK_z : chip8->keypad[0xA] = false ; break;
-                case SDLK_x : chip8->keypad[0x0] = false ; break;
-                case SDLK_c : chip8->keypad[0xB] = false ; break;
-                case SDLK_v : chip8->keypad[0xF] = false ; break; 
+                case SDLK_1 : set_key(input , config , 0x1 , false) ; break;
+                case SDLK_2 : set_key(input , config , 0x2 , false) ; break;
+                case SDLK_3 : set_key(input , config , 0x3 , false) ; break;
+                case SDLK_4 : set_key(input , config , 0xC , false) ; break;
+                case SDLK_q : set_key(input , config , 0x4 , false) ; break;
+                case SDLK_w : set_key(input , config , 0x5 , false) ; break;
+                case SDLK_e : set_key(input , config , 0x6 , false) ; break;
+                case SDLK_r : set_key(input , config , 0xD , false) ; break;
+                case SDLK_a : set_key(input , config , 0x7 , false) ; break;
+                case SDLK_s : set_key(input , config , 0x8 , false) ; break;
+                case SDLK_d : set_key(input , config , 0x9 , false) ; break;
+                case SDLK_f : set_key(input , config , 0xE , false) ; break;
+                case SDLK_z : set_key(input , config , 0xA , false) ; break;
+                case SDLK_x : set_key(input , config , 0x0 , false) ; break;
+                case SDLK_c : set_key(input , config , 0xB , false) ; break;
+                case SDLK_v : set_key(input , config , 0xF , false) ; break; 
                 */  
 
                 default : 
@@ -194,5 +159,83 @@ void handle_input (chip8_t *chip8) {
 
     }
 
-
-}
\ No newline at end of file
+    // Keys held down, once the events are in
+    const Uint8 *keys = SDL_GetKeyboardState(NULL) ;
+    const uint8_t held = (keys[SDL_SCANCODE_BACKSPACE] ? INPUT_HELD_REWIND : 0) | (keys[SDL_SCANCODE_TAB] ? INPUT_HELD_TURBO : 0) ;
+    __atomic_store_n(&input->held , held , __ATOMIC_RELEASE) ;
+}
+
+void input_keypad (input_t *input , chip8_t *chip8) {
+    const uint16_t keypad = __atomic_load_n(&input->keypad , __ATOMIC_ACQUIRE) ;
+    for ( int key = 0 ; key < 16 ; key++ ) chip8->keypad[key] = (keypad >> key) & 1 ;
+}
+
+uint8_t input_held (input_t *input) {
+    return __atomic_load_n(&input->held , __ATOMIC_ACQUIRE) ;
+}
+
+// Run the queued commands (emulation thread).
+// Returns true when the machine state was replaced (reset or state load).
+bool apply_input (input_t *input , chip8_t *chip8) {
+    bool replaced = false ;
+    if (__atomic_load_n(&input->quit , __ATOMIC_ACQUIRE)) {
+        chip8->state = STOPPED ;
+        return replaced ;
+    }
+    const uint32_t tail = __atomic_load_n(&input->tail , __ATOMIC_ACQUIRE) ;
+    for ( uint32_t head = input->head ; head != tail ; head++ ) {
+        const uint8_t command = input->commands[head % INPUT_QUEUE_SIZE] ;
+        __atomic_store_n(&input->head , head + 1 , __ATOMIC_RELEASE) ;
+        if (command >= INPUT_SAVE_1 && command < INPUT_SAVE_1 + 4) {
+            const int slot = command - INPUT_SAVE_1 + 1 ;
+            if (save_state(chip8 , chip8->save_filename , sizeof(chip8->save_filename) , slot))
+                printf ("State saved successfully in slot %d !\n" , slot) ;
+            else
+                puts ("Failed to save state !") ;
+            continue ;
+        }
+        if (command >= INPUT_LOAD_1 && command < INPUT_LOAD_1 + 4) {
+            const int slot = command - INPUT_LOAD_1 + 1 ;
+            if (load_state(chip8 , chip8->save_filename , sizeof(chip8->save_filename) , slot)) {
+                printf ("State loaded successfully from slot %d !\n" , slot) ;
+                replaced = true ;
+            }
+            else
+                puts ("Failed to load state !") ;
+            continue ;
+        }
+        switch (command) {
+            case INPUT_PAUSE :
+                // Toggle pause/resume
+                if(chip8->state == RUNNING) { 
+                    chip8->state = PAUSED ;
+                    puts("=====PAUSED =======") ; 
+                } else { 
+                    chip8->state = RUNNING  ; 
+                    puts("=====RUNNING =======") ;
+                }
+                break;
+            case INPUT_RESET :
+                // Reset emulator
+                init_chip8(chip8 , chip8->rom_name ) ;
+                replaced = true ;
+                break;
+#ifdef CHIP8_PROFILE
+            case INPUT_PROFILE_REPORT :
+                profiler_report(chip8 , stdout) ;
+                break;
+            case INPUT_PROFILE_RESET :
+                profiler_reset(chip8->profiler) ;
+                puts ("Profiler counters reset") ;
+                break;
+#endif
+            case INPUT_DEBUG :
+                if (debugger_attach(chip8)) debugger_interrupt(chip8) ;
+                break;
+            default :
+                break;
+        }
+    }
+    input_keypad(input , chip8) ;
+    return replaced ;
+}
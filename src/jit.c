@@ -0,0 +1,643 @@
+/**
+ * @file jit.c
+ * @brief x86-64 Dynamic Recompiler for CHIP-8 Basic Blocks
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * Translates runs of CHIP-8 instructions into native code operating
+ * directly on chip8_t; draws and memory writes call small C helpers (a
+ * write over compiled code leaves the block there). A block ends with a
+ * native jump, call, return or skip, or stops before FX0A, CXNN or
+ * anything else that needs host services; run_interpreter executes that
+ * one and the dispatcher looks up the next block. Blocks with a known
+ * successor jump straight into it while the cycle budget lasts, and a
+ * return looks its target up in the block table and jumps into it when
+ * it is compiled. Produces exactly the state the interpreter would:
+ * quirk-dependent instructions are emitted for chip8->quirks, which only
+ * changes in init_chip8 (which flushes the cache).
+ *
+ * Block calling convention (System V): rdi = chip8_t *, esi = cycle
+ * budget, eax = budget left on return. A block whose instruction count
+ * exceeds the budget returns immediately without touching any state.
+ * chip8->pc holds the block's address on entry; every exit stores its
+ * target as a constant, so no block reads pc back.
+ */
+#define _DEFAULT_SOURCE // mmap / MAP_ANONYMOUS under -std=c99
+
+#include "jit.h"
+#include "display.h"
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#define JIT_SUPPORTED 1
+#include <stddef.h>
+#include <sys/mman.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
+#ifdef JIT_SUPPORTED
+
+#define JIT_CODE_SIZE ( 1u << 20 ) // 1 MB of executable memory
+#define JIT_MAX_BLOCK_INSTRUCTIONS 64
+#define JIT_MAX_INSTRUCTION_BYTES 448 // Worst case is FX65 with X = F
+#define JIT_MAX_PENDING_LINKS 4096
+#define EXIT_STUB_SIZE 5
+#define ADDRESS_MASK ( CHIP8_MEMORY_SIZE - 1 )
+
+typedef uint32_t ( *block_fn_t ) ( chip8_t *chip8 , uint32_t budget ) ;
+
+typedef enum {
+    BLOCK_UNCOMPILED = 0 ,
+    BLOCK_NATIVE ,      // fn is valid
+    BLOCK_INTERPRETED , // first instruction cannot be compiled
+} block_state_t ;
+
+typedef struct {
+    block_fn_t fn ;
+    uint32_t entry ; // Offset of fn in the code buffer
+    uint16_t count ; // Instructions executed by fn
+    uint8_t state ;
+    bool idle_loop ; // Target of a backward jump that may close an idle loop, checked by the dispatcher
+} jit_block_t ;
+
+// Exit stub waiting for its target block to be compiled
+typedef struct {
+    uint32_t stub ;
+    uint16_t target ;
+} jit_link_t ;
+
+struct jit {
+    uint8_t *code ;
+    size_t used ;
+    jit_block_t blocks[CHIP8_MEMORY_SIZE] ;  // Indexed by start address
+    bool covered[CHIP8_MEMORY_SIZE] ;        // Byte belongs to a compiled block
+    uint16_t covered_start , covered_end ;   // Span of the covered bytes, empty when equal
+    jit_link_t links[JIT_MAX_PENDING_LINKS] ;
+    uint32_t link_count ;
+} ;
+
+// x86-64 register numbers used in ModRM fields
+enum { EAX = 0 , ECX = 1 , EDX = 2 } ;
+enum { JE = 0x74 , JNE = 0x75 } ;
+
+#define OFF_V(x) ( (int32_t)( offsetof(chip8_t , V) + (x) ) )
+#define OFF_I ( (int32_t)offsetof(chip8_t , I) )
+#define OFF_PC ( (int32_t)offsetof(chip8_t , pc) )
+#define OFF_SP ( (int32_t)offsetof(chip8_t , sp) )
+#define OFF_STACK ( (int32_t)offsetof(chip8_t , stack) )
+#define OFF_DT ( (int32_t)offsetof(chip8_t , delay_timer) )
+#define OFF_ST ( (int32_t)offsetof(chip8_t , sound_timer) )
+#define OFF_MEM ( (int32_t)offsetof(chip8_t , memory) )
+#define OFF_KEYPAD ( (int32_t)offsetof(chip8_t , keypad) )
+
+static void emit8 ( jit_t *jit , uint8_t byte ) {
+    jit->code[jit->used++] = byte ;
+}
+
+static void emit16 ( jit_t *jit , uint16_t value ) {
+    emit8 ( jit , value & 0xFF ) ;
+    emit8 ( jit , value >> 8 ) ;
+}
+
+static void emit32 ( jit_t *jit , uint32_t value ) {
+    for ( int i = 0 ; i < 4 ; i++ ) emit8 ( jit , (value >> (8 * i)) & 0xFF ) ;
+}
+
+static void patch32 ( jit_t *jit , size_t offset , uint32_t value ) {
+    for ( int i = 0 ; i < 4 ; i++ ) jit->code[offset + i] = (value >> (8 * i)) & 0xFF ;
+}
+
+// ModRM for [rdi + disp32] with `reg` in the reg field
+static void emit_rdi_operand ( jit_t *jit , uint8_t reg , int32_t disp ) {
+    emit8 ( jit , 0x80 | (reg << 3) | 7 ) ;
+    emit32 ( jit , (uint32_t)disp ) ;
+}
+
+// ModRM + SIB for [rdi + rax*2 + disp32] with `reg` in the reg field
+static void emit_rdi_rax2_operand ( jit_t *jit , uint8_t reg , int32_t disp ) {
+    emit8 ( jit , 0x80 | (reg << 3) | 4 ) ;
+    emit8 ( jit , 0x47 ) ;
+    emit32 ( jit , (uint32_t)disp ) ;
+}
+
+// mov r8, byte [rdi + disp]
+static void emit_load8 ( jit_t *jit , uint8_t reg , int32_t disp ) {
+    emit8 ( jit , 0x8A ) ; emit_rdi_operand ( jit , reg , disp ) ;
+}
+
+// mov byte [rdi + disp], r8
+static void emit_store8 ( jit_t *jit , uint8_t reg , int32_t disp ) {
+    emit8 ( jit , 0x88 ) ; emit_rdi_operand ( jit , reg , disp ) ;
+}
+
+// movzx eax, byte [rdi + disp]
+static void emit_load8_zx ( jit_t *jit , int32_t disp ) {
+    emit8 ( jit , 0x0F ) ; emit8 ( jit , 0xB6 ) ; emit_rdi_operand ( jit , EAX , disp ) ;
+}
+
+// mov byte [rdi + disp], imm8
+static void emit_store_imm8 ( jit_t *jit , int32_t disp , uint8_t imm ) {
+    emit8 ( jit , 0xC6 ) ; emit_rdi_operand ( jit , 0 , disp ) ; emit8 ( jit , imm ) ;
+}
+
+// mov [rdi + V[X]], al ; mov [rdi + VF], cl  (result first, flag last)
+static void emit_store_result_and_flag ( jit_t *jit , uint8_t x ) {
+    emit_store8 ( jit , EAX , OFF_V(x) ) ;
+    emit_store8 ( jit , ECX , OFF_V(0xF) ) ;
+}
+
+static void emit_setc_cl ( jit_t *jit ) { emit8 ( jit , 0x0F ) ; emit8 ( jit , 0x92 ) ; emit8 ( jit , 0xC1 ) ; }
+static void emit_setnc_cl ( jit_t *jit ) { emit8 ( jit , 0x0F ) ; emit8 ( jit , 0x93 ) ; emit8 ( jit , 0xC1 ) ; }
+
+// mov word [rdi + pc], imm16
+static void emit_set_pc ( jit_t *jit , uint16_t value ) {
+    emit8 ( jit , 0x66 ) ; emit8 ( jit , 0xC7 ) ; emit_rdi_operand ( jit , 0 , OFF_PC ) ; emit16 ( jit , value ) ;
+}
+
+// mov eax, esi ; ret
+static void emit_return ( jit_t *jit ) {
+    emit8 ( jit , 0x89 ) ; emit8 ( jit , 0xF0 ) ; emit8 ( jit , 0xC3 ) ;
+}
+
+// Jump into the block at the pc in ecx when it is compiled, otherwise
+// return to the dispatcher (which also runs any pc past the address mask)
+static void emit_jump_to_pc ( jit_t *jit ) {
+    const uint64_t blocks = (uint64_t)(uintptr_t)jit->blocks ;
+    emit8 ( jit , 0x81 ) ; emit8 ( jit , 0xF9 ) ; emit32 ( jit , ADDRESS_MASK ) ;                      // cmp ecx, mask
+    emit8 ( jit , 0x77 ) ; emit8 ( jit , 34 ) ;                                                        // ja return
+    emit8 ( jit , 0x69 ) ; emit8 ( jit , 0xC9 ) ; emit32 ( jit , sizeof ( jit_block_t ) ) ;            // imul ecx, ecx, sizeof block
+    emit8 ( jit , 0x48 ) ; emit8 ( jit , 0xB8 ) ; emit32 ( jit , (uint32_t)blocks ) ; emit32 ( jit , (uint32_t)( blocks >> 32 ) ) ; // mov rax, blocks
+    emit8 ( jit , 0x48 ) ; emit8 ( jit , 0x01 ) ; emit8 ( jit , 0xC8 ) ;                              // add rax, rcx
+    emit8 ( jit , 0x80 ) ; emit8 ( jit , 0xB8 ) ; emit32 ( jit , offsetof ( jit_block_t , state ) ) ; emit8 ( jit , BLOCK_NATIVE ) ; // cmp byte [rax + state], BLOCK_NATIVE
+    emit8 ( jit , JNE ) ; emit8 ( jit , 6 ) ;
+    emit8 ( jit , 0xFF ) ; emit8 ( jit , 0xA0 ) ; emit32 ( jit , offsetof ( jit_block_t , fn ) ) ;     // jmp [rax + fn]
+    emit_return ( jit ) ;
+}
+
+// Address of a helper for emit_call
+#define HELPER(fn) ( (uint64_t)(uintptr_t)(fn) )
+
+// Call fn ( chip8 , a , b , c , d ) from a block, keeping chip8 in rdi and
+// the budget in esi; its result is left in eax. A helper taking fewer
+// arguments ignores the registers left over.
+static void emit_call ( jit_t *jit , uint64_t fn , uint32_t a , uint32_t b , uint32_t c , uint32_t d ) {
+    emit8 ( jit , 0x57 ) ; emit8 ( jit , 0x56 ) ;                                    // push rdi ; push rsi
+    emit8 ( jit , 0x48 ) ; emit8 ( jit , 0x83 ) ; emit8 ( jit , 0xEC ) ; emit8 ( jit , 8 ) ; // sub rsp, 8 (16-byte aligned call)
+    emit8 ( jit , 0xBE ) ; emit32 ( jit , a ) ;                                      // mov esi, a
+    emit8 ( jit , 0xBA ) ; emit32 ( jit , b ) ;                                      // mov edx, b
+    emit8 ( jit , 0xB9 ) ; emit32 ( jit , c ) ;                                      // mov ecx, c
+    emit8 ( jit , 0x41 ) ; emit8 ( jit , 0xB8 ) ; emit32 ( jit , d ) ;              // mov r8d, d
+    emit8 ( jit , 0x48 ) ; emit8 ( jit , 0xB8 ) ; emit32 ( jit , (uint32_t)fn ) ; emit32 ( jit , (uint32_t)( fn >> 32 ) ) ; // mov rax, fn
+    emit8 ( jit , 0xFF ) ; emit8 ( jit , 0xD0 ) ;                                    // call rax
+    emit8 ( jit , 0x48 ) ; emit8 ( jit , 0x83 ) ; emit8 ( jit , 0xC4 ) ; emit8 ( jit , 8 ) ; // add rsp, 8
+    emit8 ( jit , 0x5E ) ; emit8 ( jit , 0x5F ) ;                                    // pop rsi ; pop rdi
+}
+
+// Leave the block for `target`: jump straight into its native code when
+// it exists, otherwise return to the dispatcher and remember the stub so
+// it can be linked once the target is compiled
+static void emit_exit ( jit_t *jit , uint16_t target ) {
+    if ( target > ADDRESS_MASK ) {
+        // Ran off the end of memory: blocks store absolute addresses, so the dispatcher runs it
+        emit_return ( jit ) ;
+        return ;
+    }
+    const jit_block_t *next = &jit->blocks[target] ;
+    const size_t stub = jit->used ;
+
+    if ( next->state == BLOCK_NATIVE ) {
+        emit8 ( jit , 0xE9 ) ; emit32 ( jit , next->entry - (uint32_t)(stub + EXIT_STUB_SIZE) ) ; // jmp rel32
+        return ;
+    }
+    emit_return ( jit ) ;
+    emit8 ( jit , 0x90 ) ; emit8 ( jit , 0x90 ) ; // room for a jmp rel32
+    if ( next->state == BLOCK_UNCOMPILED && jit->link_count < JIT_MAX_PENDING_LINKS ) {
+        jit->links[jit->link_count++] = (jit_link_t) { .stub = (uint32_t)stub , .target = target } ;
+    }
+}
+
+// Patch pending exit stubs that lead to the block just compiled at address
+static void link_block ( jit_t *jit , uint16_t address ) {
+    const jit_block_t *block = &jit->blocks[address] ;
+
+    for ( uint32_t i = 0 ; i < jit->link_count ; ) {
+        if ( jit->links[i].target != address ) {
+            i++ ;
+            continue ;
+        }
+        if ( block->state == BLOCK_NATIVE ) {
+            const uint32_t stub = jit->links[i].stub ;
+            jit->code[stub] = 0xE9 ;
+            patch32 ( jit , stub + 1 , block->entry - (stub + EXIT_STUB_SIZE) ) ;
+        }
+        jit->links[i] = jit->links[--jit->link_count] ;
+    }
+}
+
+// Block tail for a skip whose condition is already in the flags: the
+// jcc is taken when the next instruction must not be skipped
+static void emit_skip_tail ( jit_t *jit , uint8_t jcc_no_skip , uint16_t next ) {
+    emit8 ( jit , jcc_no_skip ) ; emit8 ( jit , 0 ) ;
+    const size_t patch = jit->used - 1 ;
+    emit_set_pc ( jit , next + 2 ) ;
+    emit_exit ( jit , next + 2 ) ;
+    jit->code[patch] = (uint8_t)( jit->used - patch - 1 ) ; // rel8 to the no-skip exit
+    emit_set_pc ( jit , next ) ;
+    emit_exit ( jit , next ) ;
+}
+
+// Helpers native code calls (4K address space, as the JIT only runs 4K profiles)
+
+// DXYN: VF = collision
+static void jit_draw ( chip8_t *chip8 , uint32_t x , uint32_t y , uint32_t n , uint32_t clip ) {
+    chip8->V[0xF] = display_draw ( chip8->display , chip8->hires , chip8->plane_mask , chip8->memory , ADDRESS_MASK ,
+                                   chip8->I , chip8->V[x] , chip8->V[y] , (uint8_t)n , clip ) ;
+}
+
+// FX33 and FX55 write memory, then drop the cached code they overwrote.
+// True when that flushed the JIT: the calling block is gone with the rest
+// (nothing is compiled before it returns, so its code is still intact).
+static bool jit_store_bcd ( chip8_t *chip8 , uint32_t x ) {
+    const uint8_t value = chip8->V[x] ;
+    chip8->memory[chip8->I & ADDRESS_MASK] = value / 100 ;
+    chip8->memory[(chip8->I + 1) & ADDRESS_MASK] = (value / 10) % 10 ;
+    chip8->memory[(chip8->I + 2) & ADDRESS_MASK] = value % 10 ;
+    invalidate_decoded ( chip8 , chip8->I , 3 ) ;
+    return chip8->jit->used == 0 ;
+}
+
+// `step` is what the index quirk adds to I
+static bool jit_store_registers ( chip8_t *chip8 , uint32_t last , uint32_t step ) {
+    for ( uint32_t i = 0 ; i <= last ; i++ ) chip8->memory[(chip8->I + i) & ADDRESS_MASK] = chip8->V[i] ;
+    invalidate_decoded ( chip8 , chip8->I , (uint16_t)( last + 1 ) ) ;
+    chip8->I += step ;
+    return chip8->jit->used == 0 ;
+}
+
+// FX33 or FX55 in the middle of a block: call its helper and leave for
+// `next` only when that flushed the JIT. Returns where to patch in the
+// instructions of the block still to run, which go back into the budget.
+static size_t emit_store ( jit_t *jit , const decoded_inst_t *d , const quirk_set_t *quirks , uint16_t next ) {
+    const uint32_t step = quirks->index == INDEX_UNCHANGED ? 0 : d->X + ( quirks->index == INDEX_PAST_LAST ) ;
+    if ( d->op == OP_LD_B_VX ) emit_call ( jit , HELPER ( jit_store_bcd ) , d->X , 0 , 0 , 0 ) ;
+    else emit_call ( jit , HELPER ( jit_store_registers ) , d->X , step , 0 , 0 ) ;
+    emit8 ( jit , 0x84 ) ; emit8 ( jit , 0xC0 ) ;                                                    // test al, al
+    emit8 ( jit , JE ) ; emit8 ( jit , 0 ) ;                                                          // JIT still there: go on
+    const size_t skip = jit->used - 1 ;
+    emit_set_pc ( jit , next ) ;
+    emit8 ( jit , 0x8D ) ; emit8 ( jit , 0x86 ) ; emit32 ( jit , 0 ) ;                                // lea eax, [rsi + not run]
+    const size_t refund = jit->used - 4 ;
+    emit8 ( jit , 0xC3 ) ;                                                                            // ret
+    jit->code[skip] = (uint8_t)( jit->used - skip - 1 ) ;
+    return refund ;
+}
+
+// Emit one of the instructions that end a block together with the block
+// exit, false if it is not supported. `next` is the address after it.
+static bool emit_terminator ( jit_t *jit , const decoded_inst_t *d , const quirk_set_t *quirks , uint16_t next ) {
+    switch ( d->op ) {
+        case OP_JP :
+            emit_set_pc ( jit , d->NNN ) ;
+            emit_exit ( jit , d->NNN ) ;
+            return true ;
+        case OP_CALL :
+            // sp goes through a register, not inc/dec on memory, to keep call/return chains short
+            emit_load8_zx ( jit , OFF_SP ) ;                                                          // movzx eax, byte [sp]
+            emit8 ( jit , 0x8D ) ; emit8 ( jit , 0x48 ) ; emit8 ( jit , 1 ) ;                        // lea ecx, [rax + 1]
+            emit_store8 ( jit , ECX , OFF_SP ) ;                                                      // mov [sp], cl
+            emit8 ( jit , 0x83 ) ; emit8 ( jit , 0xE0 ) ; emit8 ( jit , CHIP8_STACK_SIZE - 1 ) ;     // and eax, 15
+            emit8 ( jit , 0x66 ) ; emit8 ( jit , 0xC7 ) ; emit_rdi_rax2_operand ( jit , 0 , OFF_STACK ) ; emit16 ( jit , next ) ; // mov word [stack + rax*2], next
+            emit_set_pc ( jit , d->NNN ) ;
+            emit_exit ( jit , d->NNN ) ;
+            return true ;
+        case OP_RET :
+            emit_load8_zx ( jit , OFF_SP ) ;                                                          // movzx eax, byte [sp]
+            emit8 ( jit , 0x83 ) ; emit8 ( jit , 0xE8 ) ; emit8 ( jit , 1 ) ;                        // sub eax, 1
+            emit_store8 ( jit , EAX , OFF_SP ) ;                                                      // mov [sp], al
+            emit8 ( jit , 0x83 ) ; emit8 ( jit , 0xE0 ) ; emit8 ( jit , CHIP8_STACK_SIZE - 1 ) ;     // and eax, 15
+            emit8 ( jit , 0x0F ) ; emit8 ( jit , 0xB7 ) ; emit_rdi_rax2_operand ( jit , ECX , OFF_STACK ) ; // movzx ecx, word [stack + rax*2]
+            emit8 ( jit , 0x66 ) ; emit8 ( jit , 0x89 ) ; emit_rdi_operand ( jit , ECX , OFF_PC ) ;  // mov [pc], cx
+            emit_jump_to_pc ( jit ) ;
+            return true ;
+        case OP_DRW :
+            // Only reached with display_wait: the rest of the frame waits for the vertical blank
+            emit_call ( jit , HELPER ( jit_draw ) , d->X , d->Y , d->N , quirks->clip ) ;
+            emit_set_pc ( jit , next ) ;
+            emit8 ( jit , 0x31 ) ; emit8 ( jit , 0xC0 ) ; emit8 ( jit , 0xC3 ) ;                    // xor eax, eax ; ret
+            return true ;
+        case OP_SE_VX_NN :
+        case OP_SNE_VX_NN :
+            emit8 ( jit , 0x80 ) ; emit_rdi_operand ( jit , 7 , OFF_V(d->X) ) ; emit8 ( jit , d->NN ) ; // cmp byte [V[X]], NN
+            emit_skip_tail ( jit , d->op == OP_SE_VX_NN ? JNE : JE , next ) ;
+            return true ;
+        case OP_SE_VX_VY :
+        case OP_SNE_VX_VY :
+            emit_load8 ( jit , EAX , OFF_V(d->X) ) ;
+            emit8 ( jit , 0x3A ) ; emit_rdi_operand ( jit , EAX , OFF_V(d->Y) ) ; // cmp al, [V[Y]]
+            emit_skip_tail ( jit , d->op == OP_SE_VX_VY ? JNE : JE , next ) ;
+            return true ;
+        case OP_SKP :
+        case OP_SKNP :
+            emit_load8_zx ( jit , OFF_V(d->X) ) ;
+            emit8 ( jit , 0x83 ) ; emit8 ( jit , 0xE0 ) ; emit8 ( jit , 0x0F ) ;      // and eax, 0xF
+            emit8 ( jit , 0x80 ) ; emit8 ( jit , 0xBC ) ; emit8 ( jit , 0x07 ) ;      // cmp byte [rdi + rax + keypad], 0
+            emit32 ( jit , (uint32_t)OFF_KEYPAD ) ; emit8 ( jit , 0 ) ;
+            emit_skip_tail ( jit , d->op == OP_SKP ? JE : JNE , next ) ;
+            return true ;
+        default :
+            return false ;
+    }
+}
+
+// Emit native code for one straight-line instruction with the given quirks,
+// false if it cannot be compiled
+static bool emit_instruction ( jit_t *jit , const decoded_inst_t *d , const quirk_set_t *quirks ) {
+    switch ( d->op ) {
+        case OP_NOP :
+            return true ;
+        case OP_LD_VX_NN :
+            emit_store_imm8 ( jit , OFF_V(d->X) , d->NN ) ;
+            return true ;
+        case OP_ADD_VX_NN :
+            emit8 ( jit , 0x80 ) ; emit_rdi_operand ( jit , 0 , OFF_V(d->X) ) ; emit8 ( jit , d->NN ) ; // add byte [V[X]], NN
+            return true ;
+        case OP_LD_VX_VY :
+            emit_load8 ( jit , EAX , OFF_V(d->Y) ) ;
+            emit_store8 ( jit , EAX , OFF_V(d->X) ) ;
+            return true ;
+        case OP_OR :
+        case OP_AND :
+        case OP_XOR : {
+            static const uint8_t alu[] = { [OP_OR] = 0x08 , [OP_AND] = 0x20 , [OP_XOR] = 0x30 } ;
+            emit_load8 ( jit , EAX , OFF_V(d->Y) ) ;
+            emit8 ( jit , alu[d->op] ) ; emit_rdi_operand ( jit , EAX , OFF_V(d->X) ) ; // op [V[X]], al
+            if ( d->op == OP_AND ? quirks->vf_reset_and : quirks->vf_reset_or_xor ) emit_store_imm8 ( jit , OFF_V(0xF) , 0 ) ;
+            return true ;
+        }
+        case OP_ADD_VX_VY :
+            emit_load8 ( jit , EAX , OFF_V(d->X) ) ;
+            emit8 ( jit , 0x02 ) ; emit_rdi_operand ( jit , EAX , OFF_V(d->Y) ) ; // add al, [V[Y]]
+            emit_setc_cl ( jit ) ;
+            emit_store_result_and_flag ( jit , d->X ) ;
+            return true ;
+        case OP_SUB :
+            emit_load8 ( jit , EAX , OFF_V(d->X) ) ;
+            emit8 ( jit , 0x2A ) ; emit_rdi_operand ( jit , EAX , OFF_V(d->Y) ) ; // sub al, [V[Y]]
+            emit_setnc_cl ( jit ) ;
+            emit_store_result_and_flag ( jit , d->X ) ;
+            return true ;
+        case OP_SUBN :
+            emit_load8 ( jit , EAX , OFF_V(d->Y) ) ;
+            emit8 ( jit , 0x2A ) ; emit_rdi_operand ( jit , EAX , OFF_V(d->X) ) ; // sub al, [V[X]]
+            emit_setnc_cl ( jit ) ;
+            emit_store_result_and_flag ( jit , d->X ) ;
+            return true ;
+        case OP_SHR :
+        case OP_SHL :
+            emit_load8 ( jit , EAX , OFF_V(quirks->shift_vy ? d->Y : d->X) ) ;
+            emit8 ( jit , 0xD0 ) ; emit8 ( jit , d->op == OP_SHR ? 0xE8 : 0xE0 ) ; // shr/shl al, 1
+            emit_setc_cl ( jit ) ;
+            emit_store_result_and_flag ( jit , d->X ) ;
+            return true ;
+        case OP_LD_I :
+            emit8 ( jit , 0x66 ) ; emit8 ( jit , 0xC7 ) ; emit_rdi_operand ( jit , 0 , OFF_I ) ; emit16 ( jit , d->NNN ) ;
+            return true ;
+        case OP_ADD_I_VX :
+            emit_load8_zx ( jit , OFF_V(d->X) ) ;
+            emit8 ( jit , 0x66 ) ; emit8 ( jit , 0x01 ) ; emit_rdi_operand ( jit , EAX , OFF_I ) ; // add [I], ax
+            return true ;
+        case OP_LD_F_VX :
+            emit_load8_zx ( jit , OFF_V(d->X) ) ;
+            emit8 ( jit , 0x6B ) ; emit8 ( jit , 0xC0 ) ; emit8 ( jit , 5 ) ; // imul eax, eax, 5
+            emit8 ( jit , 0x66 ) ; emit8 ( jit , 0x89 ) ; emit_rdi_operand ( jit , EAX , OFF_I ) ; // mov [I], ax
+            return true ;
+        case OP_LD_VX_DT :
+            emit_load8 ( jit , EAX , OFF_DT ) ;
+            emit_store8 ( jit , EAX , OFF_V(d->X) ) ;
+            return true ;
+        case OP_LD_DT_VX :
+        case OP_LD_ST_VX :
+            emit_load8 ( jit , EAX , OFF_V(d->X) ) ;
+            emit_store8 ( jit , EAX , d->op == OP_LD_DT_VX ? OFF_DT : OFF_ST ) ;
+            return true ;
+        case OP_LD_VX_MEM :
+            // movzx eax, word [I]
+            emit8 ( jit , 0x0F ) ; emit8 ( jit , 0xB7 ) ; emit_rdi_operand ( jit , EAX , OFF_I ) ;
+            for ( uint8_t i = 0 ; i <= d->X ; i++ ) {
+                emit8 ( jit , 0x8D ) ; emit8 ( jit , 0x90 ) ; emit32 ( jit , i ) ;            // lea edx, [rax + i]
+                emit8 ( jit , 0x81 ) ; emit8 ( jit , 0xE2 ) ; emit32 ( jit , ADDRESS_MASK ) ; // and edx, mask
+                emit8 ( jit , 0x8A ) ; emit8 ( jit , 0x8C ) ; emit8 ( jit , 0x17 ) ;          // mov cl, [rdi + rdx + memory]
+                emit32 ( jit , (uint32_t)OFF_MEM ) ;
+                emit_store8 ( jit , ECX , OFF_V(i) ) ;
+            }
+            if ( quirks->index != INDEX_UNCHANGED ) {
+                // add word [I], X (+ 1)
+                emit8 ( jit , 0x66 ) ; emit8 ( jit , 0x83 ) ; emit_rdi_operand ( jit , 0 , OFF_I ) ;
+                emit8 ( jit , d->X + (quirks->index == INDEX_PAST_LAST) ) ;
+            }
+            return true ;
+        case OP_DRW :
+            // With display_wait it ends the block instead (emit_terminator)
+            if ( quirks->display_wait ) return false ;
+            emit_call ( jit , HELPER ( jit_draw ) , d->X , d->Y , d->N , quirks->clip ) ;
+            return true ;
+        default :
+            // FX0A, RNG, scrolling and the other rare ones stay on the interpreter
+            return false ;
+    }
+}
+
+// Could the jump at `address` to `target` close an idle loop? skip_idle_loop
+// follows the path the registers take (a skip may step over a call), so only
+// the head is known here: a loop starting with anything else is never idle
+static bool idle_back_edge ( chip8_t *chip8 , uint16_t address , uint16_t target ) {
+    return !chip8->idle_skip_off && target <= address && idle_instruction ( fetch_decoded ( chip8 , target )->op ) ;
+}
+
+// Mark the two bytes of the instruction at address as compiled
+static void cover ( jit_t *jit , uint16_t address ) {
+    for ( uint16_t i = 0 ; i < 2 ; i++ ) {
+        const uint16_t byte = ( address + i ) & ADDRESS_MASK ;
+        jit->covered[byte] = true ;
+        if ( jit->covered_start == jit->covered_end ) {
+            jit->covered_start = byte ;
+            jit->covered_end = byte + 1 ;
+        }
+        if ( byte < jit->covered_start ) jit->covered_start = byte ;
+        if ( byte >= jit->covered_end ) jit->covered_end = byte + 1 ;
+    }
+}
+
+// Translate the block starting at address
+static void compile_block ( chip8_t *chip8 , jit_t *jit , uint16_t address ) {
+    const size_t worst_case = JIT_MAX_BLOCK_INSTRUCTIONS * JIT_MAX_INSTRUCTION_BYTES + 64 ;
+    if ( jit->used + worst_case > JIT_CODE_SIZE ) jit_flush ( jit ) ;
+
+    jit_block_t *block = &jit->blocks[address & ADDRESS_MASK] ;
+    const size_t start = jit->used ;
+
+    // cmp esi, count ; jae body ; mov eax, esi ; ret ; body: sub esi, count
+    emit8 ( jit , 0x81 ) ; emit8 ( jit , 0xFE ) ; emit32 ( jit , 0 ) ;
+    const size_t count_patch_cmp = jit->used - 4 ;
+    emit8 ( jit , 0x73 ) ; emit8 ( jit , 3 ) ;
+    emit_return ( jit ) ;
+    emit8 ( jit , 0x81 ) ; emit8 ( jit , 0xEE ) ; emit32 ( jit , 0 ) ;
+    const size_t count_patch_sub = jit->used - 4 ;
+
+    // Early exits after FX33/FX55, patched once the block length is known
+    struct { size_t patch ; uint16_t done ; } refunds[JIT_MAX_BLOCK_INSTRUCTIONS] ;
+    uint32_t refund_count = 0 ;
+
+    uint16_t count = 0 ;
+    bool terminated = false ;
+    while ( count < JIT_MAX_BLOCK_INSTRUCTIONS && !terminated ) {
+        const uint16_t pc = address + 2 * count ;
+        const decoded_inst_t *d = fetch_decoded ( chip8 , pc ) ;
+        if ( d->op == OP_JP && idle_back_edge ( chip8 , pc , d->NNN ) ) {
+            // Return to the dispatcher instead of chaining, so it can check for whole iterations to skip
+            jit->blocks[d->NNN & ADDRESS_MASK].idle_loop = true ;
+            emit_set_pc ( jit , d->NNN ) ;
+            emit_return ( jit ) ;
+            terminated = true ;
+        }
+        else if ( d->op == OP_LD_B_VX || d->op == OP_LD_MEM_VX ) {
+            refunds[refund_count].patch = emit_store ( jit , d , chip8_quirk_set ( chip8->quirks ) , pc + 2 ) ;
+            refunds[refund_count++].done = count + 1 ;
+        }
+        else if ( !emit_instruction ( jit , d , chip8_quirk_set ( chip8->quirks ) ) ) {
+            terminated = emit_terminator ( jit , d , chip8_quirk_set ( chip8->quirks ) , pc + 2 ) ;
+            if ( !terminated ) break ;
+        }
+        cover ( jit , pc ) ;
+        count++ ;
+    }
+
+    if ( count == 0 ) {
+        // Covered too, so code written over the slot gets compiled again
+        cover ( jit , address ) ;
+        jit->used = start ;
+        block->state = BLOCK_INTERPRETED ;
+        link_block ( jit , address & ADDRESS_MASK ) ;
+        return ;
+    }
+    patch32 ( jit , count_patch_cmp , count ) ;
+    patch32 ( jit , count_patch_sub , count ) ;
+    for ( uint32_t i = 0 ; i < refund_count ; i++ ) patch32 ( jit , refunds[i].patch , count - refunds[i].done ) ;
+
+    // Mark the block native before emitting its fall-through exit so a
+    // block that runs into itself links directly
+    void *entry = jit->code + start ;
+    memcpy ( &block->fn , &entry , sizeof block->fn ) ; // object to function pointer without a cast warning
+    block->entry = (uint32_t)start ;
+    block->count = count ;
+    block->state = BLOCK_NATIVE ;
+
+    if ( !terminated ) {
+        emit_set_pc ( jit , address + 2 * count ) ;
+        emit_exit ( jit , address + 2 * count ) ;
+    }
+    link_block ( jit , address & ADDRESS_MASK ) ;
+}
+
+bool jit_available ( void ) {
+    return true ;
+}
+
+bool jit_enable ( chip8_t *chip8 ) {
+    if ( chip8->jit ) return true ;
+
+    jit_t *jit = calloc ( 1 , sizeof ( jit_t ) ) ;
+    if ( !jit ) return false ;
+    jit->code = mmap ( NULL , JIT_CODE_SIZE , PROT_READ | PROT_WRITE | PROT_EXEC , MAP_PRIVATE | MAP_ANONYMOUS , -1 , 0 ) ;
+    if ( jit->code == MAP_FAILED ) {
+        free ( jit ) ;
+        return false ;
+    }
+    chip8->jit = jit ;
+    return true ;
+}
+
+void jit_disable ( chip8_t *chip8 ) {
+    if ( !chip8->jit ) return ;
+    munmap ( chip8->jit->code , JIT_CODE_SIZE ) ;
+    free ( chip8->jit ) ;
+    chip8->jit = NULL ;
+}
+
+// Drop every compiled block (links between blocks go with them)
+void jit_flush ( jit_t *jit ) {
+    jit->used = 0 ;
+    jit->link_count = 0 ;
+    memset ( jit->blocks , 0 , sizeof ( jit->blocks ) ) ;
+    memset ( jit->covered , 0 , sizeof ( jit->covered ) ) ;
+    jit->covered_start = jit->covered_end = 0 ;
+}
+
+// Memory in [address, address + length) changed: drop blocks built from it
+void jit_invalidate ( jit_t *jit , uint16_t address , uint16_t length ) {
+    // Most writes are to data, away from any code: skip the byte by byte check
+    const uint32_t start = address & ADDRESS_MASK ;
+    if ( start + length <= CHIP8_MEMORY_SIZE && ( start >= jit->covered_end || start + length <= jit->covered_start ) ) return ;
+    for ( uint32_t i = 0 ; i < length ; i++ ) {
+        if ( jit->covered[(address + i) & ADDRESS_MASK] ) {
+            // Writes into code are rare enough that a full flush is cheaper than tracking owners
+            jit_flush ( jit ) ;
+            return ;
+        }
+    }
+}
+
+void jit_prewarm ( chip8_t *chip8 , uint16_t address ) {
+    if ( chip8->jit->blocks[address & ADDRESS_MASK].state == BLOCK_UNCOMPILED ) compile_block ( chip8 , chip8->jit , address ) ;
+}
+
+uint32_t jit_run ( chip8_t *chip8 , uint32_t cycles ) {
+    jit_t *jit = chip8->jit ;
+    uint32_t remaining = cycles ;
+
+    while ( remaining > 0 ) {
+        jit_block_t *block = &jit->blocks[chip8->pc & ADDRESS_MASK] ;
+        // A pc past the end of memory wraps around on the interpreter; blocks
+        // store absolute addresses, so they only run from the unwrapped one
+        const bool wrapped = chip8->pc > ADDRESS_MASK ;
+        if ( block->state == BLOCK_UNCOMPILED && !wrapped ) compile_block ( chip8 , jit , chip8->pc ) ;
+
+        if ( block->idle_loop && remaining >= IDLE_MIN_REMAINING ) {
+            remaining = skip_idle_loop ( chip8 , chip8->pc , remaining ) ;
+            if ( remaining == 0 ) break ; // Whole iterations used the budget up, pc is back at the head
+        }
+
+        if ( block->state == BLOCK_NATIVE && !wrapped ) {
+            if ( block->count > remaining ) {
+                // Not enough budget for the whole block, finish instruction by instruction
+                return cycles - remaining + run_interpreter ( chip8 , remaining ) ;
+            }
+            remaining = block->fn ( chip8 , remaining ) ;
+            continue ;
+        }
+        // An instruction the compiler leaves to the interpreter
+        const uint16_t pc = chip8->pc ;
+        remaining -= run_interpreter ( chip8 , 1 ) ;
+        // FX0A with no key down repeats itself until the keypad changes between calls,
+        // DXYN may end the frame (code written over an interpreted slot can become one),
+        // 00FD stops the machine where it is
+        const uint8_t op = chip8->decoded[pc & ADDRESS_MASK].op ; // The JIT never runs XO-CHIP
+        if ( chip8->pc == pc && op == OP_LD_VX_K ) remaining = 0 ;
+        if ( op == OP_DRW && chip8_quirk_set ( chip8->quirks )->display_wait ) remaining = 0 ;
+        if ( op == OP_EXIT ) break ;
+    }
+    return cycles - remaining ;
+}
+
+#else // !JIT_SUPPORTED
+
+bool jit_available ( void ) { return false ; }
+bool jit_enable ( chip8_t *chip8 ) { (void)chip8 ; return false ; }
+void jit_disable ( chip8_t *chip8 ) { (void)chip8 ; }
+void jit_flush ( jit_t *jit ) { (void)jit ; }
+void jit_invalidate ( jit_t *jit , uint16_t address , uint16_t length ) { (void)jit ; (void)address ; (void)length ; }
+uint32_t jit_run ( chip8_t *chip8 , uint32_t cycles ) { return run_interpreter ( chip8 , cycles ) ; }
+void jit_prewarm ( chip8_t *chip8 , uint16_t address ) { (void)chip8 ; (void)address ; }
+
+#endif // JIT_SUPPORTED
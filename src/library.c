@@ -0,0 +1,449 @@
+/**
+ * @file library.c
+ * @brief ROM Library Index and Per-ROM Settings
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * Keeps the index described in library.h in memory with two open-addressing
+ * tables, one by content hash (startup lookups) and one by path (rescans).
+ * A rescan stats every file and only maps and hashes the ones whose size or
+ * mtime differ from the index, so re-indexing a large collection that has
+ * not changed reads no ROM data at all.
+ */
+#define _POSIX_C_SOURCE 200809L // mmap, strdup
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "library.h"
+
+#define LIBRARY_LINE_MAX 4096
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+static uint64_t fnv1a ( const uint8_t *data , size_t size ) {
+    uint64_t hash = FNV_OFFSET_BASIS ;
+    for ( size_t i = 0 ; i < size ; i++ ) {
+        hash ^= data[i] ;
+        hash *= FNV_PRIME ;
+    }
+    return hash ;
+}
+
+static uint64_t path_key ( const char *path ) {
+    return fnv1a ( (const uint8_t *)path , strlen ( path ) ) ;
+}
+
+// ---------------------------------------------------------------------------
+// Hash tables
+
+// Slot holding `hash` or the empty slot where it would go
+static size_t hash_slot ( const library_t *library , uint64_t hash ) {
+    size_t slot = (size_t)hash & (library->slots - 1) ;
+    while ( library->by_hash[slot] && library->entries[library->by_hash[slot] - 1].hash != hash ) {
+        slot = (slot + 1) & (library->slots - 1) ;
+    }
+    return slot ;
+}
+
+static size_t path_slot ( const library_t *library , const char *path ) {
+    size_t slot = (size_t)path_key ( path ) & (library->slots - 1) ;
+    while ( library->by_path[slot] && strcmp ( library->entries[library->by_path[slot] - 1].path , path ) != 0 ) {
+        slot = (slot + 1) & (library->slots - 1) ;
+    }
+    return slot ;
+}
+
+// Rebuild both tables at twice the entry capacity, so they stay at most half full
+static bool rehash ( library_t *library ) {
+    size_t slots = 64 ;
+    while ( slots < 2 * library->capacity ) slots *= 2 ;
+    uint32_t *by_hash = calloc ( slots , sizeof ( uint32_t ) ) ;
+    uint32_t *by_path = calloc ( slots , sizeof ( uint32_t ) ) ;
+    if ( !by_hash || !by_path ) {
+        free ( by_hash ) ;
+        free ( by_path ) ;
+        return false ;
+    }
+    free ( library->by_hash ) ;
+    free ( library->by_path ) ;
+    library->by_hash = by_hash ;
+    library->by_path = by_path ;
+    library->slots = slots ;
+    for ( size_t i = 0 ; i < library->count ; i++ ) {
+        library->by_hash[hash_slot ( library , library->entries[i].hash )] = (uint32_t)( i + 1 ) ;
+        library->by_path[path_slot ( library , library->entries[i].path )] = (uint32_t)( i + 1 ) ;
+    }
+    return true ;
+}
+
+// Takes ownership of the entry's strings
+static library_entry_t *add_entry ( library_t *library , const library_entry_t *entry ) {
+    if ( library->count == library->capacity ) {
+        const size_t capacity = library->capacity ? library->capacity * 2 : 64 ;
+        library_entry_t *grown = realloc ( library->entries , capacity * sizeof ( library_entry_t ) ) ;
+        if ( !grown ) return NULL ;
+        library->entries = grown ;
+        library->capacity = capacity ;
+        if ( !rehash ( library ) ) return NULL ;
+    }
+    library->entries[library->count] = *entry ;
+    const uint32_t index = (uint32_t)++library->count ;
+    library->by_hash[hash_slot ( library , entry->hash )] = index ;
+    library->by_path[path_slot ( library , entry->path )] = index ;
+    return &library->entries[index - 1] ;
+}
+
+// Point an entry at a new path. Moves are rare, so the tables are simply
+// rebuilt rather than deleting from the open addressing.
+static bool move_entry ( library_t *library , library_entry_t *entry , const char *path ) {
+    if ( strcmp ( entry->path , path ) == 0 ) return true ;
+    char *copy = strdup ( path ) ;
+    if ( !copy ) return false ;
+    free ( entry->path ) ;
+    entry->path = copy ;
+    return rehash ( library ) ;
+}
+
+// Drop an entry, keeping the others in index order; as rare as moves
+static bool remove_entry ( library_t *library , library_entry_t *entry ) {
+    free ( entry->path ) ;
+    free ( entry->title ) ;
+    const size_t index = (size_t)( entry - library->entries ) ;
+    memmove ( entry , entry + 1 , ( library->count - index - 1 ) * sizeof ( library_entry_t ) ) ;
+    library->count-- ;
+    return rehash ( library ) ;
+}
+
+library_entry_t *library_find ( const library_t *library , uint64_t hash ) {
+    if ( library->count == 0 ) return NULL ;
+    const uint32_t index = library->by_hash[hash_slot ( library , hash )] ;
+    return index ? &library->entries[index - 1] : NULL ;
+}
+
+static library_entry_t *find_path ( const library_t *library , const char *path ) {
+    if ( library->count == 0 ) return NULL ;
+    const uint32_t index = library->by_path[path_slot ( library , path )] ;
+    return index ? &library->entries[index - 1] : NULL ;
+}
+
+// ---------------------------------------------------------------------------
+// Settings
+
+bool library_parse_keymap ( const char *text , uint8_t keymap[16] ) {
+    if ( strlen ( text ) != 16 ) return false ;
+    for ( int i = 0 ; i < 16 ; i++ ) {
+        char digit[2] = { text[i] , '\0' } ;
+        char *end ;
+        const unsigned long key = strtoul ( digit , &end , 16 ) ;
+        if ( *end != '\0' || end == digit ) return false ;
+        keymap[i] = (uint8_t)key ;
+    }
+    return true ;
+}
+
+bool library_set ( library_entry_t *entry , const char *setting ) {
+    const char *value = strchr ( setting , '=' ) ;
+    if ( !value ) {
+        CHIP8_LOG ( "Expected key=value, got %s\n" , setting ) ;
+        return false ;
+    }
+    const size_t length = (size_t)( value++ - setting ) ;
+    const bool reset = strcmp ( value , "-" ) == 0 ;
+    if ( length == 5 && strncmp ( setting , "title" , 5 ) == 0 ) {
+        if ( !*value || strpbrk ( value , "\t\n" ) ) {
+            CHIP8_LOG ( "Titles cannot be empty or contain tabs or newlines\n" ) ;
+            return false ;
+        }
+        char *title = strdup ( value ) ;
+        if ( !title ) return false ;
+        free ( entry->title ) ;
+        entry->title = title ;
+        return true ;
+    }
+    if ( length == 6 && strncmp ( setting , "quirks" , 6 ) == 0 ) {
+        if ( reset ) entry->quirks = QUIRKS_AUTO ;
+        return reset || chip8_parse_quirks ( value , &entry->quirks ) ;
+    }
+    if ( length == 3 && strncmp ( setting , "ips" , 3 ) == 0 ) {
+        entry->ips = reset ? 0 : (uint32_t)strtoul ( value , NULL , 10 ) ;
+        return true ;
+    }
+    if ( length == 4 && strncmp ( setting , "keys" , 4 ) == 0 ) {
+        entry->has_keymap = !reset ;
+        if ( reset || library_parse_keymap ( value , entry->keymap ) ) return true ;
+        CHIP8_LOG ( "Keymap %s is not 16 hex digits\n" , value ) ;
+        return false ;
+    }
+    CHIP8_LOG ( "Unknown setting %.*s (title, quirks, ips or keys)\n" , (int)length , setting ) ;
+    return false ;
+}
+
+void library_apply ( const library_entry_t *entry , config_t *config , quirks_t *quirks ) {
+    if ( entry->quirks != QUIRKS_AUTO && *quirks == QUIRKS_AUTO ) *quirks = entry->quirks ;
+    if ( entry->ips ) config->instructions_per_second = entry->ips ;
+    if ( entry->has_keymap ) memcpy ( config->keymap , entry->keymap , sizeof ( config->keymap ) ) ;
+}
+
+// ---------------------------------------------------------------------------
+// Index file
+
+static char *next_field ( char **cursor ) {
+    char *field = *cursor ;
+    if ( !field ) return NULL ;
+    char *tab = strchr ( field , '\t' ) ;
+    if ( tab ) *tab++ = '\0' ;
+    *cursor = tab ;
+    return field ;
+}
+
+bool library_load ( library_t *library , const char *path ) {
+    memset ( library , 0 , sizeof ( library_t ) ) ;
+    FILE *file = fopen ( path , "r" ) ;
+    if ( !file ) return true ; // Nothing indexed yet
+
+    char line[LIBRARY_LINE_MAX] ;
+    uint32_t line_number = 0 ;
+    bool ok = true ;
+    while ( ok && fgets ( line , sizeof ( line ) , file ) ) {
+        line_number++ ;
+        line[strcspn ( line , "\r\n" )] = '\0' ;
+        if ( line[0] == '#' || line[0] == '\0' ) continue ;
+
+        char *cursor = line ;
+        char *fields[8] ;
+        int count = 0 ;
+        while ( count < 8 && ( fields[count] = next_field ( &cursor ) ) ) count++ ;
+        library_entry_t entry = { .hash = strtoull ( count > 0 ? fields[0] : "" , NULL , 16 ) } ;
+        if ( count != 8 || library_find ( library , entry.hash ) ) {
+            CHIP8_LOG ( "%s:%u: %s\n" , path , line_number , count != 8 ? "expected 8 tab-separated fields" : "duplicate hash" ) ;
+            ok = false ;
+            break ;
+        }
+        entry.size = strtoull ( fields[1] , NULL , 10 ) ;
+        entry.mtime = strtoll ( fields[2] , NULL , 10 ) ;
+        entry.path = strdup ( fields[7] ) ;
+        entry.title = strdup ( fields[6] ) ;
+        ok = entry.path && entry.title ;
+        if ( ok && strcmp ( fields[3] , "-" ) != 0 ) ok = chip8_parse_quirks ( fields[3] , &entry.quirks ) ;
+        if ( ok && strcmp ( fields[4] , "-" ) != 0 ) entry.ips = strtoul ( fields[4] , NULL , 10 ) ;
+        if ( ok && strcmp ( fields[5] , "-" ) != 0 ) ok = entry.has_keymap = library_parse_keymap ( fields[5] , entry.keymap ) ;
+        if ( ok ) ok = add_entry ( library , &entry ) != NULL ;
+        if ( !ok ) {
+            CHIP8_LOG ( "%s:%u: invalid entry\n" , path , line_number ) ;
+            free ( entry.path ) ;
+            free ( entry.title ) ;
+        }
+    }
+    fclose ( file ) ;
+    if ( !ok ) library_free ( library ) ;
+    return ok ;
+}
+
+// Written through a temporary file, like save states
+bool library_save ( const library_t *library , const char *path ) {
+    char temp[LIBRARY_LINE_MAX] ;
+    snprintf ( temp , sizeof ( temp ) , "%s.tmp" , path ) ;
+    FILE *file = fopen ( temp , "w" ) ;
+    if ( !file ) {
+        CHIP8_LOG ( "Could not open file %s for writing\n" , temp ) ;
+        return false ;
+    }
+    fprintf ( file , "# CHIP-8 ROM library, see library.h. Edit settings with chip8-library set.\n"
+                     "# hash\tsize\tmtime\tquirks\tips\tkeymap\ttitle\tpath\n" ) ;
+    for ( size_t i = 0 ; i < library->count ; i++ ) {
+        const library_entry_t *entry = &library->entries[i] ;
+        char ips[16] = "-" , keymap[17] = "-" ;
+        if ( entry->ips ) snprintf ( ips , sizeof ( ips ) , "%u" , entry->ips ) ;
+        if ( entry->has_keymap ) {
+            for ( int k = 0 ; k < 16 ; k++ ) keymap[k] = "0123456789ABCDEF"[entry->keymap[k] & 0xF] ;
+            keymap[16] = '\0' ;
+        }
+        fprintf ( file , "%016llx\t%llu\t%lld\t%s\t%s\t%s\t%s\t%s\n" , (unsigned long long)entry->hash ,
+                  (unsigned long long)entry->size , (long long)entry->mtime ,
+                  entry->quirks == QUIRKS_AUTO ? "-" : chip8_quirk_set ( entry->quirks )->name ,
+                  ips , keymap , entry->title , entry->path ) ;
+    }
+    if ( fclose ( file ) != 0 ) {
+        CHIP8_LOG ( "Could not write to file %s\n" , temp ) ;
+        remove ( temp ) ;
+        return false ;
+    }
+    if ( rename ( temp , path ) != 0 ) {
+        CHIP8_LOG ( "Could not replace %s\n" , path ) ;
+        remove ( temp ) ;
+        return false ;
+    }
+    return true ;
+}
+
+void library_free ( library_t *library ) {
+    for ( size_t i = 0 ; i < library->count ; i++ ) {
+        free ( library->entries[i].path ) ;
+        free ( library->entries[i].title ) ;
+    }
+    free ( library->entries ) ;
+    free ( library->by_hash ) ;
+    free ( library->by_path ) ;
+    memset ( library , 0 , sizeof ( library_t ) ) ;
+}
+
+// ---------------------------------------------------------------------------
+// Scanning
+
+bool library_hash_file ( const char *path , uint64_t *hash , uint64_t *size , int64_t *mtime ) {
+    const int fd = open ( path , O_RDONLY ) ;
+    struct stat info ;
+    if ( fd < 0 || fstat ( fd , &info ) != 0 ) {
+        CHIP8_LOG ( "Could not open file %s for reading\n" , path ) ;
+        if ( fd >= 0 ) close ( fd ) ;
+        return false ;
+    }
+    *size = (uint64_t)info.st_size ;
+    *mtime = (int64_t)info.st_mtime ;
+    *hash = FNV_OFFSET_BASIS ;
+    if ( info.st_size > 0 ) {
+        void *data = mmap ( NULL , (size_t)info.st_size , PROT_READ , MAP_PRIVATE , fd , 0 ) ;
+        if ( data == MAP_FAILED ) {
+            CHIP8_LOG ( "Could not map %s\n" , path ) ;
+            close ( fd ) ;
+            return false ;
+        }
+        *hash = fnv1a ( data , (size_t)info.st_size ) ;
+        munmap ( data , (size_t)info.st_size ) ;
+    }
+    close ( fd ) ;
+    return true ;
+}
+
+library_entry_t *library_lookup_rom ( const library_t *library , const char *rom_path ) {
+    uint64_t hash , size ;
+    int64_t mtime ;
+    if ( library->count == 0 || !library_hash_file ( rom_path , &hash , &size , &mtime ) ) return NULL ;
+    return library_find ( library , hash ) ;
+}
+
+static bool is_rom ( const char *name ) {
+    static const char *const extensions[] = { ".ch8" , ".c8" , ".sc8" , ".xo8" } ;
+    const char *dot = strrchr ( name , '.' ) ;
+    if ( !dot ) return false ;
+    for ( size_t i = 0 ; i < sizeof ( extensions ) / sizeof ( extensions[0] ) ; i++ ) {
+        if ( strcasecmp ( dot , extensions[i] ) == 0 ) return true ;
+    }
+    return false ;
+}
+
+// The file name without its directory or extension
+static char *default_title ( const char *path ) {
+    const char *slash = strrchr ( path , '/' ) ;
+    const char *name = slash ? slash + 1 : path ;
+    const char *dot = strrchr ( name , '.' ) ;
+    const size_t length = dot && dot != name ? (size_t)( dot - name ) : strlen ( name ) ;
+    char *title = malloc ( length + 1 ) ;
+    if ( title ) {
+        memcpy ( title , name , length ) ;
+        title[length] = '\0' ;
+    }
+    return title ;
+}
+
+static bool scan_file ( library_t *library , const char *path , const struct stat *info , library_scan_t *stats ) {
+    stats->files++ ;
+    library_entry_t *known = find_path ( library , path ) ;
+    if ( known && known->size == (uint64_t)info->st_size && known->mtime == (int64_t)info->st_mtime ) return true ;
+
+    uint64_t hash , size ;
+    int64_t mtime ;
+    if ( !library_hash_file ( path , &hash , &size , &mtime ) ) return false ;
+    stats->hashed++ ;
+    library_entry_t *entry = library_find ( library , hash ) ;
+    if ( known && known != entry ) {
+        if ( !entry ) {
+            // Edited in place: the settings stay with the file
+            known->hash = hash ;
+            known->size = size ;
+            known->mtime = mtime ;
+            return rehash ( library ) ;
+        }
+        // Now holds another indexed ROM: what the entry was for is gone
+        if ( !remove_entry ( library , known ) ) return false ;
+        stats->removed++ ;
+        entry = library_find ( library , hash ) ; // Moved down by the removal
+    }
+    if ( entry ) {
+        // A second copy of an indexed ROM keeps the first one's path; copies
+        // are the only files a rescan reads again without a change
+        struct stat first ;
+        if ( strcmp ( entry->path , path ) != 0 && stat ( entry->path , &first ) == 0 &&
+             (uint64_t)first.st_size == entry->size && (int64_t)first.st_mtime == entry->mtime ) return true ;
+        // Moved or touched: the settings stay with the contents
+        entry->size = size ;
+        entry->mtime = mtime ;
+        return move_entry ( library , entry , path ) ;
+    }
+    library_entry_t added = { .hash = hash , .size = size , .mtime = mtime ,
+                              .path = strdup ( path ) , .title = default_title ( path ) } ;
+    if ( !added.path || !added.title || !add_entry ( library , &added ) ) {
+        free ( added.path ) ;
+        free ( added.title ) ;
+        return false ;
+    }
+    stats->added++ ;
+    return true ;
+}
+
+static bool scan_directory ( library_t *library , const char *directory , library_scan_t *stats ) {
+    DIR *dir = opendir ( directory ) ;
+    if ( !dir ) {
+        CHIP8_LOG ( "Could not open directory %s\n" , directory ) ;
+        return false ;
+    }
+    bool ok = true ;
+    const struct dirent *item ;
+    while ( ok && ( item = readdir ( dir ) ) ) {
+        if ( item->d_name[0] == '.' ) continue ; // ".", ".." and hidden files
+        char path[LIBRARY_LINE_MAX] ;
+        if ( snprintf ( path , sizeof ( path ) , "%s/%s" , directory , item->d_name ) >= (int)sizeof ( path ) ) continue ;
+        struct stat info ;
+        if ( stat ( path , &info ) != 0 ) continue ;
+        if ( S_ISDIR ( info.st_mode ) ) ok = scan_directory ( library , path , stats ) ;
+        else if ( S_ISREG ( info.st_mode ) && is_rom ( item->d_name ) ) ok = scan_file ( library , path , &info , stats ) ;
+    }
+    closedir ( dir ) ;
+    return ok ;
+}
+
+// Drop the entries under root whose file is gone; a ROM moved within root
+// was followed to its new path by the scan
+static bool prune_entries ( library_t *library , const char *root , library_scan_t *stats ) {
+    const size_t length = strlen ( root ) ;
+    size_t kept = 0 ;
+    for ( size_t i = 0 ; i < library->count ; i++ ) {
+        library_entry_t *entry = &library->entries[i] ;
+        struct stat info ;
+        if ( strncmp ( entry->path , root , length ) == 0 && entry->path[length] == '/' && stat ( entry->path , &info ) != 0 ) {
+            free ( entry->path ) ;
+            free ( entry->title ) ;
+            stats->removed++ ;
+            continue ;
+        }
+        library->entries[kept++] = *entry ;
+    }
+    if ( kept == library->count ) return true ;
+    library->count = kept ;
+    return rehash ( library ) ;
+}
+
+bool library_scan ( library_t *library , const char *directory , library_scan_t *stats ) {
+    memset ( stats , 0 , sizeof ( library_scan_t ) ) ;
+    // Paths are stored as given, without a trailing slash
+    char root[LIBRARY_LINE_MAX] ;
+    snprintf ( root , sizeof ( root ) , "%s" , directory ) ;
+    size_t length = strlen ( root ) ;
+    while ( length > 1 && root[length - 1] == '/' ) root[--length] = '\0' ;
+    // An unreadable directory could look like deleted files: only prune after a full scan
+    return scan_directory ( library , root , stats ) && prune_entries ( library , root , stats ) ;
+}
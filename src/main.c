@@ -4,9 +4,13 @@
  * @author Abderrahmane Benchikh
  * @date 2025
  * 
- * Main program that initializes all emulator systems and runs the main 
- * emulation loop at 60 FPS. Handles ROM loading, timing, input processing,
- * and coordinates between all emulator modules.
+ * Main program that initializes all emulator systems and splits the work
+ * over two threads. The emulation thread runs the machine at 60 FPS (frame
+ * pacing lives in scheduler.c) and publishes every frame it would draw
+ * into a triple buffer. The main thread handles the SDL events, passing
+ * them on through input.c, and presents the newest published frame, so a
+ * vsync wait or a driver stall in SDL_RenderPresent never holds up
+ * emulation.
  */
 
 #include "chip8_sdl.h"
@@ -14,63 +18,287 @@
 #include "input.h"
 #include "timer.h"
 #include "config.h"
+#include "jit.h"
+#include "aot.h"
+#include "scheduler.h"
+#include "rewind.h"
+#include "movie.h"
+#include "library.h"
+#include "debugger.h"
+#include "profiler.h"
 
 
-int main(int argc, char const *argv[]) {
-    // Validate command line arguments
-    if (argc < 2 ) {
-        fprintf ( stderr , "Usage %s <rom_name>\n" , argv[1] ) ;
-        exit(EXIT_FAILURE) ;
+// Write the movie being recorded and stop recording
+static void finish_recording(movie_t *movie , const chip8_t *chip8 , const char **movie_name , const char *reason) {
+    movie_end(movie , chip8) ;
+    if (movie_save(movie , *movie_name))
+        printf("Movie saved to %s (%llu frames, %s)\n" , *movie_name , (unsigned long long)movie->frames , reason) ;
+    movie_free(movie) ;
+    *movie_name = NULL ;
+}
+
+// Speed multiplier argument: a whole number of emulated frames per real-time frame
+// (1 or more), or "max" for SCHEDULER_UNCAPPED
+static bool parse_speed(const char *text , uint32_t *speed) {
+    if (strcmp(text , "max") == 0) {
+        *speed = SCHEDULER_UNCAPPED ;
+        return true ;
     }
-    
+    char *end = NULL ;
+    const unsigned long value = strtoul(text , &end , 10) ;
+    if (text[0] < '0' || text[0] > '9' || *end != '\0' || value == 0 || value > UINT32_MAX) {
+        fprintf(stderr , "Invalid speed %s (a whole number of frames, 1 or more, or max)\n" , text) ;
+        return false ;
+    }
+    *speed = (uint32_t)value ;
+    return true ;
+}
+
+// --render-every N: a whole number, 0 (the default) drawing the last frame of each real-time one
+static bool parse_render_interval(const char *text , uint32_t *interval) {
+    char *end = NULL ;
+    const unsigned long value = strtoul(text , &end , 10) ;
+    if (text[0] < '0' || text[0] > '9' || *end != '\0' || value > UINT32_MAX) {
+        fprintf(stderr , "Invalid render interval %s (a whole number of frames, 0 for one per real-time frame)\n" , text) ;
+        return false ;
+    }
+    *interval = (uint32_t)value ;
+    return true ;
+}
+
+// One published frame: the display planes as they were at the end of it
+typedef struct {
+    uint64_t display[CHIP8_PLANES][CHIP8_HIRES_HEIGHT][CHIP8_ROW_WORDS] ;
+    bool hires ;
+} frame_t ;
+
+// Lock-free triple buffer between the emulation thread (writer) and the
+// main thread (reader). Each side owns one slot; the third is swapped in
+// and out of `middle` with a single atomic exchange, so neither side ever
+// waits for the other and the reader always gets the newest frame.
+#define FRAME_FRESH 0x4 // Set in middle by the writer, cleared by the reader taking it
+
+typedef struct {
+    frame_t frames[3] ;
+    uint8_t back ;   // Slot the emulation thread writes
+    uint8_t middle ; // Newest complete frame, FRAME_FRESH until taken
+    uint8_t front ;  // Slot the main thread presents
+} triple_buffer_t ;
+
+static void publish_frame(triple_buffer_t *buffer , const chip8_t *chip8) {
+    frame_t *frame = &buffer->frames[buffer->back] ;
+    memcpy(frame->display , chip8->display , sizeof(frame->display)) ;
+    frame->hires = chip8->hires ;
+    buffer->back = __atomic_exchange_n(&buffer->middle , (uint8_t)(buffer->back | FRAME_FRESH) , __ATOMIC_ACQ_REL) & 3 ;
+}
+
+// The newest frame if one was published since the last call, else NULL
+static const frame_t *take_frame(triple_buffer_t *buffer) {
+    if (!(__atomic_load_n(&buffer->middle , __ATOMIC_ACQUIRE) & FRAME_FRESH)) return NULL ;
+    buffer->front = __atomic_exchange_n(&buffer->middle , buffer->front , __ATOMIC_ACQ_REL) & 3 ;
+    return &buffer->frames[buffer->front] ;
+}
+
+// Everything the emulation thread works on; the main thread only reads
+// `frames` and `done` until the thread has finished
+typedef struct {
+    chip8_t *chip8 ;
+    const config_t *config ;
+    sdl_t *sdl ;  // Audio device only
+    input_t *input ;
+    triple_buffer_t *frames ;
+    rewind_t *history ;
+    movie_t *movie ;
+    const char *movie_name ;  // NULL when not recording
+    bool done ;               // Set when the thread exits
+} emulation_t ;
+
+static int emulation_main(void *context) {
+    emulation_t *emulation = context ;
+    chip8_t *chip8 = emulation->chip8 ;
+    const config_t *config = emulation->config ;
+    scheduler_t scheduler ;
+    scheduler_init(&scheduler) ;
+    uint64_t emulated_frames = 0 ;  // For --render-every while fast-forwarding
+    while (chip8->state != STOPPED)
+    {
+        // Commands and keys from the main thread
+        PROFILE_BEGIN(chip8 , PROFILE_INPUT) ;
+        const bool replaced = apply_input(emulation->input , chip8) ;
+        PROFILE_END(chip8 , PROFILE_INPUT) ;
+        if (emulation->movie_name && replaced) finish_recording(emulation->movie , chip8 , &emulation->movie_name , "stopped by reset/state load") ;
+        if (chip8->state == STOPPED) break ;
+        if (chip8->state == PAUSED && chip8->debugger && chip8->debugger->stopped) {
+            // Breakpoint, watchpoint or F11: the terminal prompt owns the machine until it continues
+            if (!debugger_prompt(chip8 , stdin , stdout)) break ;
+            publish_frame(emulation->frames , chip8) ;  // Show what stepping drew
+            scheduler_reset(&scheduler) ;
+            continue ;
+        }
+        if (chip8->state == PAUSED) {
+            scheduler_reset(&scheduler) ;  // don't catch up on the time spent paused
+            SDL_Delay(1000 / SCHEDULER_FRAME_RATE) ;
+            continue ;
+        }
+
+        // Run every frame owed since the last iteration: its CPU cycles, then one 60 Hz timer tick.
+        // While Backspace is held, each frame steps one recorded frame back instead.
+        // Holding Tab (or --speed) runs faster than real time and publishes only some frames.
+        const uint8_t held = input_held(emulation->input) ;
+        const bool rewinding = held & INPUT_HELD_REWIND ;
+        const uint32_t speed = held & INPUT_HELD_TURBO ? config->turbo_speed : config->speed ;
+        if (rewinding) SDL_PauseAudioDevice(emulation->sdl->chip8_audio_device , 1) ;
+        if (emulation->movie_name && rewinding) finish_recording(emulation->movie , chip8 , &emulation->movie_name , "stopped by rewind") ;
+        const uint32_t frames = scheduler_frames_due(&scheduler , speed) ;
+        bool render = false ;
+        PROFILE_BEGIN(chip8 , PROFILE_EMULATION) ;
+        for ( uint32_t i = 0 ; i < frames && chip8->state == RUNNING && !scheduler_slice_over(&scheduler) ; i++ ) {
+            emulated_frames++ ;
+            render = render || speed == 1 || config->render_interval == 0 || emulated_frames % config->render_interval == 0 ;
+            if (rewinding) {
+                rewind_step_back(emulation->history , chip8) ;
+                continue ;
+            }
+            input_keypad(emulation->input , chip8) ;  // Keys pressed since the last frame count from this one
+            if (emulation->movie_name) movie_record_frame(emulation->movie , chip8) ;
+            scheduler_run_frame(&scheduler , chip8 , config) ;
+            update_timers(emulation->sdl , chip8 ) ;  // Update delay and sound timers
+            rewind_push(emulation->history , chip8) ;
+        }
+        PROFILE_END(chip8 , PROFILE_EMULATION) ;
+        if (render) {
+            PROFILE_BEGIN(chip8 , PROFILE_RENDER) ;
+            publish_frame(emulation->frames , chip8) ;  // The main thread presents it
+            PROFILE_END(chip8 , PROFILE_RENDER) ;
+            PROFILE_END_FRAME(chip8) ;
+        }
+
+        scheduler_wait(&scheduler) ;  // Sleep precisely until the next frame is due
+    }
+    chip8->state = STOPPED ;
+    SDL_PauseAudioDevice(emulation->sdl->chip8_audio_device , 1) ;
+    __atomic_store_n(&emulation->done , true , __ATOMIC_RELEASE) ;
+    return 0 ;
+}
+
+int main(int argc, char const *argv[]) {
     // Initialize configuration settings
     config_t config = {0} ; 
     if (!init_config(&config)) exit(EXIT_FAILURE) ;
 
+    // Parse command line: options first, ROM last
+    const char *rom_name = NULL ;
+    const char *movie_name = NULL ;
+    const char *aot_name = NULL ;
+    quirks_t quirks = QUIRKS_AUTO ;
+    bool debug = false ;
+    for ( int i = 1 ; i < argc ; i++ ) {
+        if ( strcmp(argv[i] , "--jit") == 0 ) config.use_jit = true ;
+        else if ( strcmp(argv[i] , "--aot") == 0 && i + 1 < argc ) aot_name = argv[++i] ;
+        else if ( strcmp(argv[i] , "--vip-timing") == 0 ) config.vip_timing = true ;
+        else if ( strcmp(argv[i] , "--record") == 0 && i + 1 < argc ) movie_name = argv[++i] ;
+        else if ( strcmp(argv[i] , "--speed") == 0 && i + 1 < argc ) {
+            if ( !parse_speed(argv[++i] , &config.speed) ) exit(EXIT_FAILURE) ;
+        }
+        else if ( strcmp(argv[i] , "--turbo") == 0 && i + 1 < argc ) {
+            if ( !parse_speed(argv[++i] , &config.turbo_speed) ) exit(EXIT_FAILURE) ;
+        }
+        else if ( strcmp(argv[i] , "--render-every") == 0 && i + 1 < argc ) {
+            if ( !parse_render_interval(argv[++i] , &config.render_interval) ) exit(EXIT_FAILURE) ;
+        }
+        else if ( strcmp(argv[i] , "--library") == 0 && i + 1 < argc ) config.library_path = argv[++i] ;
+        else if ( strcmp(argv[i] , "--debug") == 0 ) debug = true ;
+        else if ( strcmp(argv[i] , "--quirks") == 0 && i + 1 < argc ) {
+            if ( !chip8_parse_quirks(argv[++i] , &quirks) ) exit(EXIT_FAILURE) ;
+        }
+        else rom_name = argv[i] ;
+    }
+    if (!rom_name) {
+        fprintf ( stderr , "Usage %s [--jit] [--aot module] [--vip-timing] [--quirks profile] [--speed N|max] [--turbo N|max] [--render-every N]\n"
+                           "       [--library index_file] [--record movie_file] [--debug] <rom_name>\n" , argv[0] ) ;
+        exit(EXIT_FAILURE) ;
+    }
+
+    // Per-ROM settings (quirks, speed, keys) from the ROM library, looked up by content hash
+    library_t library ;
+    if (!library_load(&library , config.library_path)) exit(EXIT_FAILURE) ;
+    const library_entry_t *entry = library_lookup_rom(&library , rom_name) ;
+    if (entry) {
+        library_apply(entry , &config , &quirks) ;
+        printf("Library: %s (%u instructions per second)\n" , entry->title , config.instructions_per_second) ;
+    }
+    library_free(&library) ;
+
     // Initialize SDL (graphics, audio, input)
     sdl_t sdl = {0};
     if (!init_display(&sdl , &config)) exit(EXIT_FAILURE); 
     
     // Initialize CHIP-8 system and load ROM
     chip8_t chip8 = {0} ; 
-    const char *rom_name = argv[1] ; 
+    if (config.use_jit && !jit_enable(&chip8)) puts("JIT not available on this host, using the interpreter") ;
+    if (aot_name && !aot_load(&chip8 , aot_name)) exit(EXIT_FAILURE) ;
+    chip8.quirks_request = quirks ;  // Kept across resets
     if(!init_chip8(&chip8 , rom_name)) exit(EXIT_FAILURE) ; 
+    printf("Quirk profile: %s\n" , chip8_quirk_set(chip8.quirks)->name) ;
+    if (chip8.aot) printf("AOT module %s: %s\n" , aot_name , chip8.aot->active ? "running" : "built for another ROM or profile, not used") ;
+#ifdef CHIP8_PROFILE
+    if (!profiler_attach(&chip8)) exit(EXIT_FAILURE) ;
+    puts("Profiling on the interpreter: F9 prints the report, F10 resets it, chip8_profile.txt is written on exit") ;
+#endif
 
 
     // Clear screen and show controls
     clear_display(&sdl , config) ;
-    puts("Press Space to pause/resume, M to reset, ESC to quit, F1-F4 to save state, F5-F8 to load state") ;
+    puts("Press Space to pause/resume, M to reset, ESC to quit, F1-F4 to save state, F5-F8 to load state, hold Backspace to rewind, hold Tab to fast-forward, F11 for the debugger") ;
+    if (debug) {
+        if (!debugger_attach(&chip8)) exit(EXIT_FAILURE) ;
+        debugger_interrupt(&chip8) ;  // Start at the prompt, before the first instruction
+    }
+
+    // Per-frame history for rewinding, allocated once up front
+    rewind_t history ;
+    if (!rewind_init(&history , config.rewind_budget , config.rewind_keyframe_interval)) exit(EXIT_FAILURE) ;
+
+    // Movie recording: seed, pacing and keypad per frame, replayable with chip8-headless --replay
+    movie_t movie ;
+    if (movie_name) movie_begin(&movie , &chip8 , (uint32_t)SDL_GetPerformanceCounter() , config.instructions_per_second , config.vip_timing) ;
     
-    // Main emulation loop - runs at 60 FPS
-    while (chip8.state != STOPPED)
-    {
-        // Handle user input and system events
-        handle_input(&chip8) ; 
-        if (chip8.state == PAUSED) continue ;
-
-        // Execute CHIP-8 instructions for this frame
-        uint32_t start_time = SDL_GetPerformanceCounter ();
-        // Run multiple instructions per frame based on config
-        for( uint32_t i = 0 ; i < config.instructions_per_second / 60 ; i++ ) {
-            run_intructions(&chip8) ;
-        }
-        
-        // Calculate frame timing to maintain 60 FPS
-        uint32_t end_time = SDL_GetPerformanceCounter () ;
-        double elapsed_time = (double) ( end_time - start_time) *1000 / SDL_GetPerformanceFrequency() ;
-        uint32_t delay ; 
-        if (elapsed_time < 16.67) {
-            delay = 16.67 - elapsed_time ;  // Target: 16.67ms per frame (60 FPS)
-        } else {
-            delay = 0 ;  // Frame took too long, no delay
+    // Emulation on its own thread; this one handles events and presents frames
+    static triple_buffer_t frames = { .back = 0 , .middle = 1 , .front = 2 } ;
+    static input_t input ;
+    emulation_t emulation = {
+        .chip8 = &chip8 , .config = &config , .sdl = &sdl , .input = &input , .frames = &frames ,
+        .history = &history , .movie = &movie , .movie_name = movie_name ,
+    } ;
+    SDL_Thread *emulation_thread = SDL_CreateThread(emulation_main , "emulation" , &emulation) ;
+    if (!emulation_thread) {
+        SDL_Log("Could not start the emulation thread: %s\n" , SDL_GetError()) ;
+        exit(EXIT_FAILURE) ;
+    }
+    while (!__atomic_load_n(&emulation.done , __ATOMIC_ACQUIRE)) {
+        poll_input(&input , &config) ;
+        const frame_t *frame = take_frame(&frames) ;
+        if (frame) {
+            PROFILE_PRESENT_BEGIN(&chip8) ;
+            present_frame(&sdl , frame->display , frame->hires , config) ;  // May wait for vsync, emulation goes on
+            PROFILE_PRESENT_END(&chip8) ;
         }
-
-        SDL_Delay(delay);  // Maintain consistent frame rate
-        update_display(&sdl , &chip8 , config ) ;  // Render graphics
-        update_timers(&sdl , &chip8 ) ;  // Update delay and sound timers
+        else SDL_Delay(1) ;
     }
+    SDL_WaitThread(emulation_thread , NULL) ;
+    movie_name = emulation.movie_name ;
 
     // Cleanup and exit
+    if (movie_name) finish_recording(&movie , &chip8 , &movie_name , "end of session") ;
+    savestate_flush() ;  // Let queued F1-F4 saves reach the disk
+    rewind_free(&history) ;
+#ifdef CHIP8_PROFILE
+    if (profiler_write(&chip8 , "chip8_profile.txt")) puts("Profile written to chip8_profile.txt") ;
+    profiler_detach(&chip8) ;
+#endif
+    debugger_detach(&chip8) ;
+    aot_unload(&chip8) ;
+    free_chip8(&chip8) ;
     clear_display(&sdl , config) ;
     exit(EXIT_SUCCESS) ;
 }
@@ -0,0 +1,190 @@
+/**
+ * @file movie.c
+ * @brief Input Movie Recording and Replay
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * A run is reproducible once three things are fixed: the RNG seed, the
+ * per-frame instruction budget, and the keypad at the start of each
+ * frame. Recording logs those; replay feeds them to run_headless at
+ * uncapped speed and compares the final hashes, so a bug report becomes
+ * a regression test that runs in milliseconds.
+ */
+
+#include "movie.h"
+
+#define MOVIE_FLAG_VIP_TIMING 0x01
+
+static uint16_t keypad_mask ( const chip8_t *chip8 ) {
+    uint16_t keys = 0 ;
+    for ( uint32_t k = 0 ; k < 16 ; k++ ) if ( chip8->keypad[k] ) keys |= 1u << k ;
+    return keys ;
+}
+
+// Keys already held when recording starts are logged as pressed on frame 0
+void movie_begin ( movie_t *movie , chip8_t *chip8 , uint32_t seed , uint32_t instructions_per_second , bool vip_timing ) {
+    memset ( movie , 0 , sizeof ( movie_t ) ) ;
+    movie->seed = seed ? seed : CHIP8_RNG_SEED ; // xorshift state must not be 0
+    movie->instructions_per_second = instructions_per_second ;
+    movie->vip_timing = vip_timing ;
+    movie->quirks = chip8->quirks ;
+    movie->rom_hash = state_hash ( chip8 ) ;
+    chip8->rng = movie->seed ;
+}
+
+bool movie_record_frame ( movie_t *movie , const chip8_t *chip8 ) {
+    const uint16_t keys = keypad_mask ( chip8 ) ;
+    bool ok = true ;
+    if ( keys != movie->keys ) {
+        const input_event_t event = { .frame = (uint32_t)movie->frames ,
+                                      .press = keys & ~movie->keys , .release = movie->keys & ~keys } ;
+        ok = push_input_event ( &movie->input , event ) ;
+        movie->keys = keys ;
+    }
+    movie->frames++ ;
+    return ok ;
+}
+
+void movie_end ( movie_t *movie , const chip8_t *chip8 ) {
+    movie->display_hash = display_hash ( chip8 ) ;
+    movie->state_hash = state_hash ( chip8 ) ;
+}
+
+void movie_free ( movie_t *movie ) {
+    free_input_script ( &movie->input ) ;
+    memset ( movie , 0 , sizeof ( movie_t ) ) ;
+}
+
+// ---------------------------------------------------------------------------
+// File format
+
+static void write_le ( FILE *file , uint64_t value , int bytes ) {
+    for ( int i = 0 ; i < bytes ; i++ ) fputc ( (int)((value >> (8 * i)) & 0xFF) , file ) ;
+}
+
+static void write_varint ( FILE *file , uint32_t value ) {
+    while ( value >= 0x80 ) {
+        fputc ( (int)((value & 0x7F) | 0x80) , file ) ;
+        value >>= 7 ;
+    }
+    fputc ( (int)value , file ) ;
+}
+
+static bool read_le ( FILE *file , uint64_t *value , int bytes ) {
+    *value = 0 ;
+    for ( int i = 0 ; i < bytes ; i++ ) {
+        const int byte = fgetc ( file ) ;
+        if ( byte == EOF ) return false ;
+        *value |= (uint64_t)byte << (8 * i) ;
+    }
+    return true ;
+}
+
+static bool read_varint ( FILE *file , uint32_t *value ) {
+    *value = 0 ;
+    for ( int shift = 0 ; shift < 35 ; shift += 7 ) {
+        const int byte = fgetc ( file ) ;
+        if ( byte == EOF ) return false ;
+        *value |= (uint32_t)(byte & 0x7F) << shift ;
+        if ( !(byte & 0x80) ) return true ;
+    }
+    return false ;
+}
+
+bool movie_save ( const movie_t *movie , const char *path ) {
+    FILE *file = fopen ( path , "wb" ) ;
+    if ( !file ) {
+        CHIP8_LOG ( "Could not open movie %s for writing\n" , path ) ;
+        return false ;
+    }
+    fwrite ( MOVIE_MAGIC , 1 , 4 , file ) ;
+    write_le ( file , MOVIE_VERSION , 2 ) ;
+    write_le ( file , movie->vip_timing ? MOVIE_FLAG_VIP_TIMING : 0 , 1 ) ;
+    write_le ( file , movie->quirks , 1 ) ;
+    write_le ( file , movie->seed , 4 ) ;
+    write_le ( file , movie->instructions_per_second , 4 ) ;
+    write_le ( file , movie->rom_hash , 8 ) ;
+    write_le ( file , movie->frames , 8 ) ;
+    write_le ( file , movie->display_hash , 8 ) ;
+    write_le ( file , movie->state_hash , 8 ) ;
+    write_le ( file , movie->input.count , 4 ) ;
+
+    uint32_t previous = 0 ;
+    for ( size_t i = 0 ; i < movie->input.count ; i++ ) {
+        const input_event_t *event = &movie->input.events[i] ;
+        write_varint ( file , event->frame - previous ) ;
+        write_varint ( file , event->press ) ;
+        write_varint ( file , event->release ) ;
+        previous = event->frame ;
+    }
+
+    if ( ferror ( file ) | fclose ( file ) ) {
+        CHIP8_LOG ( "Could not write movie %s\n" , path ) ;
+        return false ;
+    }
+    return true ;
+}
+
+bool movie_load ( movie_t *movie , const char *path ) {
+    memset ( movie , 0 , sizeof ( movie_t ) ) ;
+    FILE *file = fopen ( path , "rb" ) ;
+    if ( !file ) {
+        CHIP8_LOG ( "Could not open movie %s\n" , path ) ;
+        return false ;
+    }
+
+    char magic[4] ;
+    uint64_t version = 0 , flags = 0 , quirks = 0 , seed = 0 , ips = 0 , count = 0 ;
+    bool ok = fread ( magic , 1 , 4 , file ) == 4 && memcmp ( magic , MOVIE_MAGIC , 4 ) == 0 ;
+    ok = ok && read_le ( file , &version , 2 ) && version == MOVIE_VERSION ;
+    ok = ok && read_le ( file , &flags , 1 ) && read_le ( file , &quirks , 1 ) && quirks < QUIRKS_COUNT ;
+    ok = ok && read_le ( file , &seed , 4 ) && read_le ( file , &ips , 4 ) ;
+    ok = ok && read_le ( file , &movie->rom_hash , 8 ) && read_le ( file , &movie->frames , 8 ) ;
+    ok = ok && read_le ( file , &movie->display_hash , 8 ) && read_le ( file , &movie->state_hash , 8 ) ;
+    ok = ok && read_le ( file , &count , 4 ) ;
+    movie->seed = (uint32_t)seed ;
+    movie->instructions_per_second = (uint32_t)ips ;
+    movie->vip_timing = flags & MOVIE_FLAG_VIP_TIMING ;
+    movie->quirks = (quirks_t)quirks ;
+
+    uint32_t frame = 0 ;
+    for ( uint64_t i = 0 ; ok && i < count ; i++ ) {
+        uint32_t delta , press , release ;
+        ok = read_varint ( file , &delta ) && read_varint ( file , &press ) && read_varint ( file , &release ) ;
+        frame += delta ;
+        const input_event_t event = { .frame = frame , .press = (uint16_t)press , .release = (uint16_t)release } ;
+        ok = ok && push_input_event ( &movie->input , event ) ;
+    }
+    ok = ok && fgetc ( file ) == EOF ;
+    fclose ( file ) ;
+
+    if ( !ok ) {
+        CHIP8_LOG ( "Movie %s is not a supported version %d movie or is corrupt\n" , path , MOVIE_VERSION ) ;
+        movie_free ( movie ) ;
+    }
+    return ok ;
+}
+
+// ---------------------------------------------------------------------------
+// Replay
+
+bool movie_replay ( const movie_t *movie , chip8_t *chip8 , run_result_t *result ) {
+    memset ( result , 0 , sizeof ( run_result_t ) ) ;
+    if ( movie->quirks != QUIRKS_AUTO && movie->quirks != chip8->quirks ) {
+        CHIP8_LOG ( "Movie was recorded with the %s quirk profile, not %s\n" ,
+                    chip8_quirk_set ( movie->quirks )->name , chip8_quirk_set ( chip8->quirks )->name ) ;
+        return false ;
+    }
+    if ( state_hash ( chip8 ) != movie->rom_hash ) {
+        CHIP8_LOG ( "Movie was recorded with a different ROM\n" ) ;
+        return false ;
+    }
+    chip8->rng = movie->seed ;
+
+    const run_options_t options = { .max_frames = movie->frames ,
+                                    .instructions_per_second = movie->instructions_per_second ,
+                                    .vip_timing = movie->vip_timing , .script = &movie->input } ;
+    run_headless ( chip8 , &options , result ) ;
+    return result->frames == movie->frames &&
+           display_hash ( chip8 ) == movie->display_hash && state_hash ( chip8 ) == movie->state_hash ;
+}
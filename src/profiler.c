@@ -0,0 +1,266 @@
+/**
+ * @file profiler.c
+ * @brief Per-Opcode Profiler and PC Heat Map
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * Built only with -DCHIP8_PROFILE. The interpreter bumps one opcode
+ * counter and one per-address counter for every instruction; the front
+ * end brackets its input, emulation and render work of each frame, the
+ * main thread's present_frame included (added up atomically and taken
+ * in by the emulation thread at the end of the next frame). The
+ * report ranks opcodes and addresses and groups hot addresses into loops,
+ * tagging the usual busy-wait shapes (jump to self, FX0A, delay timer
+ * polling) so time burnt waiting is not mistaken for real work.
+ */
+
+#ifdef CHIP8_PROFILE
+
+#include "profiler.h"
+#include "runner.h"
+
+#define TOP_ADDRESSES 16
+#define HOT_SHARE 0.005 // Addresses above this share of all instructions form hot regions
+#define REGION_GAP 8    // Hot addresses this close (up to three cold instructions apart) share a region
+
+static const char *const op_names[OP_COUNT] = {
+    [OP_DECODE] = "????" , [OP_NOP] = "0NNN" , [OP_CLS] = "00E0" , [OP_RET] = "00EE" , [OP_JP] = "1NNN" ,
+    [OP_CALL] = "2NNN" , [OP_SE_VX_NN] = "3XNN" , [OP_SNE_VX_NN] = "4XNN" , [OP_SE_VX_VY] = "5XY0" ,
+    [OP_LD_VX_NN] = "6XNN" , [OP_ADD_VX_NN] = "7XNN" , [OP_LD_VX_VY] = "8XY0" , [OP_OR] = "8XY1" ,
+    [OP_AND] = "8XY2" , [OP_XOR] = "8XY3" , [OP_ADD_VX_VY] = "8XY4" , [OP_SUB] = "8XY5" , [OP_SHR] = "8XY6" ,
+    [OP_SUBN] = "8XY7" , [OP_SHL] = "8XYE" , [OP_SNE_VX_VY] = "9XY0" , [OP_LD_I] = "ANNN" , [OP_JP_V0] = "BNNN" ,
+    [OP_RND] = "CXNN" , [OP_DRW] = "DXYN" , [OP_SKP] = "EX9E" , [OP_SKNP] = "EXA1" , [OP_LD_VX_DT] = "FX07" ,
+    [OP_LD_VX_K] = "FX0A" , [OP_LD_DT_VX] = "FX15" , [OP_LD_ST_VX] = "FX18" , [OP_ADD_I_VX] = "FX1E" ,
+    [OP_LD_F_VX] = "FX29" , [OP_LD_B_VX] = "FX33" , [OP_LD_MEM_VX] = "FX55" , [OP_LD_VX_MEM] = "FX65" ,
+    [OP_SCD] = "00CN" , [OP_SCU] = "00DN" , [OP_SCR] = "00FB" , [OP_SCL] = "00FC" , [OP_EXIT] = "00FD" ,
+    [OP_LORES] = "00FE" , [OP_HIRES] = "00FF" , [OP_SAVE_RANGE] = "5XY2" , [OP_LOAD_RANGE] = "5XY3" ,
+    [OP_LD_I_LONG] = "F000" , [OP_PLANE] = "FN01" , [OP_LD_HF_VX] = "FX30" , [OP_SAVE_FLAGS] = "FX75" ,
+    [OP_LOAD_FLAGS] = "FX85" ,
+} ;
+
+static const char *const phase_names[PROFILE_PHASES] = { "input" , "emulation" , "render" } ;
+
+bool profiler_attach ( chip8_t *chip8 ) {
+    if ( chip8->profiler ) return true ;
+    chip8->profiler = calloc ( 1 , sizeof ( profiler_t ) ) ;
+    if ( !chip8->profiler ) {
+        CHIP8_LOG ( "Could not allocate the profiler\n" ) ;
+        return false ;
+    }
+    return true ;
+}
+
+void profiler_detach ( chip8_t *chip8 ) {
+    free ( chip8->profiler ) ;
+    chip8->profiler = NULL ;
+}
+
+void profiler_reset ( profiler_t *profiler ) {
+    if ( profiler ) memset ( profiler , 0 , sizeof ( profiler_t ) ) ;
+}
+
+void profiler_begin ( profiler_t *profiler , profile_phase_t phase ) {
+    if ( profiler ) profiler->phase_start[phase] = monotonic_seconds () ;
+}
+
+void profiler_end ( profiler_t *profiler , profile_phase_t phase ) {
+    if ( profiler ) profiler->phase_seconds[phase] += monotonic_seconds () - profiler->phase_start[phase] ;
+}
+
+void profiler_present_begin ( profiler_t *profiler ) {
+    if ( profiler ) profiler->present_start = monotonic_seconds () ;
+}
+
+void profiler_present_end ( profiler_t *profiler ) {
+    if ( !profiler ) return ;
+    const uint64_t ns = (uint64_t)( ( monotonic_seconds () - profiler->present_start ) * 1e9 ) ;
+    __atomic_fetch_add ( &profiler->presented_ns , ns , __ATOMIC_RELAXED ) ;
+}
+
+void profiler_end_frame ( profiler_t *profiler ) {
+    if ( !profiler ) return ;
+    profiler->phase_seconds[PROFILE_RENDER] += __atomic_exchange_n ( &profiler->presented_ns , 0 , __ATOMIC_RELAXED ) * 1e-9 ;
+    profile_frame_t *frame = &profiler->history[profiler->frames % PROFILE_HISTORY] ;
+    frame->instructions = (uint32_t)( profiler->instructions - profiler->frame_first_instruction ) ;
+    for ( int phase = 0 ; phase < PROFILE_PHASES ; phase++ ) {
+        frame->phase_us[phase] = (float)( profiler->phase_seconds[phase] * 1e6 ) ;
+        profiler->total_seconds[phase] += profiler->phase_seconds[phase] ;
+        profiler->phase_seconds[phase] = 0 ;
+    }
+    profiler->frame_first_instruction = profiler->instructions ;
+    profiler->frames++ ;
+}
+
+// ---------------------------------------------------------------------------
+// Report
+
+static double share ( uint64_t count , uint64_t total ) {
+    return total ? 100.0 * (double)count / (double)total : 0 ;
+}
+
+static uint16_t opcode_at ( const chip8_t *chip8 , uint32_t address ) {
+    return (uint16_t)( chip8->memory[address & (CHIP8_MAX_MEMORY_SIZE - 1)] << 8 |
+                       chip8->memory[(address + 1) & (CHIP8_MAX_MEMORY_SIZE - 1)] ) ;
+}
+
+static int compare_floats ( const void *a , const void *b ) {
+    const float x = *(const float *)a , y = *(const float *)b ;
+    return (x > y) - (x < y) ;
+}
+
+// Indices of the `count` largest values, largest first
+static void top_indices ( const uint64_t *values , uint32_t length , uint32_t *top , uint32_t count ) {
+    for ( uint32_t i = 0 ; i < count ; i++ ) top[i] = UINT32_MAX ;
+    for ( uint32_t i = 0 ; i < length ; i++ ) {
+        if ( values[i] == 0 ) continue ;
+        for ( uint32_t k = 0 ; k < count ; k++ ) {
+            if ( top[k] == UINT32_MAX || values[i] > values[top[k]] ) {
+                memmove ( &top[k + 1] , &top[k] , (count - k - 1) * sizeof ( uint32_t ) ) ;
+                top[k] = i ;
+                break ;
+            }
+        }
+    }
+}
+
+static void report_opcodes ( const profiler_t *profiler , FILE *out ) {
+    // Families by leading hex digit, then individual opcodes
+    uint64_t families[16] = {0} ;
+    for ( int op = OP_NOP ; op < OP_COUNT ; op++ ) {
+        const char c = op_names[op][0] ;
+        families[c <= '9' ? c - '0' : c - 'A' + 10] += profiler->op_counts[op] ;
+    }
+    uint32_t order[16] ;
+    top_indices ( families , 16 , order , 16 ) ;
+    fprintf ( out , "\nOpcode families\n" ) ;
+    for ( int i = 0 ; i < 16 && order[i] != UINT32_MAX ; i++ ) {
+        fprintf ( out , "  %Xxxx %14llu %6.2f%%\n" , order[i] ,
+                  (unsigned long long)families[order[i]] , share ( families[order[i]] , profiler->instructions ) ) ;
+    }
+
+    uint32_t ops[OP_COUNT] ;
+    top_indices ( profiler->op_counts , OP_COUNT , ops , OP_COUNT ) ;
+    fprintf ( out , "\nOpcodes\n" ) ;
+    for ( int i = 0 ; i < OP_COUNT && ops[i] != UINT32_MAX ; i++ ) {
+        fprintf ( out , "  %s %14llu %6.2f%%\n" , op_names[ops[i]] ,
+                  (unsigned long long)profiler->op_counts[ops[i]] , share ( profiler->op_counts[ops[i]] , profiler->instructions ) ) ;
+    }
+}
+
+static void report_addresses ( chip8_t *chip8 , FILE *out ) {
+    const profiler_t *profiler = chip8->profiler ;
+    uint32_t top[TOP_ADDRESSES] ;
+    top_indices ( profiler->pc_counts , CHIP8_MAX_MEMORY_SIZE , top , TOP_ADDRESSES ) ;
+    fprintf ( out , "\nHottest addresses\n" ) ;
+    for ( int i = 0 ; i < TOP_ADDRESSES && top[i] != UINT32_MAX ; i++ ) {
+        fprintf ( out , "  0x%03X %04X %s %14llu %6.2f%%\n" , top[i] , opcode_at ( chip8 , top[i] ) ,
+                  op_names[fetch_decoded ( chip8 , (uint16_t)top[i] )->op] ,
+                  (unsigned long long)profiler->pc_counts[top[i]] , share ( profiler->pc_counts[top[i]] , profiler->instructions ) ) ;
+    }
+}
+
+// Name the busy-wait shape of a hot region, if it has one
+static const char *classify_region ( chip8_t *chip8 , uint32_t first , uint32_t last ) {
+    bool polls = false , jumps_back = false , only_waits = true ;
+    for ( uint32_t address = first ; address <= last ; address++ ) {
+        if ( chip8->profiler->pc_counts[address] == 0 ) continue ;
+        const decoded_inst_t *d = fetch_decoded ( chip8 , (uint16_t)address ) ;
+        switch ( d->op ) {
+            case OP_JP :
+                if ( d->NNN == address ) return "busy-wait: jump to self" ;
+                if ( d->NNN >= first && d->NNN <= address ) jumps_back = true ;
+                break ;
+            case OP_LD_VX_K :
+                return "busy-wait: key (FX0A)" ;
+            case OP_LD_VX_DT : case OP_SKP : case OP_SKNP :
+                polls = true ;
+                break ;
+            case OP_SE_VX_NN : case OP_SNE_VX_NN : case OP_SE_VX_VY : case OP_SNE_VX_VY :
+                break ;
+            default :
+                only_waits = false ;
+        }
+    }
+    // Nothing but timer/key reads, compares and jumps: the ROM is waiting, not working
+    if ( polls && jumps_back && only_waits ) return "busy-wait: polls delay timer/keys" ;
+    return jumps_back ? "loop" : "" ;
+}
+
+// Runs of hot addresses (gaps up to REGION_GAP bytes) reported as regions
+static void report_regions ( chip8_t *chip8 , FILE *out ) {
+    const profiler_t *profiler = chip8->profiler ;
+    const uint64_t threshold = (uint64_t)( profiler->instructions * HOT_SHARE ) + 1 ;
+    fprintf ( out , "\nHot regions (>= %.1f%% per address)\n" , 100 * HOT_SHARE ) ;
+    for ( uint32_t address = 0 ; address < CHIP8_MAX_MEMORY_SIZE ; address++ ) {
+        if ( profiler->pc_counts[address] < threshold ) continue ;
+        uint32_t last = address , instructions = 0 ;
+        uint64_t count = 0 ;
+        for ( uint32_t next = address ; next < CHIP8_MAX_MEMORY_SIZE && next <= last + REGION_GAP ; next++ ) {
+            if ( profiler->pc_counts[next] < threshold ) continue ;
+            count += profiler->pc_counts[next] ;
+            instructions++ ;
+            last = next ;
+        }
+        fprintf ( out , "  0x%03X-0x%03X %2u instructions %14llu %6.2f%%  %s\n" , address , last + 1 , instructions ,
+                  (unsigned long long)count , share ( count , profiler->instructions ) ,
+                  classify_region ( chip8 , address , last ) ) ;
+        address = last ;
+    }
+}
+
+static void report_frames ( const profiler_t *profiler , FILE *out ) {
+    const uint32_t kept = profiler->frames < PROFILE_HISTORY ? (uint32_t)profiler->frames : PROFILE_HISTORY ;
+    if ( kept == 0 ) return ;
+    static float samples[PROFILE_HISTORY] ;
+
+    fprintf ( out , "\nPer frame, last %u frames     mean      p50      p99      max\n" , kept ) ;
+    for ( int column = -1 ; column < PROFILE_PHASES ; column++ ) {
+        double sum = 0 ;
+        for ( uint32_t i = 0 ; i < kept ; i++ ) {
+            samples[i] = column < 0 ? (float)profiler->history[i].instructions : profiler->history[i].phase_us[column] ;
+            sum += samples[i] ;
+        }
+        qsort ( samples , kept , sizeof ( float ) , compare_floats ) ;
+        fprintf ( out , "  %-12s %-10s %8.1f %8.1f %8.1f %8.1f\n" , column < 0 ? "instructions" : phase_names[column] ,
+                  column < 0 ? "" : "(us)" , sum / kept , samples[kept / 2] , samples[(uint32_t)(kept * 0.99)] , samples[kept - 1] ) ;
+    }
+    fprintf ( out , "  whole run (s):" ) ;
+    for ( int phase = 0 ; phase < PROFILE_PHASES ; phase++ ) fprintf ( out , " %s %.3f" , phase_names[phase] , profiler->total_seconds[phase] ) ;
+    fprintf ( out , "\n" ) ;
+}
+
+void profiler_report ( chip8_t *chip8 , FILE *out ) {
+    const profiler_t *profiler = chip8->profiler ;
+    if ( !profiler ) return ;
+    fprintf ( out , "CHIP-8 profile: %s\n" , chip8->rom_name ? chip8->rom_name : "(no ROM)" ) ;
+    fprintf ( out , "  instructions %llu, frames %llu, %.1f instructions per frame\n" ,
+              (unsigned long long)profiler->instructions , (unsigned long long)profiler->frames ,
+              profiler->frames ? (double)profiler->instructions / profiler->frames : 0 ) ;
+    report_opcodes ( profiler , out ) ;
+    report_addresses ( chip8 , out ) ;
+    report_regions ( chip8 , out ) ;
+    report_frames ( profiler , out ) ;
+}
+
+bool profiler_write ( chip8_t *chip8 , const char *path ) {
+    if ( !chip8->profiler ) return false ;
+    FILE *file = fopen ( path , "w" ) ;
+    if ( !file ) {
+        CHIP8_LOG ( "Could not open profile %s for writing\n" , path ) ;
+        return false ;
+    }
+    profiler_report ( chip8 , file ) ;
+    fprintf ( file , "\nPC histogram (address count)\n" ) ;
+    for ( uint32_t address = 0 ; address < CHIP8_MAX_MEMORY_SIZE ; address++ ) {
+        if ( chip8->profiler->pc_counts[address] ) {
+            fprintf ( file , "0x%03X %llu\n" , address , (unsigned long long)chip8->profiler->pc_counts[address] ) ;
+        }
+    }
+    if ( ferror ( file ) | fclose ( file ) ) {
+        CHIP8_LOG ( "Could not write profile %s\n" , path ) ;
+        return false ;
+    }
+    return true ;
+}
+
+#endif // CHIP8_PROFILE
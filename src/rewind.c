@@ -0,0 +1,278 @@
+/**
+ * @file rewind.c
+ * @brief Per-Frame Rewind Buffer
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * Every frame is recorded as a run-length coded XOR against the keyframe
+ * of its group (one keyframe every keyframe_interval frames), so a frame
+ * costs only the bytes that changed since its keyframe and any frame can
+ * be rebuilt from two entries. Entries live in one circular byte arena of
+ * fixed size; the oldest group is evicted when a new entry does not fit.
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include "rewind.h"
+#include "jit.h"
+#include "aot.h"
+
+#define SNAPSHOT_SIZE sizeof ( rewind_snapshot_t )
+#define SCRATCH_SIZE ( 2 * SNAPSHOT_SIZE + 16 )
+// Below this many zero bytes a gap is cheaper to keep inside a literal
+#define MIN_ZERO_RUN 4
+
+static uint8_t *put_varint ( uint8_t *out , uint32_t value ) {
+    while ( value >= 0x80 ) {
+        *out++ = (uint8_t)(value | 0x80) ;
+        value >>= 7 ;
+    }
+    *out++ = (uint8_t)value ;
+    return out ;
+}
+
+static const uint8_t *get_varint ( const uint8_t *in , uint32_t *value ) {
+    uint32_t result = 0 ;
+    for ( int shift = 0 ; ; shift += 7 ) {
+        const uint8_t byte = *in++ ;
+        result |= (uint32_t)(byte & 0x7F) << shift ;
+        if ( !(byte & 0x80) ) break ;
+    }
+    *value = result ;
+    return in ;
+}
+
+// Encode data ^ reference (reference NULL = all zeros) as a sequence of
+// (zero run, literal length, literal bytes) tokens, returns the size
+static uint32_t rle_encode ( const uint8_t *data , const uint8_t *reference , size_t size , uint8_t *out ) {
+    uint8_t *start = out ;
+    size_t i = 0 ;
+    while ( i < size ) {
+        // Unchanged bytes, a word at a time where possible
+        const size_t zero_start = i ;
+        if ( reference ) {
+            while ( i + 8 <= size && memcmp ( data + i , reference + i , 8 ) == 0 ) i += 8 ;
+            while ( i < size && data[i] == reference[i] ) i++ ;
+        } else {
+            while ( i < size && data[i] == 0 ) i++ ;
+        }
+        const size_t literal_start = i ;
+        while ( i < size ) {
+            size_t zeros = 0 ;
+            while ( zeros < MIN_ZERO_RUN && i + zeros < size &&
+                    data[i + zeros] == (reference ? reference[i + zeros] : 0) ) zeros++ ;
+            if ( zeros == MIN_ZERO_RUN ) break ;
+            i += zeros ? zeros : 1 ;
+        }
+        out = put_varint ( out , (uint32_t)(literal_start - zero_start) ) ;
+        out = put_varint ( out , (uint32_t)(i - literal_start) ) ;
+        for ( size_t k = literal_start ; k < i ; k++ ) *out++ = data[k] ^ (reference ? reference[k] : 0) ;
+    }
+    return (uint32_t)(out - start) ;
+}
+
+// XOR the decoded stream into `target` (zeroed first for a keyframe)
+static void rle_apply ( const uint8_t *in , uint32_t length , uint8_t *target ) {
+    const uint8_t *end = in + length ;
+    size_t at = 0 ;
+    while ( in < end ) {
+        uint32_t zeros , literal ;
+        in = get_varint ( in , &zeros ) ;
+        in = get_varint ( in , &literal ) ;
+        at += zeros ;
+        for ( uint32_t k = 0 ; k < literal ; k++ ) target[at++] ^= *in++ ;
+    }
+}
+
+bool rewind_init ( rewind_t *history , size_t budget , uint32_t keyframe_interval ) {
+    memset ( history , 0 , sizeof ( rewind_t ) ) ;
+    // A quarter of the budget goes to the entry table, assuming ~64 bytes per frame
+    history->capacity = (uint32_t)(budget / 4 / sizeof ( rewind_entry_t )) ;
+    history->arena_size = (uint32_t)(budget - history->capacity * sizeof ( rewind_entry_t )) ;
+    history->keyframe_interval = keyframe_interval ? keyframe_interval : 1 ;
+    if ( history->capacity < 2 || history->arena_size < 2 * SCRATCH_SIZE ) {
+        CHIP8_LOG ( "Rewind budget of %zu bytes is too small\n" , budget ) ;
+        return false ;
+    }
+    history->entries = malloc ( history->capacity * sizeof ( rewind_entry_t ) ) ;
+    history->arena = malloc ( history->arena_size ) ;
+    history->scratch = malloc ( SCRATCH_SIZE ) ;
+    if ( !history->entries || !history->arena || !history->scratch ) {
+        CHIP8_LOG ( "Could not allocate the rewind buffer\n" ) ;
+        rewind_free ( history ) ;
+        return false ;
+    }
+    return true ;
+}
+
+void rewind_free ( rewind_t *history ) {
+    free ( history->entries ) ;
+    free ( history->arena ) ;
+    free ( history->scratch ) ;
+    memset ( history , 0 , sizeof ( rewind_t ) ) ;
+}
+
+void rewind_clear ( rewind_t *history ) {
+    history->first = history->next = 0 ;
+    history->head = 0 ;
+    history->key_valid = false ;
+}
+
+uint64_t rewind_frames ( const rewind_t *history ) {
+    return history->next - history->first ;
+}
+
+static rewind_entry_t *entry_at ( const rewind_t *history , uint64_t seq ) {
+    return &history->entries[seq % history->capacity] ;
+}
+
+// Drop the oldest keyframe and every delta that depends on it
+static void evict_oldest_group ( rewind_t *history ) {
+    const uint64_t key = entry_at ( history , history->first )->key ;
+    while ( history->first < history->next && entry_at ( history , history->first )->key == key ) history->first++ ;
+    if ( history->key_valid && history->key_seq == key ) history->key_valid = false ;
+}
+
+// Reserve `size` contiguous bytes at the head of the arena, evicting as needed
+static uint32_t allocate ( rewind_t *history , uint32_t size ) {
+    while ( rewind_frames ( history ) >= history->capacity ) evict_oldest_group ( history ) ;
+    for ( ;; ) {
+        if ( history->first == history->next ) {
+            history->head = 0 ;
+            return 0 ;
+        }
+        const uint32_t tail = entry_at ( history , history->first )->offset ;
+        if ( history->head > tail ) {
+            // Live data is [tail, head): use the end of the arena, or wrap
+            if ( history->head + size <= history->arena_size ) return history->head ;
+            history->head = 0 ;
+            continue ;
+        }
+        // Wrapped: free space is [head, tail)
+        if ( history->head + size <= tail ) return history->head ;
+        evict_oldest_group ( history ) ;
+    }
+}
+
+// Bytes of a snapshot in use: memory past 4K only exists on XO-CHIP
+static size_t snapshot_size ( const rewind_snapshot_t *snapshot ) {
+    return offsetof ( rewind_snapshot_t , memory ) + (snapshot->xo_chip ? CHIP8_MAX_MEMORY_SIZE : CHIP8_MEMORY_SIZE) ;
+}
+
+static void capture ( rewind_snapshot_t *snapshot , const chip8_t *chip8 ) {
+    memcpy ( snapshot->display , chip8->display , sizeof ( snapshot->display ) ) ;
+    snapshot->rng = chip8->rng ;
+    memcpy ( snapshot->stack , chip8->stack , sizeof ( snapshot->stack ) ) ;
+    snapshot->I = chip8->I ;
+    snapshot->pc = chip8->pc ;
+    memcpy ( snapshot->V , chip8->V , sizeof ( snapshot->V ) ) ;
+    snapshot->sp = chip8->sp ;
+    snapshot->delay_timer = chip8->delay_timer ;
+    snapshot->sound_timer = chip8->sound_timer ;
+    memcpy ( snapshot->flags , chip8->flags , sizeof ( snapshot->flags ) ) ;
+    snapshot->hires = chip8->hires ;
+    snapshot->plane_mask = chip8->plane_mask ;
+    snapshot->xo_chip = chip8->xo_chip ;
+    memcpy ( snapshot->memory , chip8->memory , chip8_address_mask ( chip8 ) + 1u ) ;
+}
+
+static void restore ( const rewind_snapshot_t *snapshot , chip8_t *chip8 ) {
+    memcpy ( chip8->display , snapshot->display , sizeof ( chip8->display ) ) ;
+    chip8->rng = snapshot->rng ;
+    memcpy ( chip8->stack , snapshot->stack , sizeof ( chip8->stack ) ) ;
+    chip8->I = snapshot->I ;
+    chip8->pc = snapshot->pc ;
+    memcpy ( chip8->V , snapshot->V , sizeof ( chip8->V ) ) ;
+    chip8->sp = snapshot->sp ;
+    chip8->delay_timer = snapshot->delay_timer ;
+    chip8->sound_timer = snapshot->sound_timer ;
+    memcpy ( chip8->flags , snapshot->flags , sizeof ( chip8->flags ) ) ;
+    chip8->hires = snapshot->hires ;
+    chip8->plane_mask = snapshot->plane_mask ;
+    // Most frames leave memory alone, keep the decode cache when they do
+    const size_t size = snapshot_size ( snapshot ) - offsetof ( rewind_snapshot_t , memory ) ;
+    if ( chip8->xo_chip != snapshot->xo_chip || memcmp ( chip8->memory , snapshot->memory , size ) != 0 ) {
+        const size_t used = chip8->xo_chip ? CHIP8_MAX_MEMORY_SIZE : size ;
+        memcpy ( chip8->memory , snapshot->memory , size ) ;
+        memset ( chip8->memory + size , 0 , used - size ) ;
+        chip8->xo_chip = snapshot->xo_chip ;
+        flush_decoded ( chip8 ) ;
+        if ( chip8->jit ) jit_flush ( chip8->jit ) ;
+        if ( chip8->aot ) aot_reset ( chip8 ) ;
+    }
+}
+
+// Make key_snapshot hold the decoded keyframe `key`
+static void load_keyframe ( rewind_t *history , uint64_t key ) {
+    if ( history->key_valid && history->key_seq == key ) return ;
+    const rewind_entry_t *entry = entry_at ( history , key ) ;
+    memset ( &history->key_snapshot , 0 , SNAPSHOT_SIZE ) ;
+    rle_apply ( history->arena + entry->offset , entry->size , (uint8_t *)&history->key_snapshot ) ;
+    history->key_seq = key ;
+    history->key_valid = true ;
+}
+
+void rewind_push ( rewind_t *history , const chip8_t *chip8 ) {
+    capture ( &history->current , chip8 ) ;
+
+    const uint64_t seq = history->next ;
+    bool keyframe = history->first == history->next ||
+                    seq - entry_at ( history , seq - 1 )->key >= history->keyframe_interval ;
+    uint64_t key = seq ;
+    uint32_t size ;
+    const size_t used = snapshot_size ( &history->current ) ;
+    if ( !keyframe ) {
+        key = entry_at ( history , seq - 1 )->key ;
+        load_keyframe ( history , key ) ;
+        // A delta covers only this frame's bytes, so the keyframe must be the same size
+        if ( history->key_snapshot.xo_chip != history->current.xo_chip ) {
+            keyframe = true ;
+            key = seq ;
+        }
+    }
+    if ( keyframe ) {
+        size = rle_encode ( (const uint8_t *)&history->current , NULL , used , history->scratch ) ;
+    } else {
+        size = rle_encode ( (const uint8_t *)&history->current , (const uint8_t *)&history->key_snapshot , used , history->scratch ) ;
+    }
+
+    uint32_t offset = allocate ( history , size ) ;
+    if ( !keyframe && history->first == history->next ) {
+        // Making room evicted this frame's own group: it has to be a keyframe now
+        keyframe = true ;
+        key = seq ;
+        history->first = history->next = seq ;
+        size = rle_encode ( (const uint8_t *)&history->current , NULL , used , history->scratch ) ;
+        offset = allocate ( history , size ) ;
+    }
+    memcpy ( history->arena + offset , history->scratch , size ) ;
+    *entry_at ( history , seq ) = (rewind_entry_t) { .offset = offset , .size = size , .key = key } ;
+    history->head = offset + size ;
+    history->next = seq + 1 ;
+    if ( keyframe ) {
+        memcpy ( &history->key_snapshot , &history->current , used ) ;
+        history->key_seq = seq ;
+        history->key_valid = true ;
+    }
+    history->bytes_pushed += size ;
+    history->frames_pushed++ ;
+}
+
+bool rewind_step_back ( rewind_t *history , chip8_t *chip8 ) {
+    const uint64_t frames = rewind_frames ( history ) ;
+    if ( frames == 0 ) return false ;
+    if ( frames > 1 ) {
+        // The newest entry is always last in the arena, so its bytes are simply released
+        history->next-- ;
+        history->head = entry_at ( history , history->next )->offset ;
+    }
+
+    const rewind_entry_t *entry = entry_at ( history , history->next - 1 ) ;
+    load_keyframe ( history , entry->key ) ;
+    memcpy ( &history->current , &history->key_snapshot , snapshot_size ( &history->key_snapshot ) ) ;
+    if ( entry->key != history->next - 1 ) {
+        rle_apply ( history->arena + entry->offset , entry->size , (uint8_t *)&history->current ) ;
+    }
+    restore ( &history->current , chip8 ) ;
+    return frames > 1 ;
+}
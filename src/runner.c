@@ -0,0 +1,212 @@
+/**
+ * @file runner.c
+ * @brief Headless Execution Helpers
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * Runs a loaded CHIP-8 instance without a window or audio device, as fast
+ * as the host allows: frames of instructions_per_second / 60 cycles (or
+ * COSMAC VIP timings), one timer tick per frame, keypad driven by an
+ * input script. run_frame is also what the SDL scheduler runs each frame.
+ *
+ * Input script format, one event line per frame that changes the keypad:
+ *
+ *     # frame  key changes (+K press, -K release, K is a hex digit)
+ *     120 +5 +6
+ *     130 -5
+ */
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
+#include <ctype.h>
+#include <time.h>
+#include "runner.h"
+#include "profiler.h"
+
+#define SCRIPT_LINE_MAX 256
+
+double monotonic_seconds ( void ) {
+    struct timespec now ;
+    clock_gettime ( CLOCK_MONOTONIC , &now ) ;
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9 ;
+}
+
+bool push_input_event ( input_script_t *script , input_event_t event ) {
+    if ( script->count == script->capacity ) {
+        const size_t capacity = script->capacity ? script->capacity * 2 : 64 ;
+        input_event_t *events = realloc ( script->events , capacity * sizeof ( input_event_t ) ) ;
+        if ( !events ) return false ;
+        script->events = events ;
+        script->capacity = capacity ;
+    }
+    script->events[script->count++] = event ;
+    return true ;
+}
+
+// Load an input script; frames must not decrease from one line to the next
+bool load_input_script ( input_script_t *script , const char *path ) {
+    memset ( script , 0 , sizeof ( input_script_t ) ) ;
+
+    FILE *file = fopen ( path , "r" ) ;
+    if ( !file ) {
+        CHIP8_LOG ( "Could not open input script %s\n" , path ) ;
+        return false ;
+    }
+
+    char line[SCRIPT_LINE_MAX] ;
+    uint32_t line_number = 0 ;
+    while ( fgets ( line , sizeof ( line ) , file ) ) {
+        line_number++ ;
+        char *hash = strchr ( line , '#' ) ;
+        if ( hash ) *hash = '\0' ;
+
+        char *token = strtok ( line , " \t\r\n" ) ;
+        if ( !token ) continue ; // blank or comment
+
+        char *end ;
+        input_event_t event = { .frame = (uint32_t)strtoul ( token , &end , 10 ) } ;
+        bool valid = *end == '\0' && ( script->count == 0 || event.frame >= script->events[script->count - 1].frame ) ;
+
+        while ( valid && ( token = strtok ( NULL , " \t\r\n" ) ) ) {
+            const bool press = token[0] == '+' ;
+            valid = ( press || token[0] == '-' ) && isxdigit ( (unsigned char)token[1] ) && token[2] == '\0' ;
+            if ( !valid ) break ;
+
+            const uint16_t key = 1u << strtoul ( &token[1] , NULL , 16 ) ;
+            if ( press ) event.press |= key ;
+            else event.release |= key ;
+        }
+        if ( !valid ) {
+            CHIP8_LOG ( "%s:%u: invalid input script line\n" , path , line_number ) ;
+            fclose ( file ) ;
+            free_input_script ( script ) ;
+            return false ;
+        }
+        if ( !push_input_event ( script , event ) ) {
+            fclose ( file ) ;
+            free_input_script ( script ) ;
+            return false ;
+        }
+    }
+    fclose ( file ) ;
+    return true ;
+}
+
+void free_input_script ( input_script_t *script ) {
+    free ( script->events ) ;
+    memset ( script , 0 , sizeof ( input_script_t ) ) ;
+}
+
+static void apply_input_event ( chip8_t *chip8 , const input_event_t *event ) {
+    for ( uint8_t key = 0 ; key < 16 ; key++ ) {
+        if ( event->press & (1u << key) ) chip8->keypad[key] = true ;
+        if ( event->release & (1u << key) ) chip8->keypad[key] = false ;
+    }
+}
+
+// Run the CPU for one frame (at most max_instructions) and return the number of instructions executed
+uint32_t run_frame ( chip8_t *chip8 , frame_budget_t *budget , uint32_t instructions_per_second , bool vip_timing , uint32_t max_instructions ) {
+    if ( !vip_timing ) {
+        // instructions_per_second / 60 per frame, remainder carried in 1/60ths
+        budget->cycle_credit += instructions_per_second ;
+        uint64_t cycles = budget->cycle_credit / CHIP8_FRAME_RATE ;
+        budget->cycle_credit %= CHIP8_FRAME_RATE ;
+        if ( cycles > max_instructions ) cycles = max_instructions ;
+        return run_cycles ( chip8 , (uint32_t)cycles ) ;
+    }
+    // COSMAC VIP timing: spend the frame's microseconds on per-opcode costs
+    budget->cycle_credit += 1000000 ;
+    int64_t budget_us = (int64_t)( budget->cycle_credit / CHIP8_FRAME_RATE ) - budget->time_debt_us ;
+    budget->cycle_credit %= CHIP8_FRAME_RATE ;
+    const uint32_t executed = budget_us > 0 ? run_timed ( chip8 , max_instructions , &budget_us ) : 0 ;
+    budget->time_debt_us = -budget_us ; // an instruction that ran past the frame boundary delays the next one
+    return executed ;
+}
+
+// Run until the frame or instruction limit (whichever comes first) is reached
+void run_headless ( chip8_t *chip8 , const run_options_t *options , run_result_t *result ) {
+    const input_script_t *script = options->script ;
+    size_t next_event = 0 ;
+    frame_budget_t budget = {0} ;
+
+    memset ( result , 0 , sizeof ( run_result_t ) ) ;
+    if ( options->max_frames == 0 && options->max_instructions == 0 ) return ; // would never stop
+
+    const double start = monotonic_seconds () ;
+    while ( ( options->max_frames == 0 || result->frames < options->max_frames ) &&
+            ( options->max_instructions == 0 || result->instructions < options->max_instructions ) &&
+            chip8->state != STOPPED ) {
+        while ( script && next_event < script->count && script->events[next_event].frame <= result->frames ) {
+            apply_input_event ( chip8 , &script->events[next_event++] ) ;
+        }
+
+        uint32_t limit = UINT32_MAX ;
+        if ( options->max_instructions && options->max_instructions - result->instructions < limit ) {
+            limit = (uint32_t)( options->max_instructions - result->instructions ) ;
+        }
+        PROFILE_BEGIN(chip8 , PROFILE_EMULATION) ;
+        result->instructions += run_frame ( chip8 , &budget , options->instructions_per_second , options->vip_timing , limit ) ;
+        tick_timers ( chip8 ) ;
+        PROFILE_END(chip8 , PROFILE_EMULATION) ;
+        PROFILE_END_FRAME(chip8) ;
+        if ( options->frame_done ) options->frame_done ( chip8 , result->frames , options->frame_context ) ;
+        result->frames++ ;
+        while ( chip8->state == PAUSED && options->paused ) {
+            if ( !options->paused ( chip8 , options->paused_context ) ) {
+                chip8->state = STOPPED ;
+                break ;
+            }
+        }
+    }
+    result->seconds = monotonic_seconds () - start ;
+}
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+static uint64_t fnv1a ( uint64_t hash , uint64_t value , int bytes ) {
+    for ( int byte = bytes - 1 ; byte >= 0 ; byte-- ) {
+        hash ^= (value >> (8 * byte)) & 0xFF ;
+        hash *= FNV_PRIME ;
+    }
+    return hash ;
+}
+
+// 64-bit FNV-1a over the display rows of the current resolution (byte order
+// fixed, so hashes match across hosts). The second plane is only hashed when
+// something is drawn in it, so CHIP-8 hashes are the same as before planes.
+uint64_t display_hash ( const chip8_t *chip8 ) {
+    uint64_t hash = FNV_OFFSET_BASIS ;
+    const uint32_t height = chip8->hires ? CHIP8_HIRES_HEIGHT : CHIP8_DISPLAY_HEIGHT ;
+    const uint32_t words = chip8->hires ? CHIP8_ROW_WORDS : 1 ;
+    if ( chip8->hires ) hash = fnv1a ( hash , 0xFF , 1 ) ;
+    for ( uint32_t plane = 0 ; plane < CHIP8_PLANES ; plane++ ) {
+        uint64_t used = plane == 0 ;
+        for ( uint32_t y = 0 ; y < height && !used ; y++ ) {
+            for ( uint32_t w = 0 ; w < words ; w++ ) used |= chip8->display[plane][y][w] ;
+        }
+        if ( !used ) continue ;
+        for ( uint32_t y = 0 ; y < height ; y++ ) {
+            for ( uint32_t w = 0 ; w < words ; w++ ) hash = fnv1a ( hash , chip8->display[plane][y][w] , 8 ) ;
+        }
+    }
+    return hash ;
+}
+
+// FNV-1a over the whole machine state: registers, stack, timers, memory and display
+uint64_t state_hash ( const chip8_t *chip8 ) {
+    uint64_t hash = display_hash ( chip8 ) ;
+    for ( uint32_t i = 0 ; i < 16 ; i++ ) hash = fnv1a ( hash , chip8->V[i] , 1 ) ;
+    hash = fnv1a ( hash , chip8->I , 2 ) ;
+    hash = fnv1a ( hash , chip8->pc , 2 ) ;
+    hash = fnv1a ( hash , chip8->sp , 1 ) ;
+    for ( uint32_t i = 0 ; i < CHIP8_STACK_SIZE ; i++ ) hash = fnv1a ( hash , chip8->stack[i] , 2 ) ;
+    hash = fnv1a ( hash , chip8->delay_timer , 1 ) ;
+    hash = fnv1a ( hash , chip8->sound_timer , 1 ) ;
+    for ( uint32_t i = 0 ; i <= chip8_address_mask ( chip8 ) ; i++ ) hash = fnv1a ( hash , chip8->memory[i] , 1 ) ;
+    // SUPER-CHIP and XO-CHIP state, left out while it is still at its reset value
+    if ( chip8->plane_mask != 0x01 ) hash = fnv1a ( hash , chip8->plane_mask , 1 ) ;
+    for ( uint32_t i = 0 ; i < 16 ; i++ ) {
+        if ( chip8->flags[i] ) hash = fnv1a ( hash , (uint64_t)i << 8 | chip8->flags[i] , 2 ) ;
+    }
+    return hash ;
+}
@@ -0,0 +1,438 @@
+/**
+ * @file savestate.c
+ * @brief Versioned Save States and Background Writer
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * Encodes the machine state into a small portable blob (see savestate.h)
+ * and writes slot files from a background thread. Encoding a state takes
+ * a few microseconds; the fopen/fwrite/fclose that used to run inside the
+ * frame now happens on the writer thread.
+ */
+#define _POSIX_C_SOURCE 200809L // pthreads
+
+#include <pthread.h>
+#include "savestate.h"
+#include "jit.h"
+#include "aot.h"
+
+#define WRITER_QUEUE_DEPTH 4
+#define MODE_HIRES 0x01
+#define MODE_XO_CHIP 0x02
+
+// ---------------------------------------------------------------------------
+// Byte-level helpers
+
+typedef struct {
+    uint8_t *data ;
+    size_t size ;
+    size_t capacity ;
+} writer_t ;
+
+typedef struct {
+    const uint8_t *data ;
+    size_t size ;
+    size_t offset ;
+    bool ok ;
+} reader_t ;
+
+static void put8 ( writer_t *w , uint8_t value ) {
+    if ( w->size < w->capacity ) w->data[w->size] = value ;
+    w->size++ ;
+}
+
+static void put16 ( writer_t *w , uint16_t value ) {
+    put8 ( w , value & 0xFF ) ;
+    put8 ( w , value >> 8 ) ;
+}
+
+static void put32 ( writer_t *w , uint32_t value ) {
+    for ( int i = 0 ; i < 4 ; i++ ) put8 ( w , (value >> (8 * i)) & 0xFF ) ;
+}
+
+static void put64 ( writer_t *w , uint64_t value ) {
+    for ( int i = 0 ; i < 8 ; i++ ) put8 ( w , (value >> (8 * i)) & 0xFF ) ;
+}
+
+static uint8_t get8 ( reader_t *r ) {
+    if ( r->offset >= r->size ) {
+        r->ok = false ;
+        return 0 ;
+    }
+    return r->data[r->offset++] ;
+}
+
+static uint16_t get16 ( reader_t *r ) {
+    const uint16_t low = get8 ( r ) ;
+    return low | (uint16_t)(get8 ( r ) << 8) ;
+}
+
+static uint32_t get32 ( reader_t *r ) {
+    uint32_t value = 0 ;
+    for ( int i = 0 ; i < 4 ; i++ ) value |= (uint32_t)get8 ( r ) << (8 * i) ;
+    return value ;
+}
+
+static uint64_t get64 ( reader_t *r ) {
+    uint64_t value = 0 ;
+    for ( int i = 0 ; i < 8 ; i++ ) value |= (uint64_t)get8 ( r ) << (8 * i) ;
+    return value ;
+}
+
+// Bitwise CRC-32 (IEEE), a save state is rarely more than a few kilobytes
+static uint32_t crc32 ( const uint8_t *data , size_t size ) {
+    uint32_t crc = 0xFFFFFFFFu ;
+    for ( size_t i = 0 ; i < size ; i++ ) {
+        crc ^= data[i] ;
+        for ( int bit = 0 ; bit < 8 ; bit++ ) crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1)) ;
+    }
+    return ~crc ;
+}
+
+// PackBits: a control byte n in 0..127 copies n+1 literals, 129..255 repeats
+// the next byte 257-n times. Memory is mostly zeros past the ROM, so 4 KB
+// (or 64 KB for XO-CHIP) usually packs into the size of the ROM plus a few
+// dozen bytes.
+static void packbits ( writer_t *w , const uint8_t *data , size_t size ) {
+    size_t i = 0 ;
+    while ( i < size ) {
+        size_t run = 1 ;
+        while ( i + run < size && run < 128 && data[i + run] == data[i] ) run++ ;
+        if ( run >= 3 ) {
+            put8 ( w , (uint8_t)(257 - run) ) ;
+            put8 ( w , data[i] ) ;
+            i += run ;
+            continue ;
+        }
+        // Literal stretch until the next run of 3 or more
+        size_t literal = 0 ;
+        while ( i + literal < size && literal < 128 ) {
+            const size_t at = i + literal ;
+            if ( at + 2 < size && data[at] == data[at + 1] && data[at] == data[at + 2] ) break ;
+            literal++ ;
+        }
+        put8 ( w , (uint8_t)(literal - 1) ) ;
+        for ( size_t k = 0 ; k < literal ; k++ ) put8 ( w , data[i + k] ) ;
+        i += literal ;
+    }
+}
+
+static bool unpackbits ( reader_t *r , size_t packed_size , uint8_t *out , size_t size ) {
+    const size_t end = r->offset + packed_size ;
+    size_t filled = 0 ;
+    while ( r->ok && r->offset < end ) {
+        const uint8_t control = get8 ( r ) ;
+        if ( control < 128 ) {
+            const size_t count = control + 1u ;
+            if ( filled + count > size ) return false ;
+            for ( size_t k = 0 ; k < count ; k++ ) out[filled++] = get8 ( r ) ;
+        } else if ( control > 128 ) {
+            const size_t count = 257u - control ;
+            if ( filled + count > size ) return false ;
+            memset ( &out[filled] , get8 ( r ) , count ) ;
+            filled += count ;
+        }
+    }
+    return r->ok && r->offset == end && filled == size ;
+}
+
+// ---------------------------------------------------------------------------
+// Encoding
+
+// Display planes as little-endian bytes, word by word
+static void display_to_bytes ( const chip8_t *chip8 , uint8_t bytes[SAVESTATE_DISPLAY_SIZE] ) {
+    writer_t w = { .data = bytes , .capacity = SAVESTATE_DISPLAY_SIZE } ;
+    const uint64_t *words = &chip8->display[0][0][0] ;
+    for ( size_t i = 0 ; i < SAVESTATE_DISPLAY_SIZE / 8 ; i++ ) put64 ( &w , words[i] ) ;
+}
+
+static void bytes_to_display ( const uint8_t bytes[SAVESTATE_DISPLAY_SIZE] , chip8_t *chip8 ) {
+    reader_t r = { .data = bytes , .size = SAVESTATE_DISPLAY_SIZE , .ok = true } ;
+    uint64_t *words = &chip8->display[0][0][0] ;
+    for ( size_t i = 0 ; i < SAVESTATE_DISPLAY_SIZE / 8 ; i++ ) words[i] = get64 ( &r ) ;
+}
+
+// A u32 size followed by `size` bytes packed with PackBits
+static void put_packed ( writer_t *w , const uint8_t *data , size_t size ) {
+    const size_t length_at = w->size ;
+    put32 ( w , 0 ) ;
+    packbits ( w , data , size ) ;
+    if ( w->size > w->capacity ) return ;
+    const uint32_t packed = (uint32_t)(w->size - length_at - 4) ;
+    for ( int i = 0 ; i < 4 ; i++ ) w->data[length_at + i] = (packed >> (8 * i)) & 0xFF ;
+}
+
+size_t savestate_encode ( const chip8_t *chip8 , uint8_t *buffer , size_t capacity ) {
+    writer_t w = { .data = buffer , .capacity = capacity , .size = SAVESTATE_HEADER_SIZE } ;
+
+    for ( uint32_t i = 0 ; i < 16 ; i++ ) put8 ( &w , chip8->V[i] ) ;
+    put16 ( &w , chip8->I ) ;
+    put16 ( &w , chip8->pc ) ;
+    put8 ( &w , chip8->sp ) ;
+    put8 ( &w , chip8->delay_timer ) ;
+    put8 ( &w , chip8->sound_timer ) ;
+    put8 ( &w , (chip8->hires ? MODE_HIRES : 0) | (chip8->xo_chip ? MODE_XO_CHIP : 0) ) ;
+    put32 ( &w , chip8->rng ) ;
+
+    uint16_t keys = 0 ;
+    for ( uint32_t k = 0 ; k < 16 ; k++ ) if ( chip8->keypad[k] ) keys |= 1u << k ;
+    put16 ( &w , keys ) ;
+
+    for ( uint32_t i = 0 ; i < CHIP8_STACK_SIZE ; i++ ) put16 ( &w , chip8->stack[i] ) ;
+    put8 ( &w , chip8->plane_mask ) ;
+    for ( uint32_t i = 0 ; i < 16 ; i++ ) put8 ( &w , chip8->flags[i] ) ;
+
+    uint8_t display[SAVESTATE_DISPLAY_SIZE] ;
+    display_to_bytes ( chip8 , display ) ;
+    put_packed ( &w , display , sizeof ( display ) ) ;
+    put_packed ( &w , chip8->memory , chip8_address_mask ( chip8 ) + 1u ) ;
+    if ( w.size > capacity ) return 0 ;
+
+    const size_t payload = w.size - SAVESTATE_HEADER_SIZE ;
+    writer_t header = { .data = buffer , .capacity = SAVESTATE_HEADER_SIZE } ;
+    for ( int i = 0 ; i < 4 ; i++ ) put8 ( &header , SAVESTATE_MAGIC[i] ) ;
+    put16 ( &header , SAVESTATE_VERSION ) ;
+    put16 ( &header , SAVESTATE_HEADER_SIZE ) ;
+    put32 ( &header , (uint32_t)payload ) ;
+    put32 ( &header , crc32 ( buffer + SAVESTATE_HEADER_SIZE , payload ) ) ;
+    return w.size ;
+}
+
+bool savestate_decode ( chip8_t *chip8 , const uint8_t *buffer , size_t size ) {
+    reader_t r = { .data = buffer , .size = size , .ok = true } ;
+
+    if ( size < SAVESTATE_HEADER_SIZE || memcmp ( buffer , SAVESTATE_MAGIC , 4 ) != 0 ) {
+        CHIP8_LOG ( "Not a CHIP-8 save state\n" ) ;
+        return false ;
+    }
+    r.offset = 4 ;
+    const uint16_t version = get16 ( &r ) ;
+    const uint16_t header_size = get16 ( &r ) ;
+    const uint32_t payload = get32 ( &r ) ;
+    const uint32_t checksum = get32 ( &r ) ;
+    if ( version != SAVESTATE_VERSION && version != 1 ) {
+        CHIP8_LOG ( "Save state version %u is not supported (expected 1 to %u)\n" , version , SAVESTATE_VERSION ) ;
+        return false ;
+    }
+    if ( header_size < SAVESTATE_HEADER_SIZE || header_size > size || payload != size - header_size ) {
+        CHIP8_LOG ( "Save state is truncated\n" ) ;
+        return false ;
+    }
+    if ( crc32 ( buffer + header_size , payload ) != checksum ) {
+        CHIP8_LOG ( "Save state checksum mismatch\n" ) ;
+        return false ;
+    }
+
+    // Decode into scratch copies of the registers so a bad payload changes nothing
+    r.offset = header_size ;
+    uint8_t V[16] ;
+    for ( uint32_t i = 0 ; i < 16 ; i++ ) V[i] = get8 ( &r ) ;
+    const uint16_t I = get16 ( &r ) ;
+    const uint16_t pc = get16 ( &r ) ;
+    const uint8_t sp = get8 ( &r ) ;
+    const uint8_t delay_timer = get8 ( &r ) ;
+    const uint8_t sound_timer = get8 ( &r ) ;
+    const uint8_t mode = get8 ( &r ) ; // Reserved (0) in version 1
+    const uint32_t rng = get32 ( &r ) ;
+    const uint16_t keys = get16 ( &r ) ;
+    uint16_t stack[CHIP8_STACK_SIZE] ;
+    for ( uint32_t i = 0 ; i < CHIP8_STACK_SIZE ; i++ ) stack[i] = get16 ( &r ) ;
+
+    // The address space comes with the quirk profile, which a state does not change
+    const bool xo_chip = version > 1 && (mode & MODE_XO_CHIP) ;
+    if ( xo_chip != chip8->xo_chip ) {
+        CHIP8_LOG ( "Save state is for %s machine\n" , xo_chip ? "an XO-CHIP" : "a CHIP-8 or SUPER-CHIP" ) ;
+        return false ;
+    }
+
+    uint8_t plane_mask = 0x01 , flags[16] = { 0 } ;
+    uint8_t display[SAVESTATE_DISPLAY_SIZE] = { 0 } ;
+    uint8_t memory[CHIP8_MAX_MEMORY_SIZE] ; // unpackbits fills exactly memory_size bytes
+    const size_t memory_size = xo_chip ? CHIP8_MAX_MEMORY_SIZE : CHIP8_MEMORY_SIZE ;
+    bool ok ;
+    if ( version == 1 ) {
+        // 64x32 display, one word per row (plane 0, word 0), and 4K of memory
+        writer_t w = { .data = display , .capacity = sizeof ( display ) } ;
+        for ( uint32_t y = 0 ; y < CHIP8_DISPLAY_HEIGHT ; y++ ) {
+            w.size = 8 * CHIP8_ROW_WORDS * y ;
+            put64 ( &w , get64 ( &r ) ) ;
+        }
+        const uint16_t packed = get16 ( &r ) ;
+        ok = r.ok && unpackbits ( &r , packed , memory , memory_size ) ;
+    } else {
+        plane_mask = get8 ( &r ) ;
+        for ( uint32_t i = 0 ; i < 16 ; i++ ) flags[i] = get8 ( &r ) ;
+        const uint32_t packed_display = get32 ( &r ) ;
+        ok = r.ok && unpackbits ( &r , packed_display , display , sizeof ( display ) ) ;
+        const uint32_t packed_memory = get32 ( &r ) ;
+        ok = ok && r.ok && unpackbits ( &r , packed_memory , memory , memory_size ) ;
+    }
+    if ( !ok ) {
+        CHIP8_LOG ( "Save state payload is corrupt\n" ) ;
+        return false ;
+    }
+
+    memcpy ( chip8->V , V , sizeof ( V ) ) ;
+    chip8->I = I ;
+    chip8->pc = pc ;
+    chip8->sp = sp ;
+    chip8->delay_timer = delay_timer ;
+    chip8->sound_timer = sound_timer ;
+    chip8->rng = rng ? rng : CHIP8_RNG_SEED ;
+    for ( uint32_t k = 0 ; k < 16 ; k++ ) chip8->keypad[k] = (keys >> k) & 1 ;
+    memcpy ( chip8->stack , stack , sizeof ( stack ) ) ;
+    bytes_to_display ( display , chip8 ) ;
+    memcpy ( chip8->flags , flags , sizeof ( flags ) ) ;
+    chip8->plane_mask = plane_mask ;
+    chip8->hires = mode & MODE_HIRES ;
+
+    // A classic machine never touches memory (or decodes) past 4K
+    memcpy ( chip8->memory , memory , memory_size ) ;
+
+    // Cached decodes and native blocks may not match the loaded memory
+    flush_decoded ( chip8 ) ;
+    if ( chip8->jit ) jit_flush ( chip8->jit ) ;
+    if ( chip8->aot ) aot_reset ( chip8 ) ;
+    return true ;
+}
+
+// ---------------------------------------------------------------------------
+// Background writer: a small FIFO of encoded states drained by one thread
+
+typedef struct {
+    char filename[sizeof ( ((chip8_t *)0)->save_filename )] ;
+    uint8_t data[SAVESTATE_MAX_SIZE] ;
+    size_t size ;
+} write_job_t ;
+
+static struct {
+    pthread_mutex_t lock ;
+    pthread_cond_t changed ;
+    write_job_t jobs[WRITER_QUEUE_DEPTH] ;
+    uint32_t head ;    // Next job to write
+    uint32_t pending ; // Jobs queued or being written
+    bool started ;
+} writer = { .lock = PTHREAD_MUTEX_INITIALIZER , .changed = PTHREAD_COND_INITIALIZER } ;
+
+// Write through a temporary file so a crash mid-write keeps the old slot
+static bool write_file ( const write_job_t *job ) {
+    char temp[sizeof ( job->filename ) + 4] ;
+    snprintf ( temp , sizeof ( temp ) , "%s.tmp" , job->filename ) ;
+
+    FILE *file = fopen ( temp , "wb" ) ;
+    if ( !file ) {
+        CHIP8_LOG ( "Could not open file %s for writing\n" , temp ) ;
+        return false ;
+    }
+    const bool written = fwrite ( job->data , 1 , job->size , file ) == job->size ;
+    if ( fclose ( file ) != 0 || !written ) {
+        CHIP8_LOG ( "Could not write to file %s\n" , temp ) ;
+        remove ( temp ) ;
+        return false ;
+    }
+    if ( rename ( temp , job->filename ) != 0 ) {
+        CHIP8_LOG ( "Could not replace %s\n" , job->filename ) ;
+        remove ( temp ) ;
+        return false ;
+    }
+    return true ;
+}
+
+static void *writer_main ( void *unused ) {
+    (void)unused ;
+    pthread_mutex_lock ( &writer.lock ) ;
+    for ( ;; ) {
+        while ( writer.pending == 0 ) pthread_cond_wait ( &writer.changed , &writer.lock ) ;
+        // The slot stays reserved until the write is done, so the job can be read unlocked
+        const write_job_t *job = &writer.jobs[writer.head] ;
+        pthread_mutex_unlock ( &writer.lock ) ;
+        write_file ( job ) ;
+        pthread_mutex_lock ( &writer.lock ) ;
+        writer.head = (writer.head + 1) % WRITER_QUEUE_DEPTH ;
+        writer.pending-- ;
+        pthread_cond_broadcast ( &writer.changed ) ;
+    }
+    return NULL ;
+}
+
+// Queue one encoded state; falls back to writing inline if no thread can start
+static bool enqueue_write ( const char *filename , const chip8_t *chip8 ) {
+    pthread_mutex_lock ( &writer.lock ) ;
+    if ( !writer.started ) {
+        pthread_t thread ;
+        if ( pthread_create ( &thread , NULL , writer_main , NULL ) == 0 ) {
+            pthread_detach ( thread ) ;
+            writer.started = true ;
+        }
+    }
+    if ( !writer.started ) {
+        pthread_mutex_unlock ( &writer.lock ) ;
+        static write_job_t job ;
+        snprintf ( job.filename , sizeof ( job.filename ) , "%s" , filename ) ;
+        job.size = savestate_encode ( chip8 , job.data , sizeof ( job.data ) ) ;
+        return job.size && write_file ( &job ) ;
+    }
+    // Only waits when four saves are already in flight
+    while ( writer.pending == WRITER_QUEUE_DEPTH ) pthread_cond_wait ( &writer.changed , &writer.lock ) ;
+    write_job_t *job = &writer.jobs[(writer.head + writer.pending) % WRITER_QUEUE_DEPTH] ;
+    snprintf ( job->filename , sizeof ( job->filename ) , "%s" , filename ) ;
+    job->size = savestate_encode ( chip8 , job->data , sizeof ( job->data ) ) ;
+    const bool ok = job->size != 0 ;
+    if ( ok ) {
+        writer.pending++ ;
+        pthread_cond_broadcast ( &writer.changed ) ;
+    }
+    pthread_mutex_unlock ( &writer.lock ) ;
+    return ok ;
+}
+
+void savestate_flush ( void ) {
+    pthread_mutex_lock ( &writer.lock ) ;
+    while ( writer.pending != 0 ) pthread_cond_wait ( &writer.changed , &writer.lock ) ;
+    pthread_mutex_unlock ( &writer.lock ) ;
+}
+
+// ---------------------------------------------------------------------------
+// Slot files
+
+// Generate save filename based on ROM name and slot number
+static void prepare_save_filename(chip8_t *chip8, char *save_file, size_t save_file_size, int slot) {
+    // Copy ROM name to working buffer
+    strncpy(chip8->rom_name_copy, chip8->rom_name, sizeof(chip8->rom_name_copy) - 1);
+    chip8->rom_name_copy[sizeof(chip8->rom_name_copy) - 1] = '\0';
+
+    // Remove file extension if present
+    char *dot = strrchr(chip8->rom_name_copy, '.');
+    if (dot) *dot = '\0';
+
+    // Create filename: "romname_slotN.bin"
+    snprintf(save_file, save_file_size, "%s_slot%d.bin", chip8->rom_name_copy, slot);
+}
+
+// Save current CHIP-8 state to file (returns once the state is queued)
+bool save_state ( chip8_t *chip8 , char *save_file , size_t save_file_size , int slot ) {
+    prepare_save_filename ( chip8 , save_file , save_file_size , slot ) ;
+    return enqueue_write ( save_file , chip8 ) ;
+}
+
+// Load CHIP-8 state from save file
+bool load_state ( chip8_t *chip8 , char *save_file , size_t save_file_size , int slot ) {
+    prepare_save_filename ( chip8 , save_file , save_file_size , slot ) ;
+    // A save to this slot may still be in flight
+    savestate_flush () ;
+
+    FILE *file = fopen ( save_file , "rb" ) ;
+    if ( !file ) {
+        CHIP8_LOG ( "Could not open file %s for reading\n" , save_file ) ;
+        return false ;
+    }
+    uint8_t buffer[SAVESTATE_MAX_SIZE] ;
+    const size_t size = fread ( buffer , 1 , sizeof ( buffer ) , file ) ;
+    const bool too_long = fgetc ( file ) != EOF ;
+    fclose ( file ) ;
+    if ( too_long ) {
+        CHIP8_LOG ( "Save state %s is too large\n" , save_file ) ;
+        return false ;
+    }
+    return savestate_decode ( chip8 , buffer , size ) ;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file scheduler.c
+ * @brief Frame Scheduler for the CHIP-8 Emulator
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * Accumulates real elapsed time from SDL's high-resolution counter and
+ * turns it into whole 60 Hz frames. Each frame runs exactly the CPU
+ * cycles it owes (fractions carry over, so the long-run rate matches
+ * instructions_per_second exactly) and is followed by one timer tick.
+ * Time spent rendering or in the OS is counted like any other time.
+ *
+ * Fast-forward multiplies the frames due by a speed factor, and uncapped
+ * runs as many frames as it can. Either way the caller stops once one
+ * real-time frame has passed, so input and the window stay responsive.
+ */
+
+#include "scheduler.h"
+
+#define SPIN_WAIT_MS 2 // Last part of the wait is spent spinning, SDL_Delay is not precise enough
+
+void scheduler_init ( scheduler_t *scheduler ) {
+    memset ( scheduler , 0 , sizeof ( scheduler_t ) ) ;
+    scheduler->frequency = SDL_GetPerformanceFrequency () ;
+    scheduler->last_counter = SDL_GetPerformanceCounter () ;
+}
+
+// Forget accumulated time (after a pause or a long stall)
+void scheduler_reset ( scheduler_t *scheduler ) {
+    scheduler->last_counter = SDL_GetPerformanceCounter () ;
+    scheduler->elapsed = 0 ;
+}
+
+// Add the time since the last call and return how many frames are due at
+// `speed` emulated frames per real-time frame. At SCHEDULER_UNCAPPED this
+// is UINT32_MAX, the loop running frames until the slice is over.
+// Faster than real time, stop early once scheduler_slice_over says so.
+uint32_t scheduler_frames_due ( scheduler_t *scheduler , uint32_t speed ) {
+    const uint64_t now = SDL_GetPerformanceCounter () ;
+    scheduler->uncapped = speed == SCHEDULER_UNCAPPED ;
+    scheduler->slice_end = speed == 1 ? UINT64_MAX : now + scheduler->frequency / SCHEDULER_FRAME_RATE ;
+    if ( scheduler->uncapped ) {
+        scheduler->last_counter = now ;
+        scheduler->elapsed = 0 ; // nothing is owed when running flat out
+        return UINT32_MAX ;
+    }
+    scheduler->elapsed += ( now - scheduler->last_counter ) * SCHEDULER_FRAME_RATE ;
+    scheduler->last_counter = now ;
+
+    uint64_t frames = scheduler->elapsed / scheduler->frequency ;
+    scheduler->elapsed %= scheduler->frequency ;
+    if ( frames > SCHEDULER_MAX_CATCHUP_FRAMES ) frames = SCHEDULER_MAX_CATCHUP_FRAMES ; // drop time instead of spiralling
+    frames *= speed ;
+    return frames > UINT32_MAX ? UINT32_MAX : (uint32_t)frames ;
+}
+
+// Faster than real time: true once the real-time frame begun by scheduler_frames_due is used up
+bool scheduler_slice_over ( const scheduler_t *scheduler ) {
+    return scheduler->slice_end != UINT64_MAX && SDL_GetPerformanceCounter () >= scheduler->slice_end ;
+}
+
+// Run the CPU for one frame and return the number of instructions executed
+uint32_t scheduler_run_frame ( scheduler_t *scheduler , chip8_t *chip8 , const config_t *config ) {
+    return run_frame ( chip8 , &scheduler->budget , config->instructions_per_second , config->vip_timing , UINT32_MAX ) ;
+}
+
+// Sleep until the next frame is due: coarse SDL_Delay, then spin
+void scheduler_wait ( scheduler_t *scheduler ) {
+    if ( scheduler->uncapped ) return ; // the frames themselves took a real-time frame
+    const uint64_t now = SDL_GetPerformanceCounter () ;
+    const uint64_t owed = scheduler->elapsed + ( now - scheduler->last_counter ) * SCHEDULER_FRAME_RATE ;
+    if ( owed >= scheduler->frequency ) return ; // already late
+
+    const uint64_t wait_ticks = ( scheduler->frequency - owed + SCHEDULER_FRAME_RATE - 1 ) / SCHEDULER_FRAME_RATE ;
+    const uint64_t target = now + wait_ticks ;
+    const uint64_t wait_ms = wait_ticks * 1000 / scheduler->frequency ;
+
+    if ( wait_ms > SPIN_WAIT_MS ) SDL_Delay ( (uint32_t)( wait_ms - SPIN_WAIT_MS ) ) ;
+    while ( SDL_GetPerformanceCounter () < target ) {
+        // spin for the sub-millisecond remainder
+    }
+}
@@ -0,0 +1,143 @@
+/**
+ * @file workpool.c
+ * @brief Work-Stealing Thread Pool
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * Fixed set of POSIX threads draining per-worker task deques. Tasks here
+ * are whole emulator runs (milliseconds to seconds each), so a mutex per
+ * deque costs nothing measurable and keeps the pool simple; stealing
+ * takes care of uneven task lengths.
+ */
+#define _POSIX_C_SOURCE 200809L // sysconf, pthreads
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "workpool.h"
+
+typedef struct {
+    pthread_mutex_t lock ;
+    size_t *tasks ;
+    size_t head ; // Next task to steal
+    size_t tail ; // One past the next task the owner pops
+} task_deque_t ;
+
+typedef struct workpool workpool_t ;
+
+typedef struct {
+    workpool_t *pool ;
+    unsigned index ;
+    pthread_t thread ;
+} worker_t ;
+
+struct workpool {
+    task_deque_t *deques ;
+    worker_t *workers ;
+    unsigned threads ;
+    workpool_task_fn fn ;
+    void *context ;
+} ;
+
+unsigned workpool_default_threads ( void ) {
+    const long online = sysconf ( _SC_NPROCESSORS_ONLN ) ;
+    return online > 0 ? (unsigned)online : 1 ;
+}
+
+static bool pop_own ( task_deque_t *deque , size_t *task ) {
+    bool found = false ;
+    pthread_mutex_lock ( &deque->lock ) ;
+    if ( deque->head < deque->tail ) {
+        *task = deque->tasks[--deque->tail] ;
+        found = true ;
+    }
+    pthread_mutex_unlock ( &deque->lock ) ;
+    return found ;
+}
+
+static bool steal ( task_deque_t *deque , size_t *task ) {
+    bool found = false ;
+    pthread_mutex_lock ( &deque->lock ) ;
+    if ( deque->head < deque->tail ) {
+        *task = deque->tasks[deque->head++] ;
+        found = true ;
+    }
+    pthread_mutex_unlock ( &deque->lock ) ;
+    return found ;
+}
+
+static void *worker_main ( void *argument ) {
+    worker_t *worker = argument ;
+    workpool_t *pool = worker->pool ;
+    size_t task ;
+
+    for ( ;; ) {
+        if ( pop_own ( &pool->deques[worker->index] , &task ) ) {
+            pool->fn ( pool->context , task , worker->index ) ;
+            continue ;
+        }
+        // Own deque is empty: scan the others, starting with the next worker.
+        // No new tasks are ever added, so a full empty scan means we are done.
+        bool stolen = false ;
+        for ( unsigned i = 1 ; i < pool->threads && !stolen ; i++ ) {
+            stolen = steal ( &pool->deques[(worker->index + i) % pool->threads] , &task ) ;
+        }
+        if ( !stolen ) break ;
+        pool->fn ( pool->context , task , worker->index ) ;
+    }
+    return NULL ;
+}
+
+bool workpool_run ( unsigned threads , size_t count , workpool_task_fn fn , void *context ) {
+    if ( threads == 0 ) threads = 1 ;
+    if ( count > 0 && threads > count ) threads = (unsigned)count ;
+
+    workpool_t pool = { .threads = threads , .fn = fn , .context = context } ;
+    pool.deques = calloc ( threads , sizeof ( task_deque_t ) ) ;
+    pool.workers = calloc ( threads , sizeof ( worker_t ) ) ;
+    size_t *storage = malloc ( ( count ? count : 1 ) * sizeof ( size_t ) ) ;
+    if ( !pool.deques || !pool.workers || !storage ) {
+        free ( pool.deques ) ;
+        free ( pool.workers ) ;
+        free ( storage ) ;
+        return false ;
+    }
+
+    // Deal tasks round-robin: worker w owns tasks w, w + threads, ...
+    // stored in one contiguous slice of `storage`, in reverse so the owner
+    // pops them in order
+    size_t offset = 0 ;
+    for ( unsigned w = 0 ; w < threads ; w++ ) {
+        task_deque_t *deque = &pool.deques[w] ;
+        pthread_mutex_init ( &deque->lock , NULL ) ;
+        deque->tasks = &storage[offset] ;
+        for ( size_t task = w ; task < count ; task += threads ) deque->tasks[deque->tail++] = task ;
+        for ( size_t i = 0 ; i < deque->tail / 2 ; i++ ) {
+            const size_t swap = deque->tasks[i] ;
+            deque->tasks[i] = deque->tasks[deque->tail - 1 - i] ;
+            deque->tasks[deque->tail - 1 - i] = swap ;
+        }
+        offset += deque->tail ;
+    }
+
+    // Workers that fail to start simply leave their deque to be stolen by the others
+    unsigned started = 0 ;
+    for ( unsigned w = 0 ; w < threads ; w++ ) {
+        pool.workers[started] = (worker_t) { .pool = &pool , .index = w } ;
+        if ( pthread_create ( &pool.workers[started].thread , NULL , worker_main , &pool.workers[started] ) == 0 ) started++ ;
+    }
+    if ( started == 0 ) {
+        // No thread at all: run everything on the caller
+        for ( unsigned w = 0 ; w < threads ; w++ ) {
+            size_t task ;
+            while ( pop_own ( &pool.deques[w] , &task ) ) fn ( context , task , 0 ) ;
+        }
+    }
+    for ( unsigned w = 0 ; w < started ; w++ ) pthread_join ( pool.workers[w].thread , NULL ) ;
+
+    for ( unsigned w = 0 ; w < threads ; w++ ) pthread_mutex_destroy ( &pool.deques[w].lock ) ;
+    free ( storage ) ;
+    free ( pool.deques ) ;
+    free ( pool.workers ) ;
+    return true ;
+}
@@ -0,0 +1,555 @@
+/**
+ * @file aot.c
+ * @brief Ahead-of-Time Compiler for CHIP-8 ROMs
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * Writes a ROM as a C source file with one function per basic block (see
+ * aot.h for how the module runs) and checks a built module against the
+ * interpreter frame by frame:
+ *
+ *     chip8-aot -o aot/Tetris.c roms/Tetris.ch8
+ *     cc -O2 -fPIC -shared -Iinclude aot/Tetris.c -o aot/Tetris.so
+ *     chip8-aot --check aot/Tetris.so roms/Tetris.ch8
+ *
+ * Blocks come from the control-flow analysis (cfg.h). A block is cut again
+ * after every instruction left to the interpreter, so the dispatcher finds
+ * compiled code right after it. The generated code follows the same quirk
+ * profile as the interpreter copy for chip8->quirks, folded in at
+ * generation time.
+ */
+
+#include "chip8.h"
+#include "aot.h"
+#include "cfg.h"
+#include "disasm.h"
+#include "runner.h"
+
+typedef struct {
+    const chip8_t *chip8 ;
+    const cfg_t *cfg ;
+    const quirk_set_t *quirks ;
+    uint8_t *entry ;  // Per address: a generated function may start here
+    uint16_t *count ; // Per entry: instructions its function runs (0: none is generated)
+    uint16_t *length ; // Per entry: bytes the function is compiled from
+    uint8_t *idle_loop ; // Per entry: head of an idle loop (see idle_back_edge)
+    FILE *out ;
+} generator_t ;
+
+static uint16_t opcode_at ( const generator_t *gen , uint32_t address ) {
+    const uint16_t mask = gen->cfg->mask ;
+    return (gen->cfg->memory[address & mask] << 8) | gen->cfg->memory[(address + 1) & mask] ;
+}
+
+// Handler the interpreter runs for the instruction at address (see decode_at)
+static uint8_t op_at ( const generator_t *gen , uint32_t address ) {
+    const uint8_t op = decode_op ( opcode_at ( gen , address ) ) ;
+    return op == OP_LD_I_LONG && !gen->cfg->xo_chip ? OP_NOP : op ;
+}
+
+static uint16_t instruction_length ( const generator_t *gen , uint32_t address ) {
+    return op_at ( gen , address ) == OP_LD_I_LONG ? 4 : 2 ;
+}
+
+// Draws, waits or stops: the block returns to the dispatcher before it.
+// So does a skip over the end of the image, whose length depends on
+// bytes nothing compiles.
+static bool interpreted ( const generator_t *gen , const cfg_block_t *block , uint32_t address ) {
+    switch ( op_at ( gen , address ) ) {
+        case OP_CLS : case OP_DRW : case OP_LD_VX_K : case OP_SCD : case OP_SCU : case OP_SCR : case OP_SCL :
+        case OP_EXIT : case OP_LORES : case OP_HIRES :
+            return true ;
+        case OP_SE_VX_NN : case OP_SNE_VX_NN : case OP_SE_VX_VY : case OP_SNE_VX_VY : case OP_SKP : case OP_SKNP :
+            return block->successor_count < 2 ;
+        default :
+            return false ;
+    }
+}
+
+// Reads or writes V0-VF
+static bool uses_registers ( uint8_t op ) {
+    return op != OP_NOP && op != OP_RET && op != OP_JP && op != OP_CALL && op != OP_LD_I && op != OP_LD_I_LONG && op != OP_PLANE ;
+}
+
+// Mark where functions start: every block, and every instruction after one
+// the interpreter runs
+static void find_entries ( generator_t *gen ) {
+    const cfg_t *cfg = gen->cfg ;
+    for ( size_t b = 0 ; b < cfg->block_count ; b++ ) {
+        const cfg_block_t *block = &cfg->blocks[b] ;
+        gen->entry[block->start] = 1 ;
+        for ( uint32_t pc = block->start ; pc < block->last ; pc += instruction_length ( gen , pc ) ) {
+            if ( interpreted ( gen , block , pc ) ) gen->entry[pc + instruction_length ( gen , pc )] = 1 ;
+        }
+    }
+    // Size every function before any is written: callers test for them and prologues check the count
+    for ( size_t b = 0 ; b < cfg->block_count ; b++ ) {
+        const cfg_block_t *block = &cfg->blocks[b] ;
+        uint32_t start = block->start ;
+        uint16_t count = 0 ;
+        for ( uint32_t pc = block->start ; ; pc += instruction_length ( gen , pc ) ) {
+            if ( interpreted ( gen , block , pc ) ) {
+                gen->count[start] = count ;
+                gen->length[start] = (uint16_t)( pc - start ) ;
+                if ( pc == block->last ) break ;
+                start = pc + instruction_length ( gen , pc ) ;
+                count = 0 ;
+                continue ;
+            }
+            count++ ;
+            if ( pc == block->last ) {
+                gen->count[start] = count ;
+                gen->length[start] = (uint16_t)( block->end - start ) ;
+                // An XO-CHIP skip steps over two or four bytes depending on the next instruction
+                if ( block->kind == CFG_END_SKIP && cfg->xo_chip ) gen->length[start] += 2 ;
+                break ;
+            }
+        }
+    }
+}
+
+// Can the loop head at `from` get back to the jump at `address` through idle
+// instructions alone? Skips are followed both ways, so a polling loop that
+// steps over calls qualifies; skip_idle_loop checks the path actually taken.
+static bool idle_path ( const generator_t *gen , uint32_t from , uint32_t address , uint8_t *visited , uint32_t steps ) {
+    if ( from == address ) return true ;
+    if ( steps == IDLE_MAX_STEPS || from > gen->cfg->mask || visited[from] ) return false ;
+    visited[from] = 1 ;
+    const uint8_t op = op_at ( gen , from ) ;
+    if ( !idle_instruction ( op ) ) return false ;
+    const uint32_t next = from + 2 ;
+    switch ( op ) {
+        case OP_JP :
+            return idle_path ( gen , opcode_at ( gen , from ) & 0x0FFF , address , visited , steps + 1 ) ;
+        case OP_SE_VX_NN : case OP_SNE_VX_NN : case OP_SE_VX_VY : case OP_SNE_VX_VY : case OP_SKP : case OP_SKNP :
+            return idle_path ( gen , next , address , visited , steps + 1 ) ||
+                   idle_path ( gen , next + instruction_length ( gen , next ) , address , visited , steps + 1 ) ;
+        default :
+            return idle_path ( gen , next , address , visited , steps + 1 ) ;
+    }
+}
+
+// Is the jump at `address` to `target` the back edge of an idle loop?
+static bool idle_back_edge ( const generator_t *gen , uint32_t address , uint32_t target ) {
+    if ( target > address ) return false ;
+    uint8_t *visited = calloc ( (size_t)gen->cfg->mask + 1 , 1 ) ;
+    const bool idle = visited && idle_path ( gen , target , address , visited , 0 ) ;
+    free ( visited ) ;
+    return idle ;
+}
+
+static bool has_function ( const generator_t *gen , uint32_t address ) {
+    return address <= gen->cfg->mask && gen->entry[address] && gen->count[address] > 0 ;
+}
+
+// Continue at target: straight into its function, else back to the dispatcher
+static void emit_goto ( const generator_t *gen , uint32_t target , const char *indent ) {
+    if ( has_function ( gen , target ) ) fprintf ( gen->out , "%sreturn block_%03X ( chip8 , budget ) ;\n" , indent , target ) ;
+    else fprintf ( gen->out , "%schip8->pc = 0x%03X ; return budget ;\n" , indent , target ) ;
+}
+
+// After a memory write: leave if it hit compiled code, refunding the instructions not run
+static void emit_write_check ( const generator_t *gen , const char *address , uint32_t length , uint32_t next , uint32_t rest ) {
+    fprintf ( gen->out , "    chip8->aot->invalidate ( chip8 , %s , %u ) ;\n" , address , length ) ;
+    fprintf ( gen->out , "    if ( !chip8->aot->active ) { chip8->pc = 0x%03X ; return budget + %u ; }\n" , next , rest ) ;
+}
+
+// I after FX55/FX65 (the index quirk)
+static void emit_index_update ( const generator_t *gen , uint8_t X ) {
+    if ( gen->quirks->index == INDEX_UNCHANGED ) return ;
+    fprintf ( gen->out , "    chip8->I += %u ;\n" , X + ( gen->quirks->index == INDEX_PAST_LAST ) ) ;
+}
+
+static const char *skip_condition ( uint8_t op , uint8_t X , uint8_t Y , uint8_t NN , char *text , size_t size ) {
+    switch ( op ) {
+        case OP_SE_VX_NN : snprintf ( text , size , "V[0x%X] == 0x%02X" , X , NN ) ; break ;
+        case OP_SNE_VX_NN : snprintf ( text , size , "V[0x%X] != 0x%02X" , X , NN ) ; break ;
+        case OP_SE_VX_VY : snprintf ( text , size , "V[0x%X] == V[0x%X]" , X , Y ) ; break ;
+        case OP_SNE_VX_VY : snprintf ( text , size , "V[0x%X] != V[0x%X]" , X , Y ) ; break ;
+        case OP_SKP : snprintf ( text , size , "chip8->keypad[V[0x%X] & 0x0F]" , X ) ; break ;
+        default : snprintf ( text , size , "!chip8->keypad[V[0x%X] & 0x0F]" , X ) ; break ;
+    }
+    return text ;
+}
+
+// One instruction of a function; `rest` is how many of its instructions come after this one
+static void emit_instruction ( const generator_t *gen , const cfg_block_t *block , uint32_t pc , uint32_t rest ) {
+    FILE *out = gen->out ;
+    const uint16_t mask = gen->cfg->mask ;
+    const uint16_t opcode = opcode_at ( gen , pc ) ;
+    const uint8_t op = op_at ( gen , pc ) ;
+    const uint8_t X = (opcode >> 8) & 0x0F , Y = (opcode >> 4) & 0x0F , NN = opcode & 0xFF ;
+    const uint16_t NNN = opcode & 0x0FFF ;
+    const uint32_t next = pc + instruction_length ( gen , pc ) ;
+
+    char text[DISASM_TEXT_MAX] ;
+    disassemble ( gen->cfg->memory , mask , (uint16_t)pc , gen->cfg->xo_chip , text , sizeof ( text ) ) ;
+    fprintf ( out , "    // 0x%03X: %04X  %s\n" , pc , opcode , text ) ;
+
+    switch ( op ) {
+        case OP_RET :
+            fprintf ( out , "    chip8->pc = chip8->stack[--chip8->sp & %u] ; return budget ;\n" , CHIP8_STACK_SIZE - 1 ) ;
+            return ;
+        case OP_JP :
+            if ( idle_back_edge ( gen , pc , NNN ) && has_function ( gen , NNN ) ) {
+                // Return to the dispatcher instead of chaining, so it can skip whole iterations
+                gen->idle_loop[NNN] = 1 ;
+                fprintf ( out , "    chip8->pc = 0x%03X ; return budget ; // Idle loop\n" , NNN ) ;
+                return ;
+            }
+            emit_goto ( gen , NNN , "    " ) ;
+            return ;
+        case OP_CALL :
+            fprintf ( out , "    chip8->stack[chip8->sp++ & %u] = 0x%03X ;\n" , CHIP8_STACK_SIZE - 1 , next ) ;
+            emit_goto ( gen , NNN , "    " ) ;
+            return ;
+        case OP_SE_VX_NN : case OP_SNE_VX_NN : case OP_SE_VX_VY : case OP_SNE_VX_VY : case OP_SKP : case OP_SKNP : {
+            char condition[48] ;
+            fprintf ( out , "    if ( %s ) {\n" , skip_condition ( op , X , Y , NN , condition , sizeof ( condition ) ) ) ;
+            emit_goto ( gen , block->successors[1] , "        " ) ;
+            fprintf ( out , "    }\n" ) ;
+            emit_goto ( gen , block->successors[0] , "    " ) ;
+            return ;
+        }
+        case OP_JP_V0 :
+            fprintf ( out , "    chip8->pc = (uint16_t)( V[0x%X] + 0x%03X ) ; return budget ;\n" , gen->quirks->jump_vx ? X : 0 , NNN ) ;
+            return ;
+        case OP_LD_VX_NN : fprintf ( out , "    V[0x%X] = 0x%02X ;\n" , X , NN ) ; break ;
+        case OP_ADD_VX_NN : fprintf ( out , "    V[0x%X] += 0x%02X ;\n" , X , NN ) ; break ;
+        case OP_LD_VX_VY : fprintf ( out , "    V[0x%X] = V[0x%X] ;\n" , X , Y ) ; break ;
+        case OP_OR : case OP_AND : case OP_XOR : {
+            const char operator = op == OP_OR ? '|' : op == OP_AND ? '&' : '^' ;
+            fprintf ( out , "    V[0x%X] %c= V[0x%X] ;\n" , X , operator , Y ) ;
+            if ( op == OP_AND ? gen->quirks->vf_reset_and : gen->quirks->vf_reset_or_xor ) fprintf ( out , "    V[0xF] = 0 ;\n" ) ;
+            break ;
+        }
+        case OP_ADD_VX_VY :
+            fprintf ( out , "    { const uint16_t sum = V[0x%X] + V[0x%X] ; V[0x%X] = (uint8_t)sum ; V[0xF] = sum > 255 ; }\n" , X , Y , X ) ;
+            break ;
+        case OP_SUB :
+            fprintf ( out , "    { const uint8_t flag = V[0x%X] <= V[0x%X] ; V[0x%X] -= V[0x%X] ; V[0xF] = flag ; }\n" , Y , X , X , Y ) ;
+            break ;
+        case OP_SUBN :
+            fprintf ( out , "    { const uint8_t flag = V[0x%X] <= V[0x%X] ; V[0x%X] = V[0x%X] - V[0x%X] ; V[0xF] = flag ; }\n" , X , Y , X , Y , X ) ;
+            break ;
+        case OP_SHR : case OP_SHL : {
+            const uint8_t source = gen->quirks->shift_vy ? Y : X ;
+            if ( op == OP_SHR ) fprintf ( out , "    { const uint8_t value = V[0x%X] ; V[0x%X] = value >> 1 ; V[0xF] = value & 1 ; }\n" , source , X ) ;
+            else fprintf ( out , "    { const uint8_t value = V[0x%X] ; V[0x%X] = value << 1 ; V[0xF] = value >> 7 ; }\n" , source , X ) ;
+            break ;
+        }
+        case OP_LD_I : fprintf ( out , "    chip8->I = 0x%03X ;\n" , NNN ) ; break ;
+        case OP_LD_I_LONG : fprintf ( out , "    chip8->I = 0x%04X ;\n" , opcode_at ( gen , pc + 2 ) ) ; break ;
+        case OP_RND :
+            fprintf ( out , "    { uint32_t rng = chip8->rng ; rng ^= rng << 13 ; rng ^= rng >> 17 ; rng ^= rng << 5 ;\n"
+                            "      chip8->rng = rng ; V[0x%X] = (rng >> 24) & 0x%02X ; }\n" , X , NN ) ;
+            break ;
+        case OP_LD_VX_DT : fprintf ( out , "    V[0x%X] = chip8->delay_timer ;\n" , X ) ; break ;
+        case OP_LD_DT_VX : fprintf ( out , "    chip8->delay_timer = V[0x%X] ;\n" , X ) ; break ;
+        case OP_LD_ST_VX : fprintf ( out , "    chip8->sound_timer = V[0x%X] ;\n" , X ) ; break ;
+        case OP_ADD_I_VX : fprintf ( out , "    chip8->I += V[0x%X] ;\n" , X ) ; break ;
+        case OP_LD_F_VX : fprintf ( out , "    chip8->I = V[0x%X] * 5 ;\n" , X ) ; break ;
+        case OP_LD_HF_VX : fprintf ( out , "    chip8->I = 0x%02X + ( V[0x%X] & 0x0F ) * 10 ;\n" , CHIP8_BIG_FONT_ADDRESS , X ) ; break ;
+        case OP_LD_B_VX :
+            fprintf ( out , "    chip8->memory[chip8->I & 0x%X] = V[0x%X] / 100 ;\n" , mask , X ) ;
+            fprintf ( out , "    chip8->memory[(chip8->I + 1) & 0x%X] = V[0x%X] / 10 %% 10 ;\n" , mask , X ) ;
+            fprintf ( out , "    chip8->memory[(chip8->I + 2) & 0x%X] = V[0x%X] %% 10 ;\n" , mask , X ) ;
+            emit_write_check ( gen , "chip8->I" , 3 , next , rest ) ;
+            break ;
+        case OP_LD_MEM_VX :
+            for ( uint32_t i = 0 ; i <= X ; i++ ) fprintf ( out , "    chip8->memory[(chip8->I + %u) & 0x%X] = V[0x%X] ;\n" , i , mask , i ) ;
+            // Leaving after a write over code still has to leave I where the interpreter would
+            fprintf ( out , "    { const uint16_t start = chip8->I ;\n" ) ;
+            emit_index_update ( gen , X ) ;
+            emit_write_check ( gen , "start" , X + 1u , next , rest ) ;
+            fprintf ( out , "    }\n" ) ;
+            break ;
+        case OP_LD_VX_MEM :
+            for ( uint32_t i = 0 ; i <= X ; i++ ) fprintf ( out , "    V[0x%X] = chip8->memory[(chip8->I + %u) & 0x%X] ;\n" , i , i , mask ) ;
+            emit_index_update ( gen , X ) ;
+            break ;
+        case OP_SAVE_RANGE : case OP_LOAD_RANGE : {
+            const int step = X <= Y ? 1 : -1 ;
+            const uint16_t count = (uint16_t)( (Y - X) * step + 1 ) ;
+            for ( uint32_t i = 0 ; i < count ; i++ ) {
+                const uint32_t reg = ( X + (int)i * step ) & 0x0F ;
+                if ( op == OP_SAVE_RANGE ) fprintf ( out , "    chip8->memory[(chip8->I + %u) & 0x%X] = V[0x%X] ;\n" , i , mask , reg ) ;
+                else fprintf ( out , "    V[0x%X] = chip8->memory[(chip8->I + %u) & 0x%X] ;\n" , reg , i , mask ) ;
+            }
+            if ( op == OP_SAVE_RANGE ) emit_write_check ( gen , "chip8->I" , count , next , rest ) ;
+            break ;
+        }
+        case OP_PLANE : fprintf ( out , "    chip8->plane_mask = 0x%X ;\n" , X & 0x03 ) ; break ;
+        case OP_SAVE_FLAGS : fprintf ( out , "    memcpy ( chip8->flags , V , %u ) ;\n" , X + 1u ) ; break ;
+        case OP_LOAD_FLAGS : fprintf ( out , "    memcpy ( V , chip8->flags , %u ) ;\n" , X + 1u ) ; break ;
+        default : break ; // 0NNN and the other no-ops
+    }
+}
+
+// The function for the entry at `start`, up to the next instruction the
+// interpreter runs or the end of its block
+static void emit_function ( const generator_t *gen , uint32_t start ) {
+    FILE *out = gen->out ;
+    const cfg_block_t *block = cfg_block_at ( gen->cfg , (uint16_t)start ) ;
+    const uint32_t count = gen->count[start] ;
+
+    bool registers = false ;
+    for ( uint32_t pc = start , i = 0 ; i < count ; i++ , pc += instruction_length ( gen , pc ) ) {
+        registers |= uses_registers ( op_at ( gen , pc ) ) ;
+    }
+    fprintf ( out , "\nstatic uint32_t block_%03X ( chip8_t *chip8 , uint32_t budget ) {\n" , start ) ;
+    fprintf ( out , "    if ( budget < %u ) { chip8->pc = 0x%03X ; return budget ; }\n" , count , start ) ;
+    fprintf ( out , "    budget -= %u ;\n" , count ) ;
+    if ( registers ) fprintf ( out , "    uint8_t *const V = chip8->V ;\n" ) ;
+
+    uint32_t pc = start ;
+    for ( uint32_t i = 0 ; i < count ; i++ ) {
+        emit_instruction ( gen , block , pc , count - 1 - i ) ;
+        pc += instruction_length ( gen , pc ) ;
+    }
+    // Ends that are not a jump, call, skip or return
+    if ( pc <= block->last ) {
+        fprintf ( out , "    chip8->pc = 0x%03X ; return budget ; // Left to the interpreter\n" , pc ) ;
+    }
+    else if ( block->kind == CFG_END_FALLTHROUGH ) emit_goto ( gen , block->successors[0] , "    " ) ;
+    else if ( block->kind == CFG_END_OUTSIDE ) fprintf ( out , "    chip8->pc = 0x%03X ; return budget ;\n" , pc ) ;
+    fprintf ( out , "}\n" ) ;
+}
+
+static bool generate ( const chip8_t *chip8 , const cfg_t *cfg , const char *rom_name , FILE *out ) {
+    const size_t size = (size_t)cfg->mask + 1 ;
+    generator_t gen = { .chip8 = chip8 , .cfg = cfg , .quirks = chip8_quirk_set ( chip8->quirks ) , .out = out ,
+                        .entry = calloc ( size , 1 ) , .count = calloc ( size , sizeof ( uint16_t ) ) ,
+                        .length = calloc ( size , sizeof ( uint16_t ) ) , .idle_loop = calloc ( size , 1 ) } ;
+    if ( !gen.entry || !gen.count || !gen.length || !gen.idle_loop ) {
+        fprintf ( stderr , "Out of memory\n" ) ;
+        free ( gen.entry ) ;
+        free ( gen.count ) ;
+        free ( gen.length ) ;
+        free ( gen.idle_loop ) ;
+        return false ;
+    }
+    find_entries ( &gen ) ;
+
+    uint32_t functions = 0 ;
+    for ( uint32_t a = 0 ; a < size ; a++ ) functions += has_function ( &gen , a ) ;
+
+    fprintf ( out , "// Generated by chip8-aot from %s (quirks %s), do not edit.\n" , rom_name , gen.quirks->name ) ;
+    fprintf ( out , "// Build it as a shared object against the same chip8.h:\n" ) ;
+    fprintf ( out , "//     cc -O2 -fPIC -shared -Iinclude <this file> -o <module>.so\n\n" ) ;
+    fprintf ( out , "#include \"aot.h\"\n\n" ) ;
+
+    fprintf ( out , "static const uint8_t rom[%u] = {" , chip8->rom_size ? chip8->rom_size : 1 ) ;
+    for ( uint32_t i = 0 ; i < chip8->rom_size ; i++ ) {
+        fprintf ( out , "%s0x%02X," , i % 16 == 0 ? "\n    " : " " , chip8->memory[0x200 + i] ) ;
+    }
+    fprintf ( out , "\n} ;\n\n" ) ;
+
+    for ( uint32_t a = 0 ; a < size ; a++ ) {
+        if ( has_function ( &gen , a ) ) fprintf ( out , "static uint32_t block_%03X ( chip8_t *chip8 , uint32_t budget ) ;\n" , a ) ;
+    }
+    for ( uint32_t a = 0 ; a < size ; a++ ) {
+        if ( has_function ( &gen , a ) ) emit_function ( &gen , a ) ;
+    }
+
+    fprintf ( out , "\nstatic const aot_block_t blocks[%u] = {\n" , functions ? functions : 1 ) ;
+    for ( uint32_t a = 0 ; a < size ; a++ ) {
+        if ( !has_function ( &gen , a ) ) continue ;
+        fprintf ( out , "    { 0x%03X , %u , %u , %s , block_%03X } ,\n" , a , gen.length[a] , gen.count[a] ,
+                  gen.idle_loop[a] ? "true" : "false" , a ) ;
+    }
+    fprintf ( out , "} ;\n\n" ) ;
+    static const char *const quirk_names[QUIRKS_COUNT] = {
+        [QUIRKS_AUTO] = "QUIRKS_AUTO" , [QUIRKS_CHIP8] = "QUIRKS_CHIP8" , [QUIRKS_VIP] = "QUIRKS_VIP" ,
+        [QUIRKS_CHIP48] = "QUIRKS_CHIP48" , [QUIRKS_SCHIP] = "QUIRKS_SCHIP" , [QUIRKS_XO_CHIP] = "QUIRKS_XO_CHIP" ,
+    } ;
+    fprintf ( out , "const aot_module_t %s = {\n" , AOT_SYMBOL ) ;
+    fprintf ( out , "    .abi = AOT_ABI_VERSION ,\n" ) ;
+    fprintf ( out , "    .chip8_size = sizeof ( chip8_t ) ,\n" ) ;
+    fprintf ( out , "    .quirks = %s ,\n" , quirk_names[chip8->quirks] ) ;
+    fprintf ( out , "    .rom = rom ,\n" ) ;
+    fprintf ( out , "    .rom_size = %u ,\n" , chip8->rom_size ) ;
+    fprintf ( out , "    .blocks = blocks ,\n" ) ;
+    fprintf ( out , "    .block_count = %u ,\n" , functions ) ;
+    fprintf ( out , "} ;\n" ) ;
+
+    fprintf ( stderr , "%s: %zu blocks, %u functions, %zu computed jumps\n" , rom_name , cfg->block_count , functions , cfg->computed_count ) ;
+    free ( gen.entry ) ;
+    free ( gen.count ) ;
+    free ( gen.length ) ;
+    free ( gen.idle_loop ) ;
+    return true ;
+}
+
+// ---------------------------------------------------------------------------
+// Frame-by-frame check of a built module against the interpreter
+
+typedef struct {
+    uint32_t frames ;
+    uint32_t instructions_per_second ;
+    uint32_t seed ;
+} check_options_t ;
+
+// Same keypad for both machines: now and then a random key goes down or up
+static void random_keys ( chip8_t *chip8 , uint32_t *state ) {
+    uint32_t x = *state ;
+    x ^= x << 13 ;
+    x ^= x >> 17 ;
+    x ^= x << 5 ;
+    *state = x ;
+    if ( ( x & 7 ) == 0 ) chip8->keypad[(x >> 8) & 0x0F] ^= true ;
+}
+
+// Run `frames` frames; with `check` the machines run in lockstep and are
+// compared after every frame. Returns false on the first difference.
+static bool run_pair ( chip8_t *reference , chip8_t *compiled , const check_options_t *options , bool check ,
+                       uint64_t *instructions , double seconds[2] ) {
+    chip8_t *machines[2] = { reference , compiled } ;
+    frame_budget_t budgets[2] = { {0} , {0} } ;
+    uint32_t keys[2] = { options->seed ? options->seed : 1 , options->seed ? options->seed : 1 } ;
+    *instructions = 0 ;
+
+    if ( !check ) {
+        // Timed one after the other so neither pays for the other's cache misses
+        for ( int m = 0 ; m < 2 ; m++ ) {
+            const double start = monotonic_seconds () ;
+            for ( uint32_t frame = 0 ; frame < options->frames && machines[m]->state != STOPPED ; frame++ ) {
+                random_keys ( machines[m] , &keys[m] ) ;
+                const uint32_t ran = run_frame ( machines[m] , &budgets[m] , options->instructions_per_second , false , UINT32_MAX ) ;
+                if ( m == 0 ) *instructions += ran ;
+                tick_timers ( machines[m] ) ;
+            }
+            seconds[m] = monotonic_seconds () - start ;
+        }
+        return true ;
+    }
+
+    bool module_on = true ;
+    for ( uint32_t frame = 0 ; frame < options->frames && reference->state != STOPPED ; frame++ ) {
+        uint32_t ran[2] ;
+        for ( int m = 0 ; m < 2 ; m++ ) {
+            random_keys ( machines[m] , &keys[m] ) ;
+            ran[m] = run_frame ( machines[m] , &budgets[m] , options->instructions_per_second , false , UINT32_MAX ) ;
+            tick_timers ( machines[m] ) ;
+        }
+        *instructions += ran[0] ;
+        if ( ran[0] != ran[1] || state_hash ( reference ) != state_hash ( compiled ) || reference->state != compiled->state ) {
+            fprintf ( stderr , "Frame %u differs: interpreter ran %u instructions to pc 0x%03X, module %u to pc 0x%03X\n" ,
+                      frame , ran[0] , reference->pc , ran[1] , compiled->pc ) ;
+            return false ;
+        }
+        if ( module_on && !compiled->aot->active ) {
+            fprintf ( stderr , "Frame %u: the ROM wrote over compiled code, the module is off for the rest of the run\n" , frame ) ;
+            module_on = false ;
+        }
+    }
+    return true ;
+}
+
+static bool check_module ( const char *module_name , const char *rom_name , quirks_t quirks , const check_options_t *options ) {
+    chip8_t *reference = calloc ( 1 , sizeof ( chip8_t ) ) ;
+    chip8_t *compiled = calloc ( 1 , sizeof ( chip8_t ) ) ;
+    bool ok = reference && compiled && aot_load ( compiled , module_name ) ;
+    uint64_t instructions = 0 ;
+    double seconds[2] = { 0 , 0 } ;
+
+    for ( int pass = 0 ; ok && pass < 2 ; pass++ ) {
+        reference->quirks_request = compiled->quirks_request = quirks ;
+        ok = init_chip8 ( reference , rom_name ) && init_chip8 ( compiled , rom_name ) ;
+        if ( ok && !compiled->aot->active ) {
+            fprintf ( stderr , "%s was not compiled from %s with the %s profile\n" , module_name , rom_name ,
+                      chip8_quirk_set ( compiled->quirks )->name ) ;
+            ok = false ;
+        }
+        if ( ok ) ok = run_pair ( reference , compiled , options , pass == 0 , &instructions , seconds ) ;
+    }
+    if ( ok ) {
+        const double interpreter_ips = seconds[0] > 0 ? instructions / seconds[0] : 0 ;
+        const double module_ips = seconds[1] > 0 ? instructions / seconds[1] : 0 ;
+        printf ( "rom=%s module=%s frames=%u instructions=%llu match=yes interpreter_ips=%.0f aot_ips=%.0f speedup=%.2f\n" ,
+                 rom_name , module_name , options->frames , (unsigned long long)instructions , interpreter_ips , module_ips ,
+                 interpreter_ips > 0 ? module_ips / interpreter_ips : 0 ) ;
+    }
+    if ( compiled ) aot_unload ( compiled ) ;
+    free_chip8 ( reference ) ;
+    free_chip8 ( compiled ) ;
+    free ( reference ) ;
+    free ( compiled ) ;
+    return ok ;
+}
+
+static void usage ( const char *program ) {
+    fprintf ( stderr ,
+        "Usage: %s [options] <rom>\n"
+        "  -o FILE           write the generated C to FILE (default stdout)\n"
+        "  --quirks NAME     quirk profile: auto (default), chip8, vip, chip48, schip or xochip\n"
+        "  --check MODULE    run the ROM on a built module and on the interpreter, comparing every frame\n"
+        "  --frames N        frames to check (default 3600)\n"
+        "  --ips N           instructions per second for --check (default from config)\n"
+        "  --seed N          keypad input seed for --check\n"
+        , program ) ;
+}
+
+int main ( int argc , char const *argv[] ) {
+    config_t config = {0} ;
+    if ( !init_config ( &config ) ) exit ( EXIT_FAILURE ) ;
+
+    const char *rom_name = NULL ;
+    const char *out_name = NULL ;
+    const char *module_name = NULL ;
+    quirks_t quirks = QUIRKS_AUTO ;
+    check_options_t options = { .frames = 3600 , .instructions_per_second = config.instructions_per_second , .seed = 1 } ;
+
+    for ( int i = 1 ; i < argc ; i++ ) {
+        const bool has_value = i + 1 < argc ;
+        if ( strcmp ( argv[i] , "-o" ) == 0 && has_value ) out_name = argv[++i] ;
+        else if ( strcmp ( argv[i] , "--quirks" ) == 0 && has_value ) {
+            if ( !chip8_parse_quirks ( argv[++i] , &quirks ) ) exit ( EXIT_FAILURE ) ;
+        }
+        else if ( strcmp ( argv[i] , "--check" ) == 0 && has_value ) module_name = argv[++i] ;
+        else if ( strcmp ( argv[i] , "--frames" ) == 0 && has_value ) options.frames = strtoul ( argv[++i] , NULL , 10 ) ;
+        else if ( strcmp ( argv[i] , "--ips" ) == 0 && has_value ) options.instructions_per_second = strtoul ( argv[++i] , NULL , 10 ) ;
+        else if ( strcmp ( argv[i] , "--seed" ) == 0 && has_value ) options.seed = strtoul ( argv[++i] , NULL , 0 ) ;
+        else if ( argv[i][0] == '-' ) {
+            usage ( argv[0] ) ;
+            exit ( EXIT_FAILURE ) ;
+        }
+        else rom_name = argv[i] ;
+    }
+    if ( !rom_name ) {
+        usage ( argv[0] ) ;
+        exit ( EXIT_FAILURE ) ;
+    }
+    if ( module_name ) return check_module ( module_name , rom_name , quirks , &options ) ? EXIT_SUCCESS : EXIT_FAILURE ;
+
+    chip8_t *chip8 = calloc ( 1 , sizeof ( chip8_t ) ) ;
+    if ( !chip8 ) exit ( EXIT_FAILURE ) ;
+    chip8->quirks_request = quirks ;
+    if ( !init_chip8 ( chip8 , rom_name ) ) exit ( EXIT_FAILURE ) ;
+
+    cfg_t cfg ;
+    if ( !cfg_analyze ( &cfg , chip8->memory , chip8_address_mask ( chip8 ) , chip8->xo_chip , 0x200 , 0x200 + chip8->rom_size ) ) {
+        exit ( EXIT_FAILURE ) ;
+    }
+    FILE *out = out_name ? fopen ( out_name , "w" ) : stdout ;
+    if ( !out ) {
+        fprintf ( stderr , "Could not open %s for writing\n" , out_name ) ;
+        exit ( EXIT_FAILURE ) ;
+    }
+    bool ok = generate ( chip8 , &cfg , rom_name , out ) ;
+    if ( out_name ) {
+        const bool written = !ferror ( out ) ;
+        if ( fclose ( out ) != 0 || !written ) {
+            fprintf ( stderr , "Could not write %s\n" , out_name ) ;
+            ok = false ;
+        }
+    }
+    for ( size_t i = 0 ; i < cfg.computed_count ; i++ ) {
+        fprintf ( stderr , "Computed jump at 0x%03X: its targets run on the interpreter unless they start a block\n" , cfg.computed[i] ) ;
+    }
+
+    cfg_free ( &cfg ) ;
+    free_chip8 ( chip8 ) ;
+    free ( chip8 ) ;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE ;
+}
@@ -0,0 +1,629 @@
+/**
+ * @file bench.c
+ * @brief Benchmark Suite for the Core Hot Paths (make bench)
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * Measures instruction throughput per opcode class, whole-ROM throughput
+ * for every ROM in roms/ (also with the debugger attached, to check that
+ * it costs nothing until a breakpoint is set), the batched core against a
+ * loop over instances, RL environment pool steps, save-state and rewind latency and, when built
+ * with SDL (BENCH_SDL), update_display on an offscreen renderer. Every
+ * benchmark runs a few warmup rounds and then repeated timed runs; the
+ * median, p99, min and max are printed as CSV (default) or JSON so runs
+ * from different commits can be diffed.
+ */
+#define _POSIX_C_SOURCE 200809L // setenv, opendir
+
+#include <dirent.h>
+#include <math.h>
+#include "batch.h"
+#include "chip8.h"
+#include "debugger.h"
+#include "env.h"
+#include "jit.h"
+#include "rewind.h"
+#include "runner.h"
+#include "savestate.h"
+#ifdef BENCH_SDL
+#include "chip8_sdl.h"
+#endif
+
+#define MAX_RESULTS 256
+#define MAX_RUNS 1000
+#define OPCODE_BENCH_INSTRUCTIONS 2000000
+#define ROM_BENCH_FRAMES 60
+#define ROM_BENCH_IPS 6000000 // 100k instructions per frame
+#define LATENCY_BATCH 200     // Operations per timed run for the microsecond-scale benchmarks
+#define BATCH_BENCH_LANES 1024
+#define BATCH_BENCH_FRAMES 60
+#define BATCH_BENCH_STEPS 100 // Instructions per frame and lane
+#define ENV_BENCH_ENVS 64
+#define ENV_BENCH_STEPS 30
+#define ENV_BENCH_FRAMES 4    // Frames per action
+
+typedef struct {
+    char name[96] ;
+    const char *unit ;
+    uint32_t runs ;
+    double median , p99 , min , max ;
+} bench_result_t ;
+
+typedef struct {
+    uint32_t warmup ;
+    uint32_t runs ;
+    const char *filter ;
+    const char *rom_dir ;
+    bool json ;
+    bench_result_t results[MAX_RESULTS] ;
+    uint32_t count ;
+} bench_t ;
+
+// One timed run, returns the metric in the benchmark's unit
+typedef double ( *bench_fn ) ( void *context ) ;
+
+static int compare_doubles ( const void *a , const void *b ) {
+    const double x = *(const double *)a , y = *(const double *)b ;
+    return (x > y) - (x < y) ;
+}
+
+static void run_bench ( bench_t *bench , const char *name , const char *unit , bench_fn fn , void *context ) {
+    if ( bench->filter && !strstr ( name , bench->filter ) ) return ;
+    if ( bench->count == MAX_RESULTS ) return ;
+
+    static double samples[MAX_RUNS] ;
+    for ( uint32_t i = 0 ; i < bench->warmup ; i++ ) fn ( context ) ;
+    for ( uint32_t i = 0 ; i < bench->runs ; i++ ) samples[i] = fn ( context ) ;
+    qsort ( samples , bench->runs , sizeof ( double ) , compare_doubles ) ;
+
+    bench_result_t *result = &bench->results[bench->count++] ;
+    snprintf ( result->name , sizeof ( result->name ) , "%s" , name ) ;
+    result->unit = unit ;
+    result->runs = bench->runs ;
+    result->median = bench->runs % 2 ? samples[bench->runs / 2]
+                                     : ( samples[bench->runs / 2 - 1] + samples[bench->runs / 2] ) / 2 ;
+    result->p99 = samples[(size_t)ceil ( 0.99 * bench->runs ) - 1] ;
+    result->min = samples[0] ;
+    result->max = samples[bench->runs - 1] ;
+    fprintf ( stderr , "%-40s %12.3f %s\n" , name , result->median , unit ) ;
+}
+
+static void print_results ( const bench_t *bench ) {
+    if ( bench->json ) {
+        printf ( "{\n  \"warmup\": %u,\n  \"runs\": %u,\n  \"results\": [\n" , bench->warmup , bench->runs ) ;
+        for ( uint32_t i = 0 ; i < bench->count ; i++ ) {
+            const bench_result_t *r = &bench->results[i] ;
+            printf ( "    {\"name\": \"%s\", \"unit\": \"%s\", \"runs\": %u, \"median\": %.6g, \"p99\": %.6g, \"min\": %.6g, \"max\": %.6g}%s\n" ,
+                     r->name , r->unit , r->runs , r->median , r->p99 , r->min , r->max , i + 1 < bench->count ? "," : "" ) ;
+        }
+        printf ( "  ]\n}\n" ) ;
+        return ;
+    }
+    printf ( "name,unit,runs,median,p99,min,max\n" ) ;
+    for ( uint32_t i = 0 ; i < bench->count ; i++ ) {
+        const bench_result_t *r = &bench->results[i] ;
+        printf ( "%s,%s,%u,%.6g,%.6g,%.6g,%.6g\n" , r->name , r->unit , r->runs , r->median , r->p99 , r->min , r->max ) ;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Opcode classes: tight loops dominated by one kind of instruction
+
+typedef struct {
+    const char *name ;
+    const uint16_t *program ;
+    uint16_t length ;
+} opcode_program_t ;
+
+static const uint16_t alu_program[] = {
+    0x6001 , 0x6103 ,                   // V0 = 1, V1 = 3
+    0x8014 , 0x8015 , 0x8012 , 0x8013 , // loop: 8XY4 8XY5 8XY2 8XY3
+    0x8011 , 0x8016 , 0x801E , 0x8017 , //       8XY1 8XY6 8XYE 8XY7
+    0x7005 , 0x1204 ,                   //       V0 += 5, jump loop
+} ;
+
+static const uint16_t jump_program[] = {
+    0x2206 , // loop: call sub
+    0x1200 , //       jump loop
+    0x0000 ,
+    0x00EE , // sub:  return
+} ;
+
+static const uint16_t draw_program[] = {
+    0xA000 , 0x6000 , 0x6100 , // I = font, V0 = V1 = 0
+    0xD015 ,                   // loop: draw 8x5 at (V0, V1)
+    0x7003 , 0x7101 ,          //       move the sprite
+    0x1206 ,                   //       jump loop
+} ;
+
+static const uint16_t memory_program[] = {
+    0xA400 , // I = 0x400
+    0xFF55 , // loop: store V0-VF
+    0xFF65 , //       load V0-VF
+    0x1202 , //       jump loop
+} ;
+
+typedef struct {
+    chip8_t *chip8 ;
+    const opcode_program_t *program ;
+    const char *rom ;
+    bool step ; // Single run_intructions calls instead of run_cycles batches
+} opcode_context_t ;
+
+static void load_program ( chip8_t *chip8 , const char *rom , const opcode_program_t *program ) {
+    init_chip8 ( chip8 , rom ) ;
+    for ( uint16_t i = 0 ; i < program->length ; i++ ) {
+        chip8->memory[0x200 + 2 * i] = program->program[i] >> 8 ;
+        chip8->memory[0x201 + 2 * i] = program->program[i] & 0xFF ;
+    }
+    invalidate_decoded ( chip8 , 0x200 , 2 * program->length ) ;
+}
+
+// Million instructions per second
+static double bench_opcodes ( void *context ) {
+    opcode_context_t *ctx = context ;
+    load_program ( ctx->chip8 , ctx->rom , ctx->program ) ;
+    const double start = monotonic_seconds () ;
+    if ( ctx->step ) {
+        for ( uint32_t i = 0 ; i < OPCODE_BENCH_INSTRUCTIONS ; i++ ) run_intructions ( ctx->chip8 ) ;
+    } else {
+        for ( uint32_t done = 0 ; done < OPCODE_BENCH_INSTRUCTIONS ; done += 10000 ) run_cycles ( ctx->chip8 , 10000 ) ;
+    }
+    return OPCODE_BENCH_INSTRUCTIONS / ( monotonic_seconds () - start ) / 1e6 ;
+}
+
+// ---------------------------------------------------------------------------
+// Whole ROMs
+
+typedef struct {
+    chip8_t *chip8 ;
+    const char *path ;
+} rom_context_t ;
+
+static double bench_rom ( void *context ) {
+    rom_context_t *ctx = context ;
+    init_chip8 ( ctx->chip8 , ctx->path ) ;
+    const run_options_t options = { .max_frames = ROM_BENCH_FRAMES , .instructions_per_second = ROM_BENCH_IPS } ;
+    run_result_t result ;
+    run_headless ( ctx->chip8 , &options , &result ) ;
+    return result.seconds > 0 ? result.instructions / result.seconds / 1e6 : 0 ;
+}
+
+static int compare_names ( const void *a , const void *b ) {
+    return strcmp ( *(char *const *)a , *(char *const *)b ) ;
+}
+
+// Idle loops are run out rather than skipped, so the instructions counted
+// are the ones the core executed
+static void bench_roms ( bench_t *bench , chip8_t *chip8 , const char *mode ) {
+    DIR *dir = opendir ( bench->rom_dir ) ;
+    if ( !dir ) {
+        fprintf ( stderr , "Could not open %s, skipping ROM benchmarks\n" , bench->rom_dir ) ;
+        return ;
+    }
+    char *names[MAX_RESULTS] ;
+    size_t count = 0 ;
+    struct dirent *entry ;
+    while ( ( entry = readdir ( dir ) ) && count < MAX_RESULTS ) {
+        const char *dot = strrchr ( entry->d_name , '.' ) ;
+        if ( !dot || strcmp ( dot , ".ch8" ) != 0 ) continue ;
+        names[count] = malloc ( strlen ( bench->rom_dir ) + strlen ( entry->d_name ) + 2 ) ;
+        if ( !names[count] ) break ;
+        sprintf ( names[count++] , "%s/%s" , bench->rom_dir , entry->d_name ) ;
+    }
+    closedir ( dir ) ;
+    qsort ( names , count , sizeof ( char * ) , compare_names ) ;
+
+    chip8->idle_skip_off = true ;
+    for ( size_t i = 0 ; i < count ; i++ ) {
+        char name[96] ;
+        const char *base = strrchr ( names[i] , '/' ) + 1 ;
+        snprintf ( name , sizeof ( name ) , "rom/%s/%s" , mode , base ) ;
+        rom_context_t ctx = { .chip8 = chip8 , .path = names[i] } ;
+        run_bench ( bench , name , "Minstr/s" , bench_rom , &ctx ) ;
+        free ( names[i] ) ;
+    }
+    chip8->idle_skip_off = false ;
+}
+
+// ---------------------------------------------------------------------------
+// The batched core against run_cycles in a loop over the same instances
+// (million instructions per second, summed over the instances)
+
+typedef struct {
+    chip8_t *chip8 ;
+    chip8_batch_t *batch ;
+    const uint8_t *rom ;
+    size_t rom_size ;
+    uint32_t seeds[BATCH_BENCH_LANES] ;
+} batch_context_t ;
+
+// Keypad of instance l in frame f, the same for both: now and then one key down
+static uint16_t bench_keys ( uint32_t l , uint32_t f ) {
+    uint32_t x = l * 0x9E3779B9u ^ f * 0x85EBCA6Bu ;
+    x ^= x >> 15 ;
+    x *= 0x2C1B3C6Du ;
+    x ^= x >> 12 ;
+    return x % 8 == 0 ? (uint16_t)( 1u << ( (x >> 8) % 16 ) ) : 0 ;
+}
+
+static double bench_batch ( void *context ) {
+    batch_context_t *ctx = context ;
+    chip8_batch_t *batch = ctx->batch ;
+    batch_reset ( batch , ctx->seeds ) ;
+    uint64_t instructions = 0 ;
+    const double start = monotonic_seconds () ;
+    for ( uint32_t f = 0 ; f < BATCH_BENCH_FRAMES ; f++ ) {
+        for ( uint32_t l = 0 ; l < batch->lanes ; l++ ) batch->keys[l] = bench_keys ( l , f ) ;
+        instructions += batch_step ( batch , BATCH_BENCH_STEPS ) ;
+        batch_tick_timers ( batch ) ;
+    }
+    return instructions / ( monotonic_seconds () - start ) / 1e6 ;
+}
+
+// The loading between instances is not timed
+static double bench_batch_loop ( void *context ) {
+    batch_context_t *ctx = context ;
+    chip8_t *chip8 = ctx->chip8 ;
+    uint64_t instructions = 0 ;
+    double seconds = 0 ;
+    for ( uint32_t l = 0 ; l < BATCH_BENCH_LANES ; l++ ) {
+        load_chip8 ( chip8 , ctx->rom , ctx->rom_size , NULL ) ;
+        chip8->rng = ctx->seeds[l] ;
+        const double start = monotonic_seconds () ;
+        for ( uint32_t f = 0 ; f < BATCH_BENCH_FRAMES ; f++ ) {
+            const uint16_t keys = bench_keys ( l , f ) ;
+            for ( uint32_t k = 0 ; k < 16 ; k++ ) chip8->keypad[k] = ( keys >> k ) & 1 ;
+            if ( chip8->state == RUNNING ) instructions += run_cycles ( chip8 , BATCH_BENCH_STEPS ) ;
+            tick_timers ( chip8 ) ;
+        }
+        seconds += monotonic_seconds () - start ;
+    }
+    return seconds > 0 ? instructions / seconds / 1e6 : 0 ;
+}
+
+// A ROM whose instances stay together (IBM-Logo), one where they part at
+// the paddle and meet again (Brick), one where the keys and the RNG send
+// each its own way (Tetris)
+static void bench_batches ( bench_t *bench , chip8_t *chip8 ) {
+    static const char *const roms[] = { "IBM-Logo.ch8" , "Brick.ch8" , "Tetris.ch8" } ;
+    batch_context_t *ctx = calloc ( 1 , sizeof ( batch_context_t ) ) ;
+    chip8_batch_t *batch = batch_create ( BATCH_BENCH_LANES , QUIRKS_CHIP8 ) ;
+    uint8_t *rom = malloc ( CHIP8_MEMORY_SIZE ) ;
+    if ( !ctx || !batch || !rom ) {
+        fprintf ( stderr , "Out of memory, skipping batch benchmarks\n" ) ;
+        free ( ctx ) ;
+        batch_destroy ( batch ) ;
+        free ( rom ) ;
+        return ;
+    }
+    fprintf ( stderr , "Batch vector code: %s\n" , batch_simd_name ( batch ) ) ;
+    for ( uint32_t l = 0 ; l < BATCH_BENCH_LANES ; l++ ) ctx->seeds[l] = l + 1 ;
+    chip8->quirks_request = QUIRKS_CHIP8 ;
+    for ( size_t r = 0 ; r < sizeof ( roms ) / sizeof ( roms[0] ) ; r++ ) {
+        char path[512] , name[96] ;
+        snprintf ( path , sizeof ( path ) , "%s/%s" , bench->rom_dir , roms[r] ) ;
+        if ( !init_chip8 ( chip8 , path ) ) continue ;
+        // The ROM as init_chip8 read it, for batch_load and the loop's reloads
+        ctx->rom_size = chip8->rom_size ;
+        memcpy ( rom , chip8->memory + 0x200 , ctx->rom_size ) ;
+        if ( !batch_load ( batch , rom , ctx->rom_size ) ) continue ;
+        ctx->chip8 = chip8 ;
+        ctx->batch = batch ;
+        ctx->rom = rom ;
+        snprintf ( name , sizeof ( name ) , "batch/%s/%u" , roms[r] , BATCH_BENCH_LANES ) ;
+        run_bench ( bench , name , "Minstr/s" , bench_batch , ctx ) ;
+        snprintf ( name , sizeof ( name ) , "batch_loop/%s/%u" , roms[r] , BATCH_BENCH_LANES ) ;
+        run_bench ( bench , name , "Minstr/s" , bench_batch_loop , ctx ) ;
+    }
+    chip8->quirks_request = QUIRKS_AUTO ;
+    free ( rom ) ;
+    batch_destroy ( batch ) ;
+    free ( ctx ) ;
+}
+
+// ---------------------------------------------------------------------------
+// RL environments: env_step on a pool, one thread per core, observations
+// written as bits (thousand frames per second, summed over the envs)
+
+typedef struct {
+    env_pool_t *pool ;
+    uint8_t *observations ;
+    uint16_t actions[ENV_BENCH_ENVS] ;
+    float rewards[ENV_BENCH_ENVS] ;
+    uint8_t dones[ENV_BENCH_ENVS] ;
+} env_context_t ;
+
+static double bench_env ( void *context ) {
+    env_context_t *ctx = context ;
+    env_reset_all ( ctx->pool , NULL ) ;
+    const double start = monotonic_seconds () ;
+    for ( uint32_t s = 0 ; s < ENV_BENCH_STEPS ; s++ ) {
+        for ( uint32_t e = 0 ; e < ENV_BENCH_ENVS ; e++ ) ctx->actions[e] = bench_keys ( e , s ) ;
+        env_step ( ctx->pool , ctx->actions , ENV_BENCH_FRAMES , ctx->rewards , ctx->dones ) ;
+    }
+    return (double)ENV_BENCH_ENVS * ENV_BENCH_STEPS * ENV_BENCH_FRAMES / ( monotonic_seconds () - start ) / 1e3 ;
+}
+
+static void bench_envs ( bench_t *bench ) {
+    static const char *const roms[] = { "Brick.ch8" , "Tetris.ch8" } ;
+    config_t config ;
+    init_config ( &config ) ;
+    env_options_t options ;
+    env_default_options ( &options , &config ) ;
+    env_context_t *ctx = calloc ( 1 , sizeof ( env_context_t ) ) ;
+    if ( !ctx ) return ;
+    for ( size_t r = 0 ; r < sizeof ( roms ) / sizeof ( roms[0] ) ; r++ ) {
+        char path[512] , name[96] ;
+        snprintf ( path , sizeof ( path ) , "%s/%s" , bench->rom_dir , roms[r] ) ;
+        ctx->pool = env_pool_create ( path , ENV_BENCH_ENVS , &options ) ;
+        if ( !ctx->pool ) continue ;
+        ctx->observations = calloc ( ENV_BENCH_ENVS , env_observation_size ( ctx->pool ) ) ;
+        if ( ctx->observations ) {
+            env_set_observations ( ctx->pool , ctx->observations ) ;
+            snprintf ( name , sizeof ( name ) , "env/%s/%u" , roms[r] , ENV_BENCH_ENVS ) ;
+            run_bench ( bench , name , "kframes/s" , bench_env , ctx ) ;
+        }
+        env_pool_destroy ( ctx->pool ) ;
+        free ( ctx->observations ) ;
+    }
+    free ( ctx ) ;
+}
+
+// ---------------------------------------------------------------------------
+// Save states and rewind (microseconds per operation)
+
+typedef struct {
+    chip8_t *chip8 ;
+    uint8_t buffer[SAVESTATE_MAX_SIZE] ;
+    size_t size ;
+    rewind_t history ;
+} state_context_t ;
+
+static double bench_encode ( void *context ) {
+    state_context_t *ctx = context ;
+    const double start = monotonic_seconds () ;
+    for ( int i = 0 ; i < LATENCY_BATCH ; i++ ) ctx->size = savestate_encode ( ctx->chip8 , ctx->buffer , sizeof ( ctx->buffer ) ) ;
+    return ( monotonic_seconds () - start ) * 1e6 / LATENCY_BATCH ;
+}
+
+static double bench_decode ( void *context ) {
+    state_context_t *ctx = context ;
+    const double start = monotonic_seconds () ;
+    for ( int i = 0 ; i < LATENCY_BATCH ; i++ ) savestate_decode ( ctx->chip8 , ctx->buffer , ctx->size ) ;
+    return ( monotonic_seconds () - start ) * 1e6 / LATENCY_BATCH ;
+}
+
+// What the emulation thread pays when F1 is pressed (the write is queued)
+static double bench_save_enqueue ( void *context ) {
+    state_context_t *ctx = context ;
+    const double start = monotonic_seconds () ;
+    save_state ( ctx->chip8 , ctx->chip8->save_filename , sizeof ( ctx->chip8->save_filename ) , 9 ) ;
+    const double elapsed = monotonic_seconds () - start ;
+    savestate_flush () ;
+    return elapsed * 1e6 ;
+}
+
+// Enqueue plus the background write reaching the file
+static double bench_save_flush ( void *context ) {
+    state_context_t *ctx = context ;
+    const double start = monotonic_seconds () ;
+    save_state ( ctx->chip8 , ctx->chip8->save_filename , sizeof ( ctx->chip8->save_filename ) , 9 ) ;
+    savestate_flush () ;
+    return ( monotonic_seconds () - start ) * 1e6 ;
+}
+
+static double bench_load ( void *context ) {
+    state_context_t *ctx = context ;
+    const double start = monotonic_seconds () ;
+    load_state ( ctx->chip8 , ctx->chip8->save_filename , sizeof ( ctx->chip8->save_filename ) , 9 ) ;
+    return ( monotonic_seconds () - start ) * 1e6 ;
+}
+
+// One frame of play, then a push; the timed part is the push only
+static double bench_rewind_push ( void *context ) {
+    state_context_t *ctx = context ;
+    double total = 0 ;
+    for ( int i = 0 ; i < LATENCY_BATCH ; i++ ) {
+        run_cycles ( ctx->chip8 , 12 ) ;
+        tick_timers ( ctx->chip8 ) ;
+        const double start = monotonic_seconds () ;
+        rewind_push ( &ctx->history , ctx->chip8 ) ;
+        total += monotonic_seconds () - start ;
+    }
+    return total * 1e6 / LATENCY_BATCH ;
+}
+
+static double bench_rewind_step ( void *context ) {
+    state_context_t *ctx = context ;
+    double total = 0 ;
+    int steps = 0 ;
+    for ( int i = 0 ; i < LATENCY_BATCH ; i++ ) {
+        const double start = monotonic_seconds () ;
+        if ( !rewind_step_back ( &ctx->history , ctx->chip8 ) ) break ;
+        total += monotonic_seconds () - start ;
+        steps++ ;
+    }
+    // Refill what was stepped back over for the next run
+    for ( int i = 0 ; i < steps ; i++ ) {
+        run_cycles ( ctx->chip8 , 12 ) ;
+        rewind_push ( &ctx->history , ctx->chip8 ) ;
+    }
+    return steps ? total * 1e6 / steps : 0 ;
+}
+
+static void bench_states ( bench_t *bench , chip8_t *chip8 , const char *rom ) {
+    state_context_t *ctx = calloc ( 1 , sizeof ( state_context_t ) ) ;
+    if ( !ctx || !init_chip8 ( chip8 , rom ) ) {
+        free ( ctx ) ;
+        return ;
+    }
+    ctx->chip8 = chip8 ;
+    const run_options_t options = { .max_frames = 600 , .instructions_per_second = 700 } ;
+    run_result_t result ;
+    run_headless ( chip8 , &options , &result ) ;
+
+    ctx->size = savestate_encode ( chip8 , ctx->buffer , sizeof ( ctx->buffer ) ) ;
+    run_bench ( bench , "state/encode" , "us" , bench_encode , ctx ) ;
+    run_bench ( bench , "state/decode" , "us" , bench_decode , ctx ) ;
+    run_bench ( bench , "state/save_enqueue" , "us" , bench_save_enqueue , ctx ) ;
+    run_bench ( bench , "state/save_to_disk" , "us" , bench_save_flush , ctx ) ;
+    run_bench ( bench , "state/load_from_disk" , "us" , bench_load , ctx ) ;
+    remove ( chip8->save_filename ) ;
+
+    config_t config ;
+    init_config ( &config ) ;
+    if ( rewind_init ( &ctx->history , config.rewind_budget , config.rewind_keyframe_interval ) ) {
+        run_bench ( bench , "rewind/push" , "us" , bench_rewind_push , ctx ) ;
+        run_bench ( bench , "rewind/step_back" , "us" , bench_rewind_step , ctx ) ;
+        rewind_free ( &ctx->history ) ;
+    }
+    free ( ctx ) ;
+}
+
+// ---------------------------------------------------------------------------
+// update_display on an offscreen software renderer
+
+#ifdef BENCH_SDL
+typedef struct {
+    sdl_t sdl ;
+    config_t config ;
+    chip8_t *chip8 ;
+    bool changing ; // Flip a pixel every frame, forcing the texture upload
+} display_context_t ;
+
+static double bench_display ( void *context ) {
+    display_context_t *ctx = context ;
+    const double start = monotonic_seconds () ;
+    for ( int i = 0 ; i < LATENCY_BATCH ; i++ ) {
+        if ( ctx->changing ) ctx->chip8->display[0][i % CHIP8_DISPLAY_HEIGHT][0] ^= 1ull << (i % CHIP8_DISPLAY_WIDTH) ;
+        update_display ( &ctx->sdl , ctx->chip8 , ctx->config ) ;
+    }
+    return ( monotonic_seconds () - start ) * 1e6 / LATENCY_BATCH ;
+}
+
+static void bench_displays ( bench_t *bench , chip8_t *chip8 , const char *rom ) {
+    setenv ( "SDL_VIDEODRIVER" , "offscreen" , 0 ) ;
+    display_context_t ctx = { .chip8 = chip8 } ;
+    init_config ( &ctx.config ) ;
+    ctx.config.pixelized = false ; // The grid overlay is built by init_display, which needs an audio device
+    if ( SDL_Init ( SDL_INIT_VIDEO ) != 0 ) {
+        fprintf ( stderr , "No offscreen video driver (%s), skipping display benchmarks\n" , SDL_GetError () ) ;
+        return ;
+    }
+    ctx.sdl.window = SDL_CreateWindow ( "bench" , 0 , 0 , ctx.config.window_width , ctx.config.window_height , SDL_WINDOW_HIDDEN ) ;
+    ctx.sdl.renderer = ctx.sdl.window ? SDL_CreateRenderer ( ctx.sdl.window , -1 , SDL_RENDERER_SOFTWARE ) : NULL ;
+    ctx.sdl.screen_texture = ctx.sdl.renderer ? SDL_CreateTexture ( ctx.sdl.renderer , SDL_PIXELFORMAT_RGBA8888 , SDL_TEXTUREACCESS_STREAMING ,
+                                                                    CHIP8_HIRES_WIDTH , CHIP8_HIRES_HEIGHT ) : NULL ;
+    if ( ctx.sdl.screen_texture && init_chip8 ( chip8 , rom ) ) {
+        const run_options_t options = { .max_frames = 120 , .instructions_per_second = 700 } ;
+        run_result_t result ;
+        run_headless ( chip8 , &options , &result ) ;
+        ctx.changing = false ;
+        run_bench ( bench , "display/update_unchanged" , "us" , bench_display , &ctx ) ;
+        ctx.changing = true ;
+        run_bench ( bench , "display/update_changed" , "us" , bench_display , &ctx ) ;
+    } else {
+        fprintf ( stderr , "Could not create an offscreen renderer (%s), skipping display benchmarks\n" , SDL_GetError () ) ;
+    }
+    if ( ctx.sdl.screen_texture ) SDL_DestroyTexture ( ctx.sdl.screen_texture ) ;
+    if ( ctx.sdl.renderer ) SDL_DestroyRenderer ( ctx.sdl.renderer ) ;
+    if ( ctx.sdl.window ) SDL_DestroyWindow ( ctx.sdl.window ) ;
+    SDL_Quit () ;
+}
+#endif
+
+static void usage ( const char *program ) {
+    fprintf ( stderr ,
+        "Usage: %s [options]\n"
+        "  --json            JSON instead of CSV on stdout\n"
+        "  --runs N          timed runs per benchmark (default 21)\n"
+        "  --warmup N        untimed runs first (default 3)\n"
+        "  --filter TEXT     only benchmarks whose name contains TEXT\n"
+        "  --roms DIR        ROM directory (default roms)\n" , program ) ;
+}
+
+int main ( int argc , char const *argv[] ) {
+    static bench_t bench = { .warmup = 3 , .runs = 21 , .rom_dir = "roms" } ;
+    for ( int i = 1 ; i < argc ; i++ ) {
+        const bool has_value = i + 1 < argc ;
+        if ( strcmp ( argv[i] , "--json" ) == 0 ) bench.json = true ;
+        else if ( strcmp ( argv[i] , "--runs" ) == 0 && has_value ) bench.runs = strtoul ( argv[++i] , NULL , 10 ) ;
+        else if ( strcmp ( argv[i] , "--warmup" ) == 0 && has_value ) bench.warmup = strtoul ( argv[++i] , NULL , 10 ) ;
+        else if ( strcmp ( argv[i] , "--filter" ) == 0 && has_value ) bench.filter = argv[++i] ;
+        else if ( strcmp ( argv[i] , "--roms" ) == 0 && has_value ) bench.rom_dir = argv[++i] ;
+        else {
+            usage ( argv[0] ) ;
+            exit ( EXIT_FAILURE ) ;
+        }
+    }
+    if ( bench.runs == 0 || bench.runs > MAX_RUNS ) {
+        fprintf ( stderr , "--runs must be between 1 and %d\n" , MAX_RUNS ) ;
+        exit ( EXIT_FAILURE ) ;
+    }
+
+    // Opcode programs are patched over a real ROM so init_chip8 has a file to load
+    char base_rom[512] ;
+    snprintf ( base_rom , sizeof ( base_rom ) , "%s/IBM-Logo.ch8" , bench.rom_dir ) ;
+
+    chip8_t *chip8 = calloc ( 1 , sizeof ( chip8_t ) ) ;
+    if ( !chip8 || !init_chip8 ( chip8 , base_rom ) ) exit ( EXIT_FAILURE ) ;
+
+    const opcode_program_t programs[] = {
+        { "alu" , alu_program , sizeof ( alu_program ) / sizeof ( uint16_t ) } ,
+        { "jump_call" , jump_program , sizeof ( jump_program ) / sizeof ( uint16_t ) } ,
+        { "draw" , draw_program , sizeof ( draw_program ) / sizeof ( uint16_t ) } ,
+        { "fx55_fx65" , memory_program , sizeof ( memory_program ) / sizeof ( uint16_t ) } ,
+    } ;
+    const bool have_jit = jit_available () ;
+    for ( size_t p = 0 ; p < sizeof ( programs ) / sizeof ( programs[0] ) ; p++ ) {
+        for ( int mode = 0 ; mode < 4 ; mode++ ) {
+            // debug_break: the debugger's checked copy of the interpreter, one breakpoint that never hits
+            static const char *const modes[] = { "step" , "interp" , "jit" , "debug_break" } ;
+            if ( mode == 2 && !have_jit ) continue ;
+            if ( mode == 2 ) jit_enable ( chip8 ) ;
+            if ( mode == 3 ) {
+                if ( !debugger_attach ( chip8 ) ) continue ;
+                debugger_break ( chip8->debugger , 0x000 , false , (debug_condition_t){ .reg = DEBUG_REG_NONE } ) ;
+            }
+            char name[96] ;
+            snprintf ( name , sizeof ( name ) , "opcode/%s/%s" , modes[mode] , programs[p].name ) ;
+            opcode_context_t ctx = { .chip8 = chip8 , .program = &programs[p] , .rom = base_rom , .step = mode == 0 } ;
+            run_bench ( &bench , name , "Minstr/s" , bench_opcodes , &ctx ) ;
+            jit_disable ( chip8 ) ;
+            debugger_detach ( chip8 ) ;
+        }
+    }
+
+    bench_roms ( &bench , chip8 , "interp" ) ;
+    if ( have_jit ) {
+        jit_enable ( chip8 ) ;
+        bench_roms ( &bench , chip8 , "jit" ) ;
+        jit_disable ( chip8 ) ;
+    }
+    // Attached with nothing set runs the normal interpreter, should match rom/interp;
+    // one breakpoint that never hits switches to the checked copy (as opcode/debug_break)
+    if ( debugger_attach ( chip8 ) ) {
+        bench_roms ( &bench , chip8 , "debug_idle" ) ;
+        debugger_break ( chip8->debugger , 0x000 , false , (debug_condition_t){ .reg = DEBUG_REG_NONE } ) ;
+        bench_roms ( &bench , chip8 , "debug_break" ) ;
+        debugger_detach ( chip8 ) ;
+    }
+
+    bench_batches ( &bench , chip8 ) ;
+    bench_envs ( &bench ) ;
+
+    char state_rom[512] ;
+    snprintf ( state_rom , sizeof ( state_rom ) , "%s/Tetris.ch8" , bench.rom_dir ) ;
+    bench_states ( &bench , chip8 , state_rom ) ;
+#ifdef BENCH_SDL
+    bench_displays ( &bench , chip8 , state_rom ) ;
+#else
+    fprintf ( stderr , "Built without SDL, skipping display benchmarks\n" ) ;
+#endif
+
+    print_results ( &bench ) ;
+    free_chip8 ( chip8 ) ;
+    free ( chip8 ) ;
+    return EXIT_SUCCESS ;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file disasm.c
+ * @brief Static Disassembler and Control-Flow Graph Tool
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * Loads a ROM the way the emulator does (same quirk profile detection),
+ * analyses it from 0x200 (see cfg.h) and prints a listing with labelled
+ * basic blocks and the data between them:
+ *
+ *     chip8-disasm roms/Tetris.ch8
+ *     chip8-disasm --dot tetris.dot --json tetris.json roms/Tetris.ch8
+ *     dot -Tsvg tetris.dot -o tetris.svg
+ */
+
+#include "chip8.h"
+#include "cfg.h"
+
+static void usage ( const char *program ) {
+    fprintf ( stderr ,
+        "Usage: %s [options] <rom>\n"
+        "  --dot FILE        write the control-flow graph as Graphviz DOT\n"
+        "  --json FILE       write the blocks, edges, computed jumps and data ranges as JSON\n"
+        "  --quiet           no listing on stdout\n"
+        "  --quirks NAME     quirk profile: auto (default), chip8, vip, chip48, schip or xochip\n"
+        , program ) ;
+}
+
+int main ( int argc , char const *argv[] ) {
+    const char *rom_name = NULL ;
+    const char *dot_name = NULL ;
+    const char *json_name = NULL ;
+    bool quiet = false ;
+    quirks_t quirks = QUIRKS_AUTO ;
+
+    for ( int i = 1 ; i < argc ; i++ ) {
+        const bool has_value = i + 1 < argc ;
+        if ( strcmp ( argv[i] , "--dot" ) == 0 && has_value ) dot_name = argv[++i] ;
+        else if ( strcmp ( argv[i] , "--json" ) == 0 && has_value ) json_name = argv[++i] ;
+        else if ( strcmp ( argv[i] , "--quiet" ) == 0 ) quiet = true ;
+        else if ( strcmp ( argv[i] , "--quirks" ) == 0 && has_value ) {
+            if ( !chip8_parse_quirks ( argv[++i] , &quirks ) ) exit ( EXIT_FAILURE ) ;
+        }
+        else if ( argv[i][0] == '-' ) {
+            usage ( argv[0] ) ;
+            exit ( EXIT_FAILURE ) ;
+        }
+        else rom_name = argv[i] ;
+    }
+    if ( !rom_name ) {
+        usage ( argv[0] ) ;
+        exit ( EXIT_FAILURE ) ;
+    }
+
+    chip8_t *chip8 = calloc ( 1 , sizeof ( chip8_t ) ) ;
+    if ( !chip8 ) exit ( EXIT_FAILURE ) ;
+    chip8->quirks_request = quirks ;
+    if ( !init_chip8 ( chip8 , rom_name ) ) exit ( EXIT_FAILURE ) ;
+
+    cfg_t cfg ;
+    if ( !cfg_analyze ( &cfg , chip8->memory , chip8_address_mask ( chip8 ) , chip8->xo_chip , 0x200 , 0x200 + chip8->rom_size ) ) {
+        exit ( EXIT_FAILURE ) ;
+    }
+    if ( !quiet ) cfg_print_listing ( &cfg , stdout ) ;
+    int status = EXIT_SUCCESS ;
+    if ( dot_name && !cfg_write_dot ( &cfg , dot_name ) ) status = EXIT_FAILURE ;
+    if ( json_name && !cfg_write_json ( &cfg , json_name ) ) status = EXIT_FAILURE ;
+    for ( size_t i = 0 ; i < cfg.computed_count ; i++ ) {
+        fprintf ( stderr , "Computed jump at 0x%03X: code it reaches is listed as data\n" , cfg.computed[i] ) ;
+    }
+
+    cfg_free ( &cfg ) ;
+    free_chip8 ( chip8 ) ;
+    free ( chip8 ) ;
+    return status ;
+}
@@ -0,0 +1,203 @@
+/**
+ * @file farm.c
+ * @brief Parallel ROM Farm for Regression Sweeps
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * Runs every job of a manifest on all cores in one process: a
+ * work-stealing pool hands jobs to workers, and each worker reuses one
+ * pre-allocated chip8_t for all the jobs it runs. One result line is
+ * printed per job, in manifest order.
+ *
+ * Manifest format, one job per line:
+ *
+ *     # rom                 frames  options
+ *     roms/Tetris.ch8       3600    ips=700 input=tests/tetris.keys
+ *     roms/Brick.ch8        600     jit
+ *     roms/IBM-Logo.ch8     60      quirks=vip
+ */
+
+#include "chip8.h"
+#include "config.h"
+#include "jit.h"
+#include "runner.h"
+#include "workpool.h"
+
+#define MANIFEST_LINE_MAX 1024
+
+typedef struct {
+    char *rom ;
+    char *input ;    // NULL when the job has no input script
+    uint64_t frames ;
+    uint32_t ips ;
+    bool jit ;
+    quirks_t quirks ;
+    uint32_t line ;  // Manifest line, for messages
+} farm_job_t ;
+
+typedef struct {
+    bool ok ;
+    uint64_t hash ;
+    uint64_t instructions ;
+    uint64_t frames ;
+    double seconds ;
+} farm_result_t ;
+
+typedef struct {
+    farm_job_t *jobs ;
+    farm_result_t *results ;
+    chip8_t **machines ; // One per worker
+} farm_t ;
+
+static char *copy_string ( const char *text ) {
+    char *copy = malloc ( strlen ( text ) + 1 ) ;
+    if ( copy ) strcpy ( copy , text ) ;
+    return copy ;
+}
+
+// Parse the manifest into *jobs, returns the job count or -1 on error
+static long load_manifest ( const char *path , const config_t *config , farm_job_t **jobs ) {
+    FILE *file = fopen ( path , "r" ) ;
+    if ( !file ) {
+        CHIP8_LOG ( "Could not open manifest %s\n" , path ) ;
+        return -1 ;
+    }
+
+    size_t count = 0 , capacity = 0 ;
+    char line[MANIFEST_LINE_MAX] ;
+    uint32_t line_number = 0 ;
+    *jobs = NULL ;
+    while ( fgets ( line , sizeof ( line ) , file ) ) {
+        line_number++ ;
+        char *hash = strchr ( line , '#' ) ;
+        if ( hash ) *hash = '\0' ;
+
+        char *rom = strtok ( line , " \t\r\n" ) ;
+        if ( !rom ) continue ;
+        char *frames = strtok ( NULL , " \t\r\n" ) ;
+        if ( !frames || strtoull ( frames , NULL , 10 ) == 0 ) {
+            CHIP8_LOG ( "%s:%u: expected '<rom> <frames> [options]'\n" , path , line_number ) ;
+            fclose ( file ) ;
+            return -1 ;
+        }
+
+        farm_job_t job = { .frames = strtoull ( frames , NULL , 10 ) , .ips = config->instructions_per_second ,
+                           .jit = config->use_jit , .line = line_number } ;
+        char *option ;
+        while ( ( option = strtok ( NULL , " \t\r\n" ) ) ) {
+            if ( strncmp ( option , "ips=" , 4 ) == 0 ) job.ips = strtoul ( option + 4 , NULL , 10 ) ;
+            else if ( strncmp ( option , "input=" , 6 ) == 0 ) job.input = copy_string ( option + 6 ) ;
+            else if ( strcmp ( option , "jit" ) == 0 ) job.jit = true ;
+            else if ( strcmp ( option , "interp" ) == 0 ) job.jit = false ;
+            else if ( strncmp ( option , "quirks=" , 7 ) == 0 && chip8_parse_quirks ( option + 7 , &job.quirks ) ) continue ;
+            else {
+                CHIP8_LOG ( "%s:%u: unknown option %s\n" , path , line_number , option ) ;
+                fclose ( file ) ;
+                return -1 ;
+            }
+        }
+        job.rom = copy_string ( rom ) ;
+
+        if ( count == capacity ) {
+            capacity = capacity ? capacity * 2 : 64 ;
+            farm_job_t *grown = realloc ( *jobs , capacity * sizeof ( farm_job_t ) ) ;
+            if ( !grown ) {
+                fclose ( file ) ;
+                return -1 ;
+            }
+            *jobs = grown ;
+        }
+        (*jobs)[count++] = job ;
+    }
+    fclose ( file ) ;
+    return (long)count ;
+}
+
+// Pool task: run one job on the worker's machine
+static void run_job ( void *context , size_t index , unsigned worker ) {
+    farm_t *farm = context ;
+    const farm_job_t *job = &farm->jobs[index] ;
+    farm_result_t *result = &farm->results[index] ;
+    chip8_t *chip8 = farm->machines[worker] ;
+
+    input_script_t script = {0} ;
+    if ( job->input && !load_input_script ( &script , job->input ) ) return ;
+
+    if ( job->jit ) jit_enable ( chip8 ) ;
+    else jit_disable ( chip8 ) ;
+
+    chip8->quirks_request = job->quirks ;
+    if ( init_chip8 ( chip8 , job->rom ) ) {
+        const run_options_t options = { .max_frames = job->frames , .instructions_per_second = job->ips ,
+                                        .script = job->input ? &script : NULL } ;
+        run_result_t run ;
+        run_headless ( chip8 , &options , &run ) ;
+        *result = (farm_result_t) { .ok = true , .hash = state_hash ( chip8 ) , .instructions = run.instructions ,
+                                    .frames = run.frames , .seconds = run.seconds } ;
+    }
+    free_input_script ( &script ) ;
+}
+
+int main ( int argc , char const *argv[] ) {
+    config_t config = {0} ;
+    if ( !init_config ( &config ) ) exit ( EXIT_FAILURE ) ;
+
+    const char *manifest = NULL ;
+    unsigned threads = workpool_default_threads () ;
+    for ( int i = 1 ; i < argc ; i++ ) {
+        if ( strcmp ( argv[i] , "--threads" ) == 0 && i + 1 < argc ) threads = strtoul ( argv[++i] , NULL , 10 ) ;
+        else manifest = argv[i] ;
+    }
+    if ( !manifest || threads == 0 ) {
+        fprintf ( stderr , "Usage: %s [--threads N] <manifest>\n" , argv[0] ) ;
+        exit ( EXIT_FAILURE ) ;
+    }
+
+    farm_t farm = {0} ;
+    const long count = load_manifest ( manifest , &config , &farm.jobs ) ;
+    if ( count < 0 ) exit ( EXIT_FAILURE ) ;
+    if ( (long)threads > count ) threads = count > 0 ? (unsigned)count : 1 ;
+
+    farm.results = calloc ( count ? count : 1 , sizeof ( farm_result_t ) ) ;
+    farm.machines = calloc ( threads , sizeof ( chip8_t * ) ) ;
+    if ( !farm.results || !farm.machines ) exit ( EXIT_FAILURE ) ;
+    for ( unsigned w = 0 ; w < threads ; w++ ) {
+        farm.machines[w] = calloc ( 1 , sizeof ( chip8_t ) ) ;
+        if ( !farm.machines[w] ) exit ( EXIT_FAILURE ) ;
+    }
+
+    const double start = monotonic_seconds () ;
+    workpool_run ( threads , (size_t)count , run_job , &farm ) ;
+    const double elapsed = monotonic_seconds () - start ;
+
+    int failures = 0 ;
+    uint64_t total_instructions = 0 ;
+    for ( long i = 0 ; i < count ; i++ ) {
+        const farm_result_t *result = &farm.results[i] ;
+        if ( !result->ok ) {
+            printf ( "job=%ld line=%u rom=%s status=error\n" , i , farm.jobs[i].line , farm.jobs[i].rom ) ;
+            failures++ ;
+            continue ;
+        }
+        printf ( "job=%ld line=%u rom=%s status=ok state_hash=%016llx instructions=%llu frames=%llu wall_ms=%.3f\n" ,
+                 i , farm.jobs[i].line , farm.jobs[i].rom , (unsigned long long)result->hash ,
+                 (unsigned long long)result->instructions , (unsigned long long)result->frames , result->seconds * 1000.0 ) ;
+        total_instructions += result->instructions ;
+    }
+    fprintf ( stderr , "%ld jobs on %u threads in %.3f s (%.0f instructions/s), %d failed\n" ,
+              count , threads , elapsed , elapsed > 0 ? total_instructions / elapsed : 0.0 , failures ) ;
+
+    for ( unsigned w = 0 ; w < threads ; w++ ) {
+        jit_disable ( farm.machines[w] ) ;
+        free_chip8 ( farm.machines[w] ) ;
+        free ( farm.machines[w] ) ;
+    }
+    for ( long i = 0 ; i < count ; i++ ) {
+        free ( farm.jobs[i].rom ) ;
+        free ( farm.jobs[i].input ) ;
+    }
+    free ( farm.machines ) ;
+    free ( farm.results ) ;
+    free ( farm.jobs ) ;
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS ;
+}
@@ -0,0 +1,1191 @@
+/**
+ * @file fuzz.c
+ * @brief Differential Fuzzer for the Interpreter and the JIT
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * Generates random CHIP-8 programs (or mutates the ROMs given on the
+ * command line) and runs each one in lockstep on the production core and
+ * on a deliberately naive reference model: a switch on the raw opcode
+ * nibbles, one byte per pixel, no decode cache, no idle-loop skipping and
+ * no JIT. The production side runs in chunks of random length through
+ * run_cycles, the reference executes as many instructions as run_cycles
+ * reports, and the whole machine state is compared after every chunk.
+ * Between chunks the timers tick and keys change the same way on both.
+ *
+ * The first difference stops every worker. The failing program is shrunk
+ * (fewer steps, instructions replaced with 0000, trailing bytes dropped)
+ * while it still fails, printed and saved as a text case that --replay
+ * runs again:
+ *
+ *     chip8-fuzz --seconds 60
+ *     chip8-fuzz --quirks schip --jit on roms/Tetris.ch8 roms/Brick.ch8
+ *     chip8-fuzz --replay fuzz-1f2e3d4c5b6a7988.case
+ *
+ * With --lanes N the reference is not used: each case runs on a batch of
+ * N lanes (batch.h), each with its own RNG seed and keys, and on N
+ * machines through run_cycles, and batch_export_lane must give back every
+ * machine's state after each chunk. Lanes are now and then reset or
+ * imported on both sides.
+ *
+ *     chip8-fuzz --lanes 16 --quirks chip8 roms/Tetris.ch8
+ *
+ * Workers (one per core by default) each own their machines and reference
+ * instances, so nothing is shared while a case runs. Built with
+ * -DCHIP8_LIBFUZZER (make libfuzzer) the file provides
+ * LLVMFuzzerTestOneInput instead of main.
+ */
+#define _POSIX_C_SOURCE 200809L // pthreads
+
+#include <pthread.h>
+#include <ctype.h>
+#include "batch.h"
+#include "chip8.h"
+#include "disasm.h"
+#include "jit.h"
+#include "runner.h"
+#include "workpool.h"
+
+#define FUZZ_ENTRY 0x200
+#define FUZZ_MAX_PROGRAM ( CHIP8_MEMORY_SIZE - FUZZ_ENTRY ) // Mutated ROMs are cut to 4K
+#define FUZZ_MAX_STEPS 4096    // Instructions per case
+#define FUZZ_MAX_CHUNK 200     // Longest run_cycles call (idle loops are only skipped from 64 on)
+#define FUZZ_BATCH 32          // Cases per pool task
+#define FUZZ_REPORT_MAX 256
+#define FUZZ_MAX_LANES 64      // --lanes
+
+// Everything needed to run a case again: the program and the seed of the
+// schedule (chunk lengths, timer ticks and key changes)
+typedef struct {
+    quirks_t quirks ;
+    bool jit ;
+    uint32_t seed ;
+    uint32_t steps ;   // Instruction budget (per lane)
+    uint32_t lanes ;   // Batch lanes checked against machines, 0: the core against the reference
+    uint32_t length ;  // Program bytes, loaded at 0x200
+    uint8_t program[FUZZ_MAX_PROGRAM] ;
+} fuzz_case_t ;
+
+// The reference machine: the registers of chip8_t and one byte per pixel
+typedef struct {
+    uint8_t memory[CHIP8_MAX_MEMORY_SIZE] ;
+    uint8_t V[16] ;
+    uint16_t I ;
+    uint16_t pc ;
+    uint16_t stack[CHIP8_STACK_SIZE] ;
+    uint8_t sp ;
+    uint8_t delay_timer ;
+    uint8_t sound_timer ;
+    uint8_t flags[16] ;
+    uint32_t rng ;
+    bool hires ;
+    uint8_t plane_mask ;
+    bool stopped ;
+    bool keypad[16] ;
+    bool drawn ; // Display drawn, cleared or scrolled since it was last compared
+    uint8_t pixels[CHIP8_PLANES][CHIP8_HIRES_HEIGHT][CHIP8_HIRES_WIDTH] ;
+} reference_t ;
+
+// Where and how a case failed
+typedef struct {
+    uint32_t executed ;            // Instructions run when the difference was seen
+    uint32_t chunk_start ;         // First instruction of the chunk it was seen after
+    uint16_t chunk_pc[FUZZ_MAX_CHUNK] ; // Reference pc before each instruction of that chunk
+    uint32_t chunk_length ;
+    char what[FUZZ_REPORT_MAX] ;
+} fuzz_report_t ;
+
+// ---------------------------------------------------------------------------
+// Reference model
+// ---------------------------------------------------------------------------
+
+static void reference_reset ( reference_t *ref , const chip8_t *chip8 ) {
+    memset ( ref , 0 , sizeof ( *ref ) ) ;
+    memcpy ( ref->memory , chip8->memory , sizeof ( ref->memory ) ) ; // Fonts and program
+    ref->pc = chip8->pc ;
+    ref->rng = chip8->rng ;
+    ref->plane_mask = chip8->plane_mask ;
+}
+
+static uint32_t reference_width ( const reference_t *ref ) { return ref->hires ? CHIP8_HIRES_WIDTH : CHIP8_DISPLAY_WIDTH ; }
+static uint32_t reference_height ( const reference_t *ref ) { return ref->hires ? CHIP8_HIRES_HEIGHT : CHIP8_DISPLAY_HEIGHT ; }
+
+// Move the selected planes dx pixels right (or left) or dy rows down (or up)
+static void reference_scroll ( reference_t *ref , int dx , int dy ) {
+    ref->drawn = true ;
+    const int width = (int)reference_width ( ref ) , height = (int)reference_height ( ref ) ;
+    for ( int plane = 0 ; plane < CHIP8_PLANES ; plane++ ) {
+        if ( !(ref->plane_mask & (1 << plane)) ) continue ;
+        uint8_t (*rows)[CHIP8_HIRES_WIDTH] = ref->pixels[plane] ;
+        if ( dy > 0 ) {
+            for ( int y = height - 1 ; y >= 0 ; y-- ) {
+                if ( y >= dy ) memcpy ( rows[y] , rows[y - dy] , width ) ;
+                else memset ( rows[y] , 0 , width ) ;
+            }
+        } else if ( dy < 0 ) {
+            for ( int y = 0 ; y < height ; y++ ) {
+                if ( y - dy < height ) memcpy ( rows[y] , rows[y - dy] , width ) ;
+                else memset ( rows[y] , 0 , width ) ;
+            }
+        }
+        for ( int y = 0 ; dx && y < height ; y++ ) {
+            if ( dx > 0 ) {
+                memmove ( rows[y] + dx , rows[y] , width - dx ) ;
+                memset ( rows[y] , 0 , dx ) ;
+            } else {
+                memmove ( rows[y] , rows[y] - dx , width + dx ) ;
+                memset ( rows[y] + width + dx , 0 , -dx ) ;
+            }
+        }
+    }
+}
+
+static void reference_draw ( reference_t *ref , uint8_t X , uint8_t Y , uint8_t N , uint16_t mask , bool clip ) {
+    const uint32_t width = reference_width ( ref ) , height = reference_height ( ref ) ;
+    const uint32_t x0 = ref->V[X] % width , y0 = ref->V[Y] % height ;
+    const uint32_t rows = N ? N : 16 , columns = N ? 8 : 16 ;
+    uint16_t address = ref->I ;
+    bool collision = false ;
+    ref->drawn = true ;
+    for ( int plane = 0 ; plane < CHIP8_PLANES ; plane++ ) {
+        if ( !(ref->plane_mask & (1 << plane)) ) continue ;
+        for ( uint32_t row = 0 ; row < rows ; row++ ) {
+            uint32_t bits = ref->memory[address++ & mask] ;
+            if ( N == 0 ) bits = (bits << 8) | ref->memory[address++ & mask] ;
+            for ( uint32_t column = 0 ; column < columns ; column++ ) {
+                if ( !((bits >> (columns - 1 - column)) & 1) ) continue ;
+                uint32_t x = x0 + column , y = y0 + row ;
+                if ( clip && ( x >= width || y >= height ) ) continue ;
+                x %= width ;
+                y %= height ;
+                if ( ref->pixels[plane][y][x] ) collision = true ;
+                ref->pixels[plane][y][x] ^= 1 ;
+            }
+        }
+    }
+    ref->V[0xF] = collision ;
+}
+
+// Execute one instruction; true when the machine then waits for the next
+// frame (a key for FX0A, the vertical blank after DXYN on the VIP), where
+// run_cycles counts the rest of its budget as spent, or stopped (00FD)
+static bool reference_step ( reference_t *ref , const quirk_set_t *quirks ) {
+    if ( ref->stopped ) return true ;
+    const uint16_t mask = quirks->xo_chip ? CHIP8_MAX_MEMORY_SIZE - 1 : CHIP8_MEMORY_SIZE - 1 ;
+    const uint16_t opcode = (ref->memory[ref->pc & mask] << 8) | ref->memory[(ref->pc + 1) & mask] ;
+    const uint8_t X = (opcode >> 8) & 0xF , Y = (opcode >> 4) & 0xF , N = opcode & 0xF , NN = opcode & 0xFF ;
+    const uint16_t NNN = opcode & 0xFFF ;
+    uint8_t *V = ref->V ;
+    ref->pc += 2 ;
+
+    // A taken skip steps over XO-CHIP's F000 NNNN whole
+    const uint16_t skip = quirks->xo_chip && ref->memory[ref->pc & mask] == 0xF0 && ref->memory[(ref->pc + 1) & mask] == 0x00 ? 4 : 2 ;
+    switch ( opcode >> 12 ) {
+        case 0x0 :
+            if ( (NN & 0xF0) == 0xC0 ) reference_scroll ( ref , 0 , (int)N ) ;
+            else if ( (NN & 0xF0) == 0xD0 ) reference_scroll ( ref , 0 , -(int)N ) ;
+            else if ( NN == 0xE0 ) {
+                ref->drawn = true ;
+                for ( int plane = 0 ; plane < CHIP8_PLANES ; plane++ ) {
+                    if ( ref->plane_mask & (1 << plane) ) memset ( ref->pixels[plane] , 0 , sizeof ( ref->pixels[plane] ) ) ;
+                }
+            }
+            else if ( NN == 0xEE ) ref->pc = ref->stack[--ref->sp % CHIP8_STACK_SIZE] ;
+            else if ( NN == 0xFB ) reference_scroll ( ref , 4 , 0 ) ;
+            else if ( NN == 0xFC ) reference_scroll ( ref , -4 , 0 ) ;
+            else if ( NN == 0xFD ) {
+                ref->stopped = true ;
+                ref->pc -= 2 ;
+                return true ;
+            }
+            else if ( NN == 0xFE || NN == 0xFF ) {
+                ref->hires = NN == 0xFF ;
+                ref->drawn = true ;
+                memset ( ref->pixels , 0 , sizeof ( ref->pixels ) ) ;
+            }
+            break ;
+        case 0x1 : ref->pc = NNN ; break ;
+        case 0x2 :
+            ref->stack[ref->sp++ % CHIP8_STACK_SIZE] = ref->pc ;
+            ref->pc = NNN ;
+            break ;
+        case 0x3 : if ( V[X] == NN ) ref->pc += skip ; break ;
+        case 0x4 : if ( V[X] != NN ) ref->pc += skip ; break ;
+        case 0x5 :
+            if ( N == 0 ) {
+                if ( V[X] == V[Y] ) ref->pc += skip ;
+            } else if ( N == 2 || N == 3 ) {
+                // Registers X to Y, in either direction, at I onwards
+                const int step = X <= Y ? 1 : -1 ;
+                for ( int i = 0 , r = X ; ; i++ , r += step ) {
+                    if ( N == 2 ) ref->memory[(ref->I + i) & mask] = V[r] ;
+                    else V[r] = ref->memory[(ref->I + i) & mask] ;
+                    if ( r == Y ) break ;
+                }
+            }
+            break ;
+        case 0x6 : V[X] = NN ; break ;
+        case 0x7 : V[X] += NN ; break ;
+        case 0x8 : {
+            const uint8_t x = V[X] , y = V[Y] ;
+            const uint8_t shifted = quirks->shift_vy ? y : x ;
+            switch ( N ) {
+                case 0x0 : V[X] = y ; break ;
+                case 0x1 : V[X] = x | y ; if ( quirks->vf_reset_or_xor ) V[0xF] = 0 ; break ;
+                case 0x2 : V[X] = x & y ; if ( quirks->vf_reset_and ) V[0xF] = 0 ; break ;
+                case 0x3 : V[X] = x ^ y ; if ( quirks->vf_reset_or_xor ) V[0xF] = 0 ; break ;
+                case 0x4 : V[X] = x + y ; V[0xF] = x + y > 0xFF ; break ;
+                case 0x5 : V[X] = x - y ; V[0xF] = x >= y ; break ;
+                case 0x6 : V[X] = shifted >> 1 ; V[0xF] = shifted & 1 ; break ;
+                case 0x7 : V[X] = y - x ; V[0xF] = y >= x ; break ;
+                case 0xE : V[X] = shifted << 1 ; V[0xF] = shifted >> 7 ; break ;
+                default : break ;
+            }
+            break ;
+        }
+        case 0x9 : if ( V[X] != V[Y] ) ref->pc += skip ; break ;
+        case 0xA : ref->I = NNN ; break ;
+        case 0xB : ref->pc = NNN + V[quirks->jump_vx ? X : 0] ; break ;
+        case 0xC :
+            ref->rng ^= ref->rng << 13 ;
+            ref->rng ^= ref->rng >> 17 ;
+            ref->rng ^= ref->rng << 5 ;
+            V[X] = (ref->rng >> 24) & NN ;
+            break ;
+        case 0xD :
+            reference_draw ( ref , X , Y , N , mask , quirks->clip ) ;
+            return quirks->display_wait ;
+        case 0xE :
+            if ( NN == 0x9E && ref->keypad[V[X] & 0xF] ) ref->pc += skip ;
+            if ( NN == 0xA1 && !ref->keypad[V[X] & 0xF] ) ref->pc += skip ;
+            break ;
+        case 0xF :
+            if ( opcode == 0xF000 ) {
+                if ( !quirks->xo_chip ) break ;
+                ref->I = (ref->memory[ref->pc & mask] << 8) | ref->memory[(ref->pc + 1) & mask] ;
+                ref->pc += 2 ;
+                break ;
+            }
+            switch ( NN ) {
+                case 0x01 : ref->plane_mask = X & 0x3 ; break ;
+                case 0x07 : V[X] = ref->delay_timer ; break ;
+                case 0x0A : {
+                    int key = 0 ;
+                    while ( key < 16 && !ref->keypad[key] ) key++ ;
+                    if ( key < 16 ) V[X] = key ;
+                    else {
+                        ref->pc -= 2 ;
+                        return true ;
+                    }
+                    break ;
+                }
+                case 0x15 : ref->delay_timer = V[X] ; break ;
+                case 0x18 : ref->sound_timer = V[X] ; break ;
+                case 0x1E : ref->I += V[X] ; break ;
+                case 0x29 : ref->I = V[X] * 5 ; break ;
+                case 0x30 : ref->I = CHIP8_BIG_FONT_ADDRESS + (V[X] & 0xF) * 10 ; break ;
+                case 0x33 :
+                    ref->memory[ref->I & mask] = V[X] / 100 ;
+                    ref->memory[(ref->I + 1) & mask] = V[X] / 10 % 10 ;
+                    ref->memory[(ref->I + 2) & mask] = V[X] % 10 ;
+                    break ;
+                case 0x55 :
+                case 0x65 :
+                    for ( int i = 0 ; i <= X ; i++ ) {
+                        if ( NN == 0x55 ) ref->memory[(ref->I + i) & mask] = V[i] ;
+                        else V[i] = ref->memory[(ref->I + i) & mask] ;
+                    }
+                    if ( quirks->index == INDEX_LAST ) ref->I += X ;
+                    if ( quirks->index == INDEX_PAST_LAST ) ref->I += X + 1 ;
+                    break ;
+                case 0x75 : memcpy ( ref->flags , V , X + 1u ) ; break ;
+                case 0x85 : memcpy ( V , ref->flags , X + 1u ) ; break ;
+                default : break ;
+            }
+            break ;
+    }
+    return false ;
+}
+
+// ---------------------------------------------------------------------------
+// Lockstep runs
+// ---------------------------------------------------------------------------
+
+static uint32_t fuzz_random ( uint32_t *state ) {
+    *state ^= *state << 13 ;
+    *state ^= *state >> 17 ;
+    *state ^= *state << 5 ;
+    return *state ;
+}
+
+// First difference between the machines, false when there is none. The
+// display (16K pixels) is only compared when `display` is set.
+static bool compare_state ( const chip8_t *chip8 , const reference_t *ref , bool display , char *what , size_t size ) {
+    #define DIFFER(...) do { snprintf ( what , size , __VA_ARGS__ ) ; return true ; } while (0)
+    if ( chip8->pc != ref->pc ) DIFFER ( "pc is 0x%04X, reference 0x%04X" , chip8->pc , ref->pc ) ;
+    for ( int i = 0 ; i < 16 ; i++ ) {
+        if ( chip8->V[i] != ref->V[i] ) DIFFER ( "V%X is 0x%02X, reference 0x%02X" , i , chip8->V[i] , ref->V[i] ) ;
+    }
+    if ( chip8->I != ref->I ) DIFFER ( "I is 0x%04X, reference 0x%04X" , chip8->I , ref->I ) ;
+    if ( chip8->sp != ref->sp ) DIFFER ( "sp is %u, reference %u" , chip8->sp , ref->sp ) ;
+    for ( int i = 0 ; i < CHIP8_STACK_SIZE ; i++ ) {
+        if ( chip8->stack[i] != ref->stack[i] ) DIFFER ( "stack[%d] is 0x%04X, reference 0x%04X" , i , chip8->stack[i] , ref->stack[i] ) ;
+    }
+    if ( chip8->delay_timer != ref->delay_timer ) DIFFER ( "delay timer is %u, reference %u" , chip8->delay_timer , ref->delay_timer ) ;
+    if ( chip8->sound_timer != ref->sound_timer ) DIFFER ( "sound timer is %u, reference %u" , chip8->sound_timer , ref->sound_timer ) ;
+    for ( int i = 0 ; i < 16 ; i++ ) {
+        if ( chip8->flags[i] != ref->flags[i] ) DIFFER ( "flag %d is 0x%02X, reference 0x%02X" , i , chip8->flags[i] , ref->flags[i] ) ;
+    }
+    if ( chip8->rng != ref->rng ) DIFFER ( "rng is 0x%08X, reference 0x%08X" , chip8->rng , ref->rng ) ;
+    if ( chip8->hires != ref->hires ) DIFFER ( "hires is %d, reference %d" , chip8->hires , ref->hires ) ;
+    if ( chip8->plane_mask != ref->plane_mask ) DIFFER ( "plane mask is %u, reference %u" , chip8->plane_mask , ref->plane_mask ) ;
+    if ( (chip8->state == STOPPED) != ref->stopped ) DIFFER ( "stopped is %d, reference %d" , chip8->state == STOPPED , ref->stopped ) ;
+    const uint32_t memory_size = (uint32_t)chip8_address_mask ( chip8 ) + 1 ;
+    if ( memcmp ( chip8->memory , ref->memory , memory_size ) != 0 ) {
+        for ( uint32_t a = 0 ; a < memory_size ; a++ ) {
+            if ( chip8->memory[a] != ref->memory[a] ) DIFFER ( "memory[0x%04X] is 0x%02X, reference 0x%02X" , a , chip8->memory[a] , ref->memory[a] ) ;
+        }
+    }
+    // The packed display, a row at a time: low resolution must leave
+    // everything past 64x32 clear (the reference never sets a pixel there)
+    const uint32_t width = reference_width ( ref ) , height = reference_height ( ref ) ;
+    for ( int plane = 0 ; display && plane < CHIP8_PLANES ; plane++ ) {
+        for ( uint32_t y = 0 ; y < CHIP8_HIRES_HEIGHT ; y++ ) {
+            uint64_t row[CHIP8_ROW_WORDS] = {0} ;
+            for ( uint32_t x = 0 ; y < height && x < width ; x++ ) row[x / 64] |= (uint64_t)ref->pixels[plane][y][x] << (63 - x % 64) ;
+            if ( memcmp ( row , chip8->display[plane][y] , sizeof ( row ) ) == 0 ) continue ;
+            for ( uint32_t x = 0 ; x < CHIP8_HIRES_WIDTH ; x++ ) {
+                const uint8_t pixel = (chip8->display[plane][y][x / 64] >> (63 - x % 64)) & 1 ;
+                const uint8_t expected = (row[x / 64] >> (63 - x % 64)) & 1 ;
+                if ( pixel != expected ) DIFFER ( "plane %d pixel (%u, %u) is %u, reference %u" , plane , x , y , pixel , expected ) ;
+            }
+        }
+    }
+    return false ;
+    #undef DIFFER
+}
+
+// Run the case on chip8 and the reference; true when they agree throughout
+static bool run_case ( chip8_t *chip8 , reference_t *ref , const fuzz_case_t *c , fuzz_report_t *report , uint64_t *instructions ) {
+    chip8->quirks_request = c->quirks ;
+    if ( !load_chip8 ( chip8 , c->program , c->length , NULL ) ) {
+        snprintf ( report->what , sizeof ( report->what ) , "load_chip8 rejected the program" ) ;
+        return false ;
+    }
+    reference_reset ( ref , chip8 ) ;
+    const quirk_set_t *quirks = chip8_quirk_set ( chip8->quirks ) ;
+
+    uint32_t schedule = c->seed ? c->seed : 1 ;
+    uint32_t executed = 0 , calls = 0 ;
+    bool agree = true ;
+    while ( executed < c->steps && calls++ < c->steps && chip8->state != STOPPED ) {
+        // Mostly short chunks, sometimes long enough for the idle-loop skip
+        uint32_t chunk = fuzz_random ( &schedule ) % 4 ? 1 + fuzz_random ( &schedule ) % 16 : 1 + fuzz_random ( &schedule ) % FUZZ_MAX_CHUNK ;
+        if ( chunk > c->steps - executed ) chunk = c->steps - executed ;
+
+        const uint32_t ran = run_cycles ( chip8 , chunk ) ;
+        report->chunk_start = executed ;
+        report->chunk_length = 0 ;
+        bool waits = false ;
+        while ( report->chunk_length < chunk && !waits ) {
+            report->chunk_pc[report->chunk_length++] = ref->pc ;
+            waits = reference_step ( ref , quirks ) ;
+        }
+        // Waiting uses up the budget, stopping does not
+        executed += ran ;
+        if ( ran != ( waits && !ref->stopped ? chunk : report->chunk_length ) ) {
+            snprintf ( report->what , sizeof ( report->what ) , "run_cycles(%u) returned %u, reference ran %u%s" ,
+                      chunk , ran , report->chunk_length , waits ? " then waited" : "" ) ;
+            agree = false ;
+        } else {
+            // The display when the reference changed it: a stray write on the
+            // production side still shows at the next draw or at the end
+            agree = !compare_state ( chip8 , ref , ref->drawn , report->what , sizeof ( report->what ) ) ;
+            ref->drawn = false ;
+        }
+        if ( !agree ) break ;
+
+        // Frame boundary events, the same on both sides
+        const uint32_t event = fuzz_random ( &schedule ) ;
+        if ( event % 4 == 0 ) {
+            tick_timers ( chip8 ) ;
+            if ( ref->delay_timer ) ref->delay_timer-- ;
+            if ( ref->sound_timer ) ref->sound_timer-- ;
+        }
+        // Change a key now and then (FX0A waits for one)
+        if ( (event >> 8) % 8 == 0 ) {
+            const uint32_t key = (event >> 16) & 0xF ;
+            chip8->keypad[key] = ref->keypad[key] = !ref->keypad[key] ;
+        }
+    }
+    if ( agree ) agree = !compare_state ( chip8 , ref , true , report->what , sizeof ( report->what ) ) ;
+    report->executed = executed ;
+    if ( instructions ) *instructions += executed ;
+    return agree ;
+}
+
+// The mismatch, the program and the last instructions the reference ran
+static void print_case ( FILE *out , const fuzz_case_t *c , const fuzz_report_t *report , const reference_t *ref ) {
+    fprintf ( out , "Mismatch: %s\n" , report->what ) ;
+    char mode[32] ;
+    if ( c->lanes ) snprintf ( mode , sizeof ( mode ) , "batch of %u lanes" , c->lanes ) ;
+    else snprintf ( mode , sizeof ( mode ) , "%s" , c->jit ? "JIT" : "interpreter" ) ;
+    fprintf ( out , "  profile %s, %s, schedule seed 0x%08X, seen after instruction %u\n" ,
+              chip8_quirk_set ( c->quirks )->name , mode , c->seed , report->executed ) ;
+    const bool xo_chip = chip8_quirk_set ( c->quirks )->xo_chip ;
+    const uint16_t mask = xo_chip ? CHIP8_MAX_MEMORY_SIZE - 1 : CHIP8_MEMORY_SIZE - 1 ;
+    char text[DISASM_TEXT_MAX] ;
+    fprintf ( out , "  program (0000 left out):\n" ) ;
+    for ( uint32_t at = 0 ; at + 1 < c->length ; at += 2 ) {
+        if ( c->program[at] == 0 && c->program[at + 1] == 0 ) continue ;
+        disassemble ( c->program , 0xFFFF , at , false , text , sizeof ( text ) ) ;
+        fprintf ( out , "    %03X: %02X%02X  %s\n" , FUZZ_ENTRY + at , c->program[at] , c->program[at + 1] , text ) ;
+    }
+    // The failing chunk as the reference ran it (memory as it was at the end)
+    if ( !report->chunk_length ) return ;
+    const uint32_t shown = report->chunk_length < 16 ? 0 : report->chunk_length - 16 ;
+    fprintf ( out , "  end of the last chunk (run_cycles call), instructions %u-%u:\n" ,
+              report->chunk_start + shown + 1 , report->chunk_start + report->chunk_length ) ;
+    for ( uint32_t i = shown ; i < report->chunk_length ; i++ ) {
+        disassemble ( ref->memory , mask , report->chunk_pc[i] , xo_chip , text , sizeof ( text ) ) ;
+        fprintf ( out , "    %04X  %s\n" , report->chunk_pc[i] , text ) ;
+    }
+}
+
+#ifdef CHIP8_LIBFUZZER
+
+// ---------------------------------------------------------------------------
+// libFuzzer entry point: byte 0 picks the profile, byte 1 the JIT, bytes
+// 2-5 seed the schedule, the rest is the program
+// ---------------------------------------------------------------------------
+
+int LLVMFuzzerTestOneInput ( const uint8_t *data , size_t size ) {
+    static chip8_t *machines[2] ;
+    static reference_t *ref ;
+    static fuzz_case_t c ;
+    static fuzz_report_t report ;
+    if ( !ref ) {
+        machines[0] = calloc ( 1 , sizeof ( chip8_t ) ) ;
+        machines[1] = calloc ( 1 , sizeof ( chip8_t ) ) ;
+        ref = malloc ( sizeof ( reference_t ) ) ;
+        if ( !machines[0] || !machines[1] || !ref ) abort () ;
+        jit_enable ( machines[1] ) ;
+    }
+    if ( size < 6 ) return 0 ;
+    c.quirks = (quirks_t)( QUIRKS_CHIP8 + data[0] % ( QUIRKS_COUNT - 1 ) ) ;
+    c.jit = ( data[1] & 1 ) && !chip8_quirk_set ( c.quirks )->xo_chip ;
+    c.seed = (uint32_t)data[2] | (uint32_t)data[3] << 8 | (uint32_t)data[4] << 16 | (uint32_t)data[5] << 24 ;
+    c.steps = FUZZ_MAX_STEPS ;
+    c.length = size - 6 < FUZZ_MAX_PROGRAM ? (uint32_t)( size - 6 ) : FUZZ_MAX_PROGRAM ;
+    memcpy ( c.program , data + 6 , c.length ) ;
+    if ( !run_case ( machines[c.jit] , ref , &c , &report , NULL ) ) {
+        print_case ( stderr , &c , &report , ref ) ;
+        abort () ;
+    }
+    return 0 ;
+}
+
+#else
+
+// ---------------------------------------------------------------------------
+// Program generation and mutation
+// ---------------------------------------------------------------------------
+
+// A well mixed, never zero seed for case `index` of a run seeded with `seed`
+static uint32_t fuzz_seed ( uint32_t seed , uint64_t index ) {
+    uint64_t z = ( (uint64_t)seed << 32 ) + index + 0x9E3779B97F4A7C15ull ;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull ;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull ;
+    z ^= z >> 31 ;
+    return (uint32_t)z ? (uint32_t)z : 1 ;
+}
+
+// An instruction in a random program of `count` instructions (jump, call
+// and I targets mostly stay inside it); F000 gets its address word in *next
+static uint16_t random_instruction ( uint32_t *rng , uint32_t count , uint16_t *next , bool *wide ) {
+    const uint32_t r = fuzz_random ( rng ) ;
+    const uint16_t X = (r >> 8) & 0xF , Y = (r >> 12) & 0xF , N = (r >> 16) & 0xF , NN = (r >> 20) & 0xFF ;
+    const uint16_t target = FUZZ_ENTRY + 2 * ( (r >> 4) % count ) ;
+    const uint16_t XY = (X << 8) | (Y << 4) ;
+    *wide = false ;
+    switch ( r % 48 ) {
+        case 0 : return 0x00E0 ;
+        case 1 : return 0x00EE ;
+        case 2 : return 0x00C0 | N ;
+        case 3 : return 0x00D0 | N ;
+        case 4 : return 0x00FB + (r >> 24) % 5 ; // 00FB-00FF
+        case 5 : case 6 : return 0x1000 | target ;
+        case 7 : case 8 : return 0x2000 | target ;
+        case 9 : case 10 : return 0x3000 | (X << 8) | (NN & 0x0F) ;
+        case 11 : case 12 : return 0x4000 | (X << 8) | (NN & 0x0F) ;
+        case 13 : return 0x5000 | XY ;
+        case 14 : return 0x5002 | XY ;
+        case 15 : return 0x5003 | XY ;
+        case 16 : case 17 : case 18 : return 0x6000 | (X << 8) | NN ;
+        case 19 : case 20 : return 0x7000 | (X << 8) | NN ;
+        case 21 : case 22 : case 23 : {
+            static const uint8_t alu[] = { 0x0 , 0x1 , 0x2 , 0x3 , 0x4 , 0x5 , 0x6 , 0x7 , 0xE } ;
+            return 0x8000 | XY | alu[(r >> 24) % sizeof ( alu )] ;
+        }
+        case 24 : return 0x9000 | XY ;
+        case 25 : case 26 : {
+            // The program itself (self-modifying code), the fonts, or anywhere
+            const uint32_t where = (r >> 24) % 4 ;
+            if ( where < 2 ) return 0xA000 | target ;
+            if ( where == 2 ) return 0xA000 | ( (r >> 4) % 0xF0 ) ;
+            return 0xA000 | ( (r >> 4) & 0xFFF ) ;
+        }
+        case 27 : return 0xB000 | ( target & 0xFF0 ) ;
+        case 28 : return 0xC000 | (X << 8) | NN ;
+        case 29 : case 30 : case 31 : return 0xD000 | XY | N ;
+        case 32 : return 0xE09E | (X << 8) ;
+        case 33 : return 0xE0A1 | (X << 8) ;
+        case 34 : return 0xF007 | (X << 8) ;
+        case 35 : return (r >> 24) % 4 == 0 ? 0xF00A | (X << 8) : 0xF015 | (X << 8) ;
+        case 36 : return 0xF018 | (X << 8) ;
+        case 37 : return 0xF01E | (X << 8) ;
+        case 38 : return 0xF029 | (X << 8) ;
+        case 39 : return 0xF030 | (X << 8) ;
+        case 40 : return 0xF033 | (X << 8) ;
+        case 41 : return 0xF055 | (X << 8) ;
+        case 42 : return 0xF065 | (X << 8) ;
+        case 43 : return ( (r >> 24) % 2 ? 0xF075 : 0xF085 ) | (X << 8) ;
+        case 44 : return 0xF001 | (X << 8) ;
+        case 45 :
+            *wide = true ;
+            *next = (r >> 24) % 2 ? target : (uint16_t)fuzz_random ( rng ) ;
+            return 0xF000 ;
+        case 46 : return (r >> 24) % 16 == 0 ? 0x00FD : 0x0000 ;
+        default : return (uint16_t)fuzz_random ( rng ) ; // Anything at all
+    }
+}
+
+static void put_word ( uint8_t *program , uint32_t at , uint16_t word ) {
+    program[at] = word >> 8 ;
+    program[at + 1] = word & 0xFF ;
+}
+
+static void generate_program ( fuzz_case_t *c , uint32_t *rng ) {
+    const uint32_t count = 8 + fuzz_random ( rng ) % 120 ;
+    c->length = 2 * count ;
+    for ( uint32_t i = 0 ; i < count ; i++ ) {
+        uint16_t next = 0 ;
+        bool wide ;
+        put_word ( c->program , 2 * i , random_instruction ( rng , count , &next , &wide ) ) ;
+        if ( wide && i + 1 < count ) put_word ( c->program , 2 * ++i , next ) ;
+    }
+}
+
+static void mutate_program ( fuzz_case_t *c , const uint8_t *rom , uint32_t size , uint32_t *rng ) {
+    c->length = size < FUZZ_MAX_PROGRAM ? size : FUZZ_MAX_PROGRAM ;
+    c->length &= ~1u ;
+    if ( c->length < 2 ) {
+        generate_program ( c , rng ) ;
+        return ;
+    }
+    memcpy ( c->program , rom , c->length ) ;
+    const uint32_t count = c->length / 2 ;
+    const uint32_t mutations = 1 + fuzz_random ( rng ) % 8 ;
+    for ( uint32_t m = 0 ; m < mutations ; m++ ) {
+        const uint32_t at = 2 * ( fuzz_random ( rng ) % count ) ;
+        uint16_t next = 0 ;
+        bool wide ;
+        switch ( fuzz_random ( rng ) % 4 ) {
+            case 0 : c->program[at + fuzz_random ( rng ) % 2] ^= 1u << ( fuzz_random ( rng ) % 8 ) ; break ;
+            case 1 : c->program[at + fuzz_random ( rng ) % 2] = (uint8_t)fuzz_random ( rng ) ; break ;
+            case 2 : {
+                const uint32_t from = 2 * ( fuzz_random ( rng ) % count ) ;
+                const uint8_t hi = c->program[from] , lo = c->program[from + 1] ;
+                c->program[from] = c->program[at] ;
+                c->program[from + 1] = c->program[at + 1] ;
+                c->program[at] = hi ;
+                c->program[at + 1] = lo ;
+                break ;
+            }
+            default :
+                put_word ( c->program , at , random_instruction ( rng , count , &next , &wide ) ) ;
+                if ( wide && at + 3 < c->length ) put_word ( c->program , at + 2 , next ) ;
+                break ;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Batch lanes (--lanes)
+// ---------------------------------------------------------------------------
+
+// A worker's batch and the machines its lanes are checked against
+typedef struct {
+    chip8_batch_t *batch ;  // Created again when the profile or the lane count changes
+    quirks_t quirks ;
+    chip8_t *machines[FUZZ_MAX_LANES] ;
+    chip8_t *lane ;         // Where batch_export_lane puts a lane to compare it
+} fuzz_lanes_t ;
+
+static void lanes_destroy ( fuzz_lanes_t *lanes ) {
+    if ( !lanes ) return ;
+    batch_destroy ( lanes->batch ) ;
+    for ( uint32_t l = 0 ; l < FUZZ_MAX_LANES ; l++ ) {
+        if ( !lanes->machines[l] ) continue ;
+        free_chip8 ( lanes->machines[l] ) ;
+        free ( lanes->machines[l] ) ;
+    }
+    free_chip8 ( lanes->lane ) ;
+    free ( lanes->lane ) ;
+    free ( lanes ) ;
+}
+
+// The machines for up to `count` lanes; NULL when out of memory
+static fuzz_lanes_t *lanes_create ( uint32_t count ) {
+    fuzz_lanes_t *lanes = calloc ( 1 , sizeof ( fuzz_lanes_t ) ) ;
+    if ( !lanes ) return NULL ;
+    lanes->lane = calloc ( 1 , sizeof ( chip8_t ) ) ;
+    bool ok = lanes->lane != NULL ;
+    for ( uint32_t l = 0 ; ok && l < count ; l++ ) ok = ( lanes->machines[l] = calloc ( 1 , sizeof ( chip8_t ) ) ) != NULL ;
+    if ( ok ) return lanes ;
+    lanes_destroy ( lanes ) ;
+    return NULL ;
+}
+
+// First difference between an exported lane and its machine, false when there is none
+static bool compare_lane ( const chip8_t *lane , const chip8_t *chip8 , char *what , size_t size ) {
+    #define DIFFER(...) do { snprintf ( what , size , __VA_ARGS__ ) ; return true ; } while (0)
+    if ( lane->pc != chip8->pc ) DIFFER ( "pc is 0x%04X, machine 0x%04X" , lane->pc , chip8->pc ) ;
+    for ( int i = 0 ; i < 16 ; i++ ) {
+        if ( lane->V[i] != chip8->V[i] ) DIFFER ( "V%X is 0x%02X, machine 0x%02X" , i , lane->V[i] , chip8->V[i] ) ;
+    }
+    if ( lane->I != chip8->I ) DIFFER ( "I is 0x%04X, machine 0x%04X" , lane->I , chip8->I ) ;
+    if ( lane->sp != chip8->sp ) DIFFER ( "sp is %u, machine %u" , lane->sp , chip8->sp ) ;
+    for ( int i = 0 ; i < CHIP8_STACK_SIZE ; i++ ) {
+        if ( lane->stack[i] != chip8->stack[i] ) DIFFER ( "stack[%d] is 0x%04X, machine 0x%04X" , i , lane->stack[i] , chip8->stack[i] ) ;
+    }
+    if ( lane->delay_timer != chip8->delay_timer ) DIFFER ( "delay timer is %u, machine %u" , lane->delay_timer , chip8->delay_timer ) ;
+    if ( lane->sound_timer != chip8->sound_timer ) DIFFER ( "sound timer is %u, machine %u" , lane->sound_timer , chip8->sound_timer ) ;
+    for ( int i = 0 ; i < 16 ; i++ ) {
+        if ( lane->flags[i] != chip8->flags[i] ) DIFFER ( "flag %d is 0x%02X, machine 0x%02X" , i , lane->flags[i] , chip8->flags[i] ) ;
+    }
+    if ( lane->rng != chip8->rng ) DIFFER ( "rng is 0x%08X, machine 0x%08X" , lane->rng , chip8->rng ) ;
+    if ( lane->hires != chip8->hires ) DIFFER ( "hires is %d, machine %d" , lane->hires , chip8->hires ) ;
+    if ( lane->plane_mask != chip8->plane_mask ) DIFFER ( "plane mask is %u, machine %u" , lane->plane_mask , chip8->plane_mask ) ;
+    if ( (lane->state == STOPPED) != (chip8->state == STOPPED) ) DIFFER ( "stopped is %d, machine %d" , lane->state == STOPPED , chip8->state == STOPPED ) ;
+    for ( uint32_t a = 0 ; a < CHIP8_MEMORY_SIZE ; a++ ) {
+        if ( lane->memory[a] != chip8->memory[a] ) DIFFER ( "memory[0x%04X] is 0x%02X, machine 0x%02X" , a , lane->memory[a] , chip8->memory[a] ) ;
+    }
+    for ( int plane = 0 ; plane < CHIP8_PLANES ; plane++ ) {
+        for ( uint32_t y = 0 ; y < CHIP8_HIRES_HEIGHT ; y++ ) {
+            if ( memcmp ( lane->display[plane][y] , chip8->display[plane][y] , sizeof ( lane->display[plane][y] ) ) != 0 ) {
+                DIFFER ( "plane %d row %u differs from the machine's" , plane , y ) ;
+            }
+        }
+    }
+    return false ;
+    #undef DIFFER
+}
+
+// Run the case on c->lanes batch lanes and as many machines, all with
+// their own seeds and keys; true when every lane matches its machine throughout
+static bool run_lanes_case ( fuzz_lanes_t *lanes , const fuzz_case_t *c , fuzz_report_t *report , uint64_t *instructions ) {
+    const uint32_t count = c->lanes ;
+    report->chunk_length = 0 ; // No reference listing
+    report->executed = 0 ;
+    if ( !lanes->batch || lanes->quirks != c->quirks || lanes->batch->lanes != count ) {
+        batch_destroy ( lanes->batch ) ;
+        lanes->batch = batch_create ( count , c->quirks ) ;
+        lanes->quirks = c->quirks ;
+    }
+    chip8_batch_t *batch = lanes->batch ;
+    if ( !batch || !batch_load ( batch , c->program , c->length ) ) {
+        snprintf ( report->what , sizeof ( report->what ) , "batch_create or batch_load failed" ) ;
+        return false ;
+    }
+    uint32_t schedule = c->seed ? c->seed : 1 ;
+    uint32_t seeds[FUZZ_MAX_LANES] ;
+    for ( uint32_t l = 0 ; l < count ; l++ ) {
+        chip8_t *chip8 = lanes->machines[l] ;
+        seeds[l] = fuzz_random ( &schedule ) ;
+        chip8->quirks_request = c->quirks ;
+        if ( !load_chip8 ( chip8 , c->program , c->length , NULL ) ) {
+            snprintf ( report->what , sizeof ( report->what ) , "load_chip8 rejected the program" ) ;
+            return false ;
+        }
+        chip8->rng = seeds[l] ;
+    }
+    batch_reset ( batch , seeds ) ;
+
+    uint32_t executed = 0 ;
+    bool running = true ;
+    while ( executed < c->steps && running ) {
+        uint32_t chunk = fuzz_random ( &schedule ) % 4 ? 1 + fuzz_random ( &schedule ) % 16 : 1 + fuzz_random ( &schedule ) % FUZZ_MAX_CHUNK ;
+        if ( chunk > c->steps - executed ) chunk = c->steps - executed ;
+
+        const uint64_t ran = batch_step ( batch , chunk ) ;
+        uint64_t expected = 0 ;
+        running = false ;
+        for ( uint32_t l = 0 ; l < count ; l++ ) {
+            if ( lanes->machines[l]->state != RUNNING ) continue ;
+            expected += run_cycles ( lanes->machines[l] , chunk ) ;
+            running = true ;
+        }
+        report->chunk_start = executed ;
+        executed += chunk ;
+        report->executed = executed ;
+        if ( instructions ) *instructions += expected ;
+        if ( ran != expected ) {
+            snprintf ( report->what , sizeof ( report->what ) , "batch_step(%u) ran %llu instructions, the machines %llu" ,
+                      chunk , (unsigned long long)ran , (unsigned long long)expected ) ;
+            return false ;
+        }
+        for ( uint32_t l = 0 ; l < count ; l++ ) {
+            char what[FUZZ_REPORT_MAX - 16] ;
+            batch_export_lane ( batch , l , lanes->lane ) ;
+            if ( !compare_lane ( lanes->lane , lanes->machines[l] , what , sizeof ( what ) ) ) continue ;
+            snprintf ( report->what , sizeof ( report->what ) , "lane %u: %s" , l , what ) ;
+            return false ;
+        }
+
+        // One frame per chunk, as batch.h asks (the VIP profile waits for it after a draw)
+        batch_tick_timers ( batch ) ;
+        for ( uint32_t l = 0 ; l < count ; l++ ) {
+            tick_timers ( lanes->machines[l] ) ;
+            const uint32_t key = fuzz_random ( &schedule ) ;
+            if ( key % 8 ) continue ;
+            const uint32_t k = (key >> 16) & 0xF ;
+            lanes->machines[l]->keypad[k] = !lanes->machines[l]->keypad[k] ;
+            batch->keys[l] ^= (uint16_t)( 1u << k ) ;
+        }
+        // Now and then a lane starts over, or is imported from its own
+        // machine: either takes it out of its group, or off its detached machine
+        const uint32_t event = fuzz_random ( &schedule ) ;
+        if ( event % 32 == 0 ) {
+            const uint32_t l = (event >> 8) % count ;
+            chip8_t *chip8 = lanes->machines[l] ;
+            if ( (event >> 16) % 2 ) {
+                batch_import_lane ( batch , l , chip8 ) ;
+            } else {
+                load_chip8 ( chip8 , c->program , c->length , NULL ) ;
+                chip8->rng = seeds[l] ;
+                batch_reset_lane ( batch , l , seeds[l] ) ;
+                running = true ;
+            }
+        }
+    }
+    return true ;
+}
+
+// The case on the reference and machines[c->jit], or on the lanes
+static bool check_case ( chip8_t *machines[2] , reference_t *ref , fuzz_lanes_t *lanes , const fuzz_case_t *c ,
+                         fuzz_report_t *report , uint64_t *instructions ) {
+    if ( c->lanes ) return run_lanes_case ( lanes , c , report , instructions ) ;
+    return run_case ( machines[c->jit] , ref , c , report , instructions ) ;
+}
+
+// ---------------------------------------------------------------------------
+// Shrinking and regression cases
+// ---------------------------------------------------------------------------
+
+// Make the failing case smaller while it keeps failing
+static void shrink_case ( chip8_t *machines[2] , reference_t *ref , fuzz_lanes_t *lanes , fuzz_case_t *c , fuzz_report_t *report ) {
+    fuzz_case_t *trial = malloc ( sizeof ( fuzz_case_t ) ) ;
+    fuzz_report_t *trial_report = malloc ( sizeof ( fuzz_report_t ) ) ;
+    if ( !trial || !trial_report ) {
+        free ( trial ) ;
+        free ( trial_report ) ;
+        return ;
+    }
+    #define STILL_FAILS() ( !check_case ( machines , ref , lanes , trial , trial_report , NULL ) )
+    #define KEEP() do { *c = *trial ; *report = *trial_report ; changed = true ; } while (0)
+
+    bool changed = true ;
+    while ( changed ) {
+        changed = false ;
+        // Stop right after the difference shows
+        *trial = *c ;
+        trial->steps = report->executed ;
+        if ( trial->steps < c->steps && STILL_FAILS () ) KEEP () ;
+        // An interpreter bug does not need the JIT to show
+        *trial = *c ;
+        trial->jit = false ;
+        if ( c->jit && STILL_FAILS () ) KEEP () ;
+        // Blank instructions one at a time, from the end
+        for ( uint32_t at = c->length & ~1u ; at >= 2 ; at -= 2 ) {
+            if ( c->program[at - 2] == 0 && c->program[at - 1] == 0 ) continue ;
+            *trial = *c ;
+            trial->program[at - 2] = trial->program[at - 1] = 0 ;
+            if ( STILL_FAILS () ) KEEP () ;
+        }
+        // Drop what follows the last instruction that matters
+        *trial = *c ;
+        while ( trial->length > 2 && trial->program[trial->length - 1] == 0 && trial->program[trial->length - 2] == 0 ) trial->length -= 2 ;
+        if ( trial->length < c->length && STILL_FAILS () ) KEEP () ;
+    }
+    #undef STILL_FAILS
+    #undef KEEP
+    free ( trial ) ;
+    free ( trial_report ) ;
+}
+
+// FNV-1a of the program, names the regression file
+static uint64_t case_hash ( const fuzz_case_t *c ) {
+    uint64_t hash = 0xCBF29CE484222325ull ;
+    const uint8_t header[] = { (uint8_t)c->quirks , c->jit , (uint8_t)c->seed , (uint8_t)(c->seed >> 8) ,
+                               (uint8_t)(c->seed >> 16) , (uint8_t)(c->seed >> 24) } ;
+    for ( size_t i = 0 ; i < sizeof ( header ) ; i++ ) hash = (hash ^ header[i]) * 0x100000001B3ull ;
+    if ( c->lanes ) hash = (hash ^ c->lanes) * 0x100000001B3ull ;
+    for ( uint32_t i = 0 ; i < c->length ; i++ ) hash = (hash ^ c->program[i]) * 0x100000001B3ull ;
+    return hash ;
+}
+
+static bool save_case ( const fuzz_case_t *c , const fuzz_report_t *report , const char *directory , char *path , size_t size ) {
+    snprintf ( path , size , "%s/fuzz-%016llx.case" , directory , (unsigned long long)case_hash ( c ) ) ;
+    FILE *file = fopen ( path , "w" ) ;
+    if ( !file ) {
+        CHIP8_LOG ( "Could not write %s\n" , path ) ;
+        return false ;
+    }
+    fprintf ( file , "# chip8-fuzz case: %s after %u instructions\n" , report->what , report->executed ) ;
+    fprintf ( file , "quirks %s\njit %s\nseed 0x%08X\nsteps %u\n" ,
+              chip8_quirk_set ( c->quirks )->name , c->jit ? "on" : "off" , c->seed , c->steps ) ;
+    if ( c->lanes ) fprintf ( file , "lanes %u\n" , c->lanes ) ;
+    fprintf ( file , "program" ) ;
+    for ( uint32_t i = 0 ; i < c->length ; i++ ) fprintf ( file , "%s%02X" , i % 32 == 0 ? "\n" : i % 2 == 0 ? " " : "" , c->program[i] ) ;
+    fprintf ( file , "\n" ) ;
+    return fclose ( file ) == 0 ;
+}
+
+static bool load_case ( const char *path , fuzz_case_t *c ) {
+    FILE *file = fopen ( path , "r" ) ;
+    if ( !file ) {
+        CHIP8_LOG ( "Could not open %s\n" , path ) ;
+        return false ;
+    }
+    memset ( c , 0 , sizeof ( *c ) ) ;
+    c->quirks = QUIRKS_CHIP8 ;
+    c->steps = FUZZ_MAX_STEPS ;
+    bool in_program = false , ok = true ;
+    char line[256] ;
+    while ( ok && fgets ( line , sizeof ( line ) , file ) ) {
+        char key[32] , value[64] ;
+        if ( line[0] == '#' ) continue ;
+        if ( !in_program && sscanf ( line , "%31s %63s" , key , value ) == 2 ) {
+            if ( strcmp ( key , "quirks" ) == 0 ) ok = chip8_parse_quirks ( value , &c->quirks ) && c->quirks != QUIRKS_AUTO ;
+            else if ( strcmp ( key , "jit" ) == 0 ) c->jit = strcmp ( value , "on" ) == 0 ;
+            else if ( strcmp ( key , "seed" ) == 0 ) c->seed = strtoul ( value , NULL , 0 ) ;
+            else if ( strcmp ( key , "steps" ) == 0 ) c->steps = strtoul ( value , NULL , 0 ) ;
+            else if ( strcmp ( key , "lanes" ) == 0 ) ok = ( c->lanes = strtoul ( value , NULL , 0 ) ) <= FUZZ_MAX_LANES ;
+            else ok = false ;
+            continue ;
+        }
+        if ( !in_program && sscanf ( line , "%31s" , key ) == 1 && strcmp ( key , "program" ) == 0 ) {
+            in_program = true ;
+            continue ;
+        }
+        // Program bytes: hex digit pairs, spaces anywhere
+        int high = -1 ;
+        for ( const char *p = line ; *p && ok ; p++ ) {
+            if ( isspace ( (unsigned char)*p ) ) continue ;
+            if ( !isxdigit ( (unsigned char)*p ) || !in_program || c->length >= FUZZ_MAX_PROGRAM ) {
+                ok = false ;
+                break ;
+            }
+            const int digit = isdigit ( (unsigned char)*p ) ? *p - '0' : tolower ( (unsigned char)*p ) - 'a' + 10 ;
+            if ( high < 0 ) high = digit ;
+            else {
+                c->program[c->length++] = (uint8_t)(high << 4 | digit) ;
+                high = -1 ;
+            }
+        }
+    }
+    fclose ( file ) ;
+    if ( !ok ) CHIP8_LOG ( "%s is not a chip8-fuzz case\n" , path ) ;
+    return ok ;
+}
+
+
+// ---------------------------------------------------------------------------
+// Parallel driver
+// ---------------------------------------------------------------------------
+
+typedef enum { FUZZ_JIT_OFF , FUZZ_JIT_ON , FUZZ_JIT_BOTH } fuzz_jit_t ;
+
+typedef struct {
+    uint8_t *rom ;
+    uint32_t size ;
+} corpus_entry_t ;
+
+typedef struct {
+    chip8_t *machines[2] ; // Interpreter, JIT
+    reference_t *reference ;
+    fuzz_lanes_t *lanes ;  // --lanes only
+    fuzz_case_t *scratch ;
+    fuzz_report_t *report ;
+    uint64_t execs ;
+    uint64_t instructions ;
+} fuzz_worker_t ;
+
+typedef struct {
+    uint32_t seed ;
+    quirks_t quirks ;      // QUIRKS_AUTO: a random profile per case
+    fuzz_jit_t jit ;
+    uint32_t lanes ;       // --lanes, 0: the reference instead
+    corpus_entry_t *corpus ;
+    size_t corpus_count ;
+    fuzz_worker_t *workers ;
+    uint64_t first_case ;  // Index of the first case of the current round
+    uint64_t max_execs ;   // 0: until the deadline
+    double deadline ;
+    pthread_mutex_t lock ;
+    bool failed ;          // Set once, stops every worker
+    fuzz_case_t failure ;
+    fuzz_report_t failure_report ;
+    unsigned failure_worker ;
+} fuzzer_t ;
+
+// Case `index` of the run, a pure function of the seed and the index
+static void make_case ( const fuzzer_t *fuzzer , uint64_t index , fuzz_case_t *c ) {
+    uint32_t rng = fuzz_seed ( fuzzer->seed , index ) ;
+    // Batches have no XO-CHIP, the last profile
+    const uint32_t profiles = fuzzer->lanes ? QUIRKS_XO_CHIP - QUIRKS_CHIP8 : QUIRKS_COUNT - 1 ;
+    c->quirks = fuzzer->quirks != QUIRKS_AUTO ? fuzzer->quirks : (quirks_t)( QUIRKS_CHIP8 + fuzz_random ( &rng ) % profiles ) ;
+    const bool jit = fuzzer->jit == FUZZ_JIT_BOTH ? fuzz_random ( &rng ) % 2 : fuzzer->jit == FUZZ_JIT_ON ;
+    c->jit = jit && !chip8_quirk_set ( c->quirks )->xo_chip && !fuzzer->lanes ; // XO-CHIP always runs on the interpreter
+    c->lanes = fuzzer->lanes ;
+    c->seed = fuzz_random ( &rng ) ;
+    c->steps = FUZZ_MAX_STEPS ;
+    if ( fuzzer->corpus_count && fuzz_random ( &rng ) % 2 ) {
+        const corpus_entry_t *entry = &fuzzer->corpus[fuzz_random ( &rng ) % fuzzer->corpus_count] ;
+        mutate_program ( c , entry->rom , entry->size , &rng ) ;
+    } else {
+        generate_program ( c , &rng ) ;
+    }
+}
+
+static bool fuzzer_stopped ( fuzzer_t *fuzzer ) {
+    pthread_mutex_lock ( &fuzzer->lock ) ;
+    const bool failed = fuzzer->failed ;
+    pthread_mutex_unlock ( &fuzzer->lock ) ;
+    return failed ;
+}
+
+// Pool task: FUZZ_BATCH consecutive cases on the worker's machines
+static void fuzz_batch ( void *context , size_t task , unsigned worker_index ) {
+    fuzzer_t *fuzzer = context ;
+    fuzz_worker_t *worker = &fuzzer->workers[worker_index] ;
+    for ( uint32_t i = 0 ; i < FUZZ_BATCH ; i++ ) {
+        const uint64_t index = fuzzer->first_case + (uint64_t)task * FUZZ_BATCH + i ;
+        if ( ( fuzzer->max_execs && index >= fuzzer->max_execs ) || monotonic_seconds () > fuzzer->deadline ) return ;
+        if ( fuzzer_stopped ( fuzzer ) ) return ;
+
+        fuzz_case_t *c = worker->scratch ;
+        make_case ( fuzzer , index , c ) ;
+        worker->execs++ ;
+        if ( check_case ( worker->machines , worker->reference , worker->lanes , c , worker->report , &worker->instructions ) ) continue ;
+
+        pthread_mutex_lock ( &fuzzer->lock ) ;
+        if ( !fuzzer->failed ) {
+            fuzzer->failed = true ;
+            fuzzer->failure = *c ;
+            fuzzer->failure_report = *worker->report ;
+            fuzzer->failure_worker = worker_index ;
+        }
+        pthread_mutex_unlock ( &fuzzer->lock ) ;
+        return ;
+    }
+}
+
+static bool load_corpus ( fuzzer_t *fuzzer , const char *path ) {
+    FILE *file = fopen ( path , "rb" ) ;
+    if ( !file ) {
+        CHIP8_LOG ( "Could not open %s\n" , path ) ;
+        return false ;
+    }
+    corpus_entry_t entry = { .rom = malloc ( FUZZ_MAX_PROGRAM ) } ;
+    corpus_entry_t *grown = realloc ( fuzzer->corpus , ( fuzzer->corpus_count + 1 ) * sizeof ( corpus_entry_t ) ) ;
+    if ( !entry.rom || !grown ) {
+        free ( entry.rom ) ;
+        fclose ( file ) ;
+        return false ;
+    }
+    fuzzer->corpus = grown ;
+    entry.size = (uint32_t)fread ( entry.rom , 1 , FUZZ_MAX_PROGRAM , file ) ;
+    fclose ( file ) ;
+    fuzzer->corpus[fuzzer->corpus_count++] = entry ;
+    return true ;
+}
+
+// Run the saved cases again; the number that still fail
+static int replay_cases ( int count , char const *paths[] ) {
+    chip8_t *machines[2] = { calloc ( 1 , sizeof ( chip8_t ) ) , calloc ( 1 , sizeof ( chip8_t ) ) } ;
+    reference_t *ref = malloc ( sizeof ( reference_t ) ) ;
+    fuzz_case_t *c = malloc ( sizeof ( fuzz_case_t ) ) ;
+    fuzz_report_t *report = malloc ( sizeof ( fuzz_report_t ) ) ;
+    if ( !machines[0] || !machines[1] || !ref || !c || !report ) exit ( EXIT_FAILURE ) ;
+    jit_enable ( machines[1] ) ;
+    fuzz_lanes_t *lanes = NULL ; // The first case with lanes makes them
+
+    int failures = 0 ;
+    for ( int i = 0 ; i < count ; i++ ) {
+        if ( !load_case ( paths[i] , c ) ) {
+            failures++ ;
+            continue ;
+        }
+        if ( c->lanes && !lanes && !( lanes = lanes_create ( FUZZ_MAX_LANES ) ) ) exit ( EXIT_FAILURE ) ;
+        if ( c->jit && !machines[1]->jit ) CHIP8_LOG ( "%s: no JIT on this machine, replaying on the interpreter\n" , paths[i] ) ;
+        if ( check_case ( machines , ref , lanes , c , report , NULL ) ) {
+            printf ( "%s: ok (%u instructions)\n" , paths[i] , report->executed ) ;
+            continue ;
+        }
+        printf ( "%s: ", paths[i] ) ;
+        print_case ( stdout , c , report , ref ) ;
+        failures++ ;
+    }
+    jit_disable ( machines[1] ) ;
+    free_chip8 ( machines[0] ) ;
+    free_chip8 ( machines[1] ) ;
+    free ( machines[0] ) ;
+    free ( machines[1] ) ;
+    lanes_destroy ( lanes ) ;
+    free ( ref ) ;
+    free ( c ) ;
+    free ( report ) ;
+    return failures ;
+}
+
+static void usage ( const char *program ) {
+    fprintf ( stderr ,
+        "Usage: %s [options] [seed_rom ...]\n"
+        "       %s --replay case_file ...\n"
+        "  --seconds N       stop after N seconds (default 10)\n"
+        "  --execs N         stop after N cases\n"
+        "  --threads N       worker threads (default: one per core)\n"
+        "  --seed N          run seed, cases are reproducible from it (default 1)\n"
+        "  --quirks NAME     fuzz one profile: chip8, vip, chip48, schip or xochip (default: all)\n"
+        "  --jit on|off|both run cases on the JIT, the interpreter or either (default both)\n"
+        "  --lanes N         check a batch of N lanes (1-64) against N machines instead of the reference (no xochip)\n"
+        "  --out DIR         where the failing case is saved (default .)\n"
+        "Seed ROMs are mutated for half of the cases, the rest are generated.\n"
+        , program , program ) ;
+}
+
+int main ( int argc , char const *argv[] ) {
+    fuzzer_t fuzzer = { .seed = 1 , .jit = FUZZ_JIT_BOTH } ;
+    unsigned threads = workpool_default_threads () ;
+    double seconds = 10 ;
+    const char *out = "." ;
+
+    for ( int i = 1 ; i < argc ; i++ ) {
+        const bool has_value = i + 1 < argc ;
+        if ( strcmp ( argv[i] , "--replay" ) == 0 ) {
+            if ( !has_value ) {
+                usage ( argv[0] ) ;
+                exit ( EXIT_FAILURE ) ;
+            }
+            return replay_cases ( argc - i - 1 , &argv[i + 1] ) ? EXIT_FAILURE : EXIT_SUCCESS ;
+        }
+        if ( strcmp ( argv[i] , "--seconds" ) == 0 && has_value ) seconds = strtod ( argv[++i] , NULL ) ;
+        else if ( strcmp ( argv[i] , "--execs" ) == 0 && has_value ) fuzzer.max_execs = strtoull ( argv[++i] , NULL , 10 ) ;
+        else if ( strcmp ( argv[i] , "--threads" ) == 0 && has_value ) threads = strtoul ( argv[++i] , NULL , 10 ) ;
+        else if ( strcmp ( argv[i] , "--seed" ) == 0 && has_value ) fuzzer.seed = strtoul ( argv[++i] , NULL , 0 ) ;
+        else if ( strcmp ( argv[i] , "--out" ) == 0 && has_value ) out = argv[++i] ;
+        else if ( strcmp ( argv[i] , "--lanes" ) == 0 && has_value ) fuzzer.lanes = strtoul ( argv[++i] , NULL , 10 ) ;
+        else if ( strcmp ( argv[i] , "--quirks" ) == 0 && has_value ) {
+            if ( !chip8_parse_quirks ( argv[++i] , &fuzzer.quirks ) ) exit ( EXIT_FAILURE ) ;
+        }
+        else if ( strcmp ( argv[i] , "--jit" ) == 0 && has_value ) {
+            const char *mode = argv[++i] ;
+            if ( strcmp ( mode , "on" ) == 0 ) fuzzer.jit = FUZZ_JIT_ON ;
+            else if ( strcmp ( mode , "off" ) == 0 ) fuzzer.jit = FUZZ_JIT_OFF ;
+            else if ( strcmp ( mode , "both" ) == 0 ) fuzzer.jit = FUZZ_JIT_BOTH ;
+            else {
+                usage ( argv[0] ) ;
+                exit ( EXIT_FAILURE ) ;
+            }
+        }
+        else if ( argv[i][0] == '-' ) {
+            usage ( argv[0] ) ;
+            exit ( EXIT_FAILURE ) ;
+        }
+        else if ( !load_corpus ( &fuzzer , argv[i] ) ) exit ( EXIT_FAILURE ) ;
+    }
+    if ( threads == 0 || fuzzer.lanes > FUZZ_MAX_LANES || ( fuzzer.lanes && fuzzer.quirks == QUIRKS_XO_CHIP ) ) {
+        usage ( argv[0] ) ;
+        exit ( EXIT_FAILURE ) ;
+    }
+
+    pthread_mutex_init ( &fuzzer.lock , NULL ) ;
+    fuzzer.workers = calloc ( threads , sizeof ( fuzz_worker_t ) ) ;
+    if ( !fuzzer.workers ) exit ( EXIT_FAILURE ) ;
+    bool jit = false ;
+    for ( unsigned w = 0 ; w < threads ; w++ ) {
+        fuzz_worker_t *worker = &fuzzer.workers[w] ;
+        worker->machines[0] = calloc ( 1 , sizeof ( chip8_t ) ) ;
+        worker->machines[1] = calloc ( 1 , sizeof ( chip8_t ) ) ;
+        worker->reference = malloc ( sizeof ( reference_t ) ) ;
+        worker->scratch = malloc ( sizeof ( fuzz_case_t ) ) ;
+        worker->report = malloc ( sizeof ( fuzz_report_t ) ) ;
+        worker->lanes = fuzzer.lanes ? lanes_create ( fuzzer.lanes ) : NULL ;
+        if ( !worker->machines[0] || !worker->machines[1] || !worker->reference || !worker->scratch || !worker->report ||
+             ( fuzzer.lanes && !worker->lanes ) ) {
+            exit ( EXIT_FAILURE ) ;
+        }
+        jit = jit_enable ( worker->machines[1] ) ;
+    }
+    if ( fuzzer.jit != FUZZ_JIT_OFF && !jit ) CHIP8_LOG ( "No JIT on this machine: JIT cases run on the interpreter\n" ) ;
+
+    // Rounds of a few tasks per worker, with a progress line after each
+    const double start = monotonic_seconds () ;
+    fuzzer.deadline = start + seconds ;
+    const size_t tasks = (size_t)threads * 8 ;
+    double last_report = start ;
+    uint64_t execs = 0 , instructions = 0 ;
+    while ( !fuzzer.failed && monotonic_seconds () < fuzzer.deadline && ( !fuzzer.max_execs || fuzzer.first_case < fuzzer.max_execs ) ) {
+        workpool_run ( threads , tasks , fuzz_batch , &fuzzer ) ;
+        fuzzer.first_case += tasks * FUZZ_BATCH ;
+        execs = instructions = 0 ;
+        for ( unsigned w = 0 ; w < threads ; w++ ) {
+            execs += fuzzer.workers[w].execs ;
+            instructions += fuzzer.workers[w].instructions ;
+        }
+        const double now = monotonic_seconds () ;
+        if ( now - last_report >= 1.0 ) {
+            fprintf ( stderr , "%llu execs, %.0f execs/s, %.1f M instructions/s\n" , (unsigned long long)execs ,
+                      execs / ( now - start ) , instructions / ( now - start ) / 1e6 ) ;
+            last_report = now ;
+        }
+    }
+    const double elapsed = monotonic_seconds () - start ;
+    printf ( "%llu execs on %u threads in %.2f s (%.0f execs/s, %llu instructions), %s\n" ,
+             (unsigned long long)execs , threads , elapsed , elapsed > 0 ? execs / elapsed : 0.0 ,
+             (unsigned long long)instructions , fuzzer.failed ? "MISMATCH" : "no mismatch" ) ;
+
+    int status = EXIT_SUCCESS ;
+    if ( fuzzer.failed ) {
+        fuzz_worker_t *worker = &fuzzer.workers[fuzzer.failure_worker] ;
+        shrink_case ( worker->machines , worker->reference , worker->lanes , &fuzzer.failure , &fuzzer.failure_report ) ;
+        // Run the shrunk case once more so the reference holds its final state for the listing
+        check_case ( worker->machines , worker->reference , worker->lanes , &fuzzer.failure , &fuzzer.failure_report , NULL ) ;
+        print_case ( stdout , &fuzzer.failure , &fuzzer.failure_report , worker->reference ) ;
+        char path[1024] ;
+        if ( save_case ( &fuzzer.failure , &fuzzer.failure_report , out , path , sizeof ( path ) ) ) printf ( "Saved %s\n" , path ) ;
+        status = EXIT_FAILURE ;
+    }
+
+    for ( unsigned w = 0 ; w < threads ; w++ ) {
+        fuzz_worker_t *worker = &fuzzer.workers[w] ;
+        jit_disable ( worker->machines[1] ) ;
+        free_chip8 ( worker->machines[0] ) ;
+        free_chip8 ( worker->machines[1] ) ;
+        free ( worker->machines[0] ) ;
+        free ( worker->machines[1] ) ;
+        free ( worker->reference ) ;
+        lanes_destroy ( worker->lanes ) ;
+        free ( worker->scratch ) ;
+        free ( worker->report ) ;
+    }
+    for ( size_t i = 0 ; i < fuzzer.corpus_count ; i++ ) free ( fuzzer.corpus[i].rom ) ;
+    free ( fuzzer.corpus ) ;
+    free ( fuzzer.workers ) ;
+    pthread_mutex_destroy ( &fuzzer.lock ) ;
+    return status ;
+}
+
+#endif // CHIP8_LIBFUZZER
@@ -0,0 +1,248 @@
+/**
+ * @file headless.c
+ * @brief Uncapped Batch Runner (no window, no audio)
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * Runs a ROM for a number of frames or instructions as fast as possible,
+ * optionally with a scripted keypad, then prints throughput and a hash
+ * of the final framebuffer. It also records and replays input movies
+ * (see movie.h), exports every frame as video or images (see export.h)
+ * and runs under the debugger prompt (see debugger.h). Links only the
+ * SDL-free core library, so it runs on CI machines without a display.
+ */
+
+#include "chip8.h"
+#include "aot.h"
+#include "config.h"
+#include "debugger.h"
+#include "export.h"
+#include "jit.h"
+#include "library.h"
+#include "movie.h"
+#include "runner.h"
+#include "profiler.h"
+
+// run_options_t::frame_done
+static void export_callback ( const chip8_t *chip8 , uint64_t frame , void *context ) {
+    export_frame ( context , chip8 , frame ) ;
+}
+
+// run_options_t::paused: a breakpoint or watchpoint stopped the run
+static bool debug_callback ( chip8_t *chip8 , void *context ) {
+    (void)context ;
+    return debugger_prompt ( chip8 , stdin , stdout ) ;
+}
+
+static void usage ( const char *program ) {
+    fprintf ( stderr ,
+        "Usage: %s [options] <rom_file>\n"
+        "  --frames N        run N 60 Hz frames (default 600 when no limit is given)\n"
+        "  --instructions N  run N instructions\n"
+        "  --ips N           instructions per second of emulated time (default from the library or config)\n"
+        "  --input FILE      scripted keypad input\n"
+        "  --vip-timing      COSMAC VIP per-opcode timings instead of --ips\n"
+        "  --seed N          RNG seed for CXNN\n"
+        "  --quirks NAME     quirk profile: auto (default), chip8, vip, chip48, schip or xochip\n"
+        "  --library FILE    ROM index with per-ROM settings (default chip8-library.txt)\n"
+        "  --record FILE     save the run as a movie\n"
+        "  --replay FILE     replay a movie and check its final hashes (other run options are ignored)\n"
+        "  --jit             use the x86-64 JIT\n"
+        "  --no-idle-skip    run idle loops out instead of skipping them, to time the core\n"
+        "  --aot MODULE      run on a module built by chip8-aot for this ROM\n"
+        "  --export FILE     write every frame to FILE (.y4m video, .png sequence, otherwise raw RGBA)\n"
+        "  --export-format F y4m, raw or png, overriding the extension\n"
+        "  --export-scale N  output pixels per 128x64 pixel (default 1)\n"
+        "  --dedupe          skip exported frames identical to the previous one\n"
+        "  --debug           start at the debugger prompt (breakpoints, watchpoints, stepping; type help)\n"
+#ifdef CHIP8_PROFILE
+        "  --profile FILE    write the profiler report and PC histogram to FILE (runs on the interpreter)\n"
+#endif
+        , program ) ;
+}
+
+int main ( int argc , char const *argv[] ) {
+    config_t config = {0} ;
+    if ( !init_config ( &config ) ) exit ( EXIT_FAILURE ) ;
+
+    run_options_t options = {0} ;
+    const char *rom_name = NULL ;
+    const char *script_name = NULL ;
+    const char *record_name = NULL ;
+    const char *replay_name = NULL ;
+    const char *export_name = NULL ;
+    const char *export_format = NULL ;
+    const char *aot_name = NULL ;
+    uint32_t export_scale = 1 ;
+    bool dedupe = false ;
+    bool debug = false ;
+    bool idle_skip_off = false ;
+#ifdef CHIP8_PROFILE
+    const char *profile_name = NULL ;
+#endif
+    uint32_t seed = CHIP8_RNG_SEED ;
+    quirks_t quirks = QUIRKS_AUTO ;
+
+    for ( int i = 1 ; i < argc ; i++ ) {
+        const bool has_value = i + 1 < argc ;
+        if ( strcmp ( argv[i] , "--frames" ) == 0 && has_value ) options.max_frames = strtoull ( argv[++i] , NULL , 10 ) ;
+        else if ( strcmp ( argv[i] , "--instructions" ) == 0 && has_value ) options.max_instructions = strtoull ( argv[++i] , NULL , 10 ) ;
+        else if ( strcmp ( argv[i] , "--ips" ) == 0 && has_value ) options.instructions_per_second = strtoul ( argv[++i] , NULL , 10 ) ;
+        else if ( strcmp ( argv[i] , "--input" ) == 0 && has_value ) script_name = argv[++i] ;
+        else if ( strcmp ( argv[i] , "--vip-timing" ) == 0 ) options.vip_timing = true ;
+        else if ( strcmp ( argv[i] , "--seed" ) == 0 && has_value ) seed = strtoul ( argv[++i] , NULL , 0 ) ;
+        else if ( strcmp ( argv[i] , "--quirks" ) == 0 && has_value ) {
+            if ( !chip8_parse_quirks ( argv[++i] , &quirks ) ) exit ( EXIT_FAILURE ) ;
+        }
+        else if ( strcmp ( argv[i] , "--library" ) == 0 && has_value ) config.library_path = argv[++i] ;
+        else if ( strcmp ( argv[i] , "--record" ) == 0 && has_value ) record_name = argv[++i] ;
+        else if ( strcmp ( argv[i] , "--replay" ) == 0 && has_value ) replay_name = argv[++i] ;
+        else if ( strcmp ( argv[i] , "--jit" ) == 0 ) config.use_jit = true ;
+        else if ( strcmp ( argv[i] , "--no-idle-skip" ) == 0 ) idle_skip_off = true ;
+        else if ( strcmp ( argv[i] , "--aot" ) == 0 && has_value ) aot_name = argv[++i] ;
+        else if ( strcmp ( argv[i] , "--export" ) == 0 && has_value ) export_name = argv[++i] ;
+        else if ( strcmp ( argv[i] , "--export-format" ) == 0 && has_value ) export_format = argv[++i] ;
+        else if ( strcmp ( argv[i] , "--export-scale" ) == 0 && has_value ) export_scale = strtoul ( argv[++i] , NULL , 10 ) ;
+        else if ( strcmp ( argv[i] , "--dedupe" ) == 0 ) dedupe = true ;
+        else if ( strcmp ( argv[i] , "--debug" ) == 0 ) debug = true ;
+#ifdef CHIP8_PROFILE
+        else if ( strcmp ( argv[i] , "--profile" ) == 0 && has_value ) profile_name = argv[++i] ;
+#endif
+        else if ( argv[i][0] == '-' ) {
+            usage ( argv[0] ) ;
+            exit ( EXIT_FAILURE ) ;
+        }
+        else rom_name = argv[i] ;
+    }
+    if ( !rom_name ) {
+        usage ( argv[0] ) ;
+        exit ( EXIT_FAILURE ) ;
+    }
+    if ( record_name && options.max_instructions ) {
+        // An instruction limit can stop mid-frame, which a frame-based movie cannot reproduce
+        fprintf ( stderr , "--record needs a frame limit, not --instructions\n" ) ;
+        exit ( EXIT_FAILURE ) ;
+    }
+    if ( options.max_frames == 0 && options.max_instructions == 0 ) options.max_frames = 600 ;
+
+    // Per-ROM settings from the library, the command line still wins
+    library_t library ;
+    if ( !library_load ( &library , config.library_path ) ) exit ( EXIT_FAILURE ) ;
+    const library_entry_t *entry = library_lookup_rom ( &library , rom_name ) ;
+    if ( entry ) library_apply ( entry , &config , &quirks ) ;
+    library_free ( &library ) ;
+    if ( options.instructions_per_second == 0 ) options.instructions_per_second = config.instructions_per_second ;
+
+    export_options_t export_options ;
+    export_default_options ( &export_options , &config , export_name ) ;
+    export_options.scale = export_scale ;
+    export_options.dedupe = dedupe ;
+    if ( export_format && !export_parse_format ( export_format , &export_options.format ) ) {
+        fprintf ( stderr , "Unknown export format %s (y4m, raw or png)\n" , export_format ) ;
+        exit ( EXIT_FAILURE ) ;
+    }
+
+    input_script_t script = {0} ;
+    if ( script_name ) {
+        if ( !load_input_script ( &script , script_name ) ) exit ( EXIT_FAILURE ) ;
+        options.script = &script ;
+    }
+
+    chip8_t *chip8 = calloc ( 1 , sizeof ( chip8_t ) ) ;
+    if ( !chip8 ) exit ( EXIT_FAILURE ) ;
+    if ( config.use_jit && !jit_enable ( chip8 ) ) fprintf ( stderr , "JIT not available on this host, using the interpreter\n" ) ;
+    if ( aot_name && !aot_load ( chip8 , aot_name ) ) exit ( EXIT_FAILURE ) ;
+    movie_t movie ;
+    chip8->quirks_request = quirks ;
+    chip8->idle_skip_off = idle_skip_off ;
+    if ( replay_name ) {
+        if ( !movie_load ( &movie , replay_name ) ) exit ( EXIT_FAILURE ) ;
+        chip8->quirks_request = movie.quirks ; // Replays run with the recorded profile
+    }
+    if ( !init_chip8 ( chip8 , rom_name ) ) exit ( EXIT_FAILURE ) ;
+    if ( chip8->aot && !chip8->aot->active ) {
+        fprintf ( stderr , "%s was not compiled from this ROM with the %s profile, not using it\n" , aot_name ,
+                  chip8_quirk_set ( chip8->quirks )->name ) ;
+    }
+#ifdef CHIP8_PROFILE
+    if ( profile_name && !profiler_attach ( chip8 ) ) exit ( EXIT_FAILURE ) ;
+#endif
+
+    run_result_t result ;
+    if ( replay_name ) {
+        const bool match = movie_replay ( &movie , chip8 , &result ) ;
+        printf ( "rom=%s movie=%s frames=%llu instructions=%llu seconds=%.6f replay=%s\n" ,
+                 rom_name , replay_name , (unsigned long long)result.frames , (unsigned long long)result.instructions ,
+                 result.seconds , match ? "match" : "MISMATCH" ) ;
+        if ( !match ) {
+            fprintf ( stderr , "expected display_hash=%016llx state_hash=%016llx, got display_hash=%016llx state_hash=%016llx\n" ,
+                      (unsigned long long)movie.display_hash , (unsigned long long)movie.state_hash ,
+                      (unsigned long long)display_hash ( chip8 ) , (unsigned long long)state_hash ( chip8 ) ) ;
+        }
+        movie_free ( &movie ) ;
+#ifdef CHIP8_PROFILE
+        if ( profile_name ) profiler_write ( chip8 , profile_name ) ;
+        profiler_detach ( chip8 ) ;
+#endif
+        jit_disable ( chip8 ) ;
+        aot_unload ( chip8 ) ;
+        free_chip8 ( chip8 ) ;
+        free ( chip8 ) ;
+        free_input_script ( &script ) ;
+        return match ? EXIT_SUCCESS : EXIT_FAILURE ;
+    }
+
+    exporter_t *exporter = NULL ;
+    if ( export_name ) {
+        exporter = export_open ( export_name , &export_options ) ;
+        if ( !exporter ) exit ( EXIT_FAILURE ) ;
+        options.frame_done = export_callback ;
+        options.frame_context = exporter ;
+    }
+
+    movie_begin ( &movie , chip8 , seed , options.instructions_per_second , options.vip_timing ) ;
+    if ( debug ) {
+        if ( !debugger_attach ( chip8 ) ) exit ( EXIT_FAILURE ) ;
+        options.paused = debug_callback ;
+        debugger_prompt ( chip8 , stdin , stdout ) ; // quit leaves the machine STOPPED: nothing runs
+    }
+    run_headless ( chip8 , &options , &result ) ;
+
+    const double ips = result.seconds > 0 ? result.instructions / result.seconds : 0 ;
+    printf ( "rom=%s quirks=%s frames=%llu instructions=%llu seconds=%.6f ips=%.0f display_hash=%016llx\n" ,
+             rom_name , chip8_quirk_set ( chip8->quirks )->name , (unsigned long long)result.frames , (unsigned long long)result.instructions ,
+             result.seconds , ips , (unsigned long long)display_hash ( chip8 ) ) ;
+
+    int status = EXIT_SUCCESS ;
+    if ( exporter ) {
+        uint64_t written = 0 ;
+        if ( !export_close ( exporter , &written ) ) status = EXIT_FAILURE ;
+        fprintf ( stderr , "Exported %llu of %llu frames to %s\n" , (unsigned long long)written ,
+                  (unsigned long long)result.frames , export_name ) ;
+    }
+
+    // The script already is the keypad log: the movie only adds the seed, pacing and final hashes
+    if ( record_name ) {
+        if ( script_name ) {
+            for ( size_t i = 0 ; i < script.count ; i++ ) {
+                if ( script.events[i].frame < result.frames ) push_input_event ( &movie.input , script.events[i] ) ;
+            }
+        }
+        movie.frames = result.frames ;
+        movie_end ( &movie , chip8 ) ;
+        if ( !movie_save ( &movie , record_name ) ) status = EXIT_FAILURE ;
+    }
+    movie_free ( &movie ) ;
+
+#ifdef CHIP8_PROFILE
+    if ( profile_name && !profiler_write ( chip8 , profile_name ) ) status = EXIT_FAILURE ;
+    profiler_detach ( chip8 ) ;
+#endif
+    debugger_detach ( chip8 ) ;
+    jit_disable ( chip8 ) ;
+    aot_unload ( chip8 ) ;
+    free_chip8 ( chip8 ) ;
+    free ( chip8 ) ;
+    free_input_script ( &script ) ;
+    return status ;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file library.c
+ * @brief ROM Library Maintenance Tool
+ * @author Abderrahmane Benchikh
+ * @date 2025
+ *
+ * Builds and edits the ROM index that chip8 and chip8-headless read at
+ * startup (see library.h):
+ *
+ *     chip8-library scan roms/              index new and changed ROMs
+ *     chip8-library list                    one line per ROM
+ *     chip8-library set roms/Tetris.ch8 ips=700 quirks=vip
+ *     chip8-library show roms/Tetris.ch8    settings a ROM would start with
+ *
+ * `set` and `show` take a ROM file or the hash printed by `list`.
+ */
+
+#include "chip8.h"
+#include "config.h"
+#include "library.h"
+
+static void usage ( const char *program , const char *index ) {
+    fprintf ( stderr ,
+        "Usage: %s [--index FILE] <command>\n"
+        "  scan DIR...              index the ROMs under each directory (only new or changed files are read)\n"
+        "  list                     print the index\n"
+        "  set ROM|HASH KEY=VALUE... title=TEXT, quirks=NAME, ips=N or keys=16 hex digits; VALUE - clears it\n"
+        "  show ROM|HASH            print the settings the ROM starts with\n"
+        "  --index FILE             index to use (default %s)\n"
+        , program , index ) ;
+}
+
+// A ROM file if one exists at `name`, otherwise a hash from `list`
+static library_entry_t *find_rom ( const library_t *library , const char *name ) {
+    FILE *file = fopen ( name , "rb" ) ;
+    library_entry_t *entry = NULL ;
+    if ( file ) {
+        fclose ( file ) ;
+        entry = library_lookup_rom ( library , name ) ;
+    }
+    else {
+        char *end ;
+        const uint64_t hash = strtoull ( name , &end , 16 ) ;
+        if ( *end == '\0' && end != name ) entry = library_find ( library , hash ) ;
+    }
+    if ( !entry ) fprintf ( stderr , "%s is not in the library, run chip8-library scan first\n" , name ) ;
+    return entry ;
+}
+
+static void print_entry ( const library_entry_t *entry ) {
+    char ips[16] = "-" ;
+    if ( entry->ips ) snprintf ( ips , sizeof ( ips ) , "%u" , entry->ips ) ;
+    printf ( "%016llx  %-24s  quirks=%-6s  ips=%-5s  keys=%s  %s\n" , (unsigned long long)entry->hash , entry->title ,
+             entry->quirks == QUIRKS_AUTO ? "-" : chip8_quirk_set ( entry->quirks )->name , ips ,
+             entry->has_keymap ? "custom" : "-" , entry->path ) ;
+}
+
+int main ( int argc , char const *argv[] ) {
+    config_t config = {0} ;
+    if ( !init_config ( &config ) ) exit ( EXIT_FAILURE ) ;
+
+    int first = 1 ;
+    if ( argc > 2 && strcmp ( argv[1] , "--index" ) == 0 ) {
+        config.library_path = argv[2] ;
+        first = 3 ;
+    }
+    if ( first >= argc ) {
+        usage ( argv[0] , config.library_path ) ;
+        exit ( EXIT_FAILURE ) ;
+    }
+    const char *command = argv[first] ;
+    const int count = argc - first - 1 ;
+    const char *const *args = &argv[first + 1] ;
+
+    library_t library ;
+    if ( !library_load ( &library , config.library_path ) ) exit ( EXIT_FAILURE ) ;
+
+    int status = EXIT_SUCCESS ;
+    bool changed = false ;
+    if ( strcmp ( command , "scan" ) == 0 && count > 0 ) {
+        for ( int i = 0 ; i < count ; i++ ) {
+            library_scan_t stats ;
+            if ( !library_scan ( &library , args[i] , &stats ) ) status = EXIT_FAILURE ;
+            printf ( "%s: %u ROMs, %u read, %u new, %u removed\n" , args[i] , stats.files , stats.hashed , stats.added , stats.removed ) ;
+            changed = changed || stats.hashed || stats.removed ;
+        }
+    }
+    else if ( strcmp ( command , "list" ) == 0 && count == 0 ) {
+        for ( size_t i = 0 ; i < library.count ; i++ ) print_entry ( &library.entries[i] ) ;
+    }
+    else if ( strcmp ( command , "set" ) == 0 && count > 1 ) {
+        library_entry_t *entry = find_rom ( &library , args[0] ) ;
+        if ( !entry ) status = EXIT_FAILURE ;
+        for ( int i = 1 ; entry && i < count ; i++ ) {
+            if ( !library_set ( entry , args[i] ) ) status = EXIT_FAILURE ;
+        }
+        changed = entry && status == EXIT_SUCCESS ;
+        if ( changed ) print_entry ( entry ) ;
+    }
+    else if ( strcmp ( command , "show" ) == 0 && count == 1 ) {
+        const library_entry_t *entry = find_rom ( &library , args[0] ) ;
+        if ( entry ) {
+            quirks_t quirks = QUIRKS_AUTO ;
+            library_apply ( entry , &config , &quirks ) ;
+            printf ( "title=%s\nquirks=%s\nips=%u\nkeys=" , entry->title ,
+                     quirks == QUIRKS_AUTO ? "auto" : chip8_quirk_set ( quirks )->name , config.instructions_per_second ) ;
+            for ( int k = 0 ; k < 16 ; k++ ) printf ( "%X" , config.keymap[k] ) ;
+            printf ( "\n" ) ;
+        }
+        else status = EXIT_FAILURE ;
+    }
+    else {
+        usage ( argv[0] , config.library_path ) ;
+        status = EXIT_FAILURE ;
+    }
+
+    if ( changed && !library_save ( &library , config.library_path ) ) status = EXIT_FAILURE ;
+    library_free ( &library ) ;
+    return status ;
+}